@@ -220,6 +220,10 @@ typedef struct
 #define	R_386_RELATIVE	8
 #define	R_386_GOTOFF	9
 #define	R_386_GOTPC	10
+#define	R_386_TLS_TPOFF	14		/* Negative offset in static TLS block */
+#define	R_386_TLS_DTPMOD32	35	/* Module containing the symbol */
+#define	R_386_TLS_DTPOFF32	36	/* Offset in the modules TLS block */
+#define	R_386_TLS_TPOFF32	37	/* Positive offset in static TLS block */
 
 // Program header
 
@@ -313,6 +317,9 @@ typedef struct
 #define DT_HIPROC	0x7fffffff	/* End of processor-specific */
 #define	DT_PROCNUM	DT_MIPS_NUM	/* Most used by any processor */
 
+#define DF_TEXTREL	0x4		/* DT_FLAGS, relocations might modify .text */
+#define DT_GNU_HASH	0x6ffffef5	/* GNU-style hash table */
+
 static inline uint32_t elf_hash(const char *name)
 {
 	uint8_t *buffer = (uint8_t *)name;
@@ -336,4 +343,18 @@ static inline uint32_t elf_hash(const char *name)
 	return h;
 }
 
+static inline uint32_t elf_gnuHash(const char *name)
+{
+	uint8_t *buffer = (uint8_t *)name;
+	uint32_t h = 5381;
+
+	while(*buffer != '\0')
+	{
+		h = (h << 5) + h + *buffer;
+		buffer ++;
+	}
+
+	return h;
+}
+
 #endif /* _ELF_H_ */
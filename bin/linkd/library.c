@@ -16,6 +16,7 @@
 //  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 
+#include <sys/syscall.h>
 #include <sys/fcntl.h>
 #include <sys/unistd.h>
 #include <sys/mman.h>
@@ -25,6 +26,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
 #include <dlfcn.h>
 #include "library.h"
@@ -33,6 +35,15 @@ library_t *__library_first = NULL;
 library_t *__library_main  = NULL;
 spinlock_t __library_lock = SPINLOCK_INIT;
 
+#if LIBRARY_REPORT_STARTUP
+uint32_t __library_lookups = 0;
+uint32_t __library_cacheHits = 0;
+#endif
+
+static size_t __library_tlsSize = 0;
+static size_t __library_tlsAlignment = 1;
+static bool __library_tlsCommitted = false;
+
 bool library_resolveDependencies(library_t *library)
 {
 	dependency_t *dep = library->dependency;
@@ -66,6 +77,90 @@ bool library_resolveDependencies(library_t *library)
 	return true;
 }
 
+bool library_scopeContains(library_t **scope, size_t count, library_t *library)
+{
+	for(size_t i=0; i<count; i++)
+	{
+		if(scope[i] == library)
+			return true;
+	}
+
+	return false;
+}
+
+bool library_buildScope(library_t *library)
+{
+	size_t capacity = 8;
+	size_t count = 0;
+
+	library_t **scope = malloc(capacity * sizeof(library_t *));
+	if(!scope)
+		return false;
+
+	if(__library_main && __library_main != library)
+		scope[count ++] = __library_main;
+
+	// The scope doubles as the queue for the breadth first walk, starting with the library itself
+	size_t root = count;
+	scope[count ++] = library;
+
+	for(size_t i=root; i<count; i++)
+	{
+		for(dependency_t *dep = scope[i]->dependency; dep; dep = dep->next)
+		{
+			if(!dep->library || library_scopeContains(scope, count, dep->library))
+				continue;
+
+			if(count == capacity)
+			{
+				library_t **temp = realloc(scope, (capacity * 2) * sizeof(library_t *));
+				if(!temp)
+				{
+					free(scope);
+					return false;
+				}
+
+				scope = temp;
+				capacity *= 2;
+			}
+
+			scope[count ++] = dep->library;
+		}
+	}
+
+	// Libraries look at their own symbols last, the main program first
+	if(library != __library_main)
+	{
+		memmove(&scope[root], &scope[root + 1], (count - root - 1) * sizeof(library_t *));
+		scope[count - 1] = library;
+	}
+
+	library->scope = scope;
+	library->scopeCount = count;
+
+	// Without the cache lookups are just slower
+	if(library->symbolCount > 0)
+		library->symbolCache = calloc(library->symbolCount, sizeof(library_symbol_cache_t));
+
+	return true;
+}
+
+bool library_extendGlobalScope(library_t *library)
+{
+	// Libraries loaded before the main program got its scope end up in it through the dependency walk
+	if(!__library_main || !__library_main->scope || library_scopeContains(__library_main->scope, __library_main->scopeCount, library))
+		return true;
+
+	library_t **scope = realloc(__library_main->scope, (__library_main->scopeCount + 1) * sizeof(library_t *));
+	if(!scope)
+		return false;
+
+	scope[__library_main->scopeCount ++] = library;
+	__library_main->scope = scope;
+
+	return true;
+}
+
 void library_digestDynamic(library_t *library)
 {
 	elf_dyn_t *dyn;
@@ -159,6 +254,21 @@ void library_digestDynamic(library_t *library)
 				library->chains   = library->buckets + library->nbuckets;
 				break;
 
+			case DT_GNU_HASH:
+			{
+				uint32_t *table = (uint32_t *)(library->relocBase + dyn->d_un.d_ptr);
+
+				library->gnuNBuckets   = table[0];
+				library->gnuSymOffset  = table[1];
+				library->gnuBloomSize  = table[2];
+				library->gnuBloomShift = table[3];
+
+				library->gnuBloom   = table + 4;
+				library->gnuBuckets = library->gnuBloom + library->gnuBloomSize;
+				library->gnuChains  = library->gnuBuckets + library->gnuNBuckets;
+				break;
+			}
+
 			case DT_PLTREL:
 				usePLTRel  = (dyn->d_un.d_val == DT_REL);
 				usePLTRela = (dyn->d_un.d_val == DT_RELA);
@@ -185,6 +295,31 @@ void library_digestDynamic(library_t *library)
 	library->rellimit  = (elf_rel_t *)((uint8_t *)library->rel + relSize);
 	library->relalimit = (elf_rela_t *)((uint8_t *)library->rela + relaSize);
 
+	// Symbol count
+	if(library->hashtab)
+	{
+		library->symbolCount = library->nchains;
+	}
+	else if(library->gnuBuckets)
+	{
+		// The GNU hash table doesn't store the count, the last chain ends with the last symbol
+		uint32_t last = 0;
+		for(uint32_t i=0; i<library->gnuNBuckets; i++)
+			last = MAX(last, library->gnuBuckets[i]);
+
+		if(last >= library->gnuSymOffset)
+		{
+			while(!(library->gnuChains[last - library->gnuSymOffset] & 1))
+				last ++;
+
+			library->symbolCount = last + 1;
+		}
+		else
+		{
+			library->symbolCount = library->gnuSymOffset;
+		}
+	}
+
 	if(usePLTRel)
 	{
 		library->pltRel = (elf_rel_t *)(library->relocBase + pltRel);
@@ -203,56 +338,118 @@ void library_digestDynamic(library_t *library)
 
 elf_sym_t *library_lookupSymbol(library_t *library, uint32_t symNum, library_t **outLib)
 {
+	library_symbol_cache_t *cache = NULL;
+
+#if LIBRARY_REPORT_STARTUP
+	__library_lookups ++;
+#endif
+
+	if(library->symbolCache && symNum < library->symbolCount)
+	{
+		cache = &library->symbolCache[symNum];
+		if(cache->symbol)
+		{
+#if LIBRARY_REPORT_STARTUP
+			__library_cacheHits ++;
+#endif
+
+			*outLib = cache->library;
+			return cache->symbol;
+		}
+	}
+
 	elf_sym_t *lookup = library->symtab + symNum;
 	const char *name  = library->strtab + lookup->st_name;
 
+	elf_sym_t *symbol = NULL;
+	library_t *container = library;
+
 	if(ELF32_ST_BIND(lookup->st_info) == STB_LOCAL)
 	{
-		*outLib = library;
-		return lookup;
+		symbol = lookup;
 	}
 	else
 	{
-		uint32_t hash = elf_hash(name);
-		elf_sym_t *symbol;
+		uint32_t hash    = elf_hash(name);
+		uint32_t gnuHash = elf_gnuHash(name);
 
-		// Look it up in the main program
-		symbol = library_symbolWithName(__library_main, name, hash);
-		if(symbol && symbol->st_value != 0x0)
+		if(library->scope)
 		{
-			*outLib = __library_main;
-			return symbol;
-		}
-
-		// Search the dependencies
-		// TODO: Breadth first search!
-		dependency_t *dep = library->dependency;
-		while(dep)
-		{
-			symbol = library_symbolWithName(dep->library, name, hash);
-			if(symbol && symbol->st_value != 0x0)
+			for(size_t i=0; i<library->scopeCount; i++)
 			{
-				*outLib = dep->library;
-				return symbol;
+				symbol = library_symbolWithHashes(library->scope[i], name, hash, gnuHash);
+				if(symbol && symbol->st_value != 0x0)
+				{
+					container = library->scope[i];
+					break;
+				}
+
+				symbol = NULL;
 			}
+		}
+		else
+		{
+			symbol = library_symbolWithHashes(library, name, hash, gnuHash);
+			if(symbol && symbol->st_value == 0x0)
+				symbol = NULL;
+		}
+	}
 
-			dep = dep->next;
+	if(symbol)
+	{
+		if(cache)
+		{
+			cache->library = container;
+			cache->symbol  = symbol;
 		}
 
-		// Look it up in the library
-		symbol = library_symbolWithName(library, name, hash);
-		if(symbol && symbol->st_value != 0x0)
+		*outLib = container;
+	}
+
+	return symbol;
+}
+
+elf_sym_t *library_symbolWithGNUHash(library_t *library, const char *name, uint32_t hash)
+{
+	// Reject most misses with the bloom filter before touching any bucket
+	uint32_t word = library->gnuBloom[(hash / 32) % library->gnuBloomSize];
+	uint32_t mask = (1u << (hash % 32)) | (1u << ((hash >> library->gnuBloomShift) % 32));
+
+	if((word & mask) != mask)
+		return NULL;
+
+	uint32_t symnum = library->gnuBuckets[hash % library->gnuNBuckets];
+	if(symnum < library->gnuSymOffset)
+		return NULL;
+
+	// The lowest bit of the chain entry marks the end of the chain, the rest is the symbols hash
+	while(1)
+	{
+		uint32_t chainHash = library->gnuChains[symnum - library->gnuSymOffset];
+		if((chainHash | 1) == (hash | 1))
 		{
-			*outLib = library;
-			return symbol;
+			elf_sym_t *symbol = library->symtab + symnum;
+			if(strcmp(library->strtab + symbol->st_name, name) == 0)
+				return symbol;
 		}
+
+		if(chainHash & 1)
+			break;
+
+		symnum ++;
 	}
 
 	return NULL;
 }
 
-elf_sym_t *library_symbolWithName(library_t *library, const char *name, uint32_t hash)
+elf_sym_t *library_symbolWithHashes(library_t *library, const char *name, uint32_t hash, uint32_t gnuHash)
 {
+	if(library->gnuBuckets)
+		return library_symbolWithGNUHash(library, name, gnuHash);
+
+	if(!library->buckets)
+		return NULL;
+
 	uint32_t symnum = library->buckets[hash % library->nbuckets];
 	while(symnum != 0)
 	{
@@ -268,15 +465,38 @@ elf_sym_t *library_symbolWithName(library_t *library, const char *name, uint32_t
 	return NULL;
 }
 
+elf_sym_t *library_symbolWithName(library_t *library, const char *name, uint32_t hash)
+{
+	uint32_t gnuHash = library->gnuBuckets ? elf_gnuHash(name) : 0;
+	return library_symbolWithHashes(library, name, hash, gnuHash);
+}
+
 void *library_resolveSymbolWithName(library_t *library, const char *name)
 {
-	uint32_t hash = elf_hash(name);
+	uint32_t hash    = elf_hash(name);
+	uint32_t gnuHash = elf_gnuHash(name);
+
 	if(!library)
 	{
+		// The main program's scope is the global one, RTLD_GLOBAL libraries are appended to it when they are opened
+		if(__library_main && __library_main->scope)
+		{
+			for(size_t i=0; i<__library_main->scopeCount; i++)
+			{
+				library = __library_main->scope[i];
+
+				elf_sym_t *symbol = library_symbolWithHashes(library, name, hash, gnuHash);
+				if(symbol && symbol->st_value != 0x0)
+					return (void *)(library->relocBase + symbol->st_value);
+			}
+
+			return NULL;
+		}
+
 		library = __library_first;
 		while(library)
 		{
-			elf_sym_t *symbol = library_symbolWithName(library, name, hash);
+			elf_sym_t *symbol = library_symbolWithHashes(library, name, hash, gnuHash);
 			if(symbol)
 				return (void *)(library->relocBase + symbol->st_value);
 
@@ -285,7 +505,7 @@ void *library_resolveSymbolWithName(library_t *library, const char *name)
 	}
 	else
 	{
-		elf_sym_t *symbol = library_symbolWithName(library, name, hash);
+		elf_sym_t *symbol = library_symbolWithHashes(library, name, hash, gnuHash);
 		if(symbol)
 			return (void *)(library->relocBase + symbol->st_value);
 	}
@@ -293,6 +513,63 @@ void *library_resolveSymbolWithName(library_t *library, const char *name)
 	return NULL;
 }
 
+// ------------
+// TLS
+// ------------
+
+bool library_allocateTLS(library_t *library)
+{
+	if(library->tlsSize == 0)
+		return true;
+
+	// The kernel sizes the static TLS block once, before the program starts. Libraries loaded later on can't get a block
+	if(__library_tlsCommitted)
+	{
+		library_reportError("Can't load %s, it uses TLS and the static TLS block is already committed", library->name);
+		return false;
+	}
+
+	size_t alignment = library->tlsAlignment ? library->tlsAlignment : 1;
+
+	// i386 uses TLS variant II, blocks are stacked downwards from the thread pointer
+	__library_tlsSize = (__library_tlsSize + library->tlsSize + alignment - 1) & ~(alignment - 1);
+	__library_tlsAlignment = MAX(__library_tlsAlignment, alignment);
+
+	library->tlsOffset = __library_tlsSize;
+	return true;
+}
+
+void library_commitTLS()
+{
+	__library_tlsCommitted = true;
+
+	if(__library_tlsSize == 0)
+		return;
+
+	size_t size = (__library_tlsSize + __library_tlsAlignment - 1) & ~(__library_tlsAlignment - 1);
+	uint8_t *image = calloc(1, size);
+
+	if(!image)
+		library_dieWithError("Couldn't allocate the TLS template");
+
+	if(__library_main->tlsImage)
+		memcpy(image + size - __library_main->tlsOffset, __library_main->tlsImage, __library_main->tlsImageSize);
+
+	library_t *library = __library_first;
+	while(library)
+	{
+		if(library->tlsImage)
+			memcpy(image + size - library->tlsOffset, library->tlsImage, library->tlsImageSize);
+
+		library = library->next;
+	}
+
+	if(syscall(SYS_TLS_TEMPLATE, image, size, size, __library_tlsAlignment) != 0)
+		library_dieWithError("Couldn't set the TLS template");
+
+	free(image);
+}
+
 // ------------
 // Library loading
 // ------------
@@ -351,6 +628,178 @@ void *library_map_file(int fd, size_t *tsize)
 	return area;
 }
 
+void library_digestProgramHeader(library_t *library, elf_program_header_t *program)
+{
+	if(program->p_type == PT_DYNAMIC)
+		library->dynamic = (elf_dyn_t *)program->p_vaddr;
+
+	if(program->p_type == PT_TLS)
+	{
+		library->tlsImage     = (uint8_t *)program->p_vaddr;
+		library->tlsImageSize = program->p_filesz;
+		library->tlsSize      = program->p_memsz;
+		library->tlsAlignment = program->p_align;
+	}
+}
+
+void library_setRelocBase(library_t *library, off_t relocBase)
+{
+	library->relocBase = relocBase;
+
+	if(library->tlsImage)
+		library->tlsImage = (uint8_t *)(library->relocBase + ((uintptr_t)library->tlsImage));
+
+	if(library->dynamic)
+	{
+		library->dynamic = (elf_dyn_t *)(library->relocBase + ((uintptr_t)library->dynamic));
+		library_digestDynamic(library);
+	}
+}
+
+bool library_hasTextRelocations(elf_dyn_t *dynamic)
+{
+	for(elf_dyn_t *dyn=dynamic; dyn->d_tag != DT_NULL; dyn ++)
+	{
+		if(dyn->d_tag == DT_TEXTREL)
+			return true;
+
+		if(dyn->d_tag == DT_FLAGS && (dyn->d_un.d_val & DF_TEXTREL))
+			return true;
+	}
+
+	return false;
+}
+
+// Maps the PT_LOAD segments straight from the file. Read-only segments map the kernels image cache and share
+// their frames with every other process using the library, only the writeable segments get private pages.
+// Returns false without side effects if the library can't be mapped like this, the caller then copies it instead.
+bool library_map_segments(library_t *library, int fd, bool shareable)
+{
+	size_t size = lseek(fd, 0, SEEK_END);
+	lseek(fd, 0, SEEK_SET);
+
+	if(size == (size_t)-1 || size < sizeof(elf_header_t))
+		return false;
+
+	size_t fileSize = VM_PAGE_COUNT(size) * VM_PAGE_SIZE;
+	uint8_t *begin = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if(begin == MAP_FAILED)
+		return false;
+
+	elf_header_t *header = (elf_header_t *)begin;
+	elf_program_header_t *programHeader = (elf_program_header_t *)(begin + header->e_phoff);
+	elf_program_header_t *loads[kLibraryMaxSegments];
+
+	size_t loadCount = 0;
+	bool result = false;
+
+	uint32_t minAddress = -1;
+	uint32_t maxAddress = 0;
+
+	if(header->e_phoff + header->e_phnum * sizeof(elf_program_header_t) > size)
+		goto unmapFile;
+
+	for(int i=0; i<header->e_phnum; i++)
+	{
+		elf_program_header_t *program = &programHeader[i];
+
+		if(program->p_type == PT_LOAD)
+		{
+			// Every segment needs pages of its own and must be backed by the file
+			if(loadCount == kLibraryMaxSegments || program->p_offset + program->p_filesz > size)
+				goto unmapFile;
+
+			if((program->p_vaddr % VM_PAGE_SIZE) != (program->p_offset % VM_PAGE_SIZE))
+				goto unmapFile;
+
+			if(loadCount > 0 && VM_PAGE_ALIGN_DOWN(program->p_vaddr) < maxAddress)
+				goto unmapFile;
+
+			minAddress = MIN(minAddress, program->p_vaddr);
+			maxAddress = VM_PAGE_ALIGN_UP(program->p_vaddr + program->p_memsz);
+
+			loads[loadCount ++] = program;
+		}
+
+		if(program->p_type == PT_DYNAMIC)
+		{
+			if(program->p_offset + program->p_filesz > size)
+				goto unmapFile;
+
+			if(library_hasTextRelocations((elf_dyn_t *)(begin + program->p_offset)))
+				goto unmapFile;
+		}
+	}
+
+	if(loadCount == 0)
+		goto unmapFile;
+
+	// Reserve the whole span so the segments keep their distance
+	minAddress = VM_PAGE_ALIGN_DOWN(minAddress);
+
+	size_t span = maxAddress - minAddress;
+	uint8_t *target = mmap((void *)minAddress, span, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0);
+
+	if(target == MAP_FAILED)
+		goto unmapFile;
+
+	munmap(target, span);
+
+	for(size_t i=0; i<loadCount; i++)
+	{
+		elf_program_header_t *program = loads[i];
+
+		uintptr_t address = VM_PAGE_ALIGN_DOWN(program->p_vaddr);
+		uintptr_t limit   = VM_PAGE_ALIGN_UP(program->p_vaddr + program->p_memsz);
+		uint8_t *wanted   = target + (address - minAddress);
+
+		bool shared = (shareable && !(program->p_flags & PF_W) && program->p_filesz == program->p_memsz);
+		int protection = PROT_READ;
+
+		if(program->p_flags & PF_X)
+			protection |= PROT_EXEC;
+
+		if(!shared)
+			protection |= PROT_WRITE;
+
+		void *segment = mmap(wanted, limit - address, protection, MAP_PRIVATE, fd, VM_PAGE_ALIGN_DOWN(program->p_offset));
+		if(segment == MAP_FAILED)
+			goto unmapSegments;
+
+		library->segments[library->segmentCount].address = segment;
+		library->segments[library->segmentCount].length  = limit - address;
+		library->segmentCount ++;
+
+		if(segment != wanted)
+			goto unmapSegments;
+
+		// The private copy contains whatever follows the segment in the file
+		if(!shared)
+		{
+			uintptr_t end = program->p_vaddr + program->p_filesz;
+			memset(target + (end - minAddress), 0, limit - end);
+		}
+	}
+
+	for(int i=0; i<header->e_phnum; i++)
+		library_digestProgramHeader(library, &programHeader[i]);
+
+	library_setRelocBase(library, (off_t)(target - minAddress));
+	result = true;
+	goto unmapFile;
+
+unmapSegments:
+	for(size_t i=0; i<library->segmentCount; i++)
+		munmap(library->segments[i].address, library->segments[i].length);
+
+	library->segmentCount = 0;
+
+unmapFile:
+	munmap(begin, fileSize);
+	return result;
+}
+
 void library_map_library(library_t *library, uint8_t *begin)
 {
 	elf_header_t *header = (elf_header_t *)begin;
@@ -374,8 +823,7 @@ void library_map_library(library_t *library, uint8_t *begin)
 				maxAddress = program->p_paddr + program->p_memsz;
 		}
 
-		if(program->p_type == PT_DYNAMIC)
-			library->dynamic = (elf_dyn_t *)program->p_vaddr;
+		library_digestProgramHeader(library, program);
 	}
 
 	minAddress = VM_PAGE_ALIGN_DOWN(minAddress);
@@ -394,24 +842,24 @@ void library_map_library(library_t *library, uint8_t *begin)
 		}
 	}
 
-	library->relocBase = (off_t)(target - minAddress);
-
 	library->pages = pages;
 	library->region = target;
 
-	if(library->dynamic)
-	{
-		library->dynamic = (elf_dyn_t *)(library->relocBase + ((uintptr_t)library->dynamic));
-		library_digestDynamic(library);
-	}
+	library_setRelocBase(library, (off_t)(target - minAddress));
 }
 
 
 
 void library_deleteLibrary(library_t *library)
 {
-	munmap(library->region, library->pages * VM_PAGE_SIZE);
+	if(library->region)
+		munmap(library->region, library->pages * VM_PAGE_SIZE);
 
+	for(size_t i=0; i<library->segmentCount; i++)
+		munmap(library->segments[i].address, library->segments[i].length);
+
+	free(library->scope);
+	free(library->symbolCache);
 	free(library->name);
 	free(library);
 }
@@ -440,15 +888,25 @@ library_t *library_withName(const char *name, int flags)
 
 		strcpy(library->name, name);
 
-		size_t fileSize;
-		uint8_t *begin = library_map_file(fd, &fileSize);
+		// libdl.so gets its symbol table patched, so its read-only pages can't be shared
+		bool shareable = (strcmp(name, "libdl.so") != 0);
+
+		if(!library_map_segments(library, fd, shareable))
+		{
+			size_t fileSize;
+			uint8_t *begin = library_map_file(fd, &fileSize);
+
+			library_map_library(library, begin);
+			munmap(begin, fileSize);
+		}
+
 		close(fd);
 
-		library_map_library(library, begin);
-		munmap(begin, fileSize);
+		if(!library_allocateTLS(library))
+			goto libraryLoadFailed;
 
 		library_patchLinkd(library);
-		if(!library_resolveDependencies(library))
+		if(!library_resolveDependencies(library) || !library_buildScope(library))
 			goto libraryLoadFailed;
 
 		if(flags & RTLD_NOW)
@@ -469,6 +927,9 @@ library_t *library_withName(const char *name, int flags)
 
 		if(flags & RTLD_GLOBAL)
 		{
+			if(!library_extendGlobalScope(library))
+				goto libraryLoadFailed;
+
 			if(__library_first)
 				library->next = __library_first;
 
@@ -25,6 +25,23 @@
 
 struct library_s;
 
+#define kLibraryMaxSegments 4
+
+// Set to 1 to have linkd report the cycles and symbol lookups it took to start the program
+#define LIBRARY_REPORT_STARTUP 0
+
+typedef struct library_segment_s
+{
+	void *address;
+	size_t length;
+} library_segment_t;
+
+typedef struct library_symbol_cache_s
+{
+	elf_sym_t *symbol;
+	struct library_s *library;
+} library_symbol_cache_t;
+
 typedef struct dependency_s
 {
 	uint32_t name;
@@ -59,17 +76,50 @@ typedef struct library_s
 	uint32_t nbuckets;
 	uint32_t nchains;
 
+	// DT_GNU_HASH, preferred over DT_HASH if present
+	uint32_t *gnuBloom;
+	uint32_t *gnuBuckets;
+	uint32_t *gnuChains;
+	uint32_t gnuNBuckets;
+	uint32_t gnuSymOffset;
+	uint32_t gnuBloomSize;
+	uint32_t gnuBloomShift;
+
+	uint32_t symbolCount;
+
+	// Libraries searched for the symbols of this one, in order. Built once the dependencies are loaded:
+	// the main program, the dependency tree breadth first and finally the library itself.
+	// The main program's scope is the global one, it also gets every library opened with RTLD_GLOBAL later on
+	struct library_s **scope;
+	size_t scopeCount;
+
+	library_symbol_cache_t *symbolCache; // symbolCount entries, indexed by symbol number
+
 	uintptr_t *initArray;
 	size_t initArrayCount;
 
+	// Libraries copied into one anonymous region use pages and region,
+	// libraries mapped from their file keep one mapping per PT_LOAD segment
 	size_t pages;
 	void  *region;
 
+	library_segment_t segments[kLibraryMaxSegments];
+	size_t segmentCount;
+
+	// Static TLS, the block lives at thread pointer - tlsOffset
+	uint8_t *tlsImage;
+	size_t tlsImageSize;
+	size_t tlsSize;
+	size_t tlsAlignment;
+	size_t tlsOffset;
+
 	uint32_t references;
 	struct library_s *next;
 } library_t;
 
 library_t *library_withName(const char *name, int flags);
+bool library_buildScope(library_t *library);
+bool library_extendGlobalScope(library_t *library);
 
 void library_patchLinkd(library_t *library);
 void library_fixPLTGot(library_t *library);
@@ -78,11 +128,20 @@ bool library_relocateNonPLT(library_t *library);
 bool library_relocatePLT(library_t *library);
 void library_relocatePLTLazy(library_t *library);
 
+bool library_allocateTLS(library_t *library);
+void library_commitTLS();
+
 void library_reportError(const char *error, ...);
 void library_dieWithError(const char *error, ...);
 
 elf_sym_t *library_lookupSymbol(library_t *library, uint32_t symNum, library_t **outLib);
 elf_sym_t *library_symbolWithName(library_t *library, const char *name, uint32_t hash);
+elf_sym_t *library_symbolWithHashes(library_t *library, const char *name, uint32_t hash, uint32_t gnuHash);
 void *library_resolveSymbolWithName(library_t *library, const char *name);
 
+#if LIBRARY_REPORT_STARTUP
+extern uint32_t __library_lookups;
+extern uint32_t __library_cacheHits;
+#endif
+
 #endif
@@ -85,6 +85,7 @@ library_t *map_program(uint8_t *begin, void **entry)
 	uint32_t maxAddress = 0;
 
 	elf_dyn_t *dynamic = NULL;
+	elf_program_header_t *tls = NULL;
 
 	for(int i=0; i<header->e_phnum; i++) 
 	{
@@ -101,6 +102,9 @@ library_t *map_program(uint8_t *begin, void **entry)
 
 		if(program->p_type == PT_DYNAMIC)
 			dynamic = (elf_dyn_t *)program->p_vaddr;
+
+		if(program->p_type == PT_TLS)
+			tls = program;
 	}
 
 	minAddress = VM_PAGE_ALIGN_DOWN(minAddress);
@@ -129,6 +133,16 @@ library_t *map_program(uint8_t *begin, void **entry)
 
 	library->references = 1;
 
+	if(tls)
+	{
+		library->tlsImage     = (uint8_t *)tls->p_vaddr;
+		library->tlsImageSize = tls->p_filesz;
+		library->tlsSize      = tls->p_memsz;
+		library->tlsAlignment = tls->p_align;
+
+		library_allocateTLS(library);
+	}
+
 	if(entry)
 		*entry = (void *)header->e_entry;
 
@@ -139,9 +153,25 @@ library_t *map_program(uint8_t *begin, void **entry)
 void library_digestDynamic(library_t *library);
 void library_resolveDependencies(library_t *library);
 
+#if LIBRARY_REPORT_STARTUP
+static inline uint64_t readTSC()
+{
+	uint32_t high;
+	uint32_t low;
+
+	__asm__ volatile("rdtsc" : "=a" (low), "=d" (high));
+
+	return (((uint64_t)high) << 32) | low;
+}
+#endif
+
 void _start() __attribute__ ((noreturn));
 void _start()
 {
+#if LIBRARY_REPORT_STARTUP
+	uint64_t start = readTSC();
+#endif
+
 	size_t size = 0;
 	void *data = map_file("/bin/test.bin", &size);
 
@@ -157,10 +187,20 @@ void _start()
 			library_digestDynamic(__library_main);
 			library_resolveDependencies(__library_main);
 
+			if(!library_buildScope(__library_main))
+				library_dieWithError("Couldn't build the lookup scope of the program");
+
 			library_relocatePLT(__library_main);
 			library_relocateNonPLT(__library_main);
 		}
 
+		// Every library loaded so far got its place in the static TLS block, now the kernel can size it
+		library_commitTLS();
+
+#if LIBRARY_REPORT_STARTUP
+		printf("linkd: startup %u cycles, %u symbol lookups, %u cached\n", (uint32_t)(readTSC() - start), __library_lookups, __library_cacheHits);
+#endif
+
 		// Hand over execution to the program
 		entry();
 	}
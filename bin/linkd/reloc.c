@@ -75,7 +75,29 @@ bool library_relocateNonPLT(library_t *library)
 				break;
 
 			case R_386_RELATIVE:
-				*address += container->relocBase;
+				*address += library->relocBase;
+				break;
+
+			// TLS, the offsets are relative to the thread pointer. See library_allocateTLS()
+			case R_386_TLS_TPOFF:
+			case R_386_TLS_TPOFF32:
+			case R_386_TLS_DTPMOD32:
+			case R_386_TLS_DTPOFF32:
+				symbol = library_lookupSymbol(library, symnum, &container);
+				if(!symbol)
+				{
+					library_reportError("Couldn't find symbol %s for %s!", name, library->name);
+					return false;
+				}
+
+				if(type == R_386_TLS_TPOFF)
+					*address += symbol->st_value - container->tlsOffset;
+				else if(type == R_386_TLS_TPOFF32)
+					*address = container->tlsOffset - (symbol->st_value + *address); // Negated, including the addend
+				else if(type == R_386_TLS_DTPMOD32)
+					*address = container->tlsOffset;
+				else
+					*address += symbol->st_value;
 				break;
 
 			default:
@@ -20,6 +20,150 @@
 #include <dlfcn.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/fcntl.h>
+#include <sys/unistd.h>
+#include <sys/ioring.h>
+
+#define kBenchmarkSyscallSamples 100
+#define kBenchmarkSyscallBatch   64
+
+static inline uint32_t readTSC()
+{
+	uint32_t high;
+	uint32_t low;
+
+	__asm__ volatile("rdtsc" : "=a" (low), "=d" (high));
+
+	return low;
+}
+
+// The kernels kbench harness runs in ring 0 and can't trap into the syscall gate,
+// so the null syscall is measured from here and reported in the same format
+void benchmarkSyscall()
+{
+	uint32_t samples[kBenchmarkSyscallSamples];
+
+	for(int i=0; i<kBenchmarkSyscallSamples; i++)
+	{
+		uint32_t start = readTSC();
+
+		for(int j=0; j<kBenchmarkSyscallBatch; j++)
+			getpid();
+
+		uint32_t sample = (readTSC() - start) / kBenchmarkSyscallBatch;
+
+		int k = i;
+		for(; k>0 && samples[k - 1] > sample; k--)
+			samples[k] = samples[k - 1];
+
+		samples[k] = sample;
+	}
+
+	printf("kbench: syscall/null min=%u median=%u p99=%u batch=%u\n", samples[0], samples[kBenchmarkSyscallSamples / 2], samples[(kBenchmarkSyscallSamples * 99) / 100 - 1], kBenchmarkSyscallBatch);
+}
+
+#define kBenchmarkOperations 128
+#define kBenchmarkBatch      32
+
+// Writes and stats a file once with one system call per operation and once through an I/O ring,
+// and reports how many kernel entries each variant needed per operation
+void benchmarkIORing()
+{
+	static char buffer[64];
+	struct stat info;
+
+	uint32_t syscalls = 0;
+	memset(buffer, 'x', sizeof(buffer));
+
+	int fd = open("/ioring.bench", O_RDWR | O_CREAT | O_TRUNC);
+	syscalls ++;
+
+	for(int i=0; i<kBenchmarkOperations; i++)
+	{
+		if(i % 2)
+			write(fd, buffer, sizeof(buffer));
+		else
+			stat("/ioring.bench", &info);
+
+		syscalls ++;
+	}
+
+	close(fd);
+	syscalls ++;
+
+	printf("syscalls: %u for %u operations\n", syscalls, kBenchmarkOperations + 2);
+
+
+	struct ioring *ring = io_setup(kBenchmarkBatch);
+	if(!ring)
+	{
+		printf("ioring: io_setup() failed\n");
+		return;
+	}
+
+	fd = open("/ioring.bench", O_RDWR | O_TRUNC);
+
+	uint32_t entries = 0;
+	uint32_t completed = 0;
+	uint32_t failed = 0;
+
+	syscalls = 1;
+
+	for(int i=0; i<kBenchmarkOperations; i++)
+	{
+		struct ioring_sqe *sqe = ioring_getSQE(ring);
+		if(!sqe)
+		{
+			ioring_submit(ring);
+			syscalls ++;
+
+			sqe = ioring_getSQE(ring);
+		}
+
+		if(i % 2)
+			ioring_prepWrite(sqe, fd, buffer, sizeof(buffer), i);
+		else
+			ioring_prepStat(sqe, "/ioring.bench", &info, i);
+
+		entries ++;
+
+		// Reap as we go so the completion queue never runs full
+		struct ioring_cqe *cqe;
+		while((cqe = ioring_peekCQE(ring)))
+		{
+			failed += (cqe->result < 0);
+			completed ++;
+
+			ioring_seen(ring);
+		}
+	}
+
+	struct ioring_sqe *sqe = ioring_getSQE(ring);
+	if(!sqe)
+	{
+		ioring_submit(ring);
+		syscalls ++;
+
+		sqe = ioring_getSQE(ring);
+	}
+
+	ioring_prepClose(sqe, fd, kBenchmarkOperations);
+	entries ++;
+
+	ioring_submit(ring);
+	syscalls ++;
+
+	struct ioring_cqe *cqe;
+	while((cqe = ioring_peekCQE(ring)))
+	{
+		failed += (cqe->result < 0);
+		completed ++;
+
+		ioring_seen(ring);
+	}
+
+	printf("ioring: %u syscalls for %u operations (%u completed, %u failed)\n", syscalls, entries + 1, completed, failed);
+}
 
 int main()
 {
@@ -33,5 +177,8 @@ int main()
 
 	printf("%s\n", pointer);
 
+	benchmarkSyscall();
+	benchmarkIORing();
+
 	return 0;
 }
@@ -0,0 +1,264 @@
+//
+//  bench_container.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdio.h>
+#include <container/array.h>
+#include <container/atree.h>
+#include <container/hashset.h>
+#include <container/list.h>
+#include <container/ringbuffer.h>
+#include <memory/memory.h>
+#include "hostbench.h"
+
+#define kBenchEntries 4096
+
+typedef struct bench_entry_s
+{
+	uintptr_t value;
+
+	struct bench_entry_s *next;
+	struct bench_entry_s *prev;
+} bench_entry_t;
+
+static hashset_t *integerSet;
+static hashset_t *stringSet;
+static atree_t *tree;
+static array_t *array;
+
+static char strings[kBenchEntries][16];
+
+void bench_hashsetLookup(void *argument, uint64_t iterations)
+{
+	hashset_t *set = argument;
+
+	for(uint64_t i=0; i<iterations; i++)
+		hostbench_doNotOptimize(hashset_objectForKey(set, (const void *)(uintptr_t)(i % kBenchEntries)));
+}
+
+void bench_hashsetLookupString(__unused void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+		hostbench_doNotOptimize(hashset_objectForKey(stringSet, strings[i % kBenchEntries]));
+}
+
+void bench_hashsetInsertRemove(void *argument, uint64_t iterations)
+{
+	hashset_t *set = argument;
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		const void *key = (const void *)(uintptr_t)(kBenchEntries + (i % kBenchEntries));
+
+		hashset_setObjectForKey(set, (void *)0x1, key);
+		hashset_removeObjectForKey(set, key);
+	}
+}
+
+void bench_hashsetGrow(__unused void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		hashset_t *set = hashset_create(0, hash_integer, hash_integerCompare);
+
+		for(uintptr_t j=0; j<kBenchEntries; j++)
+			hashset_setObjectForKey(set, (void *)(j + 1), (const void *)j);
+
+		hashset_destroy(set);
+	}
+}
+
+int bench_atreeComparator(void *key1, void *key2)
+{
+	uintptr_t tkey1 = (uintptr_t)key1;
+	uintptr_t tkey2 = (uintptr_t)key2;
+
+	return (tkey1 < tkey2) ? -1 : (tkey1 > tkey2);
+}
+
+void bench_atreeLookup(__unused void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+		hostbench_doNotOptimize(atree_find(tree, (void *)(uintptr_t)((i % kBenchEntries) + 1)));
+}
+
+void bench_atreeInsertRemove(__unused void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		void *key = (void *)(uintptr_t)(kBenchEntries + (i % kBenchEntries) + 1);
+
+		atree_insert(tree, key, key);
+		atree_remove(tree, key);
+	}
+}
+
+void bench_arrayAppend(__unused void *argument, uint64_t iterations)
+{
+	array_t *scratch = array_create();
+
+	for(uint64_t i=0; i<iterations; i++)
+		array_addObject(scratch, (void *)(uintptr_t)(i + 1));
+
+	array_destroy(scratch);
+}
+
+void bench_arrayIndexOf(__unused void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+		hostbench_doNotOptimize(array_indexOfObject(array, (void *)(uintptr_t)((i % kBenchEntries) + 1)));
+}
+
+void bench_listAddRemove(__unused void *argument, uint64_t iterations)
+{
+	list_t *list = list_create(sizeof(bench_entry_t), offsetof(bench_entry_t, next), offsetof(bench_entry_t, prev));
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		bench_entry_t *entry = list_addBack(list);
+		list_remove(list, entry);
+	}
+
+	list_destroy(list);
+}
+
+void bench_ringbufferWriteRead(void *argument, uint64_t iterations)
+{
+	ringbuffer_t *ringbuffer = argument;
+	uint8_t record[64] = { 0 };
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		ringbuffer_write(ringbuffer, record, sizeof(record));
+		ringbuffer_read(ringbuffer, record, sizeof(record));
+	}
+}
+
+void bench_ringbufferReserveCommit(void *argument, uint64_t iterations)
+{
+	ringbuffer_t *ringbuffer = argument;
+	ringbuffer_range_t range;
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		ringbuffer_reserve(ringbuffer, 64, &range);
+		ringbuffer_rangeCopyIn(&range, 0, &i, sizeof(uint64_t));
+		ringbuffer_commit(ringbuffer, &range);
+
+		ringbuffer_peek(ringbuffer, &range);
+		ringbuffer_consume(ringbuffer, range.size);
+	}
+}
+
+// One iteration walks the whole collection, once through the heap iterator and once with a stack cursor
+void bench_hashsetIterator(__unused void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		iterator_t *iterator = hashset_iterator(integerSet);
+		void *object;
+
+		while((object = iterator_nextObject(iterator)))
+			hostbench_doNotOptimize(object);
+
+		iterator_destroy(iterator);
+	}
+}
+
+void bench_hashsetCursor(__unused void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		hashset_cursor_t cursor;
+		void *object;
+
+		hashset_foreach(integerSet, cursor, object)
+			hostbench_doNotOptimize(object);
+	}
+}
+
+void bench_atreeIterator(__unused void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		iterator_t *iterator = atree_iterator(tree);
+		void *object;
+
+		while((object = iterator_nextObject(iterator)))
+			hostbench_doNotOptimize(object);
+
+		iterator_destroy(iterator);
+	}
+}
+
+void bench_atreeCursor(__unused void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		atree_cursor_t cursor;
+		void *object;
+
+		atree_foreach(tree, cursor, object)
+			hostbench_doNotOptimize(object);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	heap_init(NULL);
+
+	integerSet = hashset_create(0, hash_integer, hash_integerCompare);
+	stringSet  = hashset_create(0, hash_cstring, hash_cstringCompare);
+	tree  = atree_create(bench_atreeComparator);
+	array = array_create();
+
+	for(uintptr_t i=0; i<kBenchEntries; i++)
+	{
+		snprintf(strings[i], 16, "key %u", (unsigned int)i);
+
+		hashset_setObjectForKey(integerSet, (void *)(i + 1), (const void *)i);
+		hashset_setObjectForKey(stringSet, (void *)(i + 1), strings[i]);
+		atree_insert(tree, (void *)(i + 1), (void *)(i + 1));
+		array_addObject(array, (void *)(i + 1));
+	}
+
+	hostbench_t benchmarks[] = {
+		{ "hashset/lookup", bench_hashsetLookup, NULL },
+		{ "hashset/lookup_cstring", bench_hashsetLookupString, NULL },
+		{ "hashset/insert_remove", bench_hashsetInsertRemove, NULL },
+		{ "hashset/grow_4096", bench_hashsetGrow, NULL },
+		{ "atree/lookup", bench_atreeLookup, NULL },
+		{ "atree/insert_remove", bench_atreeInsertRemove, NULL },
+		{ "array/append", bench_arrayAppend, NULL },
+		{ "array/indexOf", bench_arrayIndexOf, NULL },
+		{ "list/add_remove", bench_listAddRemove, NULL },
+		{ "ringbuffer/write_read_spsc", bench_ringbufferWriteRead, NULL },
+		{ "ringbuffer/write_read_mpsc", bench_ringbufferWriteRead, NULL },
+		{ "ringbuffer/reserve_commit_mpsc", bench_ringbufferReserveCommit, NULL },
+		{ "hashset/iterate_iterator", bench_hashsetIterator, NULL },
+		{ "hashset/iterate_cursor", bench_hashsetCursor, NULL },
+		{ "atree/iterate_iterator", bench_atreeIterator, NULL },
+		{ "atree/iterate_cursor", bench_atreeCursor, NULL }
+	};
+
+	benchmarks[0].argument = integerSet;
+	benchmarks[2].argument = integerSet;
+	benchmarks[9].argument  = ringbuffer_create(4096, 0);
+	benchmarks[10].argument = ringbuffer_create(4096, kRingbufferFlagMultiProducer);
+	benchmarks[11].argument = ringbuffer_create(4096, kRingbufferFlagMultiProducer);
+
+	return hostbench_main(benchmarks, sizeof(benchmarks) / sizeof(hostbench_t), argc, argv);
+}
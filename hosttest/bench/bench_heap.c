@@ -0,0 +1,76 @@
+//
+//  bench_heap.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdlib.h>
+#include <memory/memory.h>
+#include "hostbench.h"
+
+#define kBenchLiveAllocations 256
+
+void bench_hallocFree(void *argument, uint64_t iterations)
+{
+	size_t size = (size_t)argument;
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		void *pointer = halloc(NULL, size);
+		hostbench_doNotOptimize(pointer);
+		hfree(NULL, pointer);
+	}
+}
+
+// Keeps a window of live allocations of random sizes and replaces a random one every iteration
+void bench_hallocMixed(__unused void *argument, uint64_t iterations)
+{
+	void *live[kBenchLiveAllocations] = { NULL };
+	uint32_t seed = 0x1234567;
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		uint32_t slot = (seed >> 8) % kBenchLiveAllocations;
+		size_t size = 8 + ((seed >> 16) % 2048);
+
+		if(live[slot])
+			hfree(NULL, live[slot]);
+
+		live[slot] = halloc(NULL, size);
+	}
+
+	for(int i=0; i<kBenchLiveAllocations; i++)
+	{
+		if(live[i])
+			hfree(NULL, live[i]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	heap_init(NULL);
+
+	hostbench_t benchmarks[] = {
+		{ "halloc/16", bench_hallocFree, (void *)16 },
+		{ "halloc/64", bench_hallocFree, (void *)64 },
+		{ "halloc/256", bench_hallocFree, (void *)256 },
+		{ "halloc/1024", bench_hallocFree, (void *)1024 },
+		{ "halloc/4096", bench_hallocFree, (void *)4096 },
+		{ "halloc/mixed", bench_hallocMixed, NULL }
+	};
+
+	return hostbench_main(benchmarks, sizeof(benchmarks) / sizeof(hostbench_t), argc, argv);
+}
@@ -0,0 +1,117 @@
+//
+//  bench_malloc.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include <stdlib.h>
+#include <pthread.h>
+#include "hostbench.h"
+
+#define kBenchLiveAllocations 256
+#define kBenchThreads 4
+
+// lib/libc/malloc.c is compiled with its public functions renamed, so they don't replace the host allocator
+void *libc_malloc(unsigned int size);
+void *libc_realloc(void *ptr, unsigned int size);
+void libc_free(void *ptr);
+
+void __malloc_threadExit();
+
+void bench_mallocFree(void *argument, uint64_t iterations)
+{
+	unsigned int size = (unsigned int)(uintptr_t)argument;
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		void *pointer = libc_malloc(size);
+		hostbench_doNotOptimize(pointer);
+		libc_free(pointer);
+	}
+}
+
+void bench_mallocMixed(__attribute__((unused)) void *argument, uint64_t iterations)
+{
+	void *live[kBenchLiveAllocations] = { NULL };
+	uint32_t seed = 0x1234567;
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		uint32_t slot = (seed >> 8) % kBenchLiveAllocations;
+		unsigned int size = 8 + ((seed >> 16) % 2048);
+
+		if(live[slot])
+			libc_free(live[slot]);
+
+		live[slot] = libc_malloc(size);
+	}
+
+	for(int i=0; i<kBenchLiveAllocations; i++)
+	{
+		if(live[i])
+			libc_free(live[i]);
+	}
+}
+
+void bench_mallocReallocGrow(__attribute__((unused)) void *argument, uint64_t iterations)
+{
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		void *pointer = NULL;
+
+		for(unsigned int size=16; size<=65536; size*=2)
+			pointer = libc_realloc(pointer, size);
+
+		libc_free(pointer);
+	}
+}
+
+static void *bench_mallocThread(void *argument)
+{
+	uint64_t iterations = *(uint64_t *)argument;
+
+	bench_mallocMixed(NULL, iterations);
+	__malloc_threadExit();
+
+	return NULL;
+}
+
+void bench_mallocThreaded(__attribute__((unused)) void *argument, uint64_t iterations)
+{
+	pthread_t threads[kBenchThreads];
+
+	for(int i=0; i<kBenchThreads; i++)
+		pthread_create(&threads[i], NULL, bench_mallocThread, &iterations);
+
+	for(int i=0; i<kBenchThreads; i++)
+		pthread_join(threads[i], NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	hostbench_t benchmarks[] = {
+		{ "malloc/16", bench_mallocFree, (void *)16 },
+		{ "malloc/64", bench_mallocFree, (void *)64 },
+		{ "malloc/256", bench_mallocFree, (void *)256 },
+		{ "malloc/1024", bench_mallocFree, (void *)1024 },
+		{ "malloc/4096", bench_mallocFree, (void *)4096 },
+		{ "malloc/65536", bench_mallocFree, (void *)65536 },
+		{ "malloc/mixed", bench_mallocMixed, NULL },
+		{ "malloc/realloc_grow", bench_mallocReallocGrow, NULL },
+		{ "malloc/mixed_4_threads", bench_mallocThreaded, NULL }
+	};
+
+	return hostbench_main(benchmarks, sizeof(benchmarks) / sizeof(hostbench_t), argc, argv);
+}
@@ -0,0 +1,86 @@
+//
+//  bench_zone.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdlib.h>
+#include "hostbench.h"
+
+#define kBenchLiveAllocations 256
+#define kZoneFlagAligned (1 << 1)
+
+// sys/zone.h drags in the libc type definitions which clash with the host headers
+void *_zone_create(unsigned int flags);
+void _zone__destroy(void *zone);
+void *_zone_alloc(void *zone, unsigned int size);
+void _zone_free(void *zone, void *ptr);
+
+static void *zone;
+
+void bench_zoneAllocFree(void *argument, uint64_t iterations)
+{
+	unsigned int size = (unsigned int)(uintptr_t)argument;
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		void *pointer = _zone_alloc(zone, size);
+		hostbench_doNotOptimize(pointer);
+		_zone_free(zone, pointer);
+	}
+}
+
+void bench_zoneMixed(__attribute__((unused)) void *argument, uint64_t iterations)
+{
+	void *live[kBenchLiveAllocations] = { NULL };
+	uint32_t seed = 0x1234567;
+
+	for(uint64_t i=0; i<iterations; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		uint32_t slot = (seed >> 8) % kBenchLiveAllocations;
+		unsigned int size = 8 + ((seed >> 16) % 2048);
+
+		if(live[slot])
+			_zone_free(zone, live[slot]);
+
+		live[slot] = _zone_alloc(zone, size);
+	}
+
+	for(int i=0; i<kBenchLiveAllocations; i++)
+	{
+		if(live[i])
+			_zone_free(zone, live[i]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	zone = _zone_create(kZoneFlagAligned);
+
+	hostbench_t benchmarks[] = {
+		{ "zone/16", bench_zoneAllocFree, (void *)16 },
+		{ "zone/64", bench_zoneAllocFree, (void *)64 },
+		{ "zone/256", bench_zoneAllocFree, (void *)256 },
+		{ "zone/1024", bench_zoneAllocFree, (void *)1024 },
+		{ "zone/4096", bench_zoneAllocFree, (void *)4096 },
+		{ "zone/mixed", bench_zoneMixed, NULL }
+	};
+
+	int result = hostbench_main(benchmarks, sizeof(benchmarks) / sizeof(hostbench_t), argc, argv);
+	_zone__destroy(zone);
+
+	return result;
+}
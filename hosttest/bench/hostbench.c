@@ -0,0 +1,83 @@
+//
+//  hostbench.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "hostbench.h"
+
+static uint64_t hostbench_time()
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return ((uint64_t)time.tv_sec * 1000000000ULL) + time.tv_nsec;
+}
+
+static uint64_t hostbench_measure(const hostbench_t *benchmark, uint64_t iterations)
+{
+	uint64_t start = hostbench_time();
+	benchmark->function(benchmark->argument, iterations);
+
+	return hostbench_time() - start;
+}
+
+static void hostbench_run(const hostbench_t *benchmark)
+{
+	uint64_t iterations = 1;
+	uint64_t elapsed;
+
+	// Scale the iterations up until a run is long enough
+	while((elapsed = hostbench_measure(benchmark, iterations)) < kHostBenchMinTime)
+	{
+		uint64_t factor = (elapsed > 0) ? (kHostBenchMinTime / elapsed) + 1 : 10;
+		if(factor > 10)
+			factor = 10;
+
+		iterations *= (factor > 1) ? factor : 2;
+	}
+
+	double samples[kHostBenchRepetitions];
+	for(int i=0; i<kHostBenchRepetitions; i++)
+	{
+		double sample = (double)hostbench_measure(benchmark, iterations) / iterations;
+
+		int j = i;
+		for(; j>0 && samples[j - 1] > sample; j--)
+			samples[j] = samples[j - 1];
+
+		samples[j] = sample;
+	}
+
+	printf("hostbench: %s iterations=%llu min=%.2f median=%.2f\n", benchmark->name, (unsigned long long)iterations, samples[0], samples[kHostBenchRepetitions / 2]);
+	fflush(stdout);
+}
+
+int hostbench_main(const hostbench_t *benchmarks, size_t count, int argc, char *argv[])
+{
+	const char *filter = (argc > 1) ? argv[1] : NULL;
+
+	for(size_t i=0; i<count; i++)
+	{
+		if(filter && !strstr(benchmarks[i].name, filter))
+			continue;
+
+		hostbench_run(&benchmarks[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+//
+//  hostbench.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+/*
+ * Overview:
+ * A minimal google-benchmark style runner. Every benchmark is called with a growing iteration
+ * count until one run takes long enough to be measured reliably, then it is repeated a few times
+ * and the best and median time per iteration are reported, one line per benchmark:
+ *   hostbench: <name> iterations=<n> min=<ns> median=<ns>
+ */
+#ifndef _HOSTBENCH_H_
+#define _HOSTBENCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define kHostBenchMinTime     20000000 // Minimum runtime of a measured run, in ns
+#define kHostBenchRepetitions 9
+
+typedef void (*hostbench_function_t)(void *argument, uint64_t iterations);
+
+typedef struct
+{
+	const char *name;
+	hostbench_function_t function;
+	void *argument;
+} hostbench_t;
+
+// Runs all benchmarks whose name contains argv[1], or all of them if there is no argument
+int hostbench_main(const hostbench_t *benchmarks, size_t count, int argc, char *argv[]);
+
+// Keeps the compiler from optimizing away a computed value
+#define hostbench_doNotOptimize(value) __asm__ volatile("" :: "g" (value) : "memory")
+
+#endif /* _HOSTBENCH_H_ */
@@ -0,0 +1,81 @@
+//
+//  driver.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+/*
+ * Overview:
+ * Stand-in for libFuzzer's main() when the harnesses are built with a compiler that has no
+ * -fsanitize=fuzzer. Every argument is read as an input and replayed, without arguments the
+ * driver feeds a fixed number of pseudo random inputs so that `make run` doubles as a smoke test.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define kDriverRandomInputs 2000
+#define kDriverMaxInput     4096
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static int driver_replay(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if(!file)
+	{
+		fprintf(stderr, "couldn't open %s\n", path);
+		return 1;
+	}
+
+	static uint8_t buffer[1024 * 1024];
+	size_t size = fread(buffer, 1, sizeof(buffer), file);
+	fclose(file);
+
+	LLVMFuzzerTestOneInput(buffer, size);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc > 1)
+	{
+		int result = 0;
+
+		for(int i=1; i<argc; i++)
+			result |= driver_replay(argv[i]);
+
+		return result;
+	}
+
+	static uint8_t buffer[kDriverMaxInput];
+	uint32_t seed = 0xF1DEDAC;
+
+	for(int i=0; i<kDriverRandomInputs; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		size_t size = (seed >> 8) % kDriverMaxInput;
+
+		for(size_t j=0; j<size; j++)
+		{
+			seed = seed * 1103515245 + 12345;
+			buffer[j] = (uint8_t)(seed >> 16);
+		}
+
+		LLVMFuzzerTestOneInput(buffer, size);
+	}
+
+	printf("%s: %d random inputs passed\n", argv[0], kDriverRandomInputs);
+	return 0;
+}
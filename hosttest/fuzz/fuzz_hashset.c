@@ -0,0 +1,94 @@
+//
+//  fuzz_hashset.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <string.h>
+#include <stdlib.h>
+#include <container/hashset.h>
+#include <memory/memory.h>
+
+#define kFuzzKeys 512
+
+// Interprets the input as a stream of (operation, key) pairs and checks the
+// hashset against a plain array after every step
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static bool initialized = false;
+	if(!initialized)
+	{
+		heap_init(NULL);
+		initialized = true;
+	}
+
+	void *shadow[kFuzzKeys];
+	memset(shadow, 0, sizeof(shadow));
+
+	uint32_t count = 0;
+	hashset_t *set = hashset_create((size > 0) ? (data[0] & 0x3f) : 0, hash_integer, hash_integerCompare);
+
+	for(size_t i=0; i + 2 < size; i+=3)
+	{
+		uint8_t operation = data[i] % 3;
+		uintptr_t key = ((data[i + 1] << 8) | data[i + 2]) % kFuzzKeys;
+
+		switch(operation)
+		{
+			case 0:
+			{
+				void *object = (void *)((key << 4) | (i & 0xf) | 1);
+				count += (shadow[key] == NULL);
+				shadow[key] = object;
+
+				hashset_setObjectForKey(set, object, (const void *)key);
+				break;
+			}
+			case 1:
+				count -= (shadow[key] != NULL);
+				shadow[key] = NULL;
+
+				hashset_removeObjectForKey(set, (const void *)key);
+				break;
+
+			case 2:
+				if(hashset_objectForKey(set, (const void *)key) != shadow[key])
+					abort();
+				break;
+		}
+
+		if(hashset_count(set) != count)
+			abort();
+	}
+
+	for(uintptr_t key=0; key<kFuzzKeys; key++)
+	{
+		if(hashset_objectForKey(set, (const void *)key) != shadow[key])
+			abort();
+	}
+
+	uint32_t iterated = 0;
+	iterator_t *iterator = hashset_iterator(set);
+
+	while(iterator_nextObject(iterator))
+		iterated ++;
+
+	iterator_destroy(iterator);
+
+	if(iterated != count)
+		abort();
+
+	hashset_destroy(set);
+	return 0;
+}
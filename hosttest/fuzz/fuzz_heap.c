@@ -0,0 +1,87 @@
+//
+//  fuzz_heap.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <string.h>
+#include <stdlib.h>
+#include <memory/memory.h>
+
+#define kFuzzSlots 64
+
+typedef struct
+{
+	uint8_t *pointer;
+	size_t size;
+	uint8_t pattern;
+} fuzz_allocation_t;
+
+static void fuzz_check(fuzz_allocation_t *allocation)
+{
+	for(size_t i=0; i<allocation->size; i++)
+	{
+		if(allocation->pointer[i] != allocation->pattern)
+			abort(); // Overlapping allocations
+	}
+}
+
+// Interprets the input as a stream of (slot, size) pairs. An empty slot gets a new allocation
+// that is filled with a pattern, an occupied one is verified and freed
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static bool initialized = false;
+	if(!initialized)
+	{
+		heap_init(NULL);
+		initialized = true;
+	}
+
+	fuzz_allocation_t slots[kFuzzSlots];
+	memset(slots, 0, sizeof(slots));
+
+	for(size_t i=0; i + 2 < size; i+=3)
+	{
+		fuzz_allocation_t *allocation = &slots[data[i] % kFuzzSlots];
+
+		if(allocation->pointer)
+		{
+			fuzz_check(allocation);
+			hfree(NULL, allocation->pointer);
+
+			allocation->pointer = NULL;
+			continue;
+		}
+
+		allocation->size    = 1 + (((data[i + 1] << 8) | data[i + 2]) % 8192);
+		allocation->pattern = (uint8_t)i;
+		allocation->pointer = halloc(NULL, allocation->size);
+
+		if(!allocation->pointer)
+			abort();
+
+		memset(allocation->pointer, allocation->pattern, allocation->size);
+	}
+
+	for(int i=0; i<kFuzzSlots; i++)
+	{
+		if(slots[i].pointer)
+		{
+			fuzz_check(&slots[i]);
+			hfree(NULL, slots[i].pointer);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+//
+//  fuzz_malloc.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define kFuzzSlots 64
+
+// lib/libc/malloc.c is compiled with its public functions renamed, so they don't replace the host allocator
+void *libc_malloc(unsigned int size);
+void *libc_calloc(unsigned int num, unsigned int size);
+void *libc_realloc(void *ptr, unsigned int size);
+void libc_free(void *ptr);
+
+typedef struct
+{
+	uint8_t *pointer;
+	size_t size;
+	uint8_t pattern;
+} fuzz_allocation_t;
+
+static void fuzz_check(fuzz_allocation_t *allocation, size_t size)
+{
+	for(size_t i=0; i<size; i++)
+	{
+		if(allocation->pointer[i] != allocation->pattern)
+			abort(); // Overlapping allocations or realloc() lost data
+	}
+}
+
+// Every three bytes are one operation on a slot: free an occupied slot, realloc it if the
+// top bit of the size is set, otherwise malloc or calloc a new allocation into an empty one
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	fuzz_allocation_t slots[kFuzzSlots];
+	memset(slots, 0, sizeof(slots));
+
+	for(size_t i=0; i + 2 < size; i+=3)
+	{
+		fuzz_allocation_t *allocation = &slots[data[i] % kFuzzSlots];
+		uint16_t value = (uint16_t)((data[i + 1] << 8) | data[i + 2]);
+		size_t length  = 1 + ((value & 0x7fff) % 40000);
+
+		if(allocation->pointer && (value & 0x8000))
+		{
+			size_t preserved = allocation->size < length ? allocation->size : length;
+			fuzz_check(allocation, preserved);
+
+			allocation->pointer = libc_realloc(allocation->pointer, (unsigned int)length);
+			if(!allocation->pointer)
+				abort();
+
+			fuzz_check(allocation, preserved);
+
+			allocation->size = length;
+			memset(allocation->pointer, allocation->pattern, length);
+			continue;
+		}
+
+		if(allocation->pointer)
+		{
+			fuzz_check(allocation, allocation->size);
+			libc_free(allocation->pointer);
+
+			allocation->pointer = NULL;
+			continue;
+		}
+
+		allocation->size    = length;
+		allocation->pattern = (uint8_t)i;
+
+		if(data[i] & 0x80)
+		{
+			allocation->pointer = libc_calloc(1, (unsigned int)length);
+			if(!allocation->pointer)
+				abort();
+
+			for(size_t j=0; j<length; j++)
+			{
+				if(allocation->pointer[j] != 0)
+					abort();
+			}
+		}
+		else
+		{
+			allocation->pointer = libc_malloc((unsigned int)length);
+			if(!allocation->pointer)
+				abort();
+		}
+
+		memset(allocation->pointer, allocation->pattern, allocation->size);
+	}
+
+	for(int i=0; i<kFuzzSlots; i++)
+	{
+		if(slots[i].pointer)
+		{
+			fuzz_check(&slots[i], slots[i].size);
+			libc_free(slots[i].pointer);
+		}
+	}
+
+	return 0;
+}
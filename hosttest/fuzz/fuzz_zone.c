@@ -0,0 +1,89 @@
+//
+//  fuzz_zone.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define kFuzzSlots 64
+#define kZoneFlagAligned (1 << 1)
+
+// sys/zone.h drags in the libc type definitions which clash with the host headers
+void *_zone_create(unsigned int flags);
+void _zone__destroy(void *zone);
+void *_zone_alloc(void *zone, unsigned int size);
+void _zone_free(void *zone, void *ptr);
+
+typedef struct
+{
+	uint8_t *pointer;
+	size_t size;
+	uint8_t pattern;
+} fuzz_allocation_t;
+
+static void fuzz_check(fuzz_allocation_t *allocation)
+{
+	for(size_t i=0; i<allocation->size; i++)
+	{
+		if(allocation->pointer[i] != allocation->pattern)
+			abort(); // Overlapping allocations
+	}
+}
+
+// Same input format as fuzz_heap.c, but against the libc zone allocator
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	void *zone = _zone_create(kZoneFlagAligned);
+
+	fuzz_allocation_t slots[kFuzzSlots];
+	memset(slots, 0, sizeof(slots));
+
+	for(size_t i=0; i + 2 < size; i+=3)
+	{
+		fuzz_allocation_t *allocation = &slots[data[i] % kFuzzSlots];
+
+		if(allocation->pointer)
+		{
+			fuzz_check(allocation);
+			_zone_free(zone, allocation->pointer);
+
+			allocation->pointer = NULL;
+			continue;
+		}
+
+		allocation->size    = 1 + (((data[i + 1] << 8) | data[i + 2]) % 8192);
+		allocation->pattern = (uint8_t)i;
+		allocation->pointer = _zone_alloc(zone, (unsigned int)allocation->size);
+
+		if(!allocation->pointer)
+			abort();
+
+		memset(allocation->pointer, allocation->pattern, allocation->size);
+	}
+
+	for(int i=0; i<kFuzzSlots; i++)
+	{
+		if(slots[i].pointer)
+		{
+			fuzz_check(&slots[i]);
+			_zone_free(zone, slots[i].pointer);
+		}
+	}
+
+	_zone__destroy(zone);
+	return 0;
+}
@@ -0,0 +1,53 @@
+//
+//  prefix.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+/*
+ * Overview:
+ * Replaces the kernels prefix.h for host builds. The kernel headers are used as they are,
+ * only the freestanding type definitions are swapped for the ones of the host toolchain.
+ */
+#ifndef _PREFIX_H_
+#define _PREFIX_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+#include <config.h>
+
+#define __unused      __attribute__((unused))
+#define __used        __attribute__((used))
+#define __deprecated  __attribute__((deprecated))
+#define __unavailable __attribute__((unavailable))
+
+#define __inline   inline __attribute__((__always_inline__))
+#define __noinline __attribute__((noinline))
+
+typedef size_t  offset_t;
+typedef int32_t pid_t;
+
+#define kCompareLesserThan -1
+#define kCompareEqualTo     0
+#define kCompareGreaterThan 1
+
+typedef int8_t comparison_result_t;
+typedef comparison_result_t (*comparator_t)(void *object1, void *object2);
+
+#include <libc/assert.h>
+
+#endif
@@ -0,0 +1,136 @@
+//
+//  shim.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+/*
+ * Overview:
+ * The handful of kernel primitives the container, heap and zone code depends on, implemented
+ * on top of Linux userspace. Physical and virtual memory collapse into anonymous mmap()s.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+typedef unsigned char spinlock_t;
+typedef uint32_t *vm_page_directory_t;
+typedef uint32_t vm_address_t;
+
+// The kernel keeps addresses in 32 bit integers, keep the mappings below 4gb on 64 bit hosts
+#if defined(__x86_64__) && defined(MAP_32BIT)
+	#define kShimMapFlags (MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT)
+#else
+	#define kShimMapFlags (MAP_PRIVATE | MAP_ANONYMOUS)
+#endif
+
+void panic(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+
+	fprintf(stderr, "panic: ");
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+
+	va_end(args);
+	abort();
+}
+
+void syslog(int level, const char *format, ...)
+{
+	if(level > 3) // Only errors and warnings, benchmarks shouldn't measure the terminal
+		return;
+
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+}
+
+
+void spinlock_lock(spinlock_t *lock)
+{
+	while(__sync_lock_test_and_set(lock, 1))
+		;
+}
+
+int spinlock_tryLock(spinlock_t *lock)
+{
+	return (__sync_lock_test_and_set(lock, 1) == 0);
+}
+
+void spinlock_unlock(spinlock_t *lock)
+{
+	__sync_lock_release(lock);
+}
+
+
+uintptr_t pm_alloc(size_t pages)
+{
+	void *memory = mmap(NULL, pages * 4096, PROT_READ | PROT_WRITE, kShimMapFlags, -1, 0);
+	return (memory == MAP_FAILED) ? 0 : (uintptr_t)memory;
+}
+
+uintptr_t pm_allocLimit(__attribute__((unused)) uintptr_t lowerLimit, size_t pages)
+{
+	return pm_alloc(pages);
+}
+
+void pm_free(uintptr_t page, size_t pages)
+{
+	munmap((void *)page, pages * 4096);
+}
+
+vm_page_directory_t vm_getKernelDirectory()
+{
+	return NULL;
+}
+
+vm_address_t vm_alloc(__attribute__((unused)) vm_page_directory_t directory, uintptr_t pmemory, __attribute__((unused)) size_t pages, __attribute__((unused)) uint32_t flags)
+{
+	return (vm_address_t)pmemory;
+}
+
+void vm_free(__attribute__((unused)) vm_page_directory_t directory, __attribute__((unused)) vm_address_t address, __attribute__((unused)) size_t pages)
+{}
+
+uintptr_t vm_resolveVirtualAddress(__attribute__((unused)) vm_page_directory_t directory, vm_address_t address)
+{
+	return (uintptr_t)address;
+}
+
+
+// The libc zone allocator gets its memory through mmap(), it is renamed to this at compile time
+void *hosttest_mmap(void *address, unsigned int length, __attribute__((unused)) int protection, __attribute__((unused)) int flags, __attribute__((unused)) int fd, __attribute__((unused)) int offset)
+{
+	void *memory = mmap(address, length, PROT_READ | PROT_WRITE, kShimMapFlags, -1, 0);
+	return (memory == MAP_FAILED) ? (void *)-1 : memory;
+}
+
+int hosttest_munmap(void *address, unsigned int length)
+{
+	return munmap(address, length);
+}
+
+// The libc malloc keeps its thread cache in a TLS bucket
+static __thread void *hosttest_mallocCache = NULL;
+
+void **__tls_mallocCache()
+{
+	return &hosttest_mallocCache;
+}
@@ -15,73 +15,546 @@
 //  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
 //  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
-
-#include "sys/zone.h"
+#include "sys/mman.h"
 #include "sys/lock.h"
+#include "sys/tls.h"
 #include "math.h"
 #include "string.h"
 #include "stdint.h"
-#include "stdio.h"
+#include "stdlib.h"
+
+/*
+ * Overview:
+ * Small allocations are rounded up to one of kMallocClasses size classes. Every class carves its objects out of
+ * runs, page aligned chunks obtained from mmap() that only hold objects of that class. Each thread keeps a cache
+ * of free objects per class in its TLS area, malloc() and free() only touch the class lock when a cache runs
+ * empty or overflows, and then move a whole batch at once.
+ * A two level page map translates any pointer into the run or large allocation it belongs to, so free() and
+ * realloc() find the size of an allocation without searching.
+ * Allocations above kMallocMaxSmall are served straight from mmap() and returned with munmap().
+ */
+
+#define kMallocPageSize  4096
+#define kMallocPageShift 12
+
+#define kMallocClasses   36
+#define kMallocMaxSmall  16384
+#define kMallocAlignment 16
+
+#define kMallocMinRunPages 4
+#define kMallocMaxBatch    32
+
+#define kMallocTypeRun   0x52554e21 // 'RUN!'
+#define kMallocTypeLarge 0x4c524745 // 'LRGE'
+
+typedef struct malloc_run_s
+{
+	uint32_t type;
+	uint32_t sizeClass;
+
+	uint32_t freeObjects; // Objects on the free list plus the ones that were never handed out
+	uint32_t totalObjects;
+	size_t pages;
+
+	void *freeList;
+	uintptr_t bump;
+	uintptr_t end;
+
+	struct malloc_run_s *next;
+	struct malloc_run_s *prev;
+} malloc_run_t;
+
+typedef struct
+{
+	uint32_t type;
+	size_t pages;
+	size_t size;
+	uint32_t reserved;
+} malloc_large_t;
 
-static zone_t *__malloc_zone = NULL;
-static spinlock_t lock = SPINLOCK_INIT;
+typedef struct
+{
+	spinlock_t lock;
+	malloc_run_t *partial; // Runs that have free objects
+} malloc_class_t;
 
-extern size_t __heap_sizeForPointer(zone_t *heap, uintptr_t ptr);
+typedef struct
+{
+	void *head;
+	uint32_t count;
+} malloc_bin_t;
 
-zone_t *_malloc_getZone()
+typedef struct
 {
-	spinlock_lock(&lock);
+	malloc_bin_t bins[kMallocClasses];
+} malloc_cache_t;
 
-	if(!__malloc_zone)
-		__malloc_zone = _zone_create(kZoneFlagAligned);
+static malloc_class_t __malloc_classes[kMallocClasses];
 
-	spinlock_unlock(&lock);
+static void **__malloc_pagemap[1024]; // Indexed by the upper 10 bits of the address, leaves cover 4mb each
+static spinlock_t __malloc_pagemapLock = SPINLOCK_INIT;
 
-	return __malloc_zone;
+// MARK: Size classes
+
+// 16 byte steps up to 128 bytes, above that four classes per power of two
+static inline uint32_t malloc_classForSize(size_t size)
+{
+	if(size <= 128)
+		return (size > 0) ? (uint32_t)((size - 1) >> 4) : 0;
+
+	uint32_t shift = 31 - __builtin_clz((uint32_t)(size - 1));
+	return 8 + (shift - 7) * 4 + (uint32_t)((size - 1) >> (shift - 2)) - 4;
 }
 
-void *malloc(size_t size)
+static inline size_t malloc_sizeForClass(uint32_t sizeClass)
 {
-	zone_t *zone = _malloc_getZone();
-	return _zone_alloc(zone, size);
+	if(sizeClass < 8)
+		return (sizeClass + 1) << 4;
+
+	uint32_t group = (sizeClass - 8) / 4;
+	uint32_t step  = (sizeClass - 8) % 4;
+
+	return (128 << group) + (step + 1) * (32 << group);
 }
 
-void *calloc(size_t num, size_t size)
+static inline size_t malloc_runPagesForClass(uint32_t sizeClass)
 {
-	zone_t *zone = _malloc_getZone();
-	void *allocation = _zone_alloc(zone, num * size);
+	size_t pages = (malloc_sizeForClass(sizeClass) * 8 + kMallocPageSize - 1) >> kMallocPageShift;
+	return MAX(pages, kMallocMinRunPages);
+}
 
-	if(allocation)
+static inline uint32_t malloc_batchForClass(uint32_t sizeClass)
+{
+	uint32_t batch = (uint32_t)(kMallocPageSize / malloc_sizeForClass(sizeClass));
+	return MIN(MAX(batch, 4), kMallocMaxBatch);
+}
+
+// MARK: Page map
+
+static inline void *malloc_pagemapLookup(const void *pointer)
+{
+	uintptr_t page = (uintptr_t)pointer >> kMallocPageShift;
+	void **leaf = __malloc_pagemap[(page >> 10) & 1023];
+
+	return leaf ? leaf[page & 1023] : NULL;
+}
+
+static bool malloc_pagemapSet(uintptr_t address, size_t pages, void *owner)
+{
+	uintptr_t page = address >> kMallocPageShift;
+
+	for(size_t i=0; i<pages; i++, page++)
 	{
-		memset(allocation, 0, num * size);
+		void ***slot = (void ***)&__malloc_pagemap[(page >> 10) & 1023];
+
+		if(!*slot)
+		{
+			spinlock_lock(&__malloc_pagemapLock);
+
+			if(!*slot)
+			{
+				void **leaf = mmap(NULL, 1024 * sizeof(void *), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0);
+				if(leaf == MAP_FAILED)
+				{
+					spinlock_unlock(&__malloc_pagemapLock);
+					return false;
+				}
+
+				*slot = leaf; // Fresh mmap() memory is zeroed
+			}
+
+			spinlock_unlock(&__malloc_pagemapLock);
+		}
+
+		(*slot)[page & 1023] = owner;
 	}
 
-	return allocation;
+	return true;
 }
 
-void *realloc(void *ptr, size_t size)
+// MARK: Runs
+
+static malloc_run_t *malloc_runCreate(uint32_t sizeClass)
 {
-	zone_t *zone = _malloc_getZone();
-	size_t oldSize = __heap_sizeForPointer(zone, (uintptr_t)ptr);
+	size_t pages = malloc_runPagesForClass(sizeClass);
+	size_t objectSize = malloc_sizeForClass(sizeClass);
+
+	malloc_run_t *run = mmap(NULL, pages * kMallocPageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0);
+	if(run == MAP_FAILED)
+		return NULL;
 
-	if(oldSize > 0)
+	uintptr_t begin = ((uintptr_t)run + sizeof(malloc_run_t) + kMallocAlignment - 1) & ~(kMallocAlignment - 1);
+	uintptr_t end   = (uintptr_t)run + pages * kMallocPageSize;
+
+	run->type      = kMallocTypeRun;
+	run->sizeClass = sizeClass;
+	run->pages     = pages;
+
+	run->totalObjects = (uint32_t)((end - begin) / objectSize);
+	run->freeObjects  = run->totalObjects;
+
+	run->freeList = NULL;
+	run->bump     = begin;
+	run->end      = begin + run->totalObjects * objectSize;
+
+	run->next = run->prev = NULL;
+
+	if(!malloc_pagemapSet((uintptr_t)run, pages, run))
 	{
-		void *allocation = _zone_alloc(zone, size);
+		munmap(run, pages * kMallocPageSize);
+		return NULL;
+	}
 
-		if(allocation)
+	return run;
+}
+
+static inline void malloc_classLinkRun(malloc_class_t *class, malloc_run_t *run)
+{
+	run->prev = NULL;
+	run->next = class->partial;
+
+	if(class->partial)
+		class->partial->prev = run;
+
+	class->partial = run;
+}
+
+static inline void malloc_classUnlinkRun(malloc_class_t *class, malloc_run_t *run)
+{
+	if(run->prev)
+		run->prev->next = run->next;
+	if(run->next)
+		run->next->prev = run->prev;
+
+	if(class->partial == run)
+		class->partial = run->next;
+
+	run->next = run->prev = NULL;
+}
+
+static inline void *malloc_runPop(malloc_run_t *run, size_t objectSize)
+{
+	void *object = run->freeList;
+
+	if(object)
+	{
+		run->freeList = *(void **)object;
+	}
+	else
+	{
+		object = (void *)run->bump;
+		run->bump += objectSize;
+	}
+
+	run->freeObjects --;
+	return object;
+}
+
+// Moves up to count objects of the class into the bin, returns false if no memory could be obtained
+static bool malloc_classRefill(uint32_t sizeClass, malloc_bin_t *bin, uint32_t count)
+{
+	malloc_class_t *class = &__malloc_classes[sizeClass];
+	size_t objectSize = malloc_sizeForClass(sizeClass);
+
+	spinlock_lock(&class->lock);
+
+	while(!class->partial)
+	{
+		spinlock_unlock(&class->lock);
+
+		malloc_run_t *run = malloc_runCreate(sizeClass);
+		if(!run)
+			return false;
+
+		spinlock_lock(&class->lock);
+		malloc_classLinkRun(class, run);
+	}
+
+	while(count > 0 && class->partial)
+	{
+		malloc_run_t *run = class->partial;
+
+		while(count > 0 && run->freeObjects > 0)
 		{
-			memcpy(allocation, ptr, MIN(size, oldSize));
-			_zone_free(zone, ptr);
+			void *object = malloc_runPop(run, objectSize);
+
+			*(void **)object = bin->head;
+			bin->head = object;
+			bin->count ++;
 
-			return allocation;
+			count --;
 		}
+
+		if(run->freeObjects == 0)
+			malloc_classUnlinkRun(class, run);
 	}
 
-	return NULL;
+	spinlock_unlock(&class->lock);
+	return true;
+}
+
+// Returns count objects from the bin to their runs, runs that become empty are unmapped
+static void malloc_classFlush(uint32_t sizeClass, malloc_bin_t *bin, uint32_t count)
+{
+	malloc_class_t *class = &__malloc_classes[sizeClass];
+	malloc_run_t *release = NULL;
+
+	spinlock_lock(&class->lock);
+
+	while(count > 0 && bin->head)
+	{
+		void *object = bin->head;
+		bin->head = *(void **)object;
+		bin->count --;
+		count --;
+
+		malloc_run_t *run = malloc_pagemapLookup(object);
+
+		*(void **)object = run->freeList;
+		run->freeList = object;
+
+		if((run->freeObjects ++) == 0)
+			malloc_classLinkRun(class, run);
+
+		// Keep one empty run around per class to avoid mmap() churn
+		if(run->freeObjects == run->totalObjects && (run->next || run->prev))
+		{
+			malloc_classUnlinkRun(class, run);
+
+			run->next = release;
+			release = run;
+		}
+	}
+
+	spinlock_unlock(&class->lock);
+
+	while(release)
+	{
+		malloc_run_t *run = release;
+		release = run->next;
+
+		malloc_pagemapSet((uintptr_t)run, run->pages, NULL);
+		munmap(run, run->pages * kMallocPageSize);
+	}
+}
+
+// MARK: Thread caches
+
+static malloc_cache_t *malloc_threadCache()
+{
+	void **slot = __tls_mallocCache();
+	if(!slot)
+		return NULL;
+
+	malloc_cache_t *cache = *slot;
+	if(!cache)
+	{
+		size_t size = (sizeof(malloc_cache_t) + kMallocPageSize - 1) & ~(kMallocPageSize - 1);
+
+		cache = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0);
+		if(cache == MAP_FAILED)
+			return NULL;
+
+		*slot = cache;
+	}
+
+	return cache;
+}
+
+// Called by the thread entry trampoline before a thread exits
+void __malloc_threadExit()
+{
+	void **slot = __tls_mallocCache();
+	if(!slot || !*slot)
+		return;
+
+	malloc_cache_t *cache = *slot;
+	*slot = NULL;
+
+	for(uint32_t i=0; i<kMallocClasses; i++)
+	{
+		if(cache->bins[i].count > 0)
+			malloc_classFlush(i, &cache->bins[i], cache->bins[i].count);
+	}
+
+	munmap(cache, (sizeof(malloc_cache_t) + kMallocPageSize - 1) & ~(kMallocPageSize - 1));
+}
+
+// MARK: Large allocations
+
+static void *malloc_largeAlloc(size_t size)
+{
+	size_t pages = (size + sizeof(malloc_large_t) + kMallocPageSize - 1) >> kMallocPageShift;
+
+	malloc_large_t *large = mmap(NULL, pages * kMallocPageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0);
+	if(large == MAP_FAILED)
+		return NULL;
+
+	large->type  = kMallocTypeLarge;
+	large->pages = pages;
+	large->size  = size;
+
+	if(!malloc_pagemapSet((uintptr_t)large, 1, large))
+	{
+		munmap(large, pages * kMallocPageSize);
+		return NULL;
+	}
+
+	return large + 1;
+}
+
+static void malloc_largeFree(malloc_large_t *large)
+{
+	malloc_pagemapSet((uintptr_t)large, 1, NULL);
+
+	if(munmap(large, large->pages * kMallocPageSize) != 0)
+		malloc_pagemapSet((uintptr_t)large, 1, large); // Still mapped, keep it reachable instead of losing track of it
+}
+
+// Grows the allocation without moving it into the slack of its last page.
+// Mapping more pages behind it isn't possible, munmap() can't span two separate mappings
+static bool malloc_largeGrow(malloc_large_t *large, size_t size)
+{
+	size_t pages = (size + sizeof(malloc_large_t) + kMallocPageSize - 1) >> kMallocPageShift;
+
+	if(pages > large->pages)
+		return false;
+
+	large->size = size;
+	return true;
+}
+
+// MARK: Public interface
+
+void *malloc(size_t size)
+{
+	if(size > kMallocMaxSmall)
+		return malloc_largeAlloc(size);
+
+	uint32_t sizeClass = malloc_classForSize(size);
+	malloc_cache_t *cache = malloc_threadCache();
+
+	if(!cache)
+	{
+		// No TLS area, go through the class directly
+		malloc_bin_t bin = { NULL, 0 };
+
+		if(!malloc_classRefill(sizeClass, &bin, 1))
+			return NULL;
+
+		return bin.head;
+	}
+
+	malloc_bin_t *bin = &cache->bins[sizeClass];
+
+	if(!bin->head && !malloc_classRefill(sizeClass, bin, malloc_batchForClass(sizeClass)))
+		return NULL;
+
+	void *object = bin->head;
+
+	bin->head = *(void **)object;
+	bin->count --;
+
+	return object;
 }
 
 void free(void *ptr)
 {
-	zone_t *zone = _malloc_getZone();
-	_zone_free(zone, ptr);
+	if(!ptr)
+		return;
+
+	uint32_t *type = malloc_pagemapLookup(ptr);
+	if(!type)
+		return;
+
+	if(*type == kMallocTypeLarge)
+	{
+		malloc_largeFree((malloc_large_t *)type);
+		return;
+	}
+
+	malloc_run_t *run = (malloc_run_t *)type;
+	malloc_cache_t *cache = malloc_threadCache();
+
+	if(!cache)
+	{
+		malloc_bin_t bin = { ptr, 1 };
+		*(void **)ptr = NULL;
+
+		malloc_classFlush(run->sizeClass, &bin, 1);
+		return;
+	}
+
+	malloc_bin_t *bin = &cache->bins[run->sizeClass];
+
+	*(void **)ptr = bin->head;
+	bin->head = ptr;
+	bin->count ++;
+
+	uint32_t batch = malloc_batchForClass(run->sizeClass);
+
+	if(bin->count >= batch * 2)
+		malloc_classFlush(run->sizeClass, bin, batch);
+}
+
+void *calloc(size_t num, size_t size)
+{
+	if(size && num > UINT32_MAX / size)
+		return NULL;
+
+	size_t total = num * size;
+	void *allocation = malloc(total);
+
+	// Large allocations come straight from mmap() and are already zeroed
+	if(allocation && total <= kMallocMaxSmall)
+		memset(allocation, 0, total);
+
+	return allocation;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	if(!ptr)
+		return malloc(size);
+
+	if(size == 0)
+	{
+		free(ptr);
+		return NULL;
+	}
+
+	uint32_t *type = malloc_pagemapLookup(ptr);
+	if(!type)
+		return NULL;
+
+	size_t oldSize;
+
+	if(*type == kMallocTypeLarge)
+	{
+		malloc_large_t *large = (malloc_large_t *)type;
+
+		if(size > kMallocMaxSmall && malloc_largeGrow(large, size))
+			return ptr;
+
+		oldSize = large->size;
+	}
+	else
+	{
+		malloc_run_t *run = (malloc_run_t *)type;
+
+		oldSize = malloc_sizeForClass(run->sizeClass);
+
+		// Still the same size class, nothing to do
+		if(size <= kMallocMaxSmall && malloc_classForSize(size) == run->sizeClass)
+			return ptr;
+	}
+
+	void *allocation = malloc(size);
+	if(allocation)
+	{
+		memcpy(allocation, ptr, MIN(size, oldSize));
+		free(ptr);
+	}
+
+	return allocation;
 }
@@ -28,6 +28,20 @@ struct dirent
 	int type;
 };
 
+// Compact, variable length entry as returned by getdents()
+struct dirent_record
+{
+	ino_t id;
+	unsigned short length; // Offset to the next record
+	unsigned char type;
+	unsigned char nameLength;
+	char name[]; // NUL terminated
+};
+
+#define DIRENT_RECORD_NEXT(record) ((struct dirent_record *)(((char *)(record)) + (record)->length))
+
 off_t readdir(int fd, struct dirent *entp, size_t count);
+// Fills the buffer with as many records as fit, returns the number of bytes used or 0 at the end of the directory
+size_t getdents(int fd, void *buffer, size_t size);
 
 #endif
@@ -0,0 +1,122 @@
+//
+//  sys/ioring.c
+//  libc
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "ioring.h"
+#include "syscall.h"
+
+struct ioring *io_setup(uint32_t entries)
+{
+	unsigned int result = syscall(SYS_IO_SETUP, entries);
+	return (result == (unsigned int)-1) ? NULL : (struct ioring *)result;
+}
+
+int io_enter(uint32_t count)
+{
+	return (int)syscall(SYS_IO_ENTER, count);
+}
+
+
+struct ioring_sqe *ioring_getSQE(struct ioring *ring)
+{
+	uint32_t tail = ring->sqTail;
+	if(tail - ring->sqHead >= ring->sqEntries)
+		return NULL;
+
+	struct ioring_sqe *sqes = (struct ioring_sqe *)(((uint8_t *)ring) + ring->sqOffset);
+	struct ioring_sqe *sqe = &sqes[tail & (ring->sqEntries - 1)];
+
+	sqe->opcode   = IORING_OP_NOP;
+	sqe->fd       = -1;
+	sqe->address  = 0;
+	sqe->length   = 0;
+	sqe->stat     = 0;
+	sqe->userData = 0;
+
+	__sync_synchronize(); // The kernel may only see the tail after the entry is complete
+	ring->sqTail = tail + 1;
+
+	return sqe;
+}
+
+void ioring_prepRead(struct ioring_sqe *sqe, int fd, void *buffer, size_t count, uint32_t userData)
+{
+	sqe->opcode   = IORING_OP_READ;
+	sqe->fd       = fd;
+	sqe->address  = (uint32_t)buffer;
+	sqe->length   = count;
+	sqe->userData = userData;
+}
+
+void ioring_prepWrite(struct ioring_sqe *sqe, int fd, const void *buffer, size_t count, uint32_t userData)
+{
+	sqe->opcode   = IORING_OP_WRITE;
+	sqe->fd       = fd;
+	sqe->address  = (uint32_t)buffer;
+	sqe->length   = count;
+	sqe->userData = userData;
+}
+
+void ioring_prepOpen(struct ioring_sqe *sqe, const char *path, int flags, uint32_t userData)
+{
+	sqe->opcode   = IORING_OP_OPEN;
+	sqe->address  = (uint32_t)path;
+	sqe->length   = (uint32_t)flags;
+	sqe->userData = userData;
+}
+
+void ioring_prepClose(struct ioring_sqe *sqe, int fd, uint32_t userData)
+{
+	sqe->opcode   = IORING_OP_CLOSE;
+	sqe->fd       = fd;
+	sqe->userData = userData;
+}
+
+void ioring_prepStat(struct ioring_sqe *sqe, const char *path, struct stat *buf, uint32_t userData)
+{
+	sqe->opcode   = IORING_OP_STAT;
+	sqe->address  = (uint32_t)path;
+	sqe->stat     = (uint32_t)buf;
+	sqe->userData = userData;
+}
+
+int ioring_submit(struct ioring *ring)
+{
+	uint32_t pending = ring->sqTail - ring->sqHead;
+	if(pending == 0)
+		return 0;
+
+	return io_enter(pending);
+}
+
+
+struct ioring_cqe *ioring_peekCQE(struct ioring *ring)
+{
+	uint32_t head = ring->cqHead;
+	if(head == ring->cqTail)
+		return NULL;
+
+	__sync_synchronize(); // Read the entry only after seeing the tail that published it
+
+	struct ioring_cqe *cqes = (struct ioring_cqe *)(((uint8_t *)ring) + ring->cqOffset);
+	return &cqes[head & (ring->cqEntries - 1)];
+}
+
+void ioring_seen(struct ioring *ring)
+{
+	ring->cqHead = ring->cqHead + 1;
+}
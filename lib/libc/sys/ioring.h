@@ -0,0 +1,89 @@
+//
+//  sys/ioring.h
+//  libc
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _SYS_IORING_H_
+#define _SYS_IORING_H_
+
+#include "../stdint.h"
+#include "types.h"
+#include "unistd.h"
+
+// Mirrors the kernels syscall/scioring.h
+
+#define IORING_MAX_ENTRIES 256
+
+#define IORING_OP_NOP   0
+#define IORING_OP_READ  1
+#define IORING_OP_WRITE 2
+#define IORING_OP_OPEN  3
+#define IORING_OP_CLOSE 4
+#define IORING_OP_STAT  5
+
+struct ioring_sqe
+{
+	uint32_t opcode;
+	int32_t fd;
+	uint32_t address;
+	uint32_t length;
+	uint32_t stat;
+	uint32_t userData;
+};
+
+struct ioring_cqe
+{
+	uint32_t userData;
+	int32_t result;
+	int32_t error;
+};
+
+struct ioring
+{
+	volatile uint32_t sqHead;
+	volatile uint32_t sqTail;
+	uint32_t sqEntries;
+	uint32_t sqOffset;
+
+	volatile uint32_t cqHead;
+	volatile uint32_t cqTail;
+	uint32_t cqEntries;
+	uint32_t cqOffset;
+};
+
+// Raw system calls
+struct ioring *io_setup(uint32_t entries);
+int io_enter(uint32_t count);
+
+// Rings are meant to be driven by a single thread.
+// Returns the next free submission entry or NULL if the submission queue is full.
+// The entry is queued right away but only seen by the kernel with the next ioring_submit()
+struct ioring_sqe *ioring_getSQE(struct ioring *ring);
+
+void ioring_prepRead(struct ioring_sqe *sqe, int fd, void *buffer, size_t count, uint32_t userData);
+void ioring_prepWrite(struct ioring_sqe *sqe, int fd, const void *buffer, size_t count, uint32_t userData);
+void ioring_prepOpen(struct ioring_sqe *sqe, const char *path, int flags, uint32_t userData);
+void ioring_prepClose(struct ioring_sqe *sqe, int fd, uint32_t userData);
+void ioring_prepStat(struct ioring_sqe *sqe, const char *path, struct stat *buf, uint32_t userData);
+
+// Hands all queued entries to the kernel with a single system call, returns the number of consumed entries
+int ioring_submit(struct ioring *ring);
+
+// Returns the oldest completion or NULL, ioring_seen() releases it
+struct ioring_cqe *ioring_peekCQE(struct ioring *ring);
+void ioring_seen(struct ioring *ring);
+
+#endif /* _SYS_IORING_H_ */
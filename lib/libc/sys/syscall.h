@@ -32,6 +32,7 @@
 #define SYS_THREADJOIN    10
 #define SYS_THREADSELF    11
 #define SYS_TLS_AREA      12
+#define SYS_TLS_TEMPLATE  13
 #define SYS_PROCESSCREATE 17
 #define SYS_PROCESSKILL   18
 #define SYS_MMAP          19
@@ -47,6 +48,11 @@
 #define SYS_REMOVE        29
 #define SYS_MOVE          30
 #define SYS_STAT          31
+#define SYS_GETDENTS      32
+#define SYS_DUP           33
+#define SYS_DUP2          34
+#define SYS_IO_SETUP      35
+#define SYS_IO_ENTER      36
 
 unsigned int syscall(int type, ...);
 
@@ -20,7 +20,9 @@
 #include "tls.h"
 
 #define kTLSAreaSize 2
-#define kTLSBucketCount ((kTLSAreaSize * 4096) / sizeof(struct tls_bucket_s))
+#define kTLSBucketCount (((kTLSAreaSize * 4096) - sizeof(struct tls_area_s)) / sizeof(struct tls_bucket_s))
+#define kTLSReservedBuckets 2 // errno and the malloc thread cache
+#define kTLSSelector 0x33 // The kernel loads %gs with this selector once the thread has a TLS area
 
 struct tls_bucket_s
 {
@@ -28,15 +30,55 @@ struct tls_bucket_s
 	void *value;
 };
 
+struct tls_area_s
+{
+	struct tls_area_s *self; // The thread pointer, stored by the kernel so that %gs:0 yields a flat pointer
+	uint32_t reserved;
+	struct tls_bucket_s buckets[];
+};
+
+static int __tls_fallbackErrno = 0;
+
+static struct tls_area_s *__tls_allocateArea() __attribute__((noinline));
+static struct tls_area_s *__tls_allocateArea()
+{
+	// Bypasses syscall() on purpose, a failure would make it store errno into the very area that couldn't be created.
+	// The stack mimics a call to syscall(): return address, syscall number and the argument
+	uint32_t result, error;
+	__asm__ volatile("pushl %4\n"
+		"pushl %%eax\n"
+		"pushl $0\n"
+		"int $0x80\n"
+		"addl $12, %%esp" : "=a" (result), "=c" (error) : "0" (SYS_TLS_AREA), "1" (0), "i" (kTLSAreaSize) : "memory");
+
+	return (error == 0) ? (struct tls_area_s *)result : NULL;
+}
+
+static inline struct tls_area_s *__tls_area()
+{
+	uint32_t selector;
+	__asm__ volatile("movl %%gs, %0" : "=r" (selector));
+
+	if(__builtin_expect((selector & 0xffff) != kTLSSelector, 0))
+		return __tls_allocateArea();
+
+	// Volatile so that the load isn't hoisted above the selector check, without a TLS area %gs:0 would fault
+	struct tls_area_s *area;
+	__asm__ volatile("movl %%gs:0, %0" : "=r" (area));
+
+	return area;
+}
+
+
 bool tls_set(tls_key_t key, const void *value)
 {
-	if(key == kTLSInvalidKey || key == 0)
+	if(key == kTLSInvalidKey || key < kTLSReservedBuckets || key >= kTLSBucketCount)
 		return false;
 
-	struct tls_bucket_s *bucket = (struct tls_bucket_s *)syscall(SYS_TLS_AREA, kTLSAreaSize);
-	if(bucket)
+	struct tls_area_s *area = __tls_area();
+	if(area)
 	{
-		bucket += key;
+		struct tls_bucket_s *bucket = &area->buckets[key];
 		if(bucket->occupied)
 		{
 			bucket->value = (void *)value;
@@ -49,14 +91,13 @@ bool tls_set(tls_key_t key, const void *value)
 
 void *tls_get(tls_key_t key)
 {
-	if(key == kTLSInvalidKey || key == 0)
+	if(key == kTLSInvalidKey || key < kTLSReservedBuckets || key >= kTLSBucketCount)
 		return NULL;
 
-	struct tls_bucket_s *bucket = (struct tls_bucket_s *)syscall(SYS_TLS_AREA, kTLSAreaSize);
-	if(bucket)
+	struct tls_area_s *area = __tls_area();
+	if(area)
 	{
-		bucket += key;
-
+		struct tls_bucket_s *bucket = &area->buckets[key];
 		if(bucket->occupied)
 			return bucket->value;
 	}
@@ -67,8 +108,11 @@ void *tls_get(tls_key_t key)
 
 int *__tls_errno()
 {
-	struct tls_bucket_s *buckets = (struct tls_bucket_s *)syscall(SYS_TLS_AREA, kTLSAreaSize);
-	return (int *)&(buckets[0].value);
+	struct tls_area_s *area = __tls_area();
+	if(!area)
+		return &__tls_fallbackErrno;
+
+	return (int *)&area->buckets[0].value;
 }
 
 void __tls_setErrno(int value)
@@ -76,17 +120,52 @@ void __tls_setErrno(int value)
 	*__tls_errno() = value;
 }
 
+// Compiler generated __thread accesses go through %gs directly, so every thread needs its area before
+// running any code of the program. Called by __thread_entry() and the startup code of libcrt
+void __tls_setup()
+{
+	__tls_area();
+}
+
+void **__tls_mallocCache()
+{
+	struct tls_area_s *area = __tls_area();
+	if(!area)
+		return NULL;
+
+	return &area->buckets[1].value;
+}
+
+
+// ELF TLS
+// linkd places the TLS block of every module into the static block below the thread pointer and uses
+// the distance of the block from the thread pointer as module ID, so no dynamic thread vector is needed
+
+void *__tls_get_addr(tls_index_t *index)
+{
+	uint8_t *pointer = (uint8_t *)__tls_area();
+	if(!pointer)
+		return NULL;
+
+	return pointer - index->module + index->offset;
+}
+
+__attribute__((regparm(1))) void *___tls_get_addr(tls_index_t *index)
+{
+	return __tls_get_addr(index);
+}
+
 
 tls_key_t tls_allocateKey()
 {
-	struct tls_bucket_s *buckets = (struct tls_bucket_s *)syscall(SYS_TLS_AREA, kTLSAreaSize);
-	if(buckets)
+	struct tls_area_s *area = __tls_area();
+	if(area)
 	{
-		for(uint32_t i=1; i<kTLSBucketCount; i++)
+		for(uint32_t i=kTLSReservedBuckets; i<kTLSBucketCount; i++)
 		{
-			if(!buckets[i].occupied)
+			if(!area->buckets[i].occupied)
 			{
-				buckets[i].occupied = true;
+				area->buckets[i].occupied = true;
 				return (tls_key_t)i;
 			}
 		}
@@ -97,13 +176,10 @@ tls_key_t tls_allocateKey()
 
 void tls_freeKey(tls_key_t key)
 {
-	if(key == kTLSInvalidKey || key == 0)
+	if(key == kTLSInvalidKey || key < kTLSReservedBuckets || key >= kTLSBucketCount)
 		return;
 
-	struct tls_bucket_s *bucket = (struct tls_bucket_s *)syscall(SYS_TLS_AREA, kTLSAreaSize);
-	if(bucket)
-	{
-		bucket += key;
-		bucket->occupied = false;
-	}
+	struct tls_area_s *area = __tls_area();
+	if(area)
+		area->buckets[key].occupied = false;
 }
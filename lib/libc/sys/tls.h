@@ -30,6 +30,18 @@ void *tls_get(tls_key_t key);
 int *__tls_errno();
 void __tls_setErrno(int value);
 
+void **__tls_mallocCache();
+void __tls_setup();
+
+typedef struct
+{
+	unsigned long module;
+	unsigned long offset;
+} tls_index_t;
+
+void *__tls_get_addr(tls_index_t *index);
+void *___tls_get_addr(tls_index_t *index) __attribute__((regparm(1))); // The GNU i386 variant, takes the index in %eax
+
 tls_key_t tls_allocateKey();
 void tls_freeKey(tls_key_t key);
 
@@ -28,6 +28,14 @@ void close(int fd)
 {
 	syscall(SYS_CLOSE, fd);
 }
+int dup(int fd)
+{
+	return (int)syscall(SYS_DUP, fd);
+}
+int dup2(int fd, int target)
+{
+	return (int)syscall(SYS_DUP2, fd, target);
+}
 
 size_t read(int fd, void *buffer, size_t count)
 {
@@ -45,6 +53,10 @@ off_t readdir(int fd, struct dirent *entp, size_t count)
 {
 	return (off_t)syscall(SYS_DIRREAD, fd, entp, count);
 }
+size_t getdents(int fd, void *buffer, size_t size)
+{
+	return (size_t)syscall(SYS_GETDENTS, fd, buffer, size);
+}
 
 int mkdir(const char *path)
 {
@@ -42,6 +42,8 @@ struct stat
 
 int open(const char *path, int flags);
 void close(int fd);
+int dup(int fd);
+int dup2(int fd, int target);
 
 size_t read(int fd, void *buffer, size_t count);
 size_t write(int fd, const void *buffer, size_t count);
@@ -17,16 +17,22 @@
 //
 
 #include "sys/syscall.h"
+#include "sys/tls.h"
 #include "thread.h"
 
 typedef void (*__thread_entry_point_t)(void *);
 
+extern void __malloc_threadExit();
+
 void __thread_entry(void *tentry, void *arg) __attribute__((noinline)); 
 void __thread_entry(void *tentry, void *arg)
 {
 	__thread_entry_point_t entry = (__thread_entry_point_t)tentry;
+
+	__tls_setup();
 	entry(arg);
 
+	__malloc_threadExit();
 	syscall(SYS_THREADEXIT);
 }
 
@@ -19,10 +19,15 @@
 #include "syscall.h"
 
 extern int main(int argc, char *argv[]);
+extern void __tls_setup() __attribute__((weak)); // From libc, not every program links against it
 
 void _start() __attribute__ ((noreturn));
 void _start()
 {
+	// Static executables never pass through linkd, set up the TLS area before any __thread access
+	if(__tls_setup)
+		__tls_setup();
+
 	int result = main(0, 0x0);
 	
 	_crt_syscall(1, result);
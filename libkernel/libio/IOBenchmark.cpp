@@ -0,0 +1,176 @@
+//
+//  IOBenchmark.cpp
+//  libio
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include <libkernel/libkernel.h>
+
+#include "IOBenchmark.h"
+#include "IODictionary.h"
+#include "IOSet.h"
+#include "IONumber.h"
+
+// The small collections stay in the inline storage, the large ones use the hash table.
+// The small size matches typical property and matching dictionaries of the drivers
+#define kIOBenchmarkSmallCount 6
+#define kIOBenchmarkLargeCount 256
+
+struct IOBenchmarkCollection
+{
+	IODictionary *dictionary;
+	IOSet *set;
+
+	IONumber **keys;
+	IONumber *missing;
+	size_t count;
+};
+
+static bool IOBenchmarkCollectionInit(IOBenchmarkCollection *collection, size_t count)
+{
+	collection->dictionary = IODictionary::alloc()->init();
+	collection->set = IOSet::alloc()->init();
+	collection->keys = new IONumber *[count];
+	collection->missing = IONumber::alloc()->initWithUInt32(count);
+	collection->count = 0; // Number of created keys
+
+	if(!collection->dictionary || !collection->set || !collection->keys || !collection->missing)
+		return false;
+
+	for(; collection->count<count; collection->count ++)
+	{
+		IONumber *key = IONumber::alloc()->initWithUInt32(collection->count);
+		collection->keys[collection->count] = key;
+
+		collection->dictionary->setObjectForKey(key, key);
+		collection->set->addObject(key);
+	}
+
+	return true;
+}
+
+static void IOBenchmarkCollectionFree(IOBenchmarkCollection *collection)
+{
+	if(collection->dictionary)
+		collection->dictionary->release();
+
+	if(collection->set)
+		collection->set->release();
+
+	if(collection->missing)
+		collection->missing->release();
+
+	if(collection->keys)
+	{
+		for(size_t i=0; i<collection->count; i++)
+			collection->keys[i]->release();
+
+		delete[] collection->keys;
+	}
+}
+
+// Benchmarks
+
+static void IOBenchmarkDictionaryLookup(void *argument, uint32_t iterations)
+{
+	IOBenchmarkCollection *collection = (IOBenchmarkCollection *)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		collection->dictionary->objectForKey(collection->keys[i % collection->count]);
+}
+
+static void IOBenchmarkDictionaryMiss(void *argument, uint32_t iterations)
+{
+	IOBenchmarkCollection *collection = (IOBenchmarkCollection *)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		collection->dictionary->objectForKey(collection->missing);
+}
+
+static void IOBenchmarkDictionaryInsert(void *argument, uint32_t iterations)
+{
+	IOBenchmarkCollection *collection = (IOBenchmarkCollection *)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		collection->dictionary->setObjectForKey(collection->missing, collection->missing);
+		collection->dictionary->removeObjectForKey(collection->missing);
+	}
+}
+
+static void IOBenchmarkDictionaryCreate(void *argument, uint32_t iterations)
+{
+	IOBenchmarkCollection *collection = (IOBenchmarkCollection *)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		IODictionary *dictionary = IODictionary::alloc()->init();
+
+		for(size_t j=0; j<collection->count; j++)
+			dictionary->setObjectForKey(collection->keys[j], collection->keys[j]);
+
+		dictionary->release();
+	}
+}
+
+static void IOBenchmarkSetContains(void *argument, uint32_t iterations)
+{
+	IOBenchmarkCollection *collection = (IOBenchmarkCollection *)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		collection->set->containsObject(collection->keys[i % collection->count]);
+}
+
+static void IOBenchmarkSetInsert(void *argument, uint32_t iterations)
+{
+	IOBenchmarkCollection *collection = (IOBenchmarkCollection *)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		collection->set->addObject(collection->missing);
+		collection->set->removeObject(collection->missing);
+	}
+}
+
+void IORunBenchmarks()
+{
+	IOBenchmarkCollection small, large;
+
+	bool result = IOBenchmarkCollectionInit(&small, kIOBenchmarkSmallCount);
+	result = (IOBenchmarkCollectionInit(&large, kIOBenchmarkLargeCount) && result);
+
+	if(result)
+	{
+		kbench_suite_t *suite = kbench_suiteCreate((char *)"libio");
+
+		kbench_suiteAdd(suite, (char *)"dictionary_lookup_small", IOBenchmarkDictionaryLookup, &small, 1024);
+		kbench_suiteAdd(suite, (char *)"dictionary_lookup_large", IOBenchmarkDictionaryLookup, &large, 1024);
+		kbench_suiteAdd(suite, (char *)"dictionary_miss_small", IOBenchmarkDictionaryMiss, &small, 1024);
+		kbench_suiteAdd(suite, (char *)"dictionary_miss_large", IOBenchmarkDictionaryMiss, &large, 1024);
+		kbench_suiteAdd(suite, (char *)"dictionary_insert_small", IOBenchmarkDictionaryInsert, &small, 256);
+		kbench_suiteAdd(suite, (char *)"dictionary_insert_large", IOBenchmarkDictionaryInsert, &large, 256);
+		kbench_suiteAdd(suite, (char *)"dictionary_create_small", IOBenchmarkDictionaryCreate, &small, 64);
+		kbench_suiteAdd(suite, (char *)"dictionary_create_large", IOBenchmarkDictionaryCreate, &large, 4);
+		kbench_suiteAdd(suite, (char *)"set_contains_small", IOBenchmarkSetContains, &small, 1024);
+		kbench_suiteAdd(suite, (char *)"set_contains_large", IOBenchmarkSetContains, &large, 1024);
+		kbench_suiteAdd(suite, (char *)"set_insert_small", IOBenchmarkSetInsert, &small, 256);
+		kbench_suiteAdd(suite, (char *)"set_insert_large", IOBenchmarkSetInsert, &large, 256);
+
+		kbench_suiteRun(suite);
+	}
+
+	IOBenchmarkCollectionFree(&small);
+	IOBenchmarkCollectionFree(&large);
+}
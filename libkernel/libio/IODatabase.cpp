@@ -88,6 +88,17 @@ void IODatabase::fixSymbols(IOSymbol *symbol)
 {
 	// Tell all strings in the database that they are strings...
 	IODictionaryBucket **buckets = _symbols->_buckets;
+	if(!buckets)
+	{
+		for(size_t i=0; i<_symbols->_count; i++)
+		{
+			IOString *key = (IOString *)_symbols->_small[i].key;
+			key->_symbol = symbol;
+		}
+
+		return;
+	}
+
 	for(size_t i=0; i<_symbols->_capacity; i++)
 	{
 		IODictionaryBucket *bucket = buckets[i];
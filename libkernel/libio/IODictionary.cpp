@@ -44,6 +44,18 @@ static uint32_t __IODictionaryMaxCount[42] =
 }; 
 
 
+static size_t __IODictionaryCapacityForCount(size_t count)
+{
+	for(size_t i=0; i<41; i++)
+	{
+		if(__IODictionaryMaxCount[i] > count)
+			return __IODictionaryCapacity[i];
+	}
+
+	return __IODictionaryCapacity[41];
+}
+
+
 class IODictionaryIterator : public IOIterator
 {
 public:
@@ -62,18 +74,32 @@ public:
 
 	virtual IOObject *nextObject()
 	{
-		while(!_bucket)
+		if(!_dictionary->_buckets)
 		{
-			if(_index >= _dictionary->_capacity)
+			if(_index >= _dictionary->_count)
 				return 0;
 
-			_bucket = _dictionary->_buckets[_index ++];
+			IODictionaryBucket *bucket = &_dictionary->_small[_index ++];
+			return (_keyIterator) ? bucket->key : bucket->object;
 		}
 
-		IOObject *object = (_keyIterator) ? _bucket->key : _bucket->object;
-		_bucket = _bucket->next;
+		while(1)
+		{
+			while(!_bucket)
+			{
+				if(_index >= _dictionary->_capacity)
+					return 0;
+
+				_bucket = _dictionary->_buckets[_index ++];
+			}
+
+			IODictionaryBucket *bucket = _bucket;
+			_bucket = _bucket->next;
 
-		return object;
+			// Skip removed entries
+			if(bucket->key)
+				return (_keyIterator) ? bucket->key : bucket->object;
+		}
 	}
 
 private:
@@ -94,15 +120,9 @@ IODictionary *IODictionary::init()
 {
 	if(super::init())
 	{
-		_capacity = __IODictionaryCapacity[0];
+		_buckets  = 0;
+		_capacity = 0;
 		_count = 0;
-
-		_buckets = (IODictionaryBucket **)kalloc(_capacity * sizeof(IODictionaryBucket **));
-		if(_buckets == 0)
-		{
-			release();
-			return 0;
-		}
 	}
 
 	return this;
@@ -112,6 +132,13 @@ IODictionary *IODictionary::initWithCapacity(size_t capacity)
 {
 	if(super::init())
 	{
+		_buckets  = 0;
+		_capacity = 0;
+		_count = 0;
+
+		if(capacity <= kIODictionarySmallCapacity)
+			return this;
+
 		for(int i=1; i<42; i++)
 		{
 			if(__IODictionaryCapacity[i] > capacity || i == 41)
@@ -121,8 +148,6 @@ IODictionary *IODictionary::initWithCapacity(size_t capacity)
 			}
 		}
 
-		_count = 0;
-
 		_buckets = (IODictionaryBucket **)kalloc(_capacity * sizeof(IODictionaryBucket **));
 		if(!_buckets)
 		{
@@ -136,7 +161,15 @@ IODictionary *IODictionary::initWithCapacity(size_t capacity)
 
 void IODictionary::free()
 {
-	if(_buckets)
+	if(!_buckets)
+	{
+		for(size_t i=0; i<_count; i++)
+		{
+			_small[i].key->release();
+			_small[i].object->release();
+		}
+	}
+	else
 	{
 		for(size_t i=0; i<_capacity; i++)
 		{
@@ -196,16 +229,29 @@ IODictionary *IODictionary::withObjectsAndKeys(IOObject *object, IOObject *key,
 }
 
 // Lookup
+// The cached hashes are compared first, so isEqual() is only called for likely matches
 
-IODictionaryBucket *IODictionary::findBucket1(IOObject *key)
+IODictionaryBucket *IODictionary::findBucket(IOObject *key, hash_t hash)
 {
-	hash_t hash = key->hash();
+	if(!_buckets)
+	{
+		for(size_t i=0; i<_count; i++)
+		{
+			IODictionaryBucket *bucket = &_small[i];
+
+			if(bucket->hash == hash && (bucket->key == key || bucket->key->isEqual(key)))
+				return bucket;
+		}
+
+		return 0;
+	}
+
 	size_t index = hash % _capacity;
 
 	IODictionaryBucket *bucket = _buckets[index];
 	while(bucket)
 	{
-		if(bucket->key && bucket->key->isEqual(key))
+		if(bucket->key && bucket->hash == hash && (bucket->key == key || bucket->key->isEqual(key)))
 			return bucket;
 
 		bucket = bucket->next;
@@ -214,79 +260,172 @@ IODictionaryBucket *IODictionary::findBucket1(IOObject *key)
 	return 0;
 }
 
+IODictionaryBucket *IODictionary::findBucket1(IOObject *key)
+{
+	return findBucket(key, key->hash());
+}
+
 IODictionaryBucket *IODictionary::findBucket2(IOObject *key)
 {
 	hash_t hash = key->hash();
-	size_t index = hash % _capacity;
 
-	IODictionaryBucket *bucket = _buckets[index];
-	while(bucket)
+	IODictionaryBucket *bucket = findBucket(key, hash);
+	if(bucket)
+		return bucket;
+
+	if(!_buckets)
 	{
-		if(bucket->key && bucket->key->isEqual(key))
+		if(_count < kIODictionarySmallCapacity)
+		{
+			bucket = &_small[_count];
+			bucket->key    = key;
+			bucket->object = 0;
+			bucket->hash   = hash;
+			bucket->next   = 0;
+
 			return bucket;
+		}
 
-		bucket = bucket->next;
+		// The inline storage is full, switch to a hash table
+		rehash(__IODictionaryCapacityForCount(_count + 1));
+
+		if(!_buckets)
+			return 0;
 	}
 
+	size_t index = hash % _capacity;
+
 	bucket = new IODictionaryBucket;
 	if(!bucket)
 		return 0;
 
-	bucket->key  = key;
-	bucket->next = _buckets[index];
+	bucket->key    = key;
+	bucket->object = 0;
+	bucket->hash   = hash;
+	bucket->next   = _buckets[index];
 
 	_buckets[index] = bucket;
 	return bucket;
 }
 
+void IODictionary::removeBucket(IODictionaryBucket *bucket)
+{
+	_count --;
+
+	if(!_buckets)
+	{
+		// Keep the inline entries packed
+		*bucket = _small[_count];
+		return;
+	}
+
+	bucket->object = bucket->key = 0;
+	shrinkIfNeeded();
+}
+
 // Resizing
 
 void IODictionary::rehash(size_t capacity)
 {
-	IODictionaryBucket **buckets = _buckets;
-	size_t cCapacity = _capacity;
-
-	_capacity = capacity;
-	_buckets  = (IODictionaryBucket **)kalloc(_capacity * sizeof(IODictionaryBucket **));
+	IODictionaryBucket **buckets = (IODictionaryBucket **)kalloc(capacity * sizeof(IODictionaryBucket **));
+	if(!buckets)
+		return;
 
 	if(!_buckets)
 	{
-		_capacity = cCapacity;
-		_buckets = buckets;
+		// Move the inline entries into the table, but allocate all buckets up front so that
+		// a failure leaves the dictionary untouched
+		IODictionaryBucket *moved[kIODictionarySmallCapacity];
 
-		return;
+		for(size_t i=0; i<_count; i++)
+		{
+			moved[i] = new IODictionaryBucket;
+			if(!moved[i])
+			{
+				while(i > 0)
+					delete moved[-- i];
+
+				kfree(buckets);
+				return;
+			}
+		}
+
+		for(size_t i=0; i<_count; i++)
+		{
+			IODictionaryBucket *bucket = moved[i];
+			size_t index = _small[i].hash % capacity;
+
+			*bucket = _small[i];
+			bucket->next = buckets[index];
+			buckets[index] = bucket;
+		}
 	}
+	else
+	{
+		// Re-add the old buckets
+		for(size_t i=0; i<_capacity; i++)
+		{
+			IODictionaryBucket *bucket = _buckets[i];
+			while(bucket)
+			{
+				IODictionaryBucket *next = bucket->next;
 
-	// Re-add the old buckets
-	for(size_t i=0; i<cCapacity; i++)
+				if(bucket->key)
+				{
+					size_t index = bucket->hash % capacity;
+
+					bucket->next = buckets[index];
+					buckets[index] = bucket;
+				}
+				else
+				{
+					delete bucket;
+				}
+
+				bucket = next;
+			}
+		}
+
+		kfree(_buckets);
+	}
+
+	_buckets  = buckets;
+	_capacity = capacity;
+}
+
+void IODictionary::compact()
+{
+	size_t count = 0;
+
+	for(size_t i=0; i<_capacity; i++)
 	{
-		IODictionaryBucket *bucket = buckets[i];
+		IODictionaryBucket *bucket = _buckets[i];
 		while(bucket)
 		{
 			IODictionaryBucket *next = bucket->next;
 
 			if(bucket->key)
 			{
-				hash_t hash = bucket->key->hash();
-				size_t index = hash % _capacity;
-
-				bucket->next = _buckets[index];
-				_buckets[index] = bucket;
-			}
-			else
-			{
-				delete bucket;
+				_small[count] = *bucket;
+				_small[count ++].next = 0;
 			}
 
+			delete bucket;
 			bucket = next;
 		}
 	}
 
-	kfree(buckets);
+	kfree(_buckets);
+
+	_buckets  = 0;
+	_capacity = 0;
 }
 
 void IODictionary::expandIfNeeded()
 {
+	if(!_buckets)
+		return;
+
 	for(size_t i=0; i<41; i++)
 	{
 		if(__IODictionaryCapacity[i] == _capacity)
@@ -304,6 +443,14 @@ void IODictionary::expandIfNeeded()
 
 void IODictionary::shrinkIfNeeded()
 {
+	// Only go back to the inline storage when there is room to grow again,
+	// otherwise a dictionary at the boundary would convert back and forth
+	if(_count <= kIODictionarySmallCapacity / 2)
+	{
+		compact();
+		return;
+	}
+
 	for(size_t i=1; i<41; i++)
 	{
 		if(__IODictionaryCapacity[i] == _capacity)
@@ -313,6 +460,8 @@ void IODictionary::shrinkIfNeeded()
 				size_t capacity = __IODictionaryCapacity[i - 1];
 				rehash(capacity);
 			}
+
+			break;
 		}
 	}
 }
@@ -354,10 +503,7 @@ void IODictionary::removeObjectForKey(IOObject *key)
 		bucket->key->release();
 		bucket->object->release();
 
-		bucket->object = bucket->key = 0;
-		_count --;
-
-		shrinkIfNeeded();
+		removeBucket(bucket);
 	}
 }
 
@@ -374,7 +520,7 @@ size_t IODictionary::count()
 
 size_t IODictionary::capacity()
 {
-	return _capacity;
+	return (_buckets != 0) ? _capacity : kIODictionarySmallCapacity;
 }
 
 IOIterator *IODictionary::objectIterator()
@@ -401,7 +547,12 @@ IORegisterClass(__IOPointerDictionary, IODictionary);
 
 void __IOPointerDictionary::free()
 {
-	if(_buckets)
+	if(!_buckets)
+	{
+		for(size_t i=0; i<_count; i++)
+			_small[i].key->release();
+	}
+	else
 	{
 		for(size_t i=0; i<_capacity; i++)
 		{
@@ -424,6 +575,7 @@ void __IOPointerDictionary::free()
 	super::free();
 }
 
+
 void __IOPointerDictionary::setPointerForKey(void *ptr, IOObject *key)
 {
 	if(!ptr)
@@ -457,12 +609,7 @@ void __IOPointerDictionary::removePointerForKey(IOObject *key)
 	if(bucket)
 	{
 		bucket->key->release();
-
-		bucket->object = 0;
-		bucket->key = 0;
-
-		_count --;
-		shrinkIfNeeded();
+		removeBucket(bucket);
 	}
 }
 
@@ -23,10 +23,15 @@
 #include "IOObject.h"
 #include "IOIterator.h"
 
+// Dictionaries up to this many entries keep them inline and are searched linearly,
+// bigger ones switch to a chained hash table
+#define kIODictionarySmallCapacity 8
+
 struct IODictionaryBucket
 {
 	IOObject *key;
 	IOObject *object;
+	hash_t hash; // Cached hash of the key
 
 	struct IODictionaryBucket *next;
 };
@@ -58,14 +63,18 @@ public:
 protected:
 	virtual void free();
 
+	IODictionaryBucket *findBucket(IOObject *key, hash_t hash);
 	IODictionaryBucket *findBucket1(IOObject *key);
 	IODictionaryBucket *findBucket2(IOObject *key);
+	void removeBucket(IODictionaryBucket *bucket);
 
 	void rehash(size_t capacity);
+	void compact();
 	void expandIfNeeded();
 	void shrinkIfNeeded();
 
-	IODictionaryBucket **_buckets;
+	IODictionaryBucket _small[kIODictionarySmallCapacity];
+	IODictionaryBucket **_buckets; // NULL as long as the entries are kept in _small
 
 	size_t _capacity;
 	size_t _count;
@@ -23,6 +23,7 @@
 #include "IOThread.h"
 #include "IOAutoreleasePool.h"
 #include "IONumber.h"
+#include "IOBenchmark.h"
 
 extern "C" void sd_yield();
 
@@ -69,6 +70,9 @@ extern "C"
 {
 	bool libio_init()
 	{
+		if(sys_checkCommandline("--iobench", 0))
+			IORunBenchmarks();
+
 		IOThread *worker = IOThread::alloc()->initWithFunction(libio_worker);
 		if(worker)
 		{
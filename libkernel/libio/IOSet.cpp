@@ -42,6 +42,18 @@ static uint32_t __IOSetMaxCount[42] =
 }; 
 
 
+static size_t __IOSetCapacityForCount(size_t count)
+{
+	for(size_t i=0; i<41; i++)
+	{
+		if(__IOSetMaxCount[i] > count)
+			return __IOSetCapacity[i];
+	}
+
+	return __IOSetCapacity[41];
+}
+
+
 // Constructor
 
 class IOSetIterator : public IOIterator
@@ -61,18 +73,31 @@ public:
 
 	virtual IOObject *nextObject()
 	{
-		while(!_bucket)
+		if(!_set->_buckets)
 		{
-			if(_index >= _set->_capacity)
+			if(_index >= _set->_count)
 				return 0;
 
-			_bucket = _set->_buckets[_index ++];
+			return _set->_small[_index ++].object;
 		}
 
-		IOObject *object = _bucket->object;
-		_bucket = _bucket->next;
+		while(1)
+		{
+			while(!_bucket)
+			{
+				if(_index >= _set->_capacity)
+					return 0;
+
+				_bucket = _set->_buckets[_index ++];
+			}
+
+			IOObject *object = _bucket->object;
+			_bucket = _bucket->next;
 
-		return object;
+			// Skip removed objects
+			if(object)
+				return object;
+		}
 	}
 
 private:
@@ -90,15 +115,9 @@ IOSet *IOSet::init()
 {
 	if(super::init())
 	{
-		_capacity = __IOSetCapacity[0];
+		_buckets  = 0;
+		_capacity = 0;
 		_count = 0;
-
-		_buckets = (IOSetBucket **)kalloc(_capacity * sizeof(IOSetBucket **));
-		if(_buckets == 0)
-		{
-			release();
-			return 0;
-		}
 	}
 
 	return this;
@@ -108,6 +127,13 @@ IOSet *IOSet::initWithCapacity(size_t capacity)
 {
 	if(super::init())
 	{
+		_buckets  = 0;
+		_capacity = 0;
+		_count = 0;
+
+		if(capacity <= kIOSetSmallCapacity)
+			return this;
+
 		for(int i=1; i<42; i++)
 		{
 			if(__IOSetCapacity[i] > capacity || i == 41)
@@ -117,7 +143,6 @@ IOSet *IOSet::initWithCapacity(size_t capacity)
 			}
 		}
 
-		_count = 0;
 		_buckets = (IOSetBucket **)kalloc(_capacity * sizeof(IOSetBucket **));
 		if(_buckets == 0)
 		{
@@ -131,28 +156,7 @@ IOSet *IOSet::initWithCapacity(size_t capacity)
 
 void IOSet::free()
 {
-	if(_buckets)
-	{
-		for(size_t i=0; i<_capacity; i++)
-		{
-			IOSetBucket *bucket = _buckets[i];
-			while(bucket)
-			{
-				IOSetBucket *next = bucket->next;
-
-				if(bucket->object)
-				{
-					bucket->object->release();
-				}
-
-				delete bucket;
-				bucket = next;
-			}
-		}
-
-		kfree(_buckets);
-	}
-
+	removeAllObjects();
 	super::free();
 }
 
@@ -204,16 +208,29 @@ IOSet *IOSet::withObjects(IOObject *first, ...)
 }
 
 // Lookup
+// The cached hashes are compared first, so isEqual() is only called for likely matches
 
-IOSetBucket *IOSet::findBucket1(IOObject *object)
+IOSetBucket *IOSet::findBucket(IOObject *object, hash_t hash)
 {
-	hash_t hash = object->hash();
+	if(!_buckets)
+	{
+		for(size_t i=0; i<_count; i++)
+		{
+			IOSetBucket *bucket = &_small[i];
+
+			if(bucket->hash == hash && (bucket->object == object || bucket->object->isEqual(object)))
+				return bucket;
+		}
+
+		return 0;
+	}
+
 	size_t index = hash % _capacity;
 
 	IOSetBucket *bucket = _buckets[index];
 	while(bucket)
 	{
-		if(bucket->object && bucket->object->isEqual(object))
+		if(bucket->object && bucket->hash == hash && (bucket->object == object || bucket->object->isEqual(object)))
 			return bucket;
 
 		bucket = bucket->next;
@@ -222,25 +239,46 @@ IOSetBucket *IOSet::findBucket1(IOObject *object)
 	return 0;
 }
 
+IOSetBucket *IOSet::findBucket1(IOObject *object)
+{
+	return findBucket(object, object->hash());
+}
+
 IOSetBucket *IOSet::findBucket2(IOObject *object)
 {
 	hash_t hash = object->hash();
-	size_t index = hash % _capacity;
 
-	IOSetBucket *bucket = _buckets[index];
-	while(bucket)
+	IOSetBucket *bucket = findBucket(object, hash);
+	if(bucket)
+		return bucket;
+
+	if(!_buckets)
 	{
-		if(bucket->object && bucket->object->isEqual(object))
+		if(_count < kIOSetSmallCapacity)
+		{
+			bucket = &_small[_count];
+			bucket->object = 0;
+			bucket->hash   = hash;
+			bucket->next   = 0;
+
 			return bucket;
+		}
 
-		bucket = bucket->next;
+		// The inline storage is full, switch to a hash table
+		rehash(__IOSetCapacityForCount(_count + 1));
+
+		if(!_buckets)
+			return 0;
 	}
 
+	size_t index = hash % _capacity;
+
 	bucket = new IOSetBucket;
 	if(!bucket)
 		return 0;
 
-	bucket->object = object;
+	bucket->object = 0;
+	bucket->hash   = hash;
 	bucket->next   = _buckets[index];
 
 	_buckets[index] = bucket;
@@ -248,54 +286,124 @@ IOSetBucket *IOSet::findBucket2(IOObject *object)
 	return bucket;
 }
 
+void IOSet::removeBucket(IOSetBucket *bucket)
+{
+	_count --;
+
+	if(!_buckets)
+	{
+		// Keep the inline objects packed
+		*bucket = _small[_count];
+		return;
+	}
+
+	bucket->object = 0;
+	shrinkIfNeeded();
+}
+
 // Resizing
 
 void IOSet::rehash(size_t capacity)
 {
-	IOSetBucket **buckets = _buckets;
-	size_t cCapacity = _capacity;
-
-	_capacity = capacity;
-	_buckets  = (IOSetBucket **)kalloc(_capacity * sizeof(IOSetBucket **));
+	IOSetBucket **buckets = (IOSetBucket **)kalloc(capacity * sizeof(IOSetBucket **));
+	if(!buckets)
+		return;
 
 	if(!_buckets)
 	{
-		_capacity = cCapacity;
-		_buckets = buckets;
+		// Move the inline objects into the table, but allocate all buckets up front so that
+		// a failure leaves the set untouched
+		IOSetBucket *moved[kIOSetSmallCapacity];
 
-		return;
+		for(size_t i=0; i<_count; i++)
+		{
+			moved[i] = new IOSetBucket;
+			if(!moved[i])
+			{
+				while(i > 0)
+					delete moved[-- i];
+
+				kfree(buckets);
+				return;
+			}
+		}
+
+		for(size_t i=0; i<_count; i++)
+		{
+			IOSetBucket *bucket = moved[i];
+			size_t index = _small[i].hash % capacity;
+
+			*bucket = _small[i];
+			bucket->next = buckets[index];
+			buckets[index] = bucket;
+		}
 	}
+	else
+	{
+		// Re-add the old buckets
+		for(size_t i=0; i<_capacity; i++)
+		{
+			IOSetBucket *bucket = _buckets[i];
+			while(bucket)
+			{
+				IOSetBucket *next = bucket->next;
 
-	// Re-add the old buckets
-	for(size_t i=0; i<cCapacity; i++)
+				if(bucket->object)
+				{
+					size_t index = bucket->hash % capacity;
+
+					bucket->next = buckets[index];
+					buckets[index] = bucket;
+				}
+				else
+				{
+					delete bucket;
+				}
+
+				bucket = next;
+			}
+		}
+
+		kfree(_buckets);
+	}
+
+	_buckets  = buckets;
+	_capacity = capacity;
+}
+
+void IOSet::compact()
+{
+	size_t count = 0;
+
+	for(size_t i=0; i<_capacity; i++)
 	{
-		IOSetBucket *bucket = buckets[i];
+		IOSetBucket *bucket = _buckets[i];
 		while(bucket)
 		{
 			IOSetBucket *next = bucket->next;
 
 			if(bucket->object)
 			{
-				hash_t hash = bucket->object->hash();
-				size_t index = hash % _capacity;
-
-				bucket->next = _buckets[index];
-				_buckets[index] = bucket;
-			}
-			else
-			{
-				delete bucket;
+				_small[count] = *bucket;
+				_small[count ++].next = 0;
 			}
 
+			delete bucket;
 			bucket = next;
 		}
 	}
 
-	kfree(buckets);
+	kfree(_buckets);
+
+	_buckets  = 0;
+	_capacity = 0;
 }
 
 void IOSet::expandIfNeeded()
 {
+	if(!_buckets)
+		return;
+
 	for(size_t i=0; i<41; i++)
 	{
 		if(__IOSetCapacity[i] == _capacity)
@@ -313,6 +421,14 @@ void IOSet::expandIfNeeded()
 
 void IOSet::shrinkIfNeeded()
 {
+	// Only go back to the inline storage when there is room to grow again,
+	// otherwise a set at the boundary would convert back and forth
+	if(_count <= kIOSetSmallCapacity / 2)
+	{
+		compact();
+		return;
+	}
+
 	for(size_t i=1; i<41; i++)
 	{
 		if(__IOSetCapacity[i] == _capacity)
@@ -322,6 +438,8 @@ void IOSet::shrinkIfNeeded()
 				size_t capacity = __IOSetCapacity[i - 1];
 				rehash(capacity);
 			}
+
+			break;
 		}
 	}
 }
@@ -331,10 +449,7 @@ void IOSet::shrinkIfNeeded()
 void IOSet::addObject(IOObject *object)
 {
 	if(!object)
-	{
-		removeObject(object);
 		return;
-	}
 
 	IOSetBucket *bucket = findBucket2(object);
 	if(bucket)
@@ -361,10 +476,7 @@ void IOSet::removeObject(IOObject *object)
 	if(bucket)
 	{
 		bucket->object->release();
-		bucket->object = 0;
-
-		_count --;
-		shrinkIfNeeded();
+		removeBucket(bucket);
 	}
 }
 
@@ -376,27 +488,35 @@ bool IOSet::containsObject(IOObject *object)
 
 void IOSet::removeAllObjects()
 {
-	for(size_t i=0; i<_capacity; i++)
+	if(!_buckets)
 	{
-		IOSetBucket *bucket = _buckets[i];
-		while(bucket)
+		for(size_t i=0; i<_count; i++)
+			_small[i].object->release();
+	}
+	else
+	{
+		for(size_t i=0; i<_capacity; i++)
 		{
-			IOSetBucket *next = bucket->next;
-
-			if(bucket->object)
+			IOSetBucket *bucket = _buckets[i];
+			while(bucket)
 			{
-				bucket->object->release();
-			}
+				IOSetBucket *next = bucket->next;
 
-			delete bucket;
-			bucket = next;
+				if(bucket->object)
+				{
+					bucket->object->release();
+				}
+
+				delete bucket;
+				bucket = next;
+			}
 		}
-	}
 
-	kfree(_buckets);
+		kfree(_buckets);
+	}
 
-	_capacity = __IOSetCapacity[0];
-	_buckets = (IOSetBucket **)kalloc(_capacity * sizeof(IOSetBucket **));
+	_buckets  = 0;
+	_capacity = 0;
 	_count = 0;
 }
 
@@ -413,5 +533,5 @@ size_t IOSet::count()
 
 size_t IOSet::capacity()
 {
-	return _capacity;
+	return (_buckets != 0) ? _capacity : kIOSetSmallCapacity;
 }
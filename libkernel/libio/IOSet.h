@@ -23,9 +23,14 @@
 #include "IOObject.h"
 #include "IOIterator.h"
 
+// Sets up to this many objects keep them inline and are searched linearly,
+// bigger ones switch to a chained hash table
+#define kIOSetSmallCapacity 8
+
 struct IOSetBucket
 {
 	IOObject *object;
+	hash_t hash; // Cached hash of the object
 
 	struct IOSetBucket *next;
 };
@@ -57,14 +62,18 @@ public:
 private:
 	virtual void free();
 
+	IOSetBucket *findBucket(IOObject *key, hash_t hash);
 	IOSetBucket *findBucket1(IOObject *key);
 	IOSetBucket *findBucket2(IOObject *key);
+	void removeBucket(IOSetBucket *bucket);
 
 	void rehash(size_t capacity);
+	void compact();
 	void expandIfNeeded();
 	void shrinkIfNeeded();
 
-	IOSetBucket **_buckets;
+	IOSetBucket _small[kIOSetSmallCapacity];
+	IOSetBucket **_buckets; // NULL as long as the objects are kept in _small
 
 	size_t _capacity;
 	size_t _count;
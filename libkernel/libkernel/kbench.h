@@ -0,0 +1,34 @@
+//
+//  kbench.h
+//  libkernel
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _LIBKERNEL_KBENCH_H_
+#define _LIBKERNEL_KBENCH_H_
+
+#include "base.h"
+#include "stdint.h"
+
+// The kernels kbench harness, see sys/kbench/kbench.h. Suites report through the kernel log
+// in the same format as the kernel benchmarks
+typedef struct kbench_suite_s kbench_suite_t;
+typedef void (*kbench_function_t)(void *argument, uint32_t iterations);
+
+kern_extern kbench_suite_t *kbench_suiteCreate(char *name);
+kern_extern void kbench_suiteAdd(kbench_suite_t *suite, char *name, kbench_function_t function, void *argument, uint32_t batch);
+kern_extern void kbench_suiteRun(kbench_suite_t *suite);
+
+#endif /* _LIBKERNEL_KBENCH_H_ */
@@ -38,6 +38,7 @@
 #include "thread.h"
 #include "spinlock.h"
 #include "interrupts.h"
+#include "kbench.h"
 
 kern_extern bool sys_checkCommandline(const char *option, char *buffer);
 
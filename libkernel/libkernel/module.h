@@ -47,5 +47,6 @@ kern_extern kern_module_t *io_moduleWithName(const char *name);
 
 kern_extern void io_moduleRetain(kern_module_t *module);
 kern_extern void io_moduleRelease(kern_module_t *module);
+kern_extern void io_moduleReport(); // Logs the load and unload latencies of all modules
 
 #endif /* _LIBKERNEL_MODULE_H_ */
@@ -24,6 +24,7 @@
 
 kern_extern void *memset(void *dst, int c, size_t size);
 kern_extern void *memcpy(void *dst, const void *src, size_t size);
+kern_extern void *memmove(void *dst, const void *src, size_t size);
 
 kern_extern char *strcpy(char *dst, const char *src);
 kern_extern size_t strlcpy(char *dst, const char *src, size_t size);
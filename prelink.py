@@ -0,0 +1,168 @@
+#!/usr/bin/python
+
+# Prelinks the kernel modules for fixed load addresses.
+# Every module in libkernel/ gets its own base inside the kernels prelink window and all of its
+# R_386_RELATIVE relocations are applied for that base. The base is stored in the e_ident padding,
+# see sys/ioglue/iolibrary.h. If the kernel can map the module at its base, it skips the relative
+# relocations, otherwise it adjusts them by the difference. Running the script twice is harmless.
+
+import os
+import struct
+import sys
+
+PRELINK_LOWER_LIMIT = 0x30000000
+PRELINK_UPPER_LIMIT = 0x3f000000
+
+PRELINK_IDENT_OFFSET = 9
+PRELINK_BASE_OFFSET  = 12
+PRELINK_VERSION      = 1
+
+PAGE_SIZE = 4096
+
+PT_LOAD    = 1
+PT_DYNAMIC = 2
+
+DT_NULL   = 0
+DT_REL    = 17
+DT_RELSZ  = 18
+DT_RELENT = 19
+
+R_386_RELATIVE = 8
+
+def pageAlign(value):
+	return (value + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)
+
+def readSegments(data):
+	(phoff,) = struct.unpack_from('<I', data, 28)
+	(phentsize, phnum) = struct.unpack_from('<HH', data, 42)
+
+	segments = []
+	for i in range(phnum):
+		segments.append(struct.unpack_from('<IIIIIIII', data, phoff + i * phentsize))
+
+	return segments
+
+def fileOffset(segments, address):
+	for (ptype, offset, vaddr, paddr, filesz, memsz, flags, align) in segments:
+		if ptype == PT_LOAD and address >= vaddr and address < vaddr + filesz:
+			return offset + (address - vaddr)
+
+	return None
+
+def isELF32DynamicLibrary(data):
+	if len(data) < 52 or data[0:4] != b'\x7fELF':
+		return False
+
+	(eclass, encoding) = struct.unpack_from('<BB', data, 4)
+	(etype,) = struct.unpack_from('<H', data, 16)
+
+	return eclass == 1 and encoding == 1 and etype == 3
+
+def currentBase(data):
+	ident = data[PRELINK_IDENT_OFFSET:PRELINK_IDENT_OFFSET + 3]
+	if ident != struct.pack('<ccB', b'P', b'L', PRELINK_VERSION):
+		return 0
+
+	(base,) = struct.unpack_from('<I', data, PRELINK_BASE_OFFSET)
+	return base
+
+def imageSize(segments):
+	loads = [segment for segment in segments if segment[0] == PT_LOAD]
+	if len(loads) == 0 or min(segment[2] for segment in loads) != 0:
+		return None
+
+	return pageAlign(max(segment[2] + segment[5] for segment in loads))
+
+def prelink(filepath, base):
+	f = open(filepath, 'rb')
+	data = bytearray(f.read())
+	f.close()
+
+	segments = readSegments(data)
+	dynamic = [segment for segment in segments if segment[0] == PT_DYNAMIC]
+
+	if len(dynamic) == 0:
+		return False
+
+	# Find the relocations
+	rel = relsz = 0
+	relent = 8
+	offset = dynamic[0][1]
+
+	while True:
+		(tag, value) = struct.unpack_from('<iI', data, offset)
+		offset += 8
+
+		if tag == DT_NULL:
+			break
+		elif tag == DT_REL:
+			rel = value
+		elif tag == DT_RELSZ:
+			relsz = value
+		elif tag == DT_RELENT:
+			relent = value
+
+	delta = (base - currentBase(data)) & 0xffffffff
+	reloffset = fileOffset(segments, rel) if rel else None
+
+	if relsz > 0 and reloffset is None:
+		return False
+
+	for i in range(relsz // relent):
+		(address, info) = struct.unpack_from('<II', data, reloffset + i * relent)
+		if (info & 0xff) != R_386_RELATIVE:
+			continue
+
+		target = fileOffset(segments, address)
+		if target is None:
+			return False
+
+		(value,) = struct.unpack_from('<I', data, target)
+		struct.pack_into('<I', data, target, (value + delta) & 0xffffffff)
+
+	struct.pack_into('<ccB', data, PRELINK_IDENT_OFFSET, b'P', b'L', PRELINK_VERSION)
+	struct.pack_into('<I', data, PRELINK_BASE_OFFSET, base)
+
+	f = open(filepath, 'wb')
+	f.write(data)
+	f.close()
+
+	return True
+
+def scanFolder(path, libraries):
+	for filename in sorted(os.listdir(path)):
+		filepath = os.path.join(path, filename)
+
+		if os.path.isdir(filepath) == True:
+			scanFolder(filepath, libraries)
+		elif filename.endswith('.so'):
+			libraries.append(filepath)
+
+
+directory = os.path.dirname(os.path.realpath(__file__))
+libraries = sys.argv[1:]
+
+if len(libraries) == 0:
+	scanFolder(os.path.join(directory, 'libkernel'), libraries)
+
+base = PRELINK_LOWER_LIMIT
+
+for filepath in libraries:
+	f = open(filepath, 'rb')
+	data = f.read()
+	f.close()
+
+	if not isELF32DynamicLibrary(data):
+		print('prelink: skipping %s, not an i386 shared library' % filepath)
+		continue
+
+	size = imageSize(readSegments(data))
+	if size is None or base + size > PRELINK_UPPER_LIMIT:
+		print('prelink: skipping %s' % filepath)
+		continue
+
+	if prelink(filepath, base):
+		print('prelink: %s at 0x%08x' % (os.path.basename(filepath), base))
+		base += size + PAGE_SIZE # Leave a guard page between the libraries
+	else:
+		print('prelink: skipping %s, unsupported relocations' % filepath)
@@ -0,0 +1,122 @@
+//
+//  bench_container.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <container/array.h>
+#include <container/atree.h>
+#include <container/hashset.h>
+#include "benchmarks.h"
+
+#define kBenchContainerEntries 1024
+
+void _bench_hashsetLookup(void *argument, uint32_t iterations)
+{
+	hashset_t *set = argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		hashset_objectForKey(set, (const void *)(i % kBenchContainerEntries));
+}
+
+void _bench_hashsetInsert(void *argument, uint32_t iterations)
+{
+	hashset_t *set = argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		const void *key = (const void *)(kBenchContainerEntries + i);
+
+		hashset_setObjectForKey(set, (void *)0x1, key);
+		hashset_removeObjectForKey(set, key);
+	}
+}
+
+int _bench_atreeComparator(void *key1, void *key2)
+{
+	uintptr_t tkey1 = (uintptr_t)key1;
+	uintptr_t tkey2 = (uintptr_t)key2;
+
+	return (int)(tkey1 - tkey2);
+}
+
+void _bench_atreeLookup(void *argument, uint32_t iterations)
+{
+	atree_t *tree = argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		atree_find(tree, (void *)((i % kBenchContainerEntries) + 1));
+}
+
+void _bench_atreeInsert(void *argument, uint32_t iterations)
+{
+	atree_t *tree = argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		void *key = (void *)(kBenchContainerEntries + i + 1);
+
+		atree_insert(tree, key, key);
+		atree_remove(tree, key);
+	}
+}
+
+void _bench_arrayAppend(void *argument, uint32_t iterations)
+{
+	array_t *array = argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		array_addObject(array, (void *)(i + 1));
+
+	array_removeAllObjects(array);
+}
+
+void _bench_arrayIndexOf(void *argument, uint32_t iterations)
+{
+	array_t *array = argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		array_indexOfObject(array, (void *)((i % kBenchContainerEntries) + 1));
+}
+
+void bench_container()
+{
+	kbench_suite_t *suite = kbench_suiteCreate("container");
+
+	hashset_t *set = hashset_create(0, hash_integer, hash_integerCompare);
+	atree_t *tree  = atree_create(_bench_atreeComparator);
+	array_t *array = array_create();
+	array_t *scratch = array_create();
+
+	for(uintptr_t i=0; i<kBenchContainerEntries; i++)
+	{
+		hashset_setObjectForKey(set, (void *)(i + 1), (const void *)i);
+		atree_insert(tree, (void *)(i + 1), (void *)(i + 1));
+		array_addObject(array, (void *)(i + 1));
+	}
+
+	kbench_suiteAdd(suite, "hashset_lookup", _bench_hashsetLookup, set, 1024);
+	kbench_suiteAdd(suite, "hashset_insert", _bench_hashsetInsert, set, 256);
+	kbench_suiteAdd(suite, "atree_lookup", _bench_atreeLookup, tree, 1024);
+	kbench_suiteAdd(suite, "atree_insert", _bench_atreeInsert, tree, 256);
+	kbench_suiteAdd(suite, "array_append", _bench_arrayAppend, scratch, 256);
+	kbench_suiteAdd(suite, "array_indexOf", _bench_arrayIndexOf, array, 64);
+
+	kbench_suiteRun(suite);
+
+	hashset_destroy(set);
+	atree_destroy(tree);
+	array_destroy(array);
+	array_destroy(scratch);
+}
@@ -0,0 +1,59 @@
+//
+//  bench_loader.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <loader/loader.h>
+#include <memory/memory.h>
+#include <system/syslog.h>
+#include <vfs/vfs.h>
+#include "benchmarks.h"
+
+#define kBenchLoaderPath "/bin/linkd.bin"
+
+// Maps and unmaps the executable the way process_createWithFile() does, the image cache is warm after the first run
+void _bench_loaderExecutable(__unused void *argument, uint32_t iterations)
+{
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		vm_page_directory_t pdirectory = vm_createDirectory();
+		ld_exectuable_t *executable = ld_executableCreateWithFile(pdirectory, kBenchLoaderPath);
+
+		if(executable)
+			ld_executableRelease(executable);
+
+		vm_deleteDirectory(pdirectory);
+	}
+}
+
+void bench_loader()
+{
+	int errno = 0;
+	int fd = vfs_open(kBenchLoaderPath, O_RDONLY, &errno);
+
+	if(fd == -1)
+	{
+		warn("kbench: couldn't open %s, errno %i\n", kBenchLoaderPath, errno);
+		return;
+	}
+
+	vfs_close(fd);
+
+	kbench_suite_t *suite = kbench_suiteCreate("loader");
+
+	kbench_suiteAdd(suite, "executable/linkd.bin", _bench_loaderExecutable, NULL, 4);
+
+	kbench_suiteRun(suite);
+}
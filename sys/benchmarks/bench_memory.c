@@ -0,0 +1,77 @@
+//
+//  bench_memory.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <memory/memory.h>
+#include "benchmarks.h"
+
+void _bench_halloc(void *argument, uint32_t iterations)
+{
+	size_t size = (size_t)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		void *pointer = halloc(NULL, size);
+		hfree(NULL, pointer);
+	}
+}
+
+void _bench_pmalloc(__unused void *argument, uint32_t iterations)
+{
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		uintptr_t page = pm_alloc(1);
+		pm_free(page, 1);
+	}
+}
+
+void _bench_pmallocZeroed(__unused void *argument, uint32_t iterations)
+{
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		uintptr_t page = pm_allocZeroed(1);
+		pm_free(page, 1);
+	}
+}
+
+void _bench_vmalloc(void *argument, uint32_t iterations)
+{
+	uintptr_t page = (uintptr_t)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		vm_address_t address = vm_alloc(vm_getKernelDirectory(), page, 1, VM_FLAGS_KERNEL);
+		vm_free(vm_getKernelDirectory(), address, 1);
+	}
+}
+
+void bench_memory()
+{
+	kbench_suite_t *suite = kbench_suiteCreate("memory");
+	uintptr_t page = pm_alloc(1);
+
+	kbench_suiteAdd(suite, "halloc/16", _bench_halloc, (void *)16, 256);
+	kbench_suiteAdd(suite, "halloc/64", _bench_halloc, (void *)64, 256);
+	kbench_suiteAdd(suite, "halloc/256", _bench_halloc, (void *)256, 256);
+	kbench_suiteAdd(suite, "halloc/1024", _bench_halloc, (void *)1024, 256);
+	kbench_suiteAdd(suite, "halloc/4096", _bench_halloc, (void *)4096, 64);
+	kbench_suiteAdd(suite, "pm_alloc", _bench_pmalloc, NULL, 256);
+	kbench_suiteAdd(suite, "pm_allocZeroed", _bench_pmallocZeroed, NULL, 256);
+	kbench_suiteAdd(suite, "vm_alloc", _bench_vmalloc, (void *)page, 256);
+
+	kbench_suiteRun(suite);
+	pm_free(page, 1);
+}
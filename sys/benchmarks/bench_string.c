@@ -0,0 +1,99 @@
+//
+//  bench_string.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <memory/memory.h>
+#include <libc/string.h>
+#include "benchmarks.h"
+
+#define kBenchStringMaxSize (64 * 1024)
+
+static uint8_t *_bench_source;
+static uint8_t *_bench_target;
+
+void _bench_memcpy(void *argument, uint32_t iterations)
+{
+	size_t size = (size_t)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		memcpy(_bench_target, _bench_source, size);
+}
+
+void _bench_memcpyUnaligned(void *argument, uint32_t iterations)
+{
+	size_t size = (size_t)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		memcpy(_bench_target + 1, _bench_source + 3, size);
+}
+
+void _bench_memmove(void *argument, uint32_t iterations)
+{
+	size_t size = (size_t)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		memmove(_bench_source + 4, _bench_source, size); // Overlapping, copies backwards
+}
+
+void _bench_memset(void *argument, uint32_t iterations)
+{
+	size_t size = (size_t)argument;
+
+	for(uint32_t i=0; i<iterations; i++)
+		memset(_bench_target, (int)i, size);
+}
+
+void _bench_strlen(void *argument, uint32_t iterations)
+{
+	size_t size = (size_t)argument;
+
+	memset(_bench_target, 'a', size - 1);
+	_bench_target[size - 1] = '\0';
+
+	for(uint32_t i=0; i<iterations; i++)
+		strlen((const char *)_bench_target);
+}
+
+void bench_string()
+{
+	kbench_suite_t *suite = kbench_suiteCreate("string");
+
+	_bench_source = halloc(NULL, kBenchStringMaxSize + 16);
+	_bench_target = halloc(NULL, kBenchStringMaxSize + 16);
+
+	kbench_suiteAdd(suite, "memcpy/8", _bench_memcpy, (void *)8, 1024);
+	kbench_suiteAdd(suite, "memcpy/64", _bench_memcpy, (void *)64, 1024);
+	kbench_suiteAdd(suite, "memcpy/512", _bench_memcpy, (void *)512, 256);
+	kbench_suiteAdd(suite, "memcpy/4096", _bench_memcpy, (void *)4096, 64);
+	kbench_suiteAdd(suite, "memcpy/65536", _bench_memcpy, (void *)65536, 4);
+	kbench_suiteAdd(suite, "memcpy_unaligned/64", _bench_memcpyUnaligned, (void *)64, 1024);
+	kbench_suiteAdd(suite, "memcpy_unaligned/4096", _bench_memcpyUnaligned, (void *)4096, 64);
+	kbench_suiteAdd(suite, "memmove/64", _bench_memmove, (void *)64, 1024);
+	kbench_suiteAdd(suite, "memmove/4096", _bench_memmove, (void *)4096, 64);
+	kbench_suiteAdd(suite, "memset/8", _bench_memset, (void *)8, 1024);
+	kbench_suiteAdd(suite, "memset/64", _bench_memset, (void *)64, 1024);
+	kbench_suiteAdd(suite, "memset/512", _bench_memset, (void *)512, 256);
+	kbench_suiteAdd(suite, "memset/4096", _bench_memset, (void *)4096, 64);
+	kbench_suiteAdd(suite, "memset/65536", _bench_memset, (void *)65536, 4);
+	kbench_suiteAdd(suite, "strlen/8", _bench_strlen, (void *)8, 1024);
+	kbench_suiteAdd(suite, "strlen/64", _bench_strlen, (void *)64, 1024);
+	kbench_suiteAdd(suite, "strlen/4096", _bench_strlen, (void *)4096, 64);
+
+	kbench_suiteRun(suite);
+
+	hfree(NULL, _bench_source);
+	hfree(NULL, _bench_target);
+}
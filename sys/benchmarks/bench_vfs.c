@@ -0,0 +1,76 @@
+//
+//  bench_vfs.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <vfs/vfs.h>
+#include <libc/string.h>
+#include <system/syslog.h>
+#include "benchmarks.h"
+
+#define kBenchVFSPath "/kbench.bin"
+
+void _bench_vfsOpen(__unused void *argument, uint32_t iterations)
+{
+	int errno;
+
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		int fd = vfs_open(kBenchVFSPath, O_RDONLY, &errno);
+		vfs_close(fd);
+	}
+}
+
+void _bench_vfsRead(void *argument, uint32_t iterations)
+{
+	int fd = (int)argument;
+	int errno;
+
+	uint8_t buffer[512];
+
+	for(uint32_t i=0; i<iterations; i++)
+	{
+		vfs_seek(fd, 0, SEEK_SET, &errno);
+		vfs_read(fd, buffer, sizeof(buffer), &errno);
+	}
+}
+
+void bench_vfs()
+{
+	int errno = 0;
+	int fd = vfs_open(kBenchVFSPath, O_RDWR | O_CREAT, &errno);
+
+	if(fd == -1)
+	{
+		warn("kbench: couldn't create %s, errno %i\n", kBenchVFSPath, errno);
+		return;
+	}
+
+	uint8_t buffer[512];
+	memset(buffer, 0xAB, sizeof(buffer));
+
+	for(int i=0; i<8; i++)
+		vfs_write(fd, buffer, sizeof(buffer), &errno);
+
+	kbench_suite_t *suite = kbench_suiteCreate("vfs");
+
+	kbench_suiteAdd(suite, "vfs_open", _bench_vfsOpen, NULL, 64);
+	kbench_suiteAdd(suite, "vfs_read/512", _bench_vfsRead, (void *)fd, 64);
+
+	kbench_suiteRun(suite);
+
+	vfs_close(fd);
+	vfs_remove(kBenchVFSPath, &errno);
+}
@@ -30,6 +30,9 @@
 		#define CONF_KUNITEXITATEND 1
 	#endif
 
+	// Benchmarking
+	#define CONF_RUNKBENCH 0
+
 	// Inlining
 	#define CONF_NOINLINE 0
 	#if CONF_NOINLINE
@@ -17,6 +17,7 @@
 //
 
 #include <memory/memory.h>
+#include <libc/math.h>
 #include <libc/string.h>
 #include "array.h"
 
@@ -188,6 +189,19 @@ size_t array_count(array_t *array)
 }
 
 
+size_t array_copyObjects(array_t *array, void **buffer, size_t index, size_t count)
+{
+	if(index >= array->count)
+		return 0;
+
+	size_t left = array->count - index;
+	count = MIN(count, left);
+
+	memcpy(buffer, array->data + index, count * sizeof(void *));
+	return count;
+}
+
+
 size_t array_iteratorNextObject(iterator_t *iterator, size_t maxObjects)
 {
 	array_t *array = iterator->data;
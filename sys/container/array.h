@@ -56,6 +56,13 @@ size_t array_count(array_t *array);
 
 iterator_t *array_iterator(array_t *array);
 
+// Copies up to count objects starting at index into buffer, returns the number of copied objects
+size_t array_copyObjects(array_t *array, void **buffer, size_t index, size_t count);
+
+// Iterates over all objects in order, index is declared by the macro. The array must not be mutated while iterating
+#define array_foreach(array, index, object) \
+	for(size_t index = 0; index < (array)->count && (((object) = (array)->data[index]), true); index ++)
+
 void array_sort(array_t *array, comparator_t comparator);
 
 static inline void *array_objectAtIndex(array_t *array, uint32_t index) 
@@ -100,7 +100,7 @@ void atree_destroy(atree_t *tree)
 	hfree(NULL, tree);
 }
 
-uint32_t atree_count(atree_t *tree)
+size_t atree_count(atree_t *tree)
 {
 	return tree->nodes;
 }
@@ -122,6 +122,31 @@ void *atree_find(atree_t *tree, void *key)
 	return NULL;
 }
 
+void *atree_findFloor(atree_t *tree, void *key)
+{
+	atree_node_t *node  = tree->root;
+	atree_node_t *floor = NULL;
+
+	while(node != tree->nil)
+	{
+		int result = tree->comparison(node->key, key);
+		if(result == 0)
+			return node->data;
+
+		if(result < 0)
+		{
+			floor = node;
+			node  = node->link[1];
+		}
+		else
+		{
+			node = node->link[0];
+		}
+	}
+
+	return floor ? floor->data : NULL;
+}
+
 static inline atree_node_t *atree_createNode(atree_t *tree, void *data, void *key)
 {
 	atree_node_t *node = halloc(NULL, sizeof(atree_node_t));
@@ -281,130 +306,124 @@ void atree_remove(atree_t *tree, void *key)
 }
 
 
-typedef struct
+// Cursor
+
+void atree_cursorInit(atree_cursor_t *cursor, atree_t *tree, bool backwards)
 {
-	atree_t *tree;
-	atree_node_t *node;
-	atree_node_t *path[kAtreeMaxHeight];
+	cursor->tree = tree;
+	cursor->node = tree->root;
+	cursor->top  = 0;
+	cursor->direction = backwards ? 0 : 1;
 
-	size_t top;
-	int direction;
-	bool first;
-} atree_iterator_t;
+	if(cursor->node != tree->nil)
+	{
+		while(cursor->node->link[!cursor->direction] != tree->nil)
+		{
+			cursor->path[cursor->top ++] = cursor->node;
+			cursor->node = cursor->node->link[!cursor->direction];
+		}
+	}
+}
 
-size_t atree_iteratorNextObject(iterator_t *iterator, size_t maxObjects)
+void atree_cursorAdvance(atree_cursor_t *cursor)
 {
-	size_t gathered = 0;
-	while(gathered < maxObjects)
+	atree_node_t *nil = cursor->tree->nil;
+	int direction = cursor->direction;
+
+	if(cursor->node->link[direction] != nil)
 	{
-		atree_iterator_t *aiterator = iterator->data;
-		atree_node_t *nil = aiterator->tree->nil;
+		// The successor is the outermost node of the subtree in iteration direction
+		cursor->path[cursor->top ++] = cursor->node;
+		cursor->node = cursor->node->link[direction];
 
-		if(aiterator->first && aiterator->node != nil)
+		while(cursor->node->link[!direction] != nil)
 		{
-			iterator->objects[gathered ++] = aiterator->node->data;
-			aiterator->first = false;
+			cursor->path[cursor->top ++] = cursor->node;
+			cursor->node = cursor->node->link[!direction];
 		}
 
-		if(aiterator->node->link[aiterator->direction] != nil)
-		{
-			aiterator->path[aiterator->top ++] = aiterator->node;
-			aiterator->node = aiterator->node->link[aiterator->direction];
+		return;
+	}
 
-			while(aiterator->node->link[!aiterator->direction] != nil)
-			{
-				aiterator->path[aiterator->top ++] = aiterator->node;
-				aiterator->node = aiterator->node->link[!aiterator->direction];
-			}
-		}
-		else
+	// Otherwise walk up until we leave a subtree that was entered against the iteration direction
+	atree_node_t *child;
+	do {
+		if(cursor->top == 0)
 		{
-			atree_node_t *node;
-			do {
-				if(aiterator->top == 0)
-				{
-					if(aiterator->node == aiterator->tree->root)
-						iterator->objects[gathered ++] = aiterator->node->data;
-					
-					aiterator->node = nil;
-					break;
-				}
-
-				node = aiterator->node;
-				aiterator->node = aiterator->path[-- aiterator->top];
-			} while(node == aiterator->node->link[aiterator->direction]);
+			cursor->node = nil;
+			return;
 		}
 
-		if(aiterator->node == nil)
+		child = cursor->node;
+		cursor->node = cursor->path[-- cursor->top];
+	} while(child == cursor->node->link[direction]);
+}
+
+size_t atree_copyObjects(atree_t *tree, void **buffer, size_t count)
+{
+	atree_cursor_t cursor;
+	size_t copied = 0;
+	void *object;
+
+	atree_foreach(tree, cursor, object)
+	{
+		if(copied >= count)
 			break;
 
-		iterator->objects[gathered ++] = aiterator->node->data;
+		buffer[copied ++] = object;
 	}
 
-	return gathered;
+	return copied;
 }
 
+// Iterator
+
+size_t atree_iteratorNextObject(iterator_t *iterator, size_t maxObjects)
+{
+	atree_cursor_t *cursor = iterator->data;
+	size_t gathered = 0;
+
+	while(gathered < maxObjects && cursor->node != cursor->tree->nil)
+	{
+		iterator->objects[gathered ++] = cursor->node->data;
+		atree_cursorAdvance(cursor);
+	}
 
+	return gathered;
+}
 
 void atree_iteratorDestroy(iterator_t *iterator)
 {
 	hfree(NULL, iterator->data);
 }
 
-iterator_t *atree_iterator(atree_t *tree)
+static iterator_t *atree_createIterator(atree_t *tree, bool backwards)
 {
-	atree_iterator_t *aiterator = halloc(NULL, sizeof(atree_iterator_t));
-	if(aiterator)
+	atree_cursor_t *cursor = halloc(NULL, sizeof(atree_cursor_t));
+	if(cursor)
 	{
-		aiterator->tree = tree;
-		aiterator->node = tree->root;
-		aiterator->top  = 0;
-		aiterator->first = true;
-		aiterator->direction = 1;
+		atree_cursorInit(cursor, tree, backwards);
 
-		if(aiterator->node != tree->nil)
+		iterator_t *iterator = iterator_create(atree_iteratorNextObject, cursor);
+		if(!iterator)
 		{
-			while(aiterator->node->link[0] != tree->nil)
-			{
-				aiterator->path[aiterator->top ++] = aiterator->node;
-				aiterator->node = aiterator->node->link[0];
-			}
+			hfree(NULL, cursor);
+			return NULL;
 		}
 
-		iterator_t *iterator = iterator_create(atree_iteratorNextObject, aiterator);
 		iterator->destroy = atree_iteratorDestroy;
-
 		return iterator;
 	}
 
 	return NULL;
 }
 
-iterator_t *atree_backwardsIterator(atree_t *tree)
+iterator_t *atree_iterator(atree_t *tree)
 {
-		atree_iterator_t *aiterator = halloc(NULL, sizeof(atree_iterator_t));
-	if(aiterator)
-	{
-		aiterator->tree = tree;
-		aiterator->node = tree->root;
-		aiterator->top  = 0;
-		aiterator->direction = 0;
-
-		if(aiterator->node != tree->nil)
-		{
-			while(aiterator->node->link[1] != tree->nil)
-			{
-				aiterator->path[aiterator->top ++] = aiterator->node;
-				aiterator->node = aiterator->node->link[1];
-			}
-		}
-
-		iterator_t *iterator = iterator_create(atree_iteratorNextObject, aiterator);
-		iterator->destroy = atree_iteratorDestroy;
-
-		return iterator;
-	}
-
-	return NULL;
+	return atree_createIterator(tree, false);
 }
 
+iterator_t *atree_backwardsIterator(atree_t *tree)
+{
+	return atree_createIterator(tree, true);
+}
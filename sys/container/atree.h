@@ -35,6 +35,13 @@ typedef struct atree_node_s
 
 typedef int (*atree_compare_t)(void *key1, void *key2);
 
+/**
+ * Overview:
+ * Besides the heap allocated iterator_t, trees can be walked with a cursor that lives on the stack.
+ * atree_foreach() visits all objects in key order without allocating anything or calling through function pointers,
+ * the tree must not be modified while a cursor is in use.
+ **/
+
 typedef struct
 {
 	atree_node_t *root;
@@ -48,12 +55,39 @@ atree_t *atree_create(atree_compare_t comparator);
 void atree_destroy(atree_t *tree);
 
 void *atree_find(atree_t *tree, void *key);
+// Returns the object with the greatest key lesser than or equal to key, or NULL.
+// For non overlapping ranges keyed by their start this is the range that might contain key
+void *atree_findFloor(atree_t *tree, void *key);
 
 void atree_insert(atree_t *tree, void *data, void *key);
 void atree_remove(atree_t *tree, void *key);
 
 size_t atree_count(atree_t *tree);
 
+typedef struct
+{
+	atree_t *tree;
+	atree_node_t *node; // The current node, tree->nil once the cursor ran past the end
+	atree_node_t *path[kAtreeMaxHeight];
+
+	size_t top;
+	int direction; // 1 for ascending, 0 for descending order
+} atree_cursor_t;
+
+void atree_cursorInit(atree_cursor_t *cursor, atree_t *tree, bool backwards);
+void atree_cursorAdvance(atree_cursor_t *cursor);
+
+#define atree_cursorIsValid(cursor) ((cursor)->node != (cursor)->tree->nil)
+
+#define atree_foreach(tree, cursor, object) \
+	for(atree_cursorInit(&(cursor), (tree), false); atree_cursorIsValid(&(cursor)) && (((object) = (cursor).node->data), true); atree_cursorAdvance(&(cursor)))
+
+#define atree_foreachBackwards(tree, cursor, object) \
+	for(atree_cursorInit(&(cursor), (tree), true); atree_cursorIsValid(&(cursor)) && (((object) = (cursor).node->data), true); atree_cursorAdvance(&(cursor)))
+
+// Copies up to count objects in ascending key order into buffer, returns the number of copied objects
+size_t atree_copyObjects(atree_t *tree, void **buffer, size_t count);
+
 iterator_t *atree_iterator(atree_t *tree);
 iterator_t *atree_backwardsIterator(atree_t *tree);
 
@@ -21,217 +21,248 @@
 #include <system/syslog.h>
 #include "hashset.h"
 
-static size_t hashet_capacity[42] = 
+#define kHashsetMinCapacity 8
+#define kHashsetMigrateStep 8 // Old buckets moved per mutation while resizing
+
+// Fibonacci hashing, spreads weak hashes like aligned pointers over the high bits used for indexing
+#define hashset_scramble(hash) ((hash) * 0x9E3779B1)
+
+static inline size_t hashset_distance(hashset_bucket_t *bucket, size_t index, uint32_t shift, size_t mask)
 {
-	5, 11, 23, 41, 67, 113, 199, 317, 521, 839, 1361, 2207, 3571, 5779, 9349, 15121,
-	24473, 39607, 64081, 103681, 167759, 271429, 439199, 710641, 1149857, 1860503, 3010349,
-	4870843, 7881193, 12752029, 20633237, 33385273, 54018521, 87403763, 141422317, 228826121,
-	370248451, 599074561, 969323023, 1568397599, 2537720629, 4106118251
-};
+	return (index - (bucket->hash >> shift)) & mask;
+}
 
-static size_t hashset_maxCount[42] = 
+static hashset_bucket_t *hashset_tableFind(hashset_t *set, hashset_bucket_t *buckets, size_t capacity, uint32_t shift, const void *key, uint32_t hash)
 {
-	4, 8, 17, 29, 47, 76, 123, 199, 322, 521, 843, 1364, 2207, 3571, 5778, 9349,
-	15127, 24476, 39603, 64079, 103682, 167761, 271443, 439204, 710647, 1149851, 1860498,
-	3010349, 4870847, 7881196, 12752043, 20633239, 33385282, 54018521, 87403803, 141422324,
-	228826127, 370248451, 599074578, 969323029, 1568397607, 2537720636
-}; 
+	size_t mask  = capacity - 1;
+	size_t index = hash >> shift;
 
+	for(size_t distance=0;; distance++)
+	{
+		hashset_bucket_t *bucket = &buckets[index];
 
-hashset_t *hashset_create(size_t capacity, hashset_hashfunc_t hashFunction, hashset_comparefunc_t compareFunction)
+		// Robin Hood ordering guarantees that the key can't be further away than a poorer entry
+		if(!bucket->data || hashset_distance(bucket, index, shift, mask) < distance)
+			return NULL;
+
+		if(bucket->hash == hash && set->compareFunction(bucket->key, key))
+			return bucket;
+
+		index = (index + 1) & mask;
+	}
+}
+
+static void hashset_tableInsert(hashset_bucket_t *buckets, size_t capacity, uint32_t shift, hashset_bucket_t entry)
 {
-	hashset_t *set = halloc(NULL, sizeof(hashset_t));
-	if(set)
+	size_t mask  = capacity - 1;
+	size_t index = entry.hash >> shift;
+	size_t distance = 0;
+
+	while(1)
 	{
-		// Find the right capacity for the object
-		for(int i=1; i<42; i++)
+		hashset_bucket_t *bucket = &buckets[index];
+		if(!bucket->data)
 		{
-			if(hashet_capacity[i] > capacity || i == 41)
-			{
-				capacity = hashet_capacity[i - 1];
-				break;
-			}
+			*bucket = entry;
+			return;
 		}
 
-		// Initialize the set
-		set->buckets = halloc(NULL, capacity * sizeof(hashset_bucket_t **));
-		if(!set->buckets)
+		// Take the bucket from entries closer to their home and carry them on instead
+		size_t bdistance = hashset_distance(bucket, index, shift, mask);
+		if(bdistance < distance)
 		{
-			hfree(NULL, set);
-			return NULL;
-		}
+			hashset_bucket_t temp = *bucket;
+			*bucket = entry;
+			entry = temp;
 
-		memset(set->buckets, 0, capacity * sizeof(hashset_bucket_t **));
-
-		set->capacity = capacity;
-		set->count = 0;
-
-		set->hashFunction = hashFunction;
-		set->compareFunction = compareFunction ? compareFunction : hash_pointerCompare;
+			distance = bdistance;
+		}
 
-		set->lock = SPINLOCK_INIT;
+		index = (index + 1) & mask;
+		distance ++;
 	}
-
-	return set;
 }
 
-void hashset_destroy(hashset_t *set)
+static void hashset_tableErase(hashset_bucket_t *buckets, size_t capacity, uint32_t shift, hashset_bucket_t *bucket)
 {
-	for(size_t i=0; i<set->capacity; i++)
+	size_t mask  = capacity - 1;
+	size_t index = bucket - buckets;
+
+	// Shift the following entries back by one, this keeps the table free of tombstones
+	while(1)
 	{
-		hashset_bucket_t *bucket = set->buckets[i];
-		while(bucket)
-		{
-			hashset_bucket_t *next = bucket->overflow;
-			hfree(NULL, bucket);
+		size_t next = (index + 1) & mask;
+		hashset_bucket_t *nbucket = &buckets[next];
 
-			bucket = next;
-		}
+		if(!nbucket->data || hashset_distance(nbucket, next, shift, mask) == 0)
+			break;
+
+		buckets[index] = *nbucket;
+		index = next;
 	}
 
-	hfree(NULL, set->buckets);
-	hfree(NULL, set);
+	buckets[index].key  = NULL;
+	buckets[index].data = NULL;
 }
 
 
-array_t *hashset_allObjects(hashset_t *set)
+static void hashset_migrate(hashset_t *set, size_t steps)
 {
-	array_t *array = array_create();
+	hashset_bucket_t *buckets = set->oldBuckets;
+	size_t mask = set->oldCapacity - 1;
 
-	for(size_t i=0; i<set->capacity; i++)
+	while(set->migrateLeft > 0)
 	{
-		hashset_bucket_t *bucket = set->buckets[i];
-		while(bucket)
+		hashset_bucket_t *bucket = &buckets[set->migrateIndex];
+
+		if(steps == 0)
+		{
+			// Only pause at the start of a cluster, lookups in the old table would otherwise
+			// stop at the freed buckets before reaching the entries displaced behind them
+			if(!bucket->data || hashset_distance(bucket, set->migrateIndex, set->oldShift, mask) == 0)
+				return;
+		}
+		else
+		{
+			steps --;
+		}
+
+		if(bucket->data)
 		{
-			if(bucket->data)
-				array_addObject(array, bucket->data);
+			hashset_tableInsert(set->buckets, set->capacity, set->shift, *bucket);
 
-			bucket = bucket->overflow;
+			bucket->key  = NULL;
+			bucket->data = NULL;
+
+			set->oldCount --;
 		}
+
+		set->migrateIndex = (set->migrateIndex + 1) & mask;
+		set->migrateLeft --;
 	}
 
-	return array;
+	hfree(NULL, set->oldBuckets);
+
+	set->oldBuckets  = NULL;
+	set->oldCapacity = 0;
+	set->oldCount    = 0;
 }
 
-hashset_bucket_t *hashset_findBucket1(hashset_t *set, const void *key)
+static void hashset_resize(hashset_t *set, size_t capacity)
 {
-	uint32_t hash = set->hashFunction(key);
-	size_t index = hash % set->capacity;
+	// Only one resize can be in flight
+	if(set->oldBuckets)
+		hashset_migrate(set, set->oldCapacity);
 
-	hashset_bucket_t *bucket = set->buckets[index];
-	while(bucket)
-	{
-		if(set->compareFunction(bucket->key, key))
-			return bucket;
+	hashset_bucket_t *buckets = halloc(NULL, capacity * sizeof(hashset_bucket_t));
+	if(!buckets)
+		return;
 
-		bucket = bucket->overflow;
-	}
+	memset(buckets, 0, capacity * sizeof(hashset_bucket_t));
+
+	set->oldBuckets  = set->buckets;
+	set->oldCapacity = set->capacity;
+	set->oldShift    = set->shift;
+	set->oldCount    = set->count;
+
+	set->buckets  = buckets;
+	set->capacity = capacity;
+	set->shift    = 32 - __builtin_ctz(capacity);
 
-	return NULL;
+	// Start the migration at an empty bucket so that no cluster is split at the wrap around.
+	// The load factor guarantees that there is one
+	size_t index = 0;
+	while(set->oldBuckets[index].data)
+		index ++;
+
+	set->migrateIndex = index;
+	set->migrateLeft  = set->oldCapacity;
 }
 
-hashset_bucket_t *hashset_findBucket2(hashset_t *set, const void *key)
-{
-	uint32_t hash = set->hashFunction(key);
-	size_t index = hash % set->capacity;
 
-	hashset_bucket_t *bucket = set->buckets[index];
-	while(bucket)
+hashset_t *hashset_create(size_t capacity, hashset_hashfunc_t hashFunction, hashset_comparefunc_t compareFunction)
+{
+	hashset_t *set = halloc(NULL, sizeof(hashset_t));
+	if(set)
 	{
-		if(set->compareFunction(bucket->key, key))
-			return bucket;
-		
-		bucket = bucket->overflow;
-	}
+		// Round up to a power of two that fits capacity entries below the maximum load
+		size_t minimum = capacity + (capacity / 3);
+		capacity = kHashsetMinCapacity;
+
+		while(capacity < minimum)
+			capacity <<= 1;
+
+		// Initialize the set
+		set->buckets = halloc(NULL, capacity * sizeof(hashset_bucket_t));
+		if(!set->buckets)
+		{
+			hfree(NULL, set);
+			return NULL;
+		}
+
+		memset(set->buckets, 0, capacity * sizeof(hashset_bucket_t));
+
+		set->capacity = capacity;
+		set->count = 0;
+		set->shift = 32 - __builtin_ctz(capacity);
 
-	bucket = halloc(NULL, sizeof(hashset_bucket_t));
-	if(!bucket)
-		return NULL;
+		set->oldBuckets  = NULL;
+		set->oldCapacity = 0;
+		set->oldCount    = 0;
 
-	bucket->key = key;
-	bucket->data = NULL;
-	bucket->overflow = set->buckets[index];
+		set->hashFunction = hashFunction;
+		set->compareFunction = compareFunction ? compareFunction : hash_pointerCompare;
 
-	set->buckets[index] = bucket;
+		set->lock = SPINLOCK_INIT;
+	}
 
-	return bucket;
+	return set;
 }
 
-void hashset_rehash(hashset_t *set, size_t capacity)
+void hashset_destroy(hashset_t *set)
 {
-	hashset_bucket_t **buckets = set->buckets;
-	size_t cCapacity = set->capacity;
+	if(set->oldBuckets)
+		hfree(NULL, set->oldBuckets);
 
-	set->capacity = capacity;
-	set->buckets = halloc(NULL, capacity * sizeof(hashset_bucket_t **));
+	hfree(NULL, set->buckets);
+	hfree(NULL, set);
+}
 
-	if(!set->buckets)
-	{
-		set->capacity = cCapacity;
-		set->buckets = buckets;
 
-		return;
-	}
+array_t *hashset_allObjects(hashset_t *set)
+{
+	array_t *array = array_create();
+	hashset_cursor_t cursor;
+	void *object;
 
-	memset(set->buckets, 0, capacity * sizeof(hashset_bucket_t **));
+	hashset_foreach(set, cursor, object)
+		array_addObject(array, object);
 
-	for(size_t i=0; i<cCapacity; i++)
-	{
-		hashset_bucket_t *bucket = buckets[i];
-		while(bucket)
-		{
-			hashset_bucket_t *next = bucket->overflow;
-
-			if(bucket->key)
-			{
-				uint32_t hash = set->hashFunction(bucket->key);
-				size_t index = hash % capacity;
-
-				bucket->overflow = set->buckets[index];
-				set->buckets[index] = bucket;
-			}
-			else
-			{
-				hfree(NULL, bucket);
-			}
-
-			bucket = next;
-		}
-	}
-
-	hfree(NULL, buckets);
+	return array;
 }
 
-void hashset_expandIfNeeded(hashset_t *set)
+size_t hashset_copyObjects(hashset_t *set, void **buffer, size_t count)
 {
-	for(size_t i=0; i<41; i++)
-	{
-		if(set->capacity == hashet_capacity[i])
-		{
-			if(set->count >= hashset_maxCount[i])
-			{
-				size_t capacity = hashet_capacity[i + 1];
-				hashset_rehash(set, capacity);
-			}
+	hashset_cursor_t cursor;
+	size_t copied = 0;
 
-			break;
-		}
-	}
+	hashset_cursorInit(&cursor, set);
+	while(copied < count && hashset_cursorNext(&cursor))
+		buffer[copied ++] = cursor.bucket->data;
+
+	return copied;
 }
 
-void hashset_shrinkIfNeeded(hashset_t *set)
+size_t hashset_copyKeys(hashset_t *set, const void **buffer, size_t count)
 {
-	for(size_t i=1; i<41; i++)
-	{
-		if(set->capacity == hashet_capacity[i])
-		{
-			if(set->count <= hashset_maxCount[i - 1])
-			{
-				size_t capacity = hashet_capacity[i - 1];
-				hashset_rehash(set, capacity);
-			}
-		}
-	}
+	hashset_cursor_t cursor;
+	size_t copied = 0;
+
+	hashset_cursorInit(&cursor, set);
+	while(copied < count && hashset_cursorNext(&cursor))
+		buffer[copied ++] = cursor.bucket->key;
+
+	return copied;
 }
 
 
@@ -247,21 +278,45 @@ void hashset_unlock(hashset_t *set)
 
 void *hashset_objectForKey(hashset_t *set, const void *key)
 {
-	hashset_bucket_t *bucket = hashset_findBucket1(set, key);
+	uint32_t hash = hashset_scramble(set->hashFunction(key));
+
+	hashset_bucket_t *bucket = hashset_tableFind(set, set->buckets, set->capacity, set->shift, key, hash);
+	if(!bucket && set->oldBuckets)
+		bucket = hashset_tableFind(set, set->oldBuckets, set->oldCapacity, set->oldShift, key, hash);
+
 	return bucket ? bucket->data : NULL;
 }
 
 void hashset_removeObjectForKey(hashset_t *set, const void *key)
 {
-	hashset_bucket_t *bucket = hashset_findBucket1(set, key);
+	uint32_t hash = hashset_scramble(set->hashFunction(key));
+
+	if(set->oldBuckets)
+		hashset_migrate(set, kHashsetMigrateStep);
+
+	hashset_bucket_t *bucket = hashset_tableFind(set, set->buckets, set->capacity, set->shift, key, hash);
 	if(bucket)
 	{
-		bucket->key  = NULL;
-		bucket->data = NULL;
+		hashset_tableErase(set->buckets, set->capacity, set->shift, bucket);
+	}
+	else if(set->oldBuckets)
+	{
+		bucket = hashset_tableFind(set, set->oldBuckets, set->oldCapacity, set->oldShift, key, hash);
+		if(!bucket)
+			return;
 
-		set->count --;
-		hashset_shrinkIfNeeded(set);
+		hashset_tableErase(set->oldBuckets, set->oldCapacity, set->oldShift, bucket);
+		set->oldCount --;
+	}
+	else
+	{
+		return;
 	}
+
+	set->count --;
+
+	if(!set->oldBuckets && set->capacity > kHashsetMinCapacity && set->count < set->capacity / 8)
+		hashset_resize(set, set->capacity >> 1);
 }
 
 void hashset_setObjectForKey(hashset_t *set, void *data, const void *key)
@@ -272,75 +327,69 @@ void hashset_setObjectForKey(hashset_t *set, void *data, const void *key)
 		return;
 	}
 
-	hashset_bucket_t *bucket = hashset_findBucket2(set, key);
-	if(bucket->data == NULL)
-	{
-		bucket->data = data;
+	uint32_t hash = hashset_scramble(set->hashFunction(key));
 
-		set->count ++;
-		hashset_expandIfNeeded(set);
-	}
-}
+	if(set->oldBuckets)
+		hashset_migrate(set, kHashsetMigrateStep);
 
-uint32_t hashset_count(hashset_t *set)
-{
-	return set->count;
-}
-
-void *hashset_iteratorGetNextObject(hashset_t *set, uintptr_t *__bucket, uint32_t *__index, bool object)
-{
-	hashset_bucket_t *bucket = (hashset_bucket_t *)*__bucket;
-	uint32_t index = *__index;
+	hashset_bucket_t *bucket = hashset_tableFind(set, set->buckets, set->capacity, set->shift, key, hash);
+	if(!bucket && set->oldBuckets)
+		bucket = hashset_tableFind(set, set->oldBuckets, set->oldCapacity, set->oldShift, key, hash);
 
-	while(bucket)
+	if(bucket)
 	{
-		if(bucket->data)
-		{
-			*__bucket = (uintptr_t)bucket->overflow;
-			return (object) ? bucket->data : (void *)bucket->key;
-		}
+		bucket->key  = key;
+		bucket->data = data;
 
-		bucket = bucket->overflow;
+		return;
 	}
 
-	*__bucket = 0;
+	// Keep the load factor at or below 3/4
+	if((set->count + 1) > (set->capacity >> 1) + (set->capacity >> 2))
+		hashset_resize(set, set->capacity << 1);
 
-	while(index < set->capacity)
-	{
-		bucket = set->buckets[index];
-		while(bucket)
-		{
-			if(bucket->data)
-			{
-				*__bucket = (uintptr_t)bucket->overflow;
-				*__index = index + 1;
-
-				return (object) ? bucket->data : (void *)bucket->key;
-			}
+	// A failed resize leaves the table as it is, it can still take entries until only one bucket is left
+	if(set->count - set->oldCount + 1 >= set->capacity)
+		return;
 
-			bucket = bucket->overflow;
-		}
+	hashset_bucket_t entry;
+	entry.key  = key;
+	entry.data = data;
+	entry.hash = hash;
 
-		index ++;
-	}
+	hashset_tableInsert(set->buckets, set->capacity, set->shift, entry);
+	set->count ++;
+}
 
-	return NULL;
+uint32_t hashset_count(hashset_t *set)
+{
+	return set->count;
 }
 
 size_t hashset_iteratorNextObject(iterator_t *iterator, size_t maxObjects)
 {
-	hashset_t *hashset = iterator->data;
+	hashset_t *set = iterator->data;
+	bool keys = (iterator->custom[3] != 0);
 	uint32_t i = 0;
 
+	// custom[0] and custom[1] hold the table and index of the cursor between fetches
+	hashset_cursor_t cursor;
+	hashset_cursorInit(&cursor, set);
+
+	cursor.table = (uint32_t)iterator->custom[0];
+	cursor.index = (size_t)iterator->custom[1];
+
 	for(; i<maxObjects; i++)
 	{
-		void *object = hashset_iteratorGetNextObject(hashset, (uintptr_t *)&iterator->custom[0], (uint32_t *)&iterator->custom[1], iterator->custom[3] == 0);
-		if(!object)
+		if(!hashset_cursorNext(&cursor))
 			break;
 
-		iterator->objects[i] = object;
+		iterator->objects[i] = keys ? (void *)cursor.bucket->key : cursor.bucket->data;
 	}
 
+	iterator->custom[0] = (int32_t)cursor.table;
+	iterator->custom[1] = (int32_t)cursor.index;
+
 	return i;
 }
 
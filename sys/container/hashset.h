@@ -25,11 +25,21 @@
 #include "array.h"
 #include "iterator.h"
 
+/*
+ * Overview:
+ * The hashset is an open-addressing Robin Hood table with the buckets stored inline. The capacity is
+ * always a power of two and the hash of every key is stored next to it, so lookups compare hashes before
+ * calling the compare function and resizing never has to hash a key again.
+ * Growing or shrinking allocates the new table right away but moves the old entries over in small steps
+ * with every following mutation, lookups consult both tables until the old one has been drained.
+ * hashset_foreach() walks both tables with a cursor on the stack, no mutations are allowed while it runs.
+ */
+
 typedef struct hashset_bucket_s
 {
 	const void *key;
-	void *data;
-	struct hashset_bucket_s *overflow;
+	void *data; // NULL for empty buckets
+	uint32_t hash; // Scrambled hash of the key, the home bucket is hash >> shift
 } hashset_bucket_t;
 
 typedef uint32_t (*hashset_hashfunc_t)(const void *);
@@ -38,9 +48,19 @@ typedef bool (*hashset_comparefunc_t)(const void *, const void *);
 typedef struct
 {
 	size_t capacity;
-	size_t count;
+	size_t count; // Entries in both tables
+	uint32_t shift;
+
+	hashset_bucket_t *buckets;
+
+	// Table that is being migrated into buckets, NULL if no resize is in progress
+	hashset_bucket_t *oldBuckets;
+	size_t oldCapacity;
+	size_t oldCount;
+	uint32_t oldShift;
 
-	hashset_bucket_t **buckets;
+	size_t migrateIndex; // Next bucket of the old table to move
+	size_t migrateLeft; // Buckets of the old table that haven't been visited yet
 
 	hashset_hashfunc_t hashFunction;
 	hashset_comparefunc_t compareFunction;
@@ -62,6 +82,59 @@ void hashset_setObjectForKey(hashset_t *set, void *data, const void *key);
 
 uint32_t hashset_count(hashset_t *set);
 
+typedef struct
+{
+	hashset_t *set;
+	hashset_bucket_t *bucket; // The current entry, valid after hashset_cursorNext() returned true
+	size_t index;
+	uint32_t table; // 0 for the current table, 1 for the one being migrated
+} hashset_cursor_t;
+
+static inline void hashset_cursorInit(hashset_cursor_t *cursor, hashset_t *set)
+{
+	cursor->set    = set;
+	cursor->bucket = NULL;
+	cursor->index  = 0;
+	cursor->table  = 0;
+}
+
+static inline bool hashset_cursorNext(hashset_cursor_t *cursor)
+{
+	hashset_t *set = cursor->set;
+
+	while(1)
+	{
+		hashset_bucket_t *buckets = (cursor->table == 0) ? set->buckets : set->oldBuckets;
+		size_t capacity = (cursor->table == 0) ? set->capacity : set->oldCapacity;
+
+		while(cursor->index < capacity)
+		{
+			hashset_bucket_t *bucket = &buckets[cursor->index ++];
+			if(bucket->data)
+			{
+				cursor->bucket = bucket;
+				return true;
+			}
+		}
+
+		if(cursor->table == 1)
+			return false;
+
+		cursor->table = 1;
+		cursor->index = 0;
+	}
+}
+
+#define hashset_foreach(set, cursor, object) \
+	for(hashset_cursorInit(&(cursor), (set)); hashset_cursorNext(&(cursor)) && (((object) = (cursor).bucket->data), true);)
+
+#define hashset_foreachKey(set, cursor, key) \
+	for(hashset_cursorInit(&(cursor), (set)); hashset_cursorNext(&(cursor)) && (((key) = (void *)(cursor).bucket->key), true);)
+
+// Copy up to count objects or keys into buffer, in no particular order. Return the number of copied entries
+size_t hashset_copyObjects(hashset_t *set, void **buffer, size_t count);
+size_t hashset_copyKeys(hashset_t *set, const void **buffer, size_t count);
+
 iterator_t *hashset_iterator(hashset_t *set);
 iterator_t *hashset_keyIterator(hashset_t *set);
 
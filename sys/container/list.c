@@ -179,7 +179,7 @@ void list_removeSoft(list_t *list, void *entry)
 	if(list->first == entry)
 		list->first = next;
 
-	if(list->last)
+	if(list->last == entry)
 		list->last = prev;
 
 	list->count --;
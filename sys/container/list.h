@@ -61,4 +61,10 @@ size_t list_count(list_t *list);
 void *list_first(list_t *list);
 void *list_last(list_t *list);
 
+#define list_entryNext(list, entry) (*((void **)&((char *)(entry))[(list)->offsetNext]))
+
+// Walks the intrusive links directly, entry must not be removed from within the loop
+#define list_foreach(list, entry) \
+	for((entry) = (list)->first; (entry); (entry) = list_entryNext(list, entry))
+
 #endif /* _LIST_H_ */
@@ -18,12 +18,19 @@
 
 #include <memory/memory.h>
 #include <libc/math.h>
+#include <libc/string.h>
 #include "ringbuffer.h"
 
-ringbuffer_t *ringbuffer_create(size_t size)
+#define __ringbuffer_barrier() __asm__ volatile("" ::: "memory")
+
+ringbuffer_t *ringbuffer_create(size_t size, uint32_t flags)
 {
+	size_t capacity = 16;
+	while(capacity < size)
+		capacity <<= 1;
+
 	ringbuffer_t *ringbuffer = halloc(NULL, sizeof(ringbuffer_t));
-	uint8_t *buffer = (uint8_t *)halloc(NULL, size);
+	uint8_t *buffer = (uint8_t *)halloc(NULL, capacity);
 
 	if(!buffer || !ringbuffer)
 	{
@@ -36,11 +43,14 @@ ringbuffer_t *ringbuffer_create(size_t size)
 		return NULL;
 	}
 
-	ringbuffer->buffer      = ringbuffer->begin = ringbuffer->end = buffer;
-	ringbuffer->bufferLimit = ringbuffer->buffer + size;
+	ringbuffer->buffer = buffer;
+	ringbuffer->size   = capacity;
+	ringbuffer->mask   = capacity - 1;
+	ringbuffer->flags  = flags;
 
-	ringbuffer->size  = size;
-	ringbuffer->count = 0;
+	ringbuffer->head   = 0;
+	ringbuffer->commit = 0;
+	ringbuffer->tail   = 0;
 
 	return ringbuffer;
 }
@@ -52,40 +62,161 @@ void ringbuffer_destroy(ringbuffer_t *ringbuffer)
 }
 
 
-static inline uint8_t *ringbuffer_cycle(uint8_t *val, uint8_t *lower, uint8_t *upper)
+
+static inline void ringbuffer_makeRange(ringbuffer_t *ringbuffer, size_t start, size_t size, ringbuffer_range_t *range)
 {
-	return val <= lower ? upper : (val >= upper ? lower : val);
+	size_t offset = start & ringbuffer->mask;
+	size_t first  = ringbuffer->size - offset;
+
+	if(first > size)
+		first = size;
+
+	range->data[0]   = ringbuffer->buffer + offset;
+	range->length[0] = first;
+	range->data[1]   = ringbuffer->buffer;
+	range->length[1] = size - first;
+
+	range->start = start;
+	range->size  = size;
 }
 
-void ringbuffer_write(ringbuffer_t *ringbuffer, uint8_t *data, size_t size)
+void ringbuffer_rangeCopyIn(ringbuffer_range_t *range, size_t offset, const void *data, size_t size)
 {
-	for(size_t i=0; i<size; i++)
+	const uint8_t *source = data;
+
+	if(offset < range->length[0])
 	{
-		*(ringbuffer->end ++) = data[i];
+		size_t length = MIN(size, range->length[0] - offset);
+		memcpy(range->data[0] + offset, source, length);
+
+		source += length;
+		size   -= length;
+		offset  = 0;
+	}
+	else
+	{
+		offset -= range->length[0];
+	}
+
+	if(size > 0)
+		memcpy(range->data[1] + offset, source, size);
+}
+
+void ringbuffer_rangeCopyOut(ringbuffer_range_t *range, size_t offset, void *buffer, size_t size)
+{
+	uint8_t *target = buffer;
 
-		ringbuffer->end   = ringbuffer_cycle(ringbuffer->end, ringbuffer->buffer, ringbuffer->bufferLimit);
-		ringbuffer->count = MIN(ringbuffer->count + 1, ringbuffer->size);
+	if(offset < range->length[0])
+	{
+		size_t length = MIN(size, range->length[0] - offset);
+		memcpy(target, range->data[0] + offset, length);
 
-		if(ringbuffer->count == ringbuffer->size)
-			ringbuffer->begin = ringbuffer->end; 
+		target += length;
+		size   -= length;
+		offset  = 0;
+	}
+	else
+	{
+		offset -= range->length[0];
 	}
+
+	if(size > 0)
+		memcpy(target, range->data[1] + offset, size);
 }
 
-size_t ringbuffer_read(ringbuffer_t *ringbuffer, uint8_t *buffer, size_t size)
+
+
+bool ringbuffer_reserve(ringbuffer_t *ringbuffer, size_t size, ringbuffer_range_t *range)
 {
-	size_t read = 0;
-	while(ringbuffer->count > 0 && read < size)
+	if(size == 0 || size > ringbuffer->size)
+		return false;
+
+	size_t head;
+
+	if(ringbuffer->flags & kRingbufferFlagMultiProducer)
 	{
-		buffer[read ++] = *(ringbuffer->begin ++);
+		do {
+			head = ringbuffer->head;
+
+			if(head - ringbuffer->tail + size > ringbuffer->size)
+				return false;
+
+		} while(!__sync_bool_compare_and_swap(&ringbuffer->head, head, head + size));
+	}
+	else
+	{
+		head = ringbuffer->head;
+
+		if(head - ringbuffer->tail + size > ringbuffer->size)
+			return false;
 
-		ringbuffer->begin = ringbuffer_cycle(ringbuffer->begin, ringbuffer->buffer, ringbuffer->bufferLimit);
-		ringbuffer->count --;
+		ringbuffer->head = head + size;
 	}
 
+	ringbuffer_makeRange(ringbuffer, head, size, range);
+	return true;
+}
+
+void ringbuffer_commit(ringbuffer_t *ringbuffer, ringbuffer_range_t *range)
+{
+	// Reservations become visible in the order they were made, so wait for the ones in front of us
+	while(ringbuffer->commit != range->start)
+		__asm__ volatile("pause");
+
+	__ringbuffer_barrier(); // The data has to be in place before the consumer sees the new commit index
+	ringbuffer->commit = range->start + range->size;
+}
+
+size_t ringbuffer_peek(ringbuffer_t *ringbuffer, ringbuffer_range_t *range)
+{
+	size_t tail = ringbuffer->tail;
+	size_t size = ringbuffer->commit - tail;
+
+	__ringbuffer_barrier(); // Don't touch the data before having seen the commit that published it
+
+	ringbuffer_makeRange(ringbuffer, tail, size, range);
+	return size;
+}
+
+void ringbuffer_consume(ringbuffer_t *ringbuffer, size_t size)
+{
+	__ringbuffer_barrier(); // Finish reading before handing the space back to the producers
+	ringbuffer->tail = ringbuffer->tail + size;
+}
+
+
+
+size_t ringbuffer_write(ringbuffer_t *ringbuffer, const void *data, size_t size)
+{
+	ringbuffer_range_t range;
+
+	if(!ringbuffer_reserve(ringbuffer, size, &range))
+		return 0;
+
+	ringbuffer_rangeCopyIn(&range, 0, data, size);
+	ringbuffer_commit(ringbuffer, &range);
+
+	return size;
+}
+
+size_t ringbuffer_read(ringbuffer_t *ringbuffer, void *buffer, size_t size)
+{
+	ringbuffer_range_t range;
+	size_t available = ringbuffer_peek(ringbuffer, &range);
+	size_t read = MIN(available, size);
+
+	ringbuffer_rangeCopyOut(&range, 0, buffer, read);
+	ringbuffer_consume(ringbuffer, read);
+
 	return read;
 }
 
 size_t ringbuffer_length(ringbuffer_t *ringbuffer)
 {
-	return ringbuffer->count;
+	return ringbuffer->commit - ringbuffer->tail;
+}
+
+size_t ringbuffer_space(ringbuffer_t *ringbuffer)
+{
+	return ringbuffer->size - (ringbuffer->head - ringbuffer->tail);
 }
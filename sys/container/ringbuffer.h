@@ -21,24 +21,61 @@
 
 #include <prefix.h>
 
+/*
+ * Overview:
+ * The ringbuffer is a power of two sized byte ring with free running head, commit and tail indices.
+ * Producers first reserve space by advancing head, fill it in place and then publish it by advancing commit,
+ * the consumer only ever looks at the bytes between tail and commit. Data is never overwritten, a write that
+ * doesn't fit fails as a whole and the caller decides what to do with it.
+ * A single producer ring needs no atomic operations at all, a multi producer ring reserves with a CAS and
+ * publishes its reservations in order. A producer must not be preempted by another producer of the same ring
+ * between reserve and commit (ie. interrupt handlers), the later commit would spin forever otherwise.
+ * There is only ever one consumer.
+ */
+
+#define kRingbufferFlagMultiProducer (1 << 0)
+
 typedef struct
 {
 	uint8_t *buffer;
-	uint8_t *bufferLimit;
-
-	uint8_t *begin;
-	uint8_t *end;
 
 	size_t size;
-	size_t count;
+	size_t mask;
+	uint32_t flags;
+
+	volatile size_t head; // Next byte to reserve
+	volatile size_t commit; // Bytes before this are visible to the consumer
+	volatile size_t tail; // Next byte to read
 } ringbuffer_t;
 
-ringbuffer_t *ringbuffer_create(size_t size);
+// A reserved or peeked range, split into at most two segments if it wraps around
+typedef struct
+{
+	uint8_t *data[2];
+	size_t length[2];
+
+	size_t start;
+	size_t size;
+} ringbuffer_range_t;
+
+ringbuffer_t *ringbuffer_create(size_t size, uint32_t flags);
 void ringbuffer_destroy(ringbuffer_t *ringbuffer);
 
-void ringbuffer_write(ringbuffer_t *ringbuffer, uint8_t *data, size_t size);
-size_t ringbuffer_read(ringbuffer_t *ringbuffer, uint8_t *buffer, size_t size);
+// Copying interface
+size_t ringbuffer_write(ringbuffer_t *ringbuffer, const void *data, size_t size);
+size_t ringbuffer_read(ringbuffer_t *ringbuffer, void *buffer, size_t size);
+
+// Zero copy interface
+bool ringbuffer_reserve(ringbuffer_t *ringbuffer, size_t size, ringbuffer_range_t *range);
+void ringbuffer_commit(ringbuffer_t *ringbuffer, ringbuffer_range_t *range);
+
+size_t ringbuffer_peek(ringbuffer_t *ringbuffer, ringbuffer_range_t *range);
+void ringbuffer_consume(ringbuffer_t *ringbuffer, size_t size);
+
+void ringbuffer_rangeCopyIn(ringbuffer_range_t *range, size_t offset, const void *data, size_t size);
+void ringbuffer_rangeCopyOut(ringbuffer_range_t *range, size_t offset, void *buffer, size_t size);
 
 size_t ringbuffer_length(ringbuffer_t *ringbuffer);
+size_t ringbuffer_space(ringbuffer_t *ringbuffer);
 
 #endif /* _RINGBUFFER_H_ */
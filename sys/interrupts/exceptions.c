@@ -23,6 +23,7 @@
 #include <system/helper.h>
 #include <libc/stdio.h>
 #include <scheduler/scheduler.h>
+#include <loader/loader.h>
 #include "interrupts.h"
 
 const char *__ir_exception_pageFaultTranslateBit(int bit, uint32_t error);
@@ -58,6 +59,11 @@ uint32_t __ir_handleException(uint32_t esp)
 
 		__asm__ volatile("mov %%cr2, %0" : "=r" (address)); // Get the virtual address of the page
 
+		// Lazily backed pages of the executable are filled in on their first access
+		process_t *process = process_getCurrentProcess();
+		if(!(error & 0x1) && process->image && ld_executableHandleFault(process->image, address))
+			return esp;
+
 		const char *reason = __ir_exception_pageFaultTranslateBit(0, error);
 		const char *why = __ir_exception_pageFaultTranslateBit(1, error);
 		const char *ring = __ir_exception_pageFaultTranslateBit(2, error);
@@ -253,6 +253,14 @@ void ir_enableInterrupts(bool enableNMI)
 		outb(0x70, inb(0x70) & 0x7F);
 }
 
+bool ir_interruptsEnabled()
+{
+	uint32_t eflags;
+	__asm__ volatile("pushf; pop %0" : "=r" (eflags));
+
+	return (eflags & 0x200);
+}
+
 bool ir_init(void *unused)
 {
 	ir_setInterruptHandler(__ir_handleException, 0x00);
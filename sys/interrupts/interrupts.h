@@ -113,6 +113,7 @@ uint32_t ir_interruptPublicEnd();
 
 void ir_disableInterrupts(bool disableNMI);
 void ir_enableInterrupts(bool enableNMI);
+bool ir_interruptsEnabled();
 
 void ir_setInterruptHandler(ir_interrupt_handler_t handler, uint32_t interrupt);
 void ir_setInterruptCallback(ir_interrupt_callback_t callback, uint32_t interrupt);
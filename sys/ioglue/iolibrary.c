@@ -18,9 +18,14 @@
 
 #include <memory/memory.h>
 #include <libc/assert.h>
+#include <libc/math.h>
+#include <container/array.h>
 #include <system/helper.h>
 #include <system/syslog.h>
+#include <system/symbols.h>
+#include <system/panic.h>
 #include <libc/string.h>
+#include <libc/stdio.h>
 #include <vfs/vfs.h>
 
 #include "iolibrary.h"
@@ -28,25 +33,10 @@
 
 vm_address_t io_libraryResolveAddress(io_library_t *library, vm_address_t address)
 {
-	elf_sym_t *closest = NULL;
-	vm_address_t address_noReloc = address - library->relocBase;
-
-	for(uint32_t i=0; i<library->nbuckets; i++)
-	{
-		uint32_t symnum = library->buckets[i];
-		while(symnum != 0)
-		{
-			elf_sym_t *symbol = library->symtab + symnum;
-			if(symbol->st_value <= address_noReloc)
-			{
-				if(!closest || symbol->st_value > closest->st_value)
-					closest = symbol;
-			}
-
-			symnum = library->chains[symnum];
-		}
-	}
+	if(!library->symbolIndex)
+		return 0x0;
 
+	elf_sym_t *closest = symbols_findClosest(library->symbolIndex, address - library->relocBase);
 	if(!closest)
 		return 0x0;
 
@@ -56,26 +46,54 @@ vm_address_t io_libraryResolveAddress(io_library_t *library, vm_address_t addres
 
 elf_sym_t *io_librarySymbolWithAddress(io_library_t *library, vm_address_t address)
 {
-	vm_address_t address_noReloc = address - library->relocBase;
+	if(!library->symbolIndex)
+		return NULL;
 
-	for(uint32_t i=0; i<library->nbuckets; i++)
+	return symbols_findExact(library->symbolIndex, address - library->relocBase);
+}
+
+
+static elf_sym_t *__io_librarySymbolWithGNUHash(io_library_t *library, const char *name, uint32_t hash)
+{
+	// Reject most misses with the bloom filter before touching any bucket
+	uint32_t word = library->gnuBloom[(hash / 32) % library->gnuBloomSize];
+	uint32_t mask = (1u << (hash % 32)) | (1u << ((hash >> library->gnuBloomShift) % 32));
+
+	if((word & mask) != mask)
+		return NULL;
+
+	uint32_t symnum = library->gnuBuckets[hash % library->gnuNBuckets];
+	if(symnum < library->gnuSymOffset)
+		return NULL;
+
+	// The lowest bit of the chain entry marks the end of the chain, the rest is the symbols hash
+	while(1)
 	{
-		uint32_t symnum = library->buckets[i];
-		while(symnum != 0)
+		uint32_t chainHash = library->gnuChains[symnum - library->gnuSymOffset];
+		if((chainHash | 1) == (hash | 1))
 		{
 			elf_sym_t *symbol = library->symtab + symnum;
-			if(symbol->st_value == address_noReloc)
+			if(strcmp(library->strtab + symbol->st_name, name) == 0)
 				return symbol;
-
-			symnum = library->chains[symnum];
 		}
+
+		if(chainHash & 1)
+			break;
+
+		symnum ++;
 	}
 
 	return NULL;
 }
 
-elf_sym_t *io_librarySymbolWithName(io_library_t *library, const char *name, uint32_t hash)
+elf_sym_t *io_librarySymbolWithHashes(io_library_t *library, const char *name, uint32_t hash, uint32_t gnuHash)
 {
+	if(library->gnuBuckets)
+		return __io_librarySymbolWithGNUHash(library, name, gnuHash);
+
+	if(!library->buckets)
+		return NULL;
+
 	uint32_t symnum = library->buckets[hash % library->nbuckets];
 	while(symnum != 0)
 	{
@@ -91,6 +109,12 @@ elf_sym_t *io_librarySymbolWithName(io_library_t *library, const char *name, uin
 	return NULL;
 }
 
+elf_sym_t *io_librarySymbolWithName(io_library_t *library, const char *name, uint32_t hash)
+{
+	uint32_t gnuHash = library->gnuBuckets ? elf_gnuHash(name) : 0;
+	return io_librarySymbolWithHashes(library, name, hash, gnuHash);
+}
+
 
 void *io_libraryFindSymbol(io_library_t *library, const char *name)
 {
@@ -156,7 +180,9 @@ bool io_libraryRelocateNonPLT(io_library_t *library)
 				break;
 
 			case R_386_RELATIVE:
-				*address += container->relocBase;
+				// Prelinked libraries already contain the addresses for their prelink base
+				if(library->relocBase != library->prelinkBase)
+					*address += library->relocBase - library->prelinkBase;
 				break;
 
 			default:
@@ -168,36 +194,79 @@ bool io_libraryRelocateNonPLT(io_library_t *library)
 	return true;
 }
 
+static bool __io_libraryRelocatePLTEntry(io_library_t *library, elf_rel_t *rel, elf32_address_t *outTarget)
+{
+	elf32_address_t *address = (elf32_address_t *)(library->relocBase + rel->r_offset);
+	elf32_address_t target;
+
+	elf_sym_t *symbol;
+	io_library_t *container;
+
+	uint32_t symnum = ELF32_R_SYM(rel->r_info);
+	uint32_t type = ELF32_R_TYPE(rel->r_info);
+
+	assert(type == R_386_JMP_SLOT);
+
+	elf_sym_t *lookup = library->symtab + symnum;
+	const char *name  = library->strtab + lookup->st_name;
+
+	symbol = io_storeLookupSymbol(library, symnum, &container);
+	if(!symbol)
+	{
+		warn("Couldn't find symbol %s for %s!\n", name, library->name);
+		return false;
+	}
+
+	target = (elf32_address_t)(container->relocBase + symbol->st_value);
+	*address = target;
+
+	if(outTarget)
+		*outTarget = target;
+
+	return true;
+}
+
 bool io_libraryRelocatePLT(io_library_t *library)
 {
 	for(elf_rel_t *rel = library->pltRel; rel<library->pltRellimit; rel ++)
 	{
-		elf32_address_t *address = (elf32_address_t *)(library->relocBase + rel->r_offset);
-		elf32_address_t target;
+		if(!__io_libraryRelocatePLTEntry(library, rel, NULL))
+			return false;
+	}
 
-		elf_sym_t *symbol;
-		io_library_t *container;
+	return true;
+}
 
-		uint32_t symnum = ELF32_R_SYM(rel->r_info);
-		uint32_t type = ELF32_R_TYPE(rel->r_info);
 
-		assert(type == R_386_JMP_SLOT);
+// Lazy binding
+// The GOT entries initially point back into the PLT, which pushes the relocation offset and
+// enters io_libraryBindStart() through the first PLT entry. The slot is bound on its first call
 
-		elf_sym_t *lookup = library->symtab + symnum;
-		const char *name  = library->strtab + lookup->st_name;
+void io_libraryBindStart();
 
-		symbol = io_storeLookupSymbol(library, symnum, &container);
-		if(!symbol)
-		{
-			warn("Couldn't find symbol %s for %s!\n", name, library->name);
-			return false;
-		}
+elf32_address_t io_libraryBind(io_library_t *library, elf32_word_t offset)
+{
+	elf_rel_t *rel = (elf_rel_t *)((uint8_t *)library->pltRel + offset);
+	elf32_address_t target = 0;
+
+	if(!__io_libraryRelocatePLTEntry(library, rel, &target))
+		panic("iolink: Couldn't bind symbol for %s", library->name);
+
+	return target;
+}
+
+void io_libraryRelocatePLTLazy(io_library_t *library)
+{
+	for(elf_rel_t *rel = library->pltRel; rel<library->pltRellimit; rel ++)
+	{
+		assert(ELF32_R_TYPE(rel->r_info) == R_386_JMP_SLOT);
 
-		target = (elf32_address_t)(container->relocBase + symbol->st_value);
-		*address = target;
+		elf32_address_t *address = (elf32_address_t *)(library->relocBase + rel->r_offset);
+		*address += (elf32_address_t)library->relocBase;
 	}
 
-	return true;
+	library->pltgot[1] = (elf32_address_t)library;
+	library->pltgot[2] = (elf32_address_t)&io_libraryBindStart;
 }
 
 
@@ -284,6 +353,34 @@ void io_libraryDigestDynamic(io_library_t *library)
 				library->chains   = library->buckets + library->nbuckets;
 				break;
 
+			case DT_GNU_HASH:
+			{
+				uint32_t *table = (uint32_t *)(library->relocBase + dyn->d_un.d_ptr);
+
+				library->gnuNBuckets   = table[0];
+				library->gnuSymOffset  = table[1];
+				library->gnuBloomSize  = table[2];
+				library->gnuBloomShift = table[3];
+
+				library->gnuBloom   = table + 4;
+				library->gnuBuckets = library->gnuBloom + library->gnuBloomSize;
+				library->gnuChains  = library->gnuBuckets + library->gnuNBuckets;
+				break;
+			}
+
+			case DT_PLTGOT:
+				library->pltgot = (elf32_address_t *)(library->relocBase + dyn->d_un.d_ptr);
+				break;
+
+			case DT_BIND_NOW:
+				library->bindNow = true;
+				break;
+
+			case DT_FLAGS:
+				if(dyn->d_un.d_val & DF_BIND_NOW)
+					library->bindNow = true;
+				break;
+
 			case DT_PLTREL:
 				usePLTRel  = (dyn->d_un.d_val == DT_REL);
 				usePLTRela = (dyn->d_un.d_val == DT_RELA);
@@ -306,6 +403,31 @@ void io_libraryDigestDynamic(io_library_t *library)
 	library->rellimit  = (elf_rel_t *)((uint8_t *)library->rel + relSize);
 	library->relalimit = (elf_rela_t *)((uint8_t *)library->rela + relaSize);
 
+	// Symbol count
+	if(library->hashtab)
+	{
+		library->symbolCount = library->nchains;
+	}
+	else if(library->gnuBuckets)
+	{
+		// The GNU hash table doesn't store the count, the last chain ends with the last symbol
+		uint32_t last = 0;
+		for(uint32_t i=0; i<library->gnuNBuckets; i++)
+			last = MAX(last, library->gnuBuckets[i]);
+
+		if(last >= library->gnuSymOffset)
+		{
+			while(!(library->gnuChains[last - library->gnuSymOffset] & 1))
+				last ++;
+
+			library->symbolCount = last + 1;
+		}
+		else
+		{
+			library->symbolCount = library->gnuSymOffset;
+		}
+	}
+
 	if(usePLTRel)
 	{
 		library->pltRel = (elf_rel_t *)(library->relocBase + pltRel);
@@ -318,7 +440,7 @@ void io_libraryDigestDynamic(io_library_t *library)
 	}
 }
 
-void io_libraryResolveDependencies(io_library_t *library)
+bool io_libraryResolveDependencies(io_library_t *library)
 {
 	struct io_dependency_s *dependency = list_first(library->dependencies);
 	while(dependency)
@@ -326,14 +448,87 @@ void io_libraryResolveDependencies(io_library_t *library)
 		const char *name = library->strtab + dependency->name;
 		io_library_t *other = io_storeLibraryWithName(name);
 
-		if(!other)
-			panic("Could not find dependency %s for %s", name, library->name);
+		if(other)
+		{
+			io_libraryRetain(other);
+		}
+		else
+		{
+			// Load missing dependencies on demand, so modules can be loaded in any order.
+			// The reference from the creation is the one held by this library
+			char path[256];
+			if(snprintf(path, sizeof(path), "/lib/%s", name) >= (int)sizeof(path))
+			{
+				warn("iolink: Dependency name %s of %s is too long\n", name, library->name);
+				return false;
+			}
+
+			other = io_libraryCreateWithFile(path);
+			if(!other)
+			{
+				warn("iolink: Could not find dependency %s for %s\n", name, library->name);
+				return false;
+			}
+
+			if(!io_storeAddLibrary(other))
+			{
+				io_libraryRelease(other);
+				return false;
+			}
+		}
 
 		dependency->library = other;
 		dependency = dependency->next;
+	}
 
-		io_libraryRetain(other);
+	return true;
+}
+
+bool io_libraryBeginLink(io_library_t *library)
+{
+	// The symbol cache is indexed by the symbol number of the relocations,
+	// so every symbol is looked up at most once per link
+	if(library->symbolCount > 0)
+	{
+		library->symbolCache = halloc(NULL, library->symbolCount * sizeof(struct io_symbol_cache_s));
+		if(!library->symbolCache)
+			return false;
+
+		memset(library->symbolCache, 0, library->symbolCount * sizeof(struct io_symbol_cache_s));
 	}
+
+	// Flatten the dependency tree into the breadth first search order, without duplicates.
+	// The library itself is searched last. The search order is kept around for lazy binding
+	library->searchOrder = array_create();
+	if(!library->searchOrder)
+	{
+		io_libraryEndLink(library);
+		return false;
+	}
+
+	for(size_t i=0; i<=array_count(library->searchOrder); i++)
+	{
+		io_library_t *parent = (i == 0) ? library : array_objectAtIndex(library->searchOrder, i - 1);
+		struct io_dependency_s *dependency = list_first(parent->dependencies);
+
+		while(dependency)
+		{
+			if(dependency->library != library && array_indexOfObject(library->searchOrder, dependency->library) == UINT32_MAX)
+				array_addObject(library->searchOrder, dependency->library);
+
+			dependency = dependency->next;
+		}
+	}
+
+	return true;
+}
+
+void io_libraryEndLink(io_library_t *library)
+{
+	if(library->symbolCache)
+		hfree(NULL, library->symbolCache);
+
+	library->symbolCache = NULL;
 }
 
 
@@ -341,6 +536,22 @@ void io_libraryResolveDependencies(io_library_t *library)
 // Creation / Deletion
 // -----------
 
+vm_address_t io_libraryPrelinkBase(elf_header_t *header)
+{
+	const uint8_t *ident = header->e_ident;
+
+	if(ident[kIOPrelinkIdentOffset] != 'P' || ident[kIOPrelinkIdentOffset + 1] != 'L' || ident[kIOPrelinkIdentOffset + 2] != kIOPrelinkVersion)
+		return 0x0;
+
+	const uint8_t *bytes = ident + kIOPrelinkBaseOffset;
+
+	vm_address_t base = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((vm_address_t)bytes[3] << 24);
+	if((base % VM_PAGE_SIZE) != 0 || base < kIOPrelinkLowerLimit || base >= kIOPrelinkUpperLimit)
+		return 0x0;
+
+	return base;
+}
+
 io_library_t *io_libraryCreate(const char *path, uint8_t *buffer, __unused size_t length)
 {
 	io_library_t *library = halloc(NULL, sizeof(io_library_t));
@@ -422,7 +633,18 @@ io_library_t *io_libraryCreate(const char *path, uint8_t *buffer, __unused size_
 			return NULL;
 		}
 
-		library->vmemory = vm_alloc(vm_getKernelDirectory(), (uintptr_t)library->pmemory, library->pages, VM_FLAGS_KERNEL);
+		// Prelinked libraries are mapped at their prelink base if it's still free
+		library->prelinkBase = io_libraryPrelinkBase(header);
+
+		if(library->prelinkBase && minAddress == 0)
+		{
+			vm_address_t limit = library->prelinkBase + (library->pages * VM_PAGE_SIZE);
+			library->vmemory = vm_allocLimit(vm_getKernelDirectory(), (uintptr_t)library->pmemory, library->pages, library->prelinkBase, limit, VM_FLAGS_KERNEL);
+		}
+
+		if(!library->vmemory)
+			library->vmemory = vm_alloc(vm_getKernelDirectory(), (uintptr_t)library->pmemory, library->pages, VM_FLAGS_KERNEL);
+
 		if(!library->vmemory)
 		{
 			io_libraryRelease(library);
@@ -446,6 +668,8 @@ io_library_t *io_libraryCreate(const char *path, uint8_t *buffer, __unused size_
 		{
 			library->dynamic = (elf_dyn_t *)(library->relocBase + ((uintptr_t)library->dynamic));
 			io_libraryDigestDynamic(library);
+
+			library->symbolIndex = symbols_createIndex(library->symtab, library->symbolCount, library->strtabSize);
 		}
 	}
 
@@ -503,7 +727,9 @@ void io_libraryRelease(io_library_t *library)
 		struct io_dependency_s *dependency = list_first(library->dependencies);
 		while(dependency)
 		{
-			io_libraryRelease(dependency->library);
+			if(dependency->library)
+				io_libraryRelease(dependency->library);
+
 			dependency = dependency->next;
 		}
 
@@ -515,6 +741,12 @@ void io_libraryRelease(io_library_t *library)
 		if(library->pmemory)
 			pm_free(library->pmemory, library->pages);
 
+		if(library->symbolIndex)
+			array_destroy(library->symbolIndex);
+
+		if(library->searchOrder)
+			array_destroy(library->searchOrder);
+
 		hfree(NULL, library->path);
 		list_destroy(library->dependencies);
 		return;
@@ -22,8 +22,24 @@
 #include <prefix.h>
 #include <system/elf.h>
 #include <container/list.h>
+#include <container/array.h>
 #include <memory/memory.h>
-#include <container/list.h>
+
+/**
+ * Overview:
+ * prelink.py can precompute the R_386_RELATIVE relocations of a module for a fixed base address
+ * inside [kIOPrelinkLowerLimit, kIOPrelinkUpperLimit). The base is stored in the otherwise unused
+ * e_ident padding as 'P', 'L', version and the little endian address in bytes 12 to 15.
+ * If the base is still free in the kernel directory, the module is mapped there and the relative
+ * relocations are skipped, otherwise they are adjusted by the difference to the real base.
+ **/
+
+#define kIOPrelinkIdentOffset 9
+#define kIOPrelinkBaseOffset  12
+#define kIOPrelinkVersion     1
+
+#define kIOPrelinkLowerLimit 0x30000000
+#define kIOPrelinkUpperLimit 0x3f000000
 
 typedef struct io_library_s
 {
@@ -37,6 +53,8 @@ typedef struct io_library_s
 	size_t 		strtabSize;
 	elf_sym_t  *symtab;
 
+	elf32_address_t *pltgot;
+
 	elf_rel_t  *rel, *pltRel;
 	elf_rel_t  *rellimit, *pltRellimit;
 	elf_rela_t *rela;
@@ -50,8 +68,27 @@ typedef struct io_library_s
 	uint32_t nbuckets;
 	uint32_t nchains;
 
+	// DT_GNU_HASH, preferred over the SysV table when the library provides it
+	uint32_t *gnuBloom;
+	uint32_t *gnuBuckets;
+	uint32_t *gnuChains;
+	uint32_t gnuNBuckets;
+	uint32_t gnuSymOffset;
+	uint32_t gnuBloomSize;
+	uint32_t gnuBloomShift;
+
+	size_t symbolCount;
+	array_t *symbolIndex; // Sorted by address, see system/symbols.h
+
+	// Created by io_libraryBeginLink(), the cache only lives until the library is linked
+	struct io_symbol_cache_s *symbolCache;
+	array_t *searchOrder;
+
+	bool bindNow; // Set by DT_BIND_NOW or DF_BIND_NOW, opts the library out of lazy PLT binding
+
 	// Binary content and info
 	offset_t relocBase;
+	vm_address_t prelinkBase; // 0 if the library isn't prelinked
 
 	size_t pages;
 	uintptr_t    pmemory;
@@ -64,8 +101,15 @@ typedef struct io_library_s
 	// Misc
 	spinlock_t lock;
 	uint32_t refCount;
+	bool initialized; // Set once the init functions ran, see io_storeInitializeLibrary()
 } io_library_t;
 
+struct io_symbol_cache_s
+{
+	elf_sym_t *symbol;
+	io_library_t *library;
+};
+
 struct io_dependency_s
 {
 	uint32_t name;
@@ -76,19 +120,25 @@ struct io_dependency_s
 };
 
 io_library_t *io_libraryCreateWithFile(const char *file);
+vm_address_t io_libraryPrelinkBase(elf_header_t *header);
 
 void io_libraryRetain(io_library_t *library);
 void io_libraryRelease(io_library_t *library);
 
 bool io_libraryRelocateNonPLT(io_library_t *library);
 bool io_libraryRelocatePLT(io_library_t *library);
+void io_libraryRelocatePLTLazy(io_library_t *library);
+
+bool io_libraryResolveDependencies(io_library_t *library);
 
-void io_libraryResolveDependencies(io_library_t *library);
+bool io_libraryBeginLink(io_library_t *library);
+void io_libraryEndLink(io_library_t *library);
 
 vm_address_t io_libraryResolveAddress(io_library_t *library, vm_address_t address);
 
 elf_sym_t *io_librarySymbolWithAddress(io_library_t *library, vm_address_t address);
 elf_sym_t *io_librarySymbolWithName(io_library_t *library, const char *name, uint32_t hash);
+elf_sym_t *io_librarySymbolWithHashes(io_library_t *library, const char *name, uint32_t hash, uint32_t gnuHash);
 
 void *io_libraryFindSymbol(io_library_t *library, const char *name);
 
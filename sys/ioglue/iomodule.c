@@ -17,15 +17,59 @@
 //
 
 #include <container/atree.h>
+#include <container/array.h>
+#include <system/cpu.h>
 #include <system/syslog.h>
+#include <system/helper.h>
+#include <scheduler/scheduler.h>
 #include <libc/assert.h>
 #include <libc/string.h>
+#include <libc/stdio.h>
 
 #include "iomodule.h"
 #include "iostore.h"
 
 spinlock_t __io_moduleLock = SPINLOCK_INIT_LOCKED;
 atree_t *__io_moduleTree = NULL;
+array_t *__io_moduleRecords = NULL;
+array_t *__io_moduleLoading = NULL; // Names of the modules whose library is loaded right now, outside of the module lock
+
+extern void __ioglued_addReferencelessModule(io_module_t *module);
+
+// Must be called with the module lock held
+io_module_record_t *__io_moduleRecordWithName(const char *name)
+{
+	io_module_record_t *record;
+	array_foreach(__io_moduleRecords, i, record)
+	{
+		if(strcmp(record->name, name) == 0)
+			return record;
+	}
+
+	record = halloc(NULL, sizeof(io_module_record_t));
+	if(record)
+	{
+		memset(record, 0, sizeof(io_module_record_t));
+		strlcpy(record->name, name, kIOModuleRecordNameLength);
+
+		array_addObject(__io_moduleRecords, record);
+	}
+
+	return record;
+}
+
+// Must be called with the module lock held
+bool __io_moduleIsLoading(const char *name)
+{
+	const char *loading;
+	array_foreach(__io_moduleLoading, i, loading)
+	{
+		if(strcmp(loading, name) == 0)
+			return true;
+	}
+
+	return false;
+}
 
 int io_moduleAtreeLookup(void *key1, void *key2)
 {
@@ -57,20 +101,46 @@ int io_moduleAtreeLookup(void *key1, void *key2)
 
 
 
+void __io_moduleReleaseDependencies(array_t *dependencies)
+{
+	io_module_t *dependency;
+	array_foreach(dependencies, i, dependency)
+	{
+		io_moduleRelease(dependency);
+	}
+
+	array_destroy(dependencies);
+}
+
 bool __io_moduleStart(io_module_t *module)
 {
-	// Call the init functions
 	io_library_t *library = module->library;
-	for(size_t i=0; i<library->initArrayCount; i++)
+
+	// Modules this one links against are started first and stay loaded as long as it is,
+	// plain libraries only get their init functions called
+	struct io_dependency_s *dependency = list_first(library->dependencies);
+	while(dependency)
 	{
-		uintptr_t ptr = (library->initArray[i]);
-		if(ptr == 0x0 || ptr == UINT32_MAX)
-			continue;
+		io_library_t *other = dependency->library;
+		elf_sym_t *start = other ? io_librarySymbolWithName(other, "_kern_start", elf_hash("_kern_start")) : NULL;
+
+		if(start && start->st_value != 0x0)
+		{
+			io_module_t *required = io_moduleWithName(other->name);
+			if(!required)
+			{
+				dbg("iomodule: %s requires %s, which couldn't be started\n", module->name, other->name);
+				return false;
+			}
+
+			array_addObject(module->dependencies, required);
+		}
 
-		io_module_init_t init = (io_module_init_t)ptr;
-		init();
+		dependency = dependency->next;
 	}
-	
+
+	io_storeInitializeLibrary(library);
+
 	// Call the kernel entry point
 	bool result = module->start(module);
 	return result;
@@ -87,6 +157,9 @@ io_module_t *__io_moduleCreateWithLibrary(io_library_t *library, bool retainLibr
 		module->name = library->name;
 		module->references = 1;
 		module->lock = SPINLOCK_INIT;
+		module->initialized = false;
+		module->record = __io_moduleRecordWithName(module->name);
+		module->releaseTime = 0;
 
 		module->start = (io_module_start_t)io_libraryFindSymbol(library, "_kern_start");
 		module->stop  = (io_module_stop_t)io_libraryFindSymbol(library, "_kern_stop");
@@ -99,10 +172,15 @@ io_module_t *__io_moduleCreateWithLibrary(io_library_t *library, bool retainLibr
 			return NULL;
 		}
 
+		module->dependencies = array_create();
+		if(!module->dependencies)
+		{
+			hfree(NULL, module);
+			return NULL;
+		}
+
 		if(retainLibrary)
 			io_libraryRetain(library);
-
-		atree_insert(__io_moduleTree, module, module->name);
 	}
 
 	return module;
@@ -110,51 +188,124 @@ io_module_t *__io_moduleCreateWithLibrary(io_library_t *library, bool retainLibr
 
 io_module_t *io_moduleWithName(const char *name)
 {
+	// Modules and libraries are keyed by their file name, but can be requested by path as well
+	const char *file = sys_fileWithoutPath(name);
+	char path[256];
+
+	uint64_t start = cpu_readTSC();
+
+	if(file == name)
+	{
+		if(snprintf(path, sizeof(path), "/lib/%s", name) >= (int)sizeof(path))
+		{
+			warn("Couldn't load library %s, the name is too long!\n", name);
+			return NULL;
+		}
+
+		name = path;
+	}
+
+	// The lock only covers the lookup and the insertion, the library is read, linked and started without it.
+	// Modules are published once they started, requests for a module that another thread is loading wait
+	// until then or until the load failed
 	spinlock_lock(&__io_moduleLock);
 
-	io_module_t *module = (io_module_t *)atree_find(__io_moduleTree, (void *)name);
-	if(!module)
+	io_module_t *module;
+	while(!(module = (io_module_t *)atree_find(__io_moduleTree, (void *)file)) && __io_moduleIsLoading(file))
 	{
-		bool createdLibrary = false;
-		io_library_t *library = io_storeLibraryWithName(name);
+		spinlock_unlock(&__io_moduleLock);
+		sd_yield();
+		spinlock_lock(&__io_moduleLock);
+	}
 
-		if(!library)
-		{
-			library = io_libraryCreateWithFile(name);
-			if(!library)
-			{
-				warn("Couldn't find library %s!\n", name);
-				spinlock_unlock(&__io_moduleLock);
+	if(module)
+	{
+		spinlock_unlock(&__io_moduleLock);
+		io_moduleRetain(module);
 
-				return NULL;
-			}
+		return module;
+	}
+
+	array_addObject(__io_moduleLoading, (void *)file);
+	spinlock_unlock(&__io_moduleLock);
 
-			io_storeAddLibrary(library);
-			createdLibrary = true;
+	bool createdLibrary = false;
+	io_library_t *library = io_storeLibraryWithName(file);
+
+	if(!library)
+	{
+		library = io_libraryCreateWithFile(name);
+		if(library && !io_storeAddLibrary(library))
+		{
+			// Either the library failed to link, or another thread loaded it as a dependency in the meantime
+			io_libraryRelease(library);
+			library = io_storeLibraryWithName(file);
+		}
+		else
+		{
+			createdLibrary = (library != NULL);
 		}
+	}
+
+	spinlock_lock(&__io_moduleLock);
 
+	if(library)
+	{
 		module = __io_moduleCreateWithLibrary(library, !createdLibrary);
-		spinlock_unlock(&__io_moduleLock);
+		if(!module && createdLibrary)
+			io_libraryRelease(library);
+	}
 
-		if(module)
-		{
-			module->initialized = __io_moduleStart(module);
-			if(!module->initialized)
-			{
-				io_libraryRelease(module->library);
-				hfree(NULL, module);
+	if(!module)
+		array_removeObject(__io_moduleLoading, (void *)file);
 
-				return NULL;
-			}
-		}
+	spinlock_unlock(&__io_moduleLock);
+
+	if(!library)
+	{
+		warn("Couldn't load library %s!\n", name);
+		return NULL;
 	}
-	else
+
+	if(module)
 	{
+		bool initialized = __io_moduleStart(module);
+
+		spinlock_lock(&__io_moduleLock);
+
+		if(initialized)
+			atree_insert(__io_moduleTree, module, module->name);
+
+		array_removeObject(__io_moduleLoading, (void *)file);
 		spinlock_unlock(&__io_moduleLock);
-		io_moduleRetain(module);
+
+		if(!initialized)
+		{
+			__io_moduleReleaseDependencies(module->dependencies);
+			io_libraryRelease(module->library);
+			hfree(NULL, module);
+
+			return NULL;
+		}
+
+		if(module->record)
+		{
+			module->record->loads ++;
+			module->record->loadCycles = cpu_readTSC() - start;
+		}
+
+		// The module might have dropped its last reference while starting, stopping it was left to us
+		spinlock_lock(&module->lock);
+
+		module->initialized = true;
+		bool released = (module->references == 0);
+
+		spinlock_unlock(&module->lock);
+
+		if(released)
+			__ioglued_addReferencelessModule(module);
 	}
 
-	
 	return module;
 }
 
@@ -168,8 +319,6 @@ void io_moduleRetain(io_module_t *module)
 	spinlock_unlock(&module->lock);
 }
 
-extern void __ioglued_addReferencelessModule(io_module_t *module);
-
 void io_moduleRelease(io_module_t *module)
 {
 	if(!module)
@@ -179,33 +328,81 @@ void io_moduleRelease(io_module_t *module)
 
 	if((-- module->references) == 0)
 	{
-		__ioglued_addReferencelessModule(module);
+		module->releaseTime = cpu_readTSC();
+
+		// Modules that are still starting get handed to ioglued by io_moduleWithName()
+		if(module->initialized)
+			__ioglued_addReferencelessModule(module);
 	}
 
 	spinlock_unlock(&module->lock);
 }
 
-void io_moduleStop(io_module_t *module)
+bool io_moduleStop(io_module_t *module, io_module_retired_t *retired)
 {
 	if(!module->stop(module))
 	{
 		module->references ++;
-		return;
+		return false;
 	}
 
 	spinlock_lock(&__io_moduleLock);
 	atree_remove(__io_moduleTree, (void *)module->name);
 	spinlock_unlock(&__io_moduleLock);
 
-	io_libraryRelease(module->library);
+	// The library stays mapped, threads might still be on their way out of it
+	retired->library      = module->library;
+	retired->dependencies = module->dependencies;
+	retired->record       = module->record;
+	retired->releaseTime  = module->releaseTime;
+	retired->stopTime     = cpu_readTSC();
+
 	hfree(NULL, module);
+	return true;
+}
+
+void io_moduleFinishUnload(io_module_retired_t *retired)
+{
+	io_libraryRelease(retired->library);
+
+	// Only now the modules it required can go as well, the library might have called them up until here
+	__io_moduleReleaseDependencies(retired->dependencies);
+
+	if(retired->record)
+	{
+		uint64_t now = cpu_readTSC();
+
+		retired->record->unloads ++;
+		retired->record->unloadCycles = now - retired->releaseTime;
+		retired->record->graceCycles  = now - retired->stopTime;
+	}
+}
+
+void io_moduleReport()
+{
+	spinlock_lock(&__io_moduleLock);
+
+	io_module_record_t *record;
+	array_foreach(__io_moduleRecords, i, record)
+	{
+		dbg("iomodule: %s, %u loads, last in %llu cycles", record->name, record->loads, record->loadCycles);
+
+		if(record->unloads > 0)
+			dbg(", %u unloads, last in %llu cycles (%llu waiting for the grace period)", record->unloads, record->unloadCycles, record->graceCycles);
+
+		dbg("\n");
+	}
+
+	spinlock_unlock(&__io_moduleLock);
 }
 
 
 bool io_moduleInit()
 {
 	__io_moduleTree = atree_create(io_moduleAtreeLookup);
+	__io_moduleRecords = array_create();
+	__io_moduleLoading = array_create();
 	spinlock_unlock(&__io_moduleLock);
 
-	return (__io_moduleTree != NULL);
+	return (__io_moduleTree != NULL && __io_moduleRecords != NULL && __io_moduleLoading != NULL);
 }
@@ -22,6 +22,19 @@
 #include <prefix.h>
 #include "iolibrary.h"
 
+/**
+ * Overview:
+ * A module is a library with kernel entry points. Once its last reference is dropped, ioglued calls
+ * io_moduleStop() and keeps the library mapped until a grace period has passed. That is until no kernel
+ * thread executes the library or has one of its frames on the stack anymore, see ioglued.c. Only then
+ * io_moduleFinishUnload() releases the library.
+ * Modules a module links against are started before it and published only once they started,
+ * they stay loaded until the module that required them is unloaded.
+ * The load and unload latencies of every module are recorded, io_moduleReport() logs them on demand.
+ **/
+
+#define kIOModuleRecordNameLength 64
+
 struct io_module_s;
 
 typedef void (*io_module_init_t)();
@@ -41,13 +54,44 @@ typedef struct io_module_s
 
 	io_module_start_t start;
 	io_module_stop_t stop;
+
+	// Not part of kern_module_t, keep these below the entry points
+	struct io_module_record_s *record;
+	uint64_t releaseTime; // TSC when the last reference was dropped
+	array_t *dependencies; // The modules this one links against, each retained once
 } io_module_t;
 
+typedef struct io_module_record_s
+{
+	char name[kIOModuleRecordNameLength];
+
+	uint32_t loads;
+	uint32_t unloads;
+
+	uint64_t loadCycles; // Of the last load, until _kern_start() returned
+	uint64_t unloadCycles; // Of the last unload, from dropping the last reference until the library was released
+	uint64_t graceCycles; // The part of unloadCycles spent waiting for the grace period
+} io_module_record_t;
+
+// A stopped module whose library waits for the end of its grace period
+typedef struct
+{
+	io_library_t *library;
+	array_t *dependencies;
+	io_module_record_t *record;
+
+	uint64_t releaseTime;
+	uint64_t stopTime;
+} io_module_retired_t;
+
 io_module_t *io_moduleWithName(const char *name);
 
 void io_moduleRetain(io_module_t *module);
 void io_moduleRelease(io_module_t *module);
 
-void io_moduleStop(io_module_t *module);
+bool io_moduleStop(io_module_t *module, io_module_retired_t *retired);
+void io_moduleFinishUnload(io_module_retired_t *retired);
+
+void io_moduleReport();
 
 #endif /* _IOMODULE_H_ */
@@ -20,18 +20,64 @@
 #include <container/array.h>
 #include <system/syslog.h>
 #include <system/helper.h>
+#include <system/cpu.h>
+#include <scheduler/scheduler.h>
 #include <libc/string.h>
 #include "iostore.h"
 #include "iostubs.h"
 #include "iomodule.h"
 
 //static spinlock_t __io_storeLock = SPINLOCK_INIT;
+
+// Linking is serialized by a lock that the linking thread can take again, dependencies are loaded and linked
+// by the thread that needs them. Other threads only ever see libraries that are completely linked.
+static thread_t *__io_storeLinker = NULL;
+static uint32_t __io_storeLinkDepth = 0;
 static atree_t *__io_storeLibraries = NULL;
+static atree_t *__io_storeRanges = NULL; // Libraries keyed by their start address
 static spinlock_t __io_storeLock = SPINLOCK_INIT;
 
 static io_library_t *__io_libio = NULL;
 static io_library_t *__io_libkernel = NULL;
 
+static elf_sym_t *__io_storeResolveSymbol(io_library_t *library, const char *name, io_library_t **outLib)
+{
+	uint32_t hash = elf_hash(name);
+	uint32_t gnuHash = elf_gnuHash(name);
+	elf_sym_t *symbol;
+
+	// Try to find the symbol in the kernel
+	symbol = io_findKernelSymbolWithHash(name, hash);
+	if(symbol)
+	{
+		*outLib = io_kernelLibraryStub();
+		return symbol;
+	}
+
+	// Search through the dependencies, breadth first
+	io_library_t *dependency;
+
+	array_foreach(library->searchOrder, index, dependency)
+	{
+		symbol = io_librarySymbolWithHashes(dependency, name, hash, gnuHash);
+		if(symbol && symbol->st_value != 0x0)
+		{
+			*outLib = dependency;
+			return symbol;
+		}
+	}
+
+	// Look it up in the library
+	symbol = io_librarySymbolWithHashes(library, name, hash, gnuHash);
+	if(symbol && symbol->st_value != 0x0)
+	{
+		*outLib = library;
+		return symbol;
+	}
+
+	return NULL;
+}
+
 elf_sym_t *io_storeLookupSymbol(io_library_t *library, uint32_t symNum, io_library_t **outLib)
 {
 	elf_sym_t *lookup = library->symtab + symNum;
@@ -42,57 +88,23 @@ elf_sym_t *io_storeLookupSymbol(io_library_t *library, uint32_t symNum, io_libra
 		*outLib = library;
 		return lookup;
 	}
-	else
-	{
-		uint32_t hash = elf_hash(name);
-		elf_sym_t *symbol;
-
-		// Try to find the symbol in the kernel
-		symbol = io_findKernelSymbol(name);
-		if(symbol)
-		{
-			*outLib = io_kernelLibraryStub();
-			return symbol;
-		}
-
-		// Search through the dependencies
-		// Breadth first
-		array_t *dependencyTree = array_create();
-		array_addObject(dependencyTree, library->dependencies);
-		
-		for(size_t i=0; i<array_count(dependencyTree); i++)
-		{
-			list_t *dependencies = array_objectAtIndex(dependencyTree, i);
-			struct io_dependency_s *dependency = list_first(dependencies);
-			while(dependency)
-			{
-				symbol = io_librarySymbolWithName(dependency->library, name, hash);
-				if(symbol  && symbol->st_value != 0x0)
-				{
-					*outLib = dependency->library;
-					array_destroy(dependencyTree);
-					return symbol;
-				}
-
-				if(list_count(dependency->library->dependencies) > 0)
-					array_addObject(dependencyTree, dependency->library->dependencies);
-				
-				dependency = dependency->next;
-			}
-		}
 
-		array_destroy(dependencyTree);
+	// Most imports are referenced by more than one relocation, the cache is gone for lazy binds after the link
+	struct io_symbol_cache_s *cache = (library->symbolCache && symNum < library->symbolCount) ? &library->symbolCache[symNum] : NULL;
+	if(cache && cache->symbol)
+	{
+		*outLib = cache->library;
+		return cache->symbol;
+	}
 
-		// Look it up in the library
-		symbol = io_librarySymbolWithName(library, name, hash);
-		if(symbol && symbol->st_value != 0x0)
-		{
-			*outLib = library;
-			return symbol;
-		}
+	elf_sym_t *symbol = __io_storeResolveSymbol(library, name, outLib);
+	if(symbol && cache)
+	{
+		cache->symbol  = symbol;
+		cache->library = *outLib;
 	}
 
-	return NULL;
+	return symbol;
 }
 
 
@@ -127,95 +139,173 @@ int io_storeAtreeLookup(void *key1, void *key2)
 
 
 
+int io_storeAtreeAddressLookup(void *key1, void *key2)
+{
+	vm_address_t address1 = (vm_address_t)key1;
+	vm_address_t address2 = (vm_address_t)key2;
+
+	if(address1 == address2)
+		return kCompareEqualTo;
+
+	return (address1 > address2) ? kCompareGreaterThan : kCompareLesserThan;
+}
+
+
+
+static void __io_storeLockLinker()
+{
+	thread_t *self = thread_getCurrentThread();
+
+	while(1)
+	{
+		spinlock_lock(&__io_storeLock);
+
+		if(__io_storeLinkDepth == 0 || __io_storeLinker == self)
+		{
+			__io_storeLinker = self;
+			__io_storeLinkDepth ++;
+
+			spinlock_unlock(&__io_storeLock);
+			return;
+		}
+
+		spinlock_unlock(&__io_storeLock);
+		sd_yield();
+	}
+}
+
+static void __io_storeUnlockLinker()
+{
+	spinlock_lock(&__io_storeLock);
+
+	if((-- __io_storeLinkDepth) == 0)
+		__io_storeLinker = NULL;
+
+	spinlock_unlock(&__io_storeLock);
+}
+
 io_library_t *io_storeLibraryWithName(const char *name)
 {
+	__io_storeLockLinker();
+
 	spinlock_lock(&__io_storeLock);
 	io_library_t *library = (io_library_t *)atree_find(__io_storeLibraries, (void *)name);
 	spinlock_unlock(&__io_storeLock);
 
+	__io_storeUnlockLinker();
 	return library;
 }
 
-io_library_t *io_storeLibraryWithAddress(vm_address_t address)
+static io_library_t *__io_storeFindLibraryWithAddress(vm_address_t address)
 {
-	spinlock_lock(&__io_storeLock);
-	iterator_t *iterator = atree_iterator(__io_storeLibraries);
-	io_library_t *library;
+	if(!__io_storeRanges)
+		return NULL;
 
-	while((library = iterator_nextObject(iterator)))
+	// Libraries never overlap, so the closest library below the address is the only candidate
+	io_library_t *library = atree_findFloor(__io_storeRanges, (void *)address);
+	if(library)
 	{
 		vm_address_t vlimit = library->vmemory + (library->pages * VM_PAGE_SIZE);
-		if(address >= library->vmemory && address <= vlimit)
-		{
-			iterator_destroy(iterator);
-			spinlock_unlock(&__io_storeLock);
-
+		if(address < vlimit)
 			return library;
-		}
 	}
 
-	iterator_destroy(iterator);
-	spinlock_unlock(&__io_storeLock);
 	return NULL;
 }
 
+io_library_t *io_storeLibraryWithAddress(vm_address_t address)
+{
+	spinlock_lock(&__io_storeLock);
+	io_library_t *library = __io_storeFindLibraryWithAddress(address);
+	spinlock_unlock(&__io_storeLock);
+
+	return library;
+}
+
 io_library_t *__io_storeLibraryWithAddress(vm_address_t address)
 {
+	io_library_t *library = NULL;
+
 	if(spinlock_tryLock(&__io_storeLock))
 	{
-		iterator_t *iterator = atree_iterator(__io_storeLibraries);
-		io_library_t *library;
-
-		while((library = iterator_nextObject(iterator)))
-		{
-			vm_address_t vlimit = library->vmemory + (library->pages * VM_PAGE_SIZE);
-			if(address >= library->vmemory && address <= vlimit)
-			{
-				iterator_destroy(iterator);
-				spinlock_unlock(&__io_storeLock);
-
-				return library;
-			}
-		}
-
-		iterator_destroy(iterator);
+		library = __io_storeFindLibraryWithAddress(address);
 		spinlock_unlock(&__io_storeLock);
 	}
 	
-	return NULL;
+	return library;
 }
 
 
 bool io_storeAddLibrary(io_library_t *library)
 {
+	__io_storeLockLinker();
+
 	spinlock_lock(&__io_storeLock);
-	if(!atree_find(__io_storeLibraries, (void *)library->name))
+	if(atree_find(__io_storeLibraries, (void *)library->name))
 	{
-		atree_insert(__io_storeLibraries, library, (void *)library->name);
 		spinlock_unlock(&__io_storeLock);
+		__io_storeUnlockLinker();
 
-		io_libraryResolveDependencies(library);
+		return false;
+	}
 
-		bool rel1 = io_libraryRelocateNonPLT(library);
-		bool rel2 = io_libraryRelocatePLT(library); 
+	atree_insert(__io_storeLibraries, library, (void *)library->name);
+	atree_insert(__io_storeRanges, library, (void *)library->vmemory);
+	spinlock_unlock(&__io_storeLock);
 
-		if(!rel1 || !rel2)
-		{
-			io_storeRemoveLibrary(library);
-			return false;
-		}
+	uint64_t start = cpu_readTSC();
 
-		return true;
+	if(!io_libraryResolveDependencies(library) || !io_libraryBeginLink(library))
+	{
+		io_storeRemoveLibrary(library);
+		__io_storeUnlockLinker();
+
+		return false;
 	}
 
-	spinlock_unlock(&__io_storeLock);
+	// Libraries linked with -z now opt out of lazy binding, --iobindnow disables it for all of them
+	bool lazy = (library->pltgot && !library->bindNow && !sys_checkCommandline("--iobindnow", NULL));
+
+	bool rel1 = io_libraryRelocateNonPLT(library);
+	bool rel2 = true;
+
+	if(lazy)
+		io_libraryRelocatePLTLazy(library);
+	else
+		rel2 = io_libraryRelocatePLT(library);
+
+	io_libraryEndLink(library);
+
+	if(!rel1 || !rel2)
+	{
+		io_storeRemoveLibrary(library);
+		__io_storeUnlockLinker();
+
+		return false;
+	}
+
+	__io_storeUnlockLinker();
+
+	// The per module load numbers, boot with --debug to get them. The cycles cover resolving the dependencies,
+	// which are reported on their own as well, and the relocations, but not reading the file
+	size_t relocations = (library->rellimit - library->rel) + (library->pltRellimit - library->pltRel);
+	bool prelinked = (library->prelinkBase && library->relocBase == library->prelinkBase);
+	dbg("iolink: linked %s, %u relocations in %llu cycles (%s binding%s)\n", library->name, relocations, cpu_readTSC() - start, lazy ? "lazy" : "eager", prelinked ? ", prelinked" : "");
+
 	return true;
 }
 
 void io_storeRemoveLibrary(io_library_t *library)
 {
 	spinlock_lock(&__io_storeLock);
-	atree_remove(__io_storeLibraries, (void *)library->name);
+
+	// A copy that lost the race against another thread must not remove the stored library
+	if(atree_find(__io_storeLibraries, (void *)library->name) == library)
+	{
+		atree_remove(__io_storeLibraries, (void *)library->name);
+		atree_remove(__io_storeRanges, (void *)library->vmemory);
+	}
+
 	spinlock_unlock(&__io_storeLock);
 }
 
@@ -235,6 +325,34 @@ void io_storeCallInitFunctions(io_library_t *library)
 	}
 }
 
+static void __io_storeInitializeLibrary(io_library_t *library)
+{
+	// Set up front, so dependency cycles end here
+	if(library->initialized)
+		return;
+
+	library->initialized = true;
+
+	struct io_dependency_s *dependency = list_first(library->dependencies);
+	while(dependency)
+	{
+		if(dependency->library)
+			__io_storeInitializeLibrary(dependency->library);
+
+		dependency = dependency->next;
+	}
+
+	io_storeCallInitFunctions(library);
+}
+
+void io_storeInitializeLibrary(io_library_t *library)
+{
+	// Taking the linker lock keeps other threads from running the same init functions concurrently
+	__io_storeLockLinker();
+	__io_storeInitializeLibrary(library);
+	__io_storeUnlockLinker();
+}
+
 bool io_initStubs();
 bool io_moduleInit();
 
@@ -244,7 +362,9 @@ bool io_init(__unused void *data)
 		return false;
 
 	__io_storeLibraries = atree_create(io_storeAtreeLookup);
-	if(!__io_storeLibraries)
+	__io_storeRanges    = atree_create(io_storeAtreeAddressLookup);
+
+	if(!__io_storeLibraries || !__io_storeRanges)
 		return false;
 
 	if(sys_checkCommandline("--no-ioglue", NULL))
@@ -271,8 +391,8 @@ bool io_init(__unused void *data)
 			return false;
 		}
 		
-		io_storeCallInitFunctions(__io_libkernel);
-		io_storeCallInitFunctions(__io_libio);
+		io_storeInitializeLibrary(__io_libkernel);
+		io_storeInitializeLibrary(__io_libio);
 
 		libio_init_t libio_init = (libio_init_t)io_libraryFindSymbol(__io_libio, "libio_init");
 		if(!libio_init)
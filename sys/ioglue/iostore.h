@@ -35,9 +35,11 @@ io_library_t *io_storeLibraryWithName(const char *name);
 
 io_library_t *__io_storeLibraryWithAddress(vm_address_t address); // Non-blocking version of io_storeLibraryWithAddress()
 
-bool io_storeAddLibrary(io_library_t *library);
+bool io_storeAddLibrary(io_library_t *library); // Fails if a library with the same name is already stored
 void io_storeRemoveLibrary(io_library_t *library);
 
+void io_storeInitializeLibrary(io_library_t *library); // Calls the init functions once, after the ones of the dependencies
+
 bool io_init(void *unused);
 
 #endif /* _IOSTORE_H_ */
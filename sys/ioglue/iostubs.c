@@ -150,10 +150,9 @@ void __io_dispatchInterrupt(cpu_state_t *state)
 
 	if(entry)
 	{
-		array_t *allHandler = entry->handler;
-		for(size_t i=0; i<array_count(allHandler); i++)
+		io_interrupt_handler_t *handler;
+		array_foreach(entry->handler, i, handler)
 		{
-			io_interrupt_handler_t *handler = array_objectAtIndex(allHandler, i);
 			handler->callback(handler->owner, handler->context, state->interrupt);
 		}
 	}
@@ -302,6 +301,7 @@ const char *__io_exportedSymbolNames[] = {
 	"io_moduleWithName",
 	"io_moduleRetain",
 	"io_moduleRelease",
+	"io_moduleReport",
 	// Memory
 	"kern_alloc",
 	"kern_free",
@@ -314,11 +314,27 @@ const char *__io_exportedSymbolNames[] = {
 	"time_convertTimestamp",
 	"time_getTimestamp",
 	"time_getUnixTime",
-	"time_getBootTime"
+	"time_getBootTime",
+	// Benchmarks
+	"kbench_suiteCreate",
+	"kbench_suiteAdd",
+	"kbench_suiteRun"
 };
 
+// The export table is built once in io_initStubs(). It is sorted by the elf_hash() of the names,
+// so a lookup is a binary search over the hashes followed by a strcmp() of the (usually single) match.
+// The kernel symbols are resolved for all exports up front in a single pass over the kernels .symtab
+typedef struct
+{
+	uint32_t hash;
+	const char *name;
+	elf_sym_t *symbol;
+} io_kernel_export_t;
+
+#define kIOKernelExportCount (sizeof(__io_exportedSymbolNames) / sizeof(char *))
+
 io_library_t *__io_kernelLibrary = NULL;
-elf_sym_t **__io_exportedSymbols = NULL;
+io_kernel_export_t *__io_exportedSymbols = NULL;
 
 size_t __io_kernelLibrarySymbolCount;
 
@@ -329,31 +345,66 @@ io_library_t *io_kernelLibraryStub()
 	return __io_kernelLibrary;
 }
 
-elf_sym_t *io_findKernelSymbol(const char *name)
+static io_kernel_export_t *__io_findKernelExport(const char *name, uint32_t hash)
 {
-	// Look if the symbol was already exported...
-	bool isExported = false;
-	size_t index = 0;
+	size_t lower = 0;
+	size_t upper = kIOKernelExportCount;
 
-	size_t size = sizeof(__io_exportedSymbolNames) / sizeof(char *);
-	for(size_t i=0; i<size; i++)
+	// Find the first entry with the given hash
+	while(lower < upper)
 	{
-		if(strcmp(__io_exportedSymbolNames[i], name) == 0)
-		{
-			if(__io_exportedSymbols[i] != NULL)
-				return __io_exportedSymbols[i];
+		size_t middle = lower + ((upper - lower) / 2);
 
-			index = i;
-			isExported = true;
-			break;
-		}
+		if(__io_exportedSymbols[middle].hash < hash)
+			lower = middle + 1;
+		else
+			upper = middle;
 	}
 
+	// Collisions are adjacent
+	for(size_t i=lower; i<kIOKernelExportCount && __io_exportedSymbols[i].hash == hash; i++)
+	{
+		if(strcmp(__io_exportedSymbols[i].name, name) == 0)
+			return &__io_exportedSymbols[i];
+	}
+
+	return NULL;
+}
+
+elf_sym_t *io_findKernelSymbolWithHash(const char *name, uint32_t hash)
+{
 	// If the symbol isn't exported by the kernel in general, we won't look into the kernels symbol at all
-	if(!isExported)
-		return NULL;
+	io_kernel_export_t *export = __io_findKernelExport(name, hash);
+	return export ? export->symbol : NULL;
+}
 
-	// Find the symbol in the binary
+elf_sym_t *io_findKernelSymbol(const char *name)
+{
+	return io_findKernelSymbolWithHash(name, elf_hash(name));
+}
+
+
+static void __io_buildExportTable()
+{
+	for(size_t i=0; i<kIOKernelExportCount; i++)
+	{
+		io_kernel_export_t export;
+		export.name   = __io_exportedSymbolNames[i];
+		export.hash   = elf_hash(export.name);
+		export.symbol = NULL;
+
+		// Insertion sort, the table is small and this runs exactly once
+		size_t index = i;
+		while(index > 0 && __io_exportedSymbols[index - 1].hash > export.hash)
+		{
+			__io_exportedSymbols[index] = __io_exportedSymbols[index - 1];
+			index --;
+		}
+
+		__io_exportedSymbols[index] = export;
+	}
+
+	// Resolve all exports with one pass over the kernels symbol table
 	elf_sym_t *symbol = __io_kernelLibrary->symtab;
 	for(size_t i=0; i<__io_kernelLibrarySymbolCount; i++, symbol++)
 	{
@@ -361,14 +412,11 @@ elf_sym_t *io_findKernelSymbol(const char *name)
 			continue;
 
 		const char *symname = __io_kernelLibrary->strtab + symbol->st_name;
-		if(strcmp(symname, name) == 0)
-		{
-			__io_exportedSymbols[index] = symbol;
-			return symbol;
-		}
-	}
+		io_kernel_export_t *export = __io_findKernelExport(symname, elf_hash(symname));
 
-	return NULL;
+		if(export && !export->symbol)
+			export->symbol = symbol;
+	}
 }
 
 
@@ -406,9 +454,13 @@ bool io_initStubs()
 		// Initialize the kernel library stub and allocate enough space for the exported symbol section
 		__io_kernelLibrary->name = __io_kernelLibrary->path = "firedrake";
 		__io_kernelLibrary->relocBase = 0x0;
-		__io_exportedSymbols = halloc(NULL, (sizeof(__io_exportedSymbolNames) / sizeof(char *)) * sizeof(elf_sym_t *));
+		__io_exportedSymbols = halloc(NULL, kIOKernelExportCount * sizeof(io_kernel_export_t));
+
+		if(!__io_kernelLibrary->strtab || !__io_kernelLibrary->symtab || !__io_exportedSymbols)
+			return false;
 
-		return (__io_kernelLibrary->strtab && __io_kernelLibrary->symtab && __io_exportedSymbols);
+		__io_buildExportTable();
+		return true;
 	}
 
 	return true;
@@ -24,5 +24,6 @@
 
 io_library_t *io_kernelLibraryStub();
 elf_sym_t *io_findKernelSymbol(const char *name);
+elf_sym_t *io_findKernelSymbolWithHash(const char *name, uint32_t hash);
 
 #endif /* _IOSTUBS_H_ */
@@ -0,0 +1,119 @@
+//
+//  kbench.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <libc/string.h>
+#include <memory/memory.h>
+#include <system/syslog.h>
+#include <system/cpu.h>
+
+#include "kbench.h"
+
+kbench_suite_t *kbench_suiteCreate(char *name)
+{
+	kbench_suite_t *suite = halloc(NULL, sizeof(kbench_suite_t));
+	if(suite)
+	{
+		suite->name  = name;
+		suite->first = suite->last = NULL;
+	}
+
+	return suite;
+}
+
+void kbench_suiteAdd(kbench_suite_t *suite, char *name, kbench_function_t function, void *argument, uint32_t batch)
+{
+	if(!suite)
+		return;
+
+	kbench_t *bench = halloc(NULL, sizeof(kbench_t));
+	if(!bench)
+	{
+		warn("kbench: couldn't allocate %s/%s\n", suite->name, name);
+		return;
+	}
+
+	bench->name     = name;
+	bench->function = function;
+	bench->argument = argument;
+	bench->batch    = (batch > 0) ? batch : 1;
+	bench->next     = NULL;
+
+	if(suite->last)
+	{
+		suite->last->next = bench;
+		suite->last = bench;
+	}
+	else
+	{
+		suite->first = suite->last = bench;
+	}
+}
+
+
+static uint32_t kbench_sample(kbench_t *bench)
+{
+	uint64_t start = cpu_readTSC();
+	bench->function(bench->argument, bench->batch);
+	uint64_t end = cpu_readTSC();
+
+	return (uint32_t)((end - start) / bench->batch);
+}
+
+static void kbench_run(kbench_suite_t *suite, kbench_t *bench)
+{
+	uint32_t samples[kKBenchSamples];
+
+	// Warm up caches and lazily initialized state
+	for(int i=0; i<kKBenchWarmup; i++)
+		kbench_sample(bench);
+
+	for(int i=0; i<kKBenchSamples; i++)
+	{
+		uint32_t sample = kbench_sample(bench);
+
+		// Insertion sort, the samples are ordered once the loop is done
+		int j = i;
+		for(; j>0 && samples[j - 1] > sample; j--)
+			samples[j] = samples[j - 1];
+
+		samples[j] = sample;
+	}
+
+	uint32_t median = samples[kKBenchSamples / 2];
+	uint32_t p99    = samples[(kKBenchSamples * 99) / 100 - 1];
+
+	info("kbench: %s/%s min=%u median=%u p99=%u batch=%u\n", suite->name, bench->name, samples[0], median, p99, bench->batch);
+}
+
+void kbench_suiteRun(kbench_suite_t *suite)
+{
+	if(!suite)
+		return;
+
+	kbench_t *bench = suite->first;
+	while(bench)
+	{
+		kbench_t *next = bench->next;
+
+		kbench_run(suite, bench);
+		hfree(NULL, bench);
+
+		bench = next;
+	}
+
+	hfree(NULL, suite);
+}
@@ -0,0 +1,62 @@
+//
+//  kbench.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+/**
+ * Overview:
+ * A small benchmark harness for the kernel. Benchmarks are timed with the TSC in batches,
+ * every batch yields one sample in cycles per iteration. After a few warm-up batches the
+ * harness collects kKBenchSamples samples and reports the min, median and 99th percentile as
+ * one line per benchmark:
+ *   kbench: <suite>/<benchmark> min=<cycles> median=<cycles> p99=<cycles> batch=<iterations>
+ * The lines don't depend on anything but the measurements, so the output of two runs can be diffed
+ **/
+#ifndef _KBENCH_H_
+#define _KBENCH_H_
+
+#include <prefix.h>
+
+#define kKBenchWarmup  4
+#define kKBenchSamples 100
+
+// Runs the measured operation iterations times, argument is the one passed on creation
+typedef void (*kbench_function_t)(void *argument, uint32_t iterations);
+
+typedef struct kbench_s
+{
+	char *name;
+	kbench_function_t function;
+	void *argument;
+	uint32_t batch; // Iterations per sample
+
+	struct kbench_s *next;
+} kbench_t;
+
+typedef struct kbench_suite_s
+{
+	char *name;
+
+	kbench_t *first;
+	kbench_t *last;
+} kbench_suite_t;
+
+kbench_suite_t *kbench_suiteCreate(char *name);
+void kbench_suiteAdd(kbench_suite_t *suite, char *name, kbench_function_t function, void *argument, uint32_t batch);
+
+// Runs all benchmarks of the suite and destroys it afterwards
+void kbench_suiteRun(kbench_suite_t *suite);
+
+#endif /* _KBENCH_H_ */
@@ -29,8 +29,26 @@
 
 #include "ioglued.h"
 
+#define kIOGluedGracePeriodPoll 10 // Milliseconds between two checks for the end of a grace period
+#define kIOGluedWorkerStackSize (4 * VM_PAGE_SIZE) // Loading dependencies on demand recurses once per level
+
+// Module unloading
+// ioglued blocks until a module drops its last reference. Stopped modules are retired: their library
+// stays mapped until a grace period has passed, which ends once no kernel thread executes the library
+// or has an address of it on its stack. The stacks are scanned word by word instead of following the
+// frame pointers, modules are built without them. Stray values only delay the unload.
+// Only threads of ring 0 processes are checked, modules are never called from anywhere else.
+// Log records that syslogd hasn't printed yet don't matter, syslog() copies format strings of modules into them.
+
+extern process_t *process_getFirstProcess();
+
 static spinlock_t __ioglued_lock = SPINLOCK_INIT_LOCKED;
 static array_t *__ioglued_modulesToStop = NULL;
+static array_t *__ioglued_modulesStopping = NULL; // Swapped with __ioglued_modulesToStop by ioglued
+static array_t *__ioglued_retiredModules = NULL; // Only touched by ioglued
+
+static thread_t *__ioglued_thread = NULL;
+static bool __ioglued_waiting = false;
 
 void __ioglued_addReferencelessModule(io_module_t *module)
 {
@@ -38,18 +56,203 @@ void __ioglued_addReferencelessModule(io_module_t *module)
 
 	array_addObject(__ioglued_modulesToStop, module);
 
+	if(__ioglued_waiting)
+	{
+		__ioglued_waiting = false;
+		__ioglued_thread->blocks --;
+	}
+
 	spinlock_unlock(&__ioglued_lock);
 }
 
+static bool __ioglued_threadUsesLibrary(thread_t *thread, vm_address_t lower, vm_address_t upper)
+{
+	cpu_state_t *state = (cpu_state_t *)thread->esp;
+
+	if(state->eip >= lower && state->eip < upper)
+		return true;
+
+	uint32_t *stack = (uint32_t *)thread->esp;
+	uint32_t *stackTop = (uint32_t *)(thread->kernelStackVirt + (thread->kernelStackPages * VM_PAGE_SIZE));
+
+	if(stack < (uint32_t *)thread->kernelStackVirt)
+		return false;
+
+	for(; stack < stackTop; stack ++)
+	{
+		if(*stack >= lower && *stack < upper)
+			return true;
+	}
+
+	return false;
+}
+
+static bool __ioglued_libraryIsQuiescent(io_library_t *library)
+{
+	vm_address_t lower = library->vmemory;
+	vm_address_t upper = lower + (library->pages * VM_PAGE_SIZE);
+
+	thread_t *self = thread_getCurrentThread();
+	bool quiescent = true;
+
+	// Holding the scheduler lock keeps every thread where it is while its stack is walked
+	spinlock_lock(&_sd_lock);
+
+	process_t *process = process_getFirstProcess();
+	while(process && quiescent)
+	{
+		if(process->ring0 && !process->died)
+		{
+			thread_t *thread = process->mainThread;
+			while(thread)
+			{
+				if(thread != self && !thread->died && thread->kernelStackVirt && __ioglued_threadUsesLibrary(thread, lower, upper))
+				{
+					quiescent = false;
+					break;
+				}
+
+				thread = thread->next;
+			}
+		}
+
+		process = process->next;
+	}
+
+	spinlock_unlock(&_sd_lock);
+	return quiescent;
+}
+
+static void __ioglued_stopModules(array_t *modules)
+{
+	io_module_t *module;
+	array_foreach(modules, i, module)
+	{
+		io_module_retired_t *retired = halloc(NULL, sizeof(io_module_retired_t));
+		if(!retired)
+		{
+			// Try again later
+			__ioglued_addReferencelessModule(module);
+			continue;
+		}
+
+		if(!io_moduleStop(module, retired))
+		{
+			hfree(NULL, retired);
+			continue;
+		}
+
+		array_addObject(__ioglued_retiredModules, retired);
+	}
+
+	array_removeAllObjects(modules);
+}
+
+static void __ioglued_unloadRetiredModules()
+{
+	for(size_t i=0; i<array_count(__ioglued_retiredModules);)
+	{
+		io_module_retired_t *retired = array_objectAtIndex(__ioglued_retiredModules, i);
+
+		if(!__ioglued_libraryIsQuiescent(retired->library))
+		{
+			i ++;
+			continue;
+		}
+
+		io_moduleFinishUnload(retired);
+
+		array_removeObjectAtIndex(__ioglued_retiredModules, i);
+		hfree(NULL, retired);
+	}
+}
+
+// Module loading
+// Every entry of /etc/ioglue.conf gets its own worker thread. Dependencies are loaded on demand
+// by the linker and modules among them are started before the module that needs them, so the order
+// of the entries doesn't matter and independent modules don't wait for each other. Only linking
+// is serialized, reading and starting modules overlaps.
+
+static uint32_t __ioglued_pendingLoads = 0;
+
+void __ioglued_loadWorker()
+{
+	thread_t *thread = thread_getCurrentThread();
+	char *path = (char *)thread->arguments[0];
+
+	thread_setName(thread, "ioglued.load", NULL);
+
+	io_module_t *module = io_moduleWithName(path);
+	if(!module)
+		dbg("ioglued: Failed to publish \"%s\"\n", path);
+
+	hfree(NULL, path);
+
+	__sync_fetch_and_sub(&__ioglued_pendingLoads, 1);
+	sd_threadExit();
+}
+
+static void __ioglued_loadModules(char *content)
+{
+	process_t *process = process_getCurrentProcess();
+	char *entry = content;
+
+	while(entry && *entry != '\0')
+	{
+		char *next = strpbrk(entry, ",\n");
+		if(next)
+			*(next ++) = '\0';
+
+		// Trim the entry
+		while(*entry == ' ' || *entry == '\t' || *entry == '\r')
+			entry ++;
+
+		size_t length = strlen(entry);
+		while(length > 0 && (entry[length - 1] == ' ' || entry[length - 1] == '\t' || entry[length - 1] == '\r'))
+			entry[-- length] = '\0';
+
+		if(length > 0)
+		{
+			char *path = halloc(NULL, length + 6);
+			if(path)
+			{
+				sprintf(path, "/lib/%s", entry);
+				__sync_fetch_and_add(&__ioglued_pendingLoads, 1);
+
+				thread_t *worker = thread_create(process, __ioglued_loadWorker, kIOGluedWorkerStackSize, NULL, 1, (uint32_t)path);
+				if(!worker)
+				{
+					__sync_fetch_and_sub(&__ioglued_pendingLoads, 1);
+					hfree(NULL, path);
+
+					dbg("ioglued: Failed to publish \"/lib/%s\"\n", entry);
+				}
+			}
+		}
+
+		entry = next;
+	}
+
+	// Wait until all modules are published
+	while(__ioglued_pendingLoads > 0)
+		sd_yield();
+}
+
 void ioglued()
 {
-	thread_setName(thread_getCurrentThread(), "ioglued", NULL);
+	__ioglued_thread = thread_getCurrentThread();
+	thread_setName(__ioglued_thread, "ioglued", NULL);
+
+	__ioglued_modulesToStop   = array_create();
+	__ioglued_modulesStopping = array_create();
+	__ioglued_retiredModules  = array_create();
 
-	__ioglued_modulesToStop = array_create();
 	spinlock_unlock(&__ioglued_lock);
 
 	if(sys_checkCommandline("--no-ioglue", NULL))
 	{
+		// Nothing will ever wake the thread up again
+		__ioglued_thread->blocks ++;
 		while(1)
 			sd_yield();
 	}
@@ -74,28 +277,10 @@ void ioglued()
 			temp += read;
 		}
 
-		temp = content;
-
-		while(temp)
-		{
-			char path[256];
-			char *start = temp;
-
-			temp = strpbrk(content, ",");
-			if(temp)
-				*temp = '\0';
-			
-			sprintf(path, "/lib/%s", start);
-
-			io_module_t *module = io_moduleWithName(path);
-			if(!module)
-				dbg("ioglued: Failed to publish \"%s\"\n", path);
-
-			temp = temp ? strstr(temp + 1, "lib") : temp;
-		}
+		vfs_close(fd);
 
+		__ioglued_loadModules(content);
 		hfree(NULL, content);
-		vfs_close(fd);
 	}
 	else
 	{
@@ -103,37 +288,41 @@ void ioglued()
 	}
 
 
-	while(1) 
+	if(sys_checkCommandline("--ioreport", NULL))
+		io_moduleReport();
+
+	while(1)
 	{
 		spinlock_lock(&__ioglued_lock);
-		if(array_count(__ioglued_modulesToStop) > 0)
+
+		if(array_count(__ioglued_modulesToStop) == 0 && array_count(__ioglued_retiredModules) == 0)
 		{
-			array_t *copy = array_copy(__ioglued_modulesToStop);
-			array_removeAllObjects(__ioglued_modulesToStop);
+			// Nothing to do, block until __ioglued_addReferencelessModule() has work for us
+			__ioglued_waiting = true;
+			__ioglued_thread->blocks ++;
 
 			spinlock_unlock(&__ioglued_lock);
+			sd_yield();
 
-			for(size_t i=0; i<array_count(copy); i++)
-			{
-				io_module_t *module = array_objectAtIndex(copy, i);
+			continue;
+		}
 
-				spinlock_lock(&module->lock);
-				if(!module->initialized)
-				{
-					__ioglued_addReferencelessModule(module);
-					spinlock_unlock(&module->lock);
-					continue;
-				}
-				
-				spinlock_unlock(&module->lock);
-				io_moduleStop(module);
-			}
+		// Swap the queues, new requests can come in while the modules are stopped
+		array_t *modules = __ioglued_modulesToStop;
 
-			array_destroy(copy);
-		}
-		else
-			spinlock_unlock(&__ioglued_lock);
+		__ioglued_modulesToStop   = __ioglued_modulesStopping;
+		__ioglued_modulesStopping = modules;
 
-		sd_yield();
+		spinlock_unlock(&__ioglued_lock);
+
+		__ioglued_stopModules(modules);
+		__ioglued_unloadRetiredModules();
+
+		// Modules still in their grace period are checked again later, sleeping instead of spinning
+		if(array_count(__ioglued_retiredModules) > 0)
+		{
+			thread_sleep(__ioglued_thread, kIOGluedGracePeriodPoll);
+			sd_yield();
+		}
 	}
 }
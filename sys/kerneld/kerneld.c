@@ -24,10 +24,13 @@
 #include <libc/string.h>
 #include <libc/stdio.h>
 #include <tests/unittests.h>
+#include <benchmarks/benchmarks.h>
 
 #include "syslogd.h"
 #include "ioglued.h"
 
+#define kKerneldZeroBatch 16 // Pages zeroed per pass through the idle loop
+
 extern void sd_disableScheduler();
 extern void syslogd_forceFlush();
 
@@ -38,6 +41,7 @@ extern void process_destroy(process_t *process);
 extern void thread_destroy(thread_t *thread);
 
 void kerneld_unitTests() __attribute__((noreturn));
+void kerneld_benchmarks() __attribute__((noreturn));
 
 void kerneld_main() __attribute__((noinline, noreturn));
 void kerneld_main()
@@ -50,7 +54,11 @@ void kerneld_main()
 	thread_create(self, ioglued, 4096, NULL, 0);
 	thread_create(self, kerneld_unitTests, 4096, NULL, 0);
 
-#if CONF_RUNKUNIT == 0
+#if CONF_RUNKBENCH
+	thread_create(self, kerneld_benchmarks, 4096, NULL, 0);
+#endif /* CONF_RUNKBENCH */
+
+#if CONF_RUNKUNIT == 0 && CONF_RUNKBENCH == 0
 	// Spawn a test process
 	process_createWithFile("/bin/linkd.bin", NULL);
 #endif /* CONF_RUNKUNIT */
@@ -79,7 +87,10 @@ void kerneld_main()
 		}
 
 		self->mainThread->wasNice = true;
-		__asm__ volatile("hlt;"); // Idle for the heck of it!
+
+		// Refill the pool of zeroed pages instead of idling, but only halt once there is nothing left to do
+		if(pm_zeroFreePages(kKerneldZeroBatch) == 0)
+			__asm__ volatile("hlt;"); // Idle for the heck of it!
 	}
 }
 
@@ -103,3 +114,12 @@ void kerneld_unitTests()
 
 	sd_threadExit();
 }
+
+// Benchmarks
+void kerneld_benchmarks()
+{
+	runBenchmarks();
+	info("Ran all benchmarks\n");
+
+	sd_threadExit();
+}
@@ -15,21 +15,68 @@
 //  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
 //  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
-
 #include <memory/memory.h>
 #include <container/ringbuffer.h>
 #include <scheduler/scheduler.h>
+#include <interrupts/interrupts.h>
 #include <system/lock.h>
 #include <system/panic.h>
 #include <system/video.h>
+#include <system/time.h>
 #include <libc/string.h>
+#include <libc/stdio.h>
 
 #include "syslogd.h"
 #include <system/syslog.h>
 
+/*
+ * Overview:
+ * syslog() doesn't format messages, it captures the format string and the raw arguments into a binary record
+ * and leaves the formatting to syslogd. String arguments are copied into the record, they may not outlive the call.
+ * The same goes for format strings outside of the kernel image, the module they belong to might be unloaded by then.
+ * The records are published into lock-free rings, one shared by all threads and one for interrupt handlers (which
+ * don't nest). Firedrake runs on a single CPU, so the rings are per execution context instead of per CPU and every
+ * record carries a sequence number that syslogd uses to merge them back into order.
+ * A record that doesn't fit into its ring is dropped and counted, producers never wait for syslogd.
+ */
+
+#define kSyslogdContextThread    0
+#define kSyslogdContextInterrupt 1
+#define kSyslogdContexts         2
+
+#define kSyslogdMaxArguments  16 // 32 bit words
+#define kSyslogdMaxRecordSize 512
+#define kSyslogdIdleTimeout   1000 // Milliseconds
+
+typedef struct
+{
+	uint16_t size; // Size including the arguments and inlined strings, always a multiple of 4
+	uint8_t level;
+	uint8_t context;
+	uint32_t sequence;
+	uint32_t tid;
+	timestamp_t timestamp;
+
+	const char *format;
+	uint32_t formatOffset; // Offset of the format string inside the record, 0 if format points into the kernel image
+	uint32_t argumentCount;
+	uint32_t strings; // Bitmask of the arguments that are offsets to strings inside the record
+
+	uint32_t arguments[];
+} syslogd_record_t;
+
 static spinlock_t syslogd_lock = SPINLOCK_INIT;
-static ringbuffer_t *syslogd_buffer = NULL;
 static bool syslogd_running = false;
+static thread_t *syslogd_thread = NULL;
+
+static ringbuffer_t *syslogd_rings[kSyslogdContexts];
+static size_t syslogd_ringSizes[kSyslogdContexts] = { 16384, 4096 };
+static uint32_t syslogd_drops[kSyslogdContexts];
+static uint32_t syslogd_sequence = 0;
+static int syslogd_dummy = 0; // Target for %n, there is nothing sensible to report when formatting later
+
+extern uintptr_t kernelBegin; // Marks the beginning of the kernel (set by the linker)
+extern uintptr_t kernelEnd;	// Marks the end of the kernel (also set by the linker)
 
 static syslog_level_t __syslog_level = LOG_WARNING;
 static vd_color_t __sylog_color_table[] = {
@@ -42,29 +89,236 @@ static vd_color_t __sylog_color_table[] = {
 };
 
 
-void syslogd_queueMessage(syslog_level_t level, const char *message)
+// Walks the format string the same way vsnprintf() does and pulls the arguments as 32 bit words
+static size_t syslogd_captureArguments(const char *format, va_list arguments, uint32_t *words, const char **strings, uint32_t *stringMask)
 {
-	if(level > __syslog_level)
+	size_t count = 0;
+
+	for(const char *c = format; *c != '\0'; c ++)
+	{
+		if(*c != '%')
+			continue;
+
+		c ++;
+
+		while(*c == '0' || *c == '-' || *c == '+')
+			c ++;
+
+		while(isdigit(*c))
+			c ++;
+
+		size_t length = 4;
+
+		if(*c == 'h')
+		{
+			c ++;
+
+			if(*c == 'h')
+				c ++;
+		}
+		else if(*c == 'l')
+		{
+			c ++;
+
+			if(*c == 'l')
+			{
+				length = 8;
+				c ++;
+			}
+		}
+
+		if(*c == '\0' || count + 2 > kSyslogdMaxArguments)
+			break;
+
+		switch(*c)
+		{
+			case 'i':
+			case 'd':
+			case 'x':
+			case 'X':
+			case 'u':
+				if(length == 8)
+				{
+					uint64_t value = va_arg(arguments, uint64_t);
+
+					words[count ++] = (uint32_t)value;
+					words[count ++] = (uint32_t)(value >> 32);
+					break;
+				}
+
+				words[count ++] = va_arg(arguments, uint32_t);
+				break;
+
+			case 'c':
+				words[count ++] = (uint32_t)va_arg(arguments, int);
+				break;
+
+			case 'p':
+				words[count ++] = (uint32_t)va_arg(arguments, void *);
+				break;
+
+			case 's':
+				strings[count] = va_arg(arguments, const char *);
+				*stringMask |= (1 << count);
+
+				words[count ++] = 0;
+				break;
+
+			case 'n':
+				va_arg(arguments, int *);
+				words[count ++] = (uint32_t)&syslogd_dummy;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	return count;
+}
+
+static void syslogd_wakeup()
+{
+	thread_t *thread = syslogd_thread;
+	if(!thread->sleeping)
 		return;
 
-	spinlock_lock(&syslogd_lock);
+	bool enabled = ir_interruptsEnabled();
+
+	if(enabled)
+		ir_disableInterrupts(false);
+
+	thread_wakeup(thread);
+
+	if(enabled)
+		ir_enableInterrupts(false);
+}
+
+void syslogd_queueMessage(syslog_level_t level, const char *format, va_list arguments)
+{
+	if(level > __syslog_level)
+		return;
 
 	if(!syslogd_running)
 	{
+		char buffer[kSyslogdMaxRecordSize];
+		vsnprintf(buffer, kSyslogdMaxRecordSize, format, arguments);
+
+		spinlock_lock(&syslogd_lock);
+
 		vd_setColor(__sylog_color_table[level], true);
-		vd_writeString(message);
+		vd_writeString(buffer);
 
 		spinlock_unlock(&syslogd_lock);
 		return;
 	}
 
-	size_t length = strlen(message);
-	uint8_t colorbuffer[2] = { 14, vd_translateColor(__sylog_color_table[level]) };
+	uint32_t words[kSyslogdMaxArguments];
+	const char *strings[kSyslogdMaxArguments];
+	size_t lengths[kSyslogdMaxArguments];
+	uint32_t stringMask = 0;
 
-	ringbuffer_write(syslogd_buffer, colorbuffer, 2);
-	ringbuffer_write(syslogd_buffer, (uint8_t *)message, length);
+	size_t count = syslogd_captureArguments(format, arguments, words, strings, &stringMask);
+	size_t size  = sizeof(syslogd_record_t) + count * sizeof(uint32_t);
 
-	spinlock_unlock(&syslogd_lock);
+	size_t formatOffset = 0;
+	size_t formatLength = 0;
+
+	if((uintptr_t)format < (uintptr_t)&kernelBegin || (uintptr_t)format >= (uintptr_t)&kernelEnd)
+	{
+		formatLength = strlen(format);
+		formatOffset = size;
+
+		if(formatLength > kSyslogdMaxRecordSize / 2)
+			formatLength = kSyslogdMaxRecordSize / 2;
+
+		size += formatLength + 1;
+	}
+
+	// Lay out the strings behind the arguments and truncate them if the record gets too large
+	for(size_t i=0; i<count; i++)
+	{
+		if(!(stringMask & (1 << i)))
+			continue;
+
+		if(size + 1 > kSyslogdMaxRecordSize)
+		{
+			// Not even the terminator fits anymore, the one of the string before doubles as an empty string
+			strings[i] = "";
+			lengths[i] = 0;
+			words[i]   = (uint32_t)(size - 1);
+
+			continue;
+		}
+
+		const char *string = strings[i] ? strings[i] : "(null)";
+		size_t length = strlen(string);
+		size_t left = kSyslogdMaxRecordSize - size - 1;
+
+		if(length > left)
+			length = left;
+
+		strings[i] = string;
+		lengths[i] = length;
+		words[i]   = (uint32_t)size;
+
+		size += length + 1;
+	}
+
+	size = (size + 3) & ~3;
+
+	// Publish the record
+	uint32_t context  = ir_isInsideInterruptHandler() ? kSyslogdContextInterrupt : kSyslogdContextThread;
+	ringbuffer_t *ring = syslogd_rings[context];
+
+	if(size > kSyslogdMaxRecordSize)
+	{
+		__sync_fetch_and_add(&syslogd_drops[context], 1);
+		return;
+	}
+	ringbuffer_range_t range;
+
+	if(!ringbuffer_reserve(ring, size, &range))
+	{
+		__sync_fetch_and_add(&syslogd_drops[context], 1);
+		return;
+	}
+
+	thread_t *thread = thread_getCurrentThread();
+	syslogd_record_t record;
+
+	record.size      = (uint16_t)size;
+	record.level     = (uint8_t)level;
+	record.context   = (uint8_t)context;
+	record.sequence  = __sync_fetch_and_add(&syslogd_sequence, 1);
+	record.tid       = thread ? thread->id : THREAD_NULL;
+	record.timestamp = time_getTimestamp();
+
+	record.format        = format;
+	record.formatOffset  = (uint32_t)formatOffset;
+	record.argumentCount = (uint32_t)count;
+	record.strings       = stringMask;
+
+	ringbuffer_rangeCopyIn(&range, 0, &record, sizeof(syslogd_record_t));
+	ringbuffer_rangeCopyIn(&range, sizeof(syslogd_record_t), words, count * sizeof(uint32_t));
+
+	if(formatOffset)
+	{
+		ringbuffer_rangeCopyIn(&range, formatOffset, format, formatLength);
+		ringbuffer_rangeCopyIn(&range, formatOffset + formatLength, "", 1);
+	}
+
+	for(size_t i=0; i<count; i++)
+	{
+		if(stringMask & (1 << i))
+		{
+			ringbuffer_rangeCopyIn(&range, words[i], strings[i], lengths[i]);
+			ringbuffer_rangeCopyIn(&range, words[i] + lengths[i], "", 1);
+		}
+	}
+
+	ringbuffer_commit(ring, &range);
+	syslogd_wakeup();
 }
 
 void syslogd_setLogLevel(syslog_level_t level)
@@ -74,16 +328,113 @@ void syslogd_setLogLevel(syslog_level_t level)
 
 
 
+// The words are pushed onto the stack just like the original call pushed the arguments, so vsnprintf()
+// reads them as if it was called by the logging code directly
+static void syslogd_format(char *buffer, size_t size, const char *format, ...)
+{
+	va_list arguments;
+	va_start(arguments, format);
+
+	vsnprintf(buffer, size, format, arguments);
+
+	va_end(arguments);
+}
+
+static void syslogd_printRecord(syslogd_record_t *record)
+{
+	uint32_t words[kSyslogdMaxArguments];
+	char message[kSyslogdMaxRecordSize];
+
+	memset(words, 0, kSyslogdMaxArguments * sizeof(uint32_t));
+
+	for(uint32_t i=0; i<record->argumentCount; i++)
+	{
+		uint32_t word = record->arguments[i];
+		words[i] = (record->strings & (1 << i)) ? (uint32_t)((uint8_t *)record + word) : word;
+	}
+
+	const char *format = record->formatOffset ? (const char *)record + record->formatOffset : record->format;
+
+	syslogd_format(message, kSyslogdMaxRecordSize, format,
+		words[0], words[1], words[2], words[3], words[4], words[5], words[6], words[7],
+		words[8], words[9], words[10], words[11], words[12], words[13], words[14], words[15]);
+
+	vd_setColor(__sylog_color_table[record->level], true);
+	vd_writeString(message);
+}
+
+static bool syslogd_hasPendingRecords()
+{
+	for(int i=0; i<kSyslogdContexts; i++)
+	{
+		if(ringbuffer_length(syslogd_rings[i]) > 0 || syslogd_drops[i] > 0)
+			return true;
+	}
+
+	return false;
+}
+
 void __syslogd_flush()
 {
-	while(ringbuffer_length(syslogd_buffer) > 0)
+	uint32_t buffer[kSyslogdMaxRecordSize / sizeof(uint32_t)];
+	syslogd_record_t *record = (syslogd_record_t *)buffer;
+
+	while(1)
 	{
-		char buffer[256];
-		size_t read = ringbuffer_read(syslogd_buffer, (uint8_t *)buffer, 255);
-		
-		buffer[read] = '\0';
+		// Print the oldest record of all rings first
+		ringbuffer_range_t ranges[kSyslogdContexts];
+		size_t available[kSyslogdContexts];
+		syslogd_record_t header;
+		int next = -1;
 
-		vd_writeString(buffer);
+		for(int i=0; i<kSyslogdContexts; i++)
+		{
+			available[i] = ringbuffer_peek(syslogd_rings[i], &ranges[i]);
+			if(available[i] == 0)
+				continue;
+
+			syslogd_record_t candidate;
+			ringbuffer_rangeCopyOut(&ranges[i], 0, &candidate, sizeof(syslogd_record_t));
+
+			if(next == -1 || (int32_t)(candidate.sequence - header.sequence) < 0)
+			{
+				header = candidate;
+				next = i;
+			}
+		}
+
+		if(next == -1)
+			break;
+
+		// Records are never larger than the buffer. If one claims to be, the ring can't be trusted
+		// anymore and everything published so far is dropped instead of overflowing the stack
+		if(header.size < sizeof(syslogd_record_t) || header.size > sizeof(buffer) || header.size > available[next])
+		{
+			ringbuffer_consume(syslogd_rings[next], available[next]);
+			__sync_fetch_and_add(&syslogd_drops[next], 1);
+
+			continue;
+		}
+
+		ringbuffer_rangeCopyOut(&ranges[next], 0, record, header.size);
+		ringbuffer_consume(syslogd_rings[next], header.size);
+
+		syslogd_printRecord(record);
+	}
+
+	for(int i=0; i<kSyslogdContexts; i++)
+	{
+		uint32_t drops = syslogd_drops[i];
+		if(drops > 0)
+		{
+			char message[64];
+			snprintf(message, 64, "syslogd: dropped %u messages\n", drops);
+
+			vd_setColor(__sylog_color_table[LOG_WARNING], true);
+			vd_writeString(message);
+
+			__sync_fetch_and_sub(&syslogd_drops[i], drops);
+		}
 	}
 }
 
@@ -113,19 +464,39 @@ void syslogd_forceFlush()
 
 void syslogd()
 {
-	thread_setName(thread_getCurrentThread(), "syslogd", NULL);
+	thread_t *self = thread_getCurrentThread();
+	thread_setName(self, "syslogd", NULL);
 
-	syslogd_buffer = ringbuffer_create(80 * 25);
-	if(!syslogd_buffer)
-		panic("Couldn't allocate buffer for syslogd!");
+	for(int i=0; i<kSyslogdContexts; i++)
+	{
+		uint32_t flags = (i == kSyslogdContextThread) ? kRingbufferFlagMultiProducer : 0;
+
+		syslogd_rings[i] = ringbuffer_create(syslogd_ringSizes[i], flags);
+		syslogd_drops[i] = 0;
+
+		if(!syslogd_rings[i])
+			panic("Couldn't allocate buffer for syslogd!");
+	}
 
 	spinlock_lock(&syslogd_lock);
+	syslogd_thread  = self;
 	syslogd_running = true;
 	spinlock_unlock(&syslogd_lock);
 
 	while(1)
 	{
 		syslogd_flush();
+
+		// Producers wake us up once they published a record. The rings are checked again with
+		// interrupts disabled, so a record committed in between is either seen here or sees the sleeping flag
+		ir_disableInterrupts(false);
+
+		thread_sleep(self, kSyslogdIdleTimeout);
+
+		if(syslogd_hasPendingRecords())
+			thread_wakeup(self);
+
+		ir_enableInterrupts(false);
 		sd_yield();
 	}
 }
@@ -22,7 +22,7 @@
 #include <prefix.h>
 #include <system/syslog.h>
 
-void syslogd_queueMessage(syslog_level_t level, const char *message);
+void syslogd_queueMessage(syslog_level_t level, const char *format, va_list arguments);
 void syslogd_setLogLevel(syslog_level_t level);
 
 void syslogd_flush();
@@ -18,35 +18,6 @@
 
 #include "string.h"
 
-void *memset(void *dst, int c, size_t size)
-{
-	if(size)
-	{
-		unsigned char *d = (unsigned char *)dst;
-
-		do {
-			*d++ = (unsigned char)c;
-		} while(--size != 0);
-	}
-
-	return dst;
-}
-
-void *memcpy(void *dst, const void *src, size_t size)
-{
-	if(size)
-	{
-		unsigned char *d = (unsigned char *)dst;
-		unsigned char *s = (unsigned char *)src;
-
-		do {
-			*d++ = *s++;
-		} while(--size != 0);
-	}
-
-	return dst;
-}
-
 char *strcpy(char *dst, const char *src)
 {
 	char *d = dst;
@@ -94,15 +65,6 @@ size_t strlcpy(char *dst, const char *src, size_t size)
 	return (s - src) - 1; // Return the count of copied bytes, not including the NULL termination
 }
 
-size_t strlen(const char *string)
-{
-	const char *s = string;
-	for(; *s != '\0'; s++)
-	{}
-
-	return s - string;
-}
-
 int strcmp(const char *str1, const char *str2)
 {
 	if(!str1)
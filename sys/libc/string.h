@@ -30,6 +30,7 @@
 
 void *memset(void *dst, int c, size_t size);
 void *memcpy(void *dst, const void *src, size_t size);
+void *memmove(void *dst, const void *src, size_t size);
 
 char *strcpy(char *dst, const char *src);
 size_t strlcpy(char *dst, const char *src, size_t size); // Similar to strncpy, but appends the NULL byte always!
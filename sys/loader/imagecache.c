@@ -0,0 +1,262 @@
+//
+//  imagecache.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <container/list.h>
+#include <scheduler/scheduler.h>
+#include <system/syslog.h>
+#include <libc/string.h>
+#include <vfs/vfs.h>
+#include <vfs/filesystem.h>
+#include <errno.h>
+#include "imagecache.h"
+
+static list_t *__ld_imageCache = NULL;
+static spinlock_t __ld_imageCacheLock = SPINLOCK_INIT;
+static size_t __ld_imageCacheUnused = 0;
+
+static void __ld_imageFileFreeFrames(ld_image_file_t *entry, size_t pages)
+{
+	for(size_t i=0; i<pages; i++)
+		pm_free(entry->frames[i], 1);
+
+	hfree(NULL, entry->frames);
+	entry->frames = NULL;
+}
+
+static bool __ld_imageFileAllocateFrames(ld_image_file_t *entry)
+{
+	entry->frames = halloc(NULL, entry->pages * sizeof(uintptr_t));
+	if(!entry->frames)
+		return false;
+
+	for(size_t i=0; i<entry->pages; i++)
+	{
+		entry->frames[i] = pm_alloc(1);
+		if(!entry->frames[i])
+		{
+			__ld_imageFileFreeFrames(entry, i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ld_imageFileMapPages(ld_image_file_t *file, vm_page_directory_t pdirectory, size_t page, vm_address_t vaddress, size_t pages, uint32_t vmflags)
+{
+	for(size_t i=0; i<pages && page + i < file->pages; i++)
+		vm_mapPage(pdirectory, file->frames[page + i], vaddress + (i * VM_PAGE_SIZE), vmflags);
+}
+
+vm_address_t ld_imageFileMapKernel(ld_image_file_t *file, size_t page, size_t pages)
+{
+	if(page + pages > file->pages)
+		return 0x0;
+
+	vm_address_t vaddress = vm_alloc(vm_getKernelDirectory(), file->frames[page], pages, VM_FLAGS_KERNEL);
+	if(vaddress)
+		ld_imageFileMapPages(file, vm_getKernelDirectory(), page, vaddress, pages, VM_FLAGS_KERNEL);
+
+	return vaddress;
+}
+
+static bool __ld_imageFileRead(ld_image_file_t *entry, vfs_file_t *file, int *errno)
+{
+	vfs_instance_t *instance = file->node->instance;
+	vfs_context_t *context = vfs_getCurrentContext();
+
+	uint8_t *buffer = (uint8_t *)ld_imageFileMapKernel(entry, 0, entry->pages);
+	if(!buffer)
+	{
+		*errno = ENOMEM;
+		return false;
+	}
+
+	// Read the whole file without disturbing the offset of the descriptor
+	off_t offset = instance->callbacks.fileSeek(instance, context, file, 0, SEEK_CUR, errno);
+	instance->callbacks.fileSeek(instance, context, file, 0, SEEK_SET, errno);
+
+	size_t left = entry->size;
+	uint8_t *temp = buffer;
+
+	while(left > 0)
+	{
+		size_t read = instance->callbacks.fileRead(instance, context, file, temp, left, errno);
+		if(read == 0 || read == (size_t)-1)
+			break;
+
+		left -= read;
+		temp += read;
+	}
+
+	memset(buffer + entry->size, 0, (entry->pages * VM_PAGE_SIZE) - entry->size);
+
+	instance->callbacks.fileSeek(instance, context, file, offset, SEEK_SET, errno);
+	vm_free(vm_getKernelDirectory(), (vm_address_t)buffer, entry->pages);
+
+	if(left > 0)
+	{
+		*errno = EIO;
+		return false;
+	}
+
+	return true;
+}
+
+static void __ld_imageCacheEvict()
+{
+	while(__ld_imageCacheUnused > kLDImageCacheUnusedLimit)
+	{
+		ld_image_file_t *entry;
+		list_foreach(__ld_imageCache, entry)
+		{
+			if(entry->references == 0)
+				break;
+		}
+
+		if(!entry)
+			break;
+
+		__ld_imageFileFreeFrames(entry, entry->pages);
+		list_remove(__ld_imageCache, entry);
+
+		__ld_imageCacheUnused --;
+	}
+}
+
+ld_image_file_t *ld_imageFileWithDescriptor(int fd, int *errno)
+{
+	process_t *process = process_getCurrentProcess();
+	vfs_file_t *file = process_fileWithFiledescriptor(process, fd);
+
+	if(!file)
+	{
+		*errno = EBADF;
+		return NULL;
+	}
+
+	if(file->node->type != vfs_nodeTypeFile || file->node->size == 0)
+	{
+		vfs_fileRelease(file);
+
+		*errno = EACCES;
+		return NULL;
+	}
+
+	vfs_node_t *node = file->node;
+	ld_image_file_t *entry;
+
+	spinlock_lock(&__ld_imageCacheLock);
+
+	if(!__ld_imageCache)
+	{
+		__ld_imageCache = list_create(sizeof(ld_image_file_t), offsetof(ld_image_file_t, next), offsetof(ld_image_file_t, prev));
+		if(!__ld_imageCache)
+		{
+			spinlock_unlock(&__ld_imageCacheLock);
+			vfs_fileRelease(file);
+
+			*errno = ENOMEM;
+			return NULL;
+		}
+	}
+
+	list_foreach(__ld_imageCache, entry)
+	{
+		if(entry->instance == node->instance && entry->id == node->id && entry->size == node->size && entry->version == node->version)
+		{
+			if((entry->references ++) == 0)
+				__ld_imageCacheUnused --;
+
+			spinlock_unlock(&__ld_imageCacheLock);
+			vfs_fileRelease(file);
+
+			return entry;
+		}
+	}
+
+	// Not cached yet, the entry is inserted once it's fully read
+	entry = halloc(NULL, sizeof(ld_image_file_t));
+	if(!entry)
+	{
+		spinlock_unlock(&__ld_imageCacheLock);
+		vfs_fileRelease(file);
+
+		*errno = ENOMEM;
+		return NULL;
+	}
+
+	memset(entry, 0, sizeof(ld_image_file_t));
+
+	entry->instance   = node->instance;
+	entry->id         = node->id;
+	entry->size       = node->size;
+	entry->version    = node->version;
+	entry->pages      = VM_PAGE_COUNT(node->size);
+	entry->references = 1;
+
+	bool allocated = __ld_imageFileAllocateFrames(entry);
+
+	if(!allocated || !__ld_imageFileRead(entry, file, errno))
+	{
+		if(allocated)
+		{
+			__ld_imageFileFreeFrames(entry, entry->pages);
+		}
+		else
+		{
+			*errno = ENOMEM;
+		}
+
+		spinlock_unlock(&__ld_imageCacheLock);
+		vfs_fileRelease(file);
+		hfree(NULL, entry);
+
+		return NULL;
+	}
+
+	list_insertBack(__ld_imageCache, entry);
+
+	spinlock_unlock(&__ld_imageCacheLock);
+	vfs_fileRelease(file);
+
+	return entry;
+}
+
+void ld_imageFileRetain(ld_image_file_t *file)
+{
+	spinlock_lock(&__ld_imageCacheLock);
+	file->references ++;
+	spinlock_unlock(&__ld_imageCacheLock);
+}
+
+void ld_imageFileRelease(ld_image_file_t *file)
+{
+	spinlock_lock(&__ld_imageCacheLock);
+
+	if((-- file->references) == 0)
+	{
+		// Move the entry to the back, so the least recently used one gets evicted first
+		list_removeSoft(__ld_imageCache, file);
+		list_insertBack(__ld_imageCache, file);
+
+		__ld_imageCacheUnused ++;
+		__ld_imageCacheEvict();
+	}
+
+	spinlock_unlock(&__ld_imageCacheLock);
+}
@@ -0,0 +1,66 @@
+//
+//  imagecache.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _IMAGECACHE_H_
+#define _IMAGECACHE_H_
+
+#include <prefix.h>
+#include <memory/memory.h>
+
+/**
+ * Overview:
+ * The image cache keeps the contents of executables and shared libraries in physical memory, so that
+ * the read-only segments of a binary can be mapped into every address space from the same frames.
+ * Entries are keyed by the file system instance, the node id, the size and the content version of
+ * the file. Every write and truncation bumps the version, a modified file therefore gets a new entry. Files are kept page aligned and zero padded,
+ * every page in a frame of its own, so big binaries don't depend on contiguous physical memory.
+ * Entries without references are kept around for the next process until there are more than
+ * kLDImageCacheUnusedLimit of them, the oldest one is evicted first.
+ **/
+
+#define kLDImageCacheUnusedLimit 8
+
+struct vfs_instance_s;
+
+typedef struct ld_image_file_s
+{
+	struct vfs_instance_s *instance;
+	uint32_t id;
+	size_t size;
+	uint32_t version;
+
+	uintptr_t *frames; // One frame per page
+	size_t pages;
+
+	uint32_t references;
+
+	struct ld_image_file_s *next;
+	struct ld_image_file_s *prev;
+} ld_image_file_t;
+
+ld_image_file_t *ld_imageFileWithDescriptor(int fd, int *errno);
+
+void ld_imageFileRetain(ld_image_file_t *file);
+void ld_imageFileRelease(ld_image_file_t *file);
+
+// Maps pages of the file, starting at page, into the directory. Frames past the end of the file are left alone
+void ld_imageFileMapPages(ld_image_file_t *file, vm_page_directory_t pdirectory, size_t page, vm_address_t vaddress, size_t pages, uint32_t vmflags);
+
+// Maps pages of the file into a contiguous window of the kernel, release it with vm_free()
+vm_address_t ld_imageFileMapKernel(ld_image_file_t *file, size_t page, size_t pages);
+
+#endif /* _IMAGECACHE_H_ */
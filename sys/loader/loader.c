@@ -16,80 +16,178 @@
 //  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 
+#include <libc/math.h>
 #include <libc/string.h>
 #include <bootstrap/multiboot.h>
 #include <system/elf.h>
 #include <system/helper.h>
 #include <system/syslog.h>
 #include <vfs/vfs.h>
+#include "imagecache.h"
 #include "loader.h"
 
-ld_exectuable_t *ld_exectuableCreate(vm_page_directory_t pdirectory, uint8_t *begin, __unused size_t size)
+// Returns the frame mapped at page, allocating a new one if there is none yet
+// Pages shared by two segments end up with the union of their flags
+uintptr_t __ld_executableMapPrivatePage(vm_page_directory_t pdirectory, vm_address_t page, uint32_t vmflags, bool zeroed)
 {
-	elf_header_t *header = (elf_header_t *)begin;
+	uintptr_t frame = vm_resolveVirtualAddress(pdirectory, page);
+	if(frame)
+	{
+		if(vmflags & VM_PAGETABLEFLAG_WRITEABLE)
+			vm_mapPage(pdirectory, frame, page, vmflags);
+
+		return frame;
+	}
+
+	frame = zeroed ? pm_allocZeroed(1) : pm_alloc(1);
+	if(frame)
+		vm_mapPage(pdirectory, frame, page, vmflags);
+
+	return frame;
+}
+
+void __ld_executableCopyToFrame(uintptr_t frame, size_t offset, const uint8_t *data, size_t length)
+{
+	uint8_t *mapped = (uint8_t *)vm_alloc(vm_getKernelDirectory(), frame, 1, VM_FLAGS_KERNEL);
+	memcpy(mapped + offset, data, length);
+	vm_free(vm_getKernelDirectory(), (vm_address_t)mapped, 1);
+}
+
+bool __ld_executableMapSegment(ld_exectuable_t *executable, elf_program_header_t *program, elf_program_header_t *next, uint8_t *image)
+{
+	ld_segment_t *segment = &executable->segments[executable->segmentCount];
+
+	vm_address_t start = VM_PAGE_ALIGN_DOWN(program->p_vaddr);
+	vm_address_t end   = VM_PAGE_ALIGN_UP(program->p_vaddr + program->p_memsz);
+
+	segment->vaddress = start;
+	segment->pages    = VM_PAGE_COUNT(end - start);
+	segment->vmflags  = (program->p_flags & PF_W) ? VM_FLAGS_USERLAND : VM_FLAGS_USERLAND_R;
+	segment->shared   = false;
+	segment->filePage = 0;
+
+	executable->segmentCount ++;
+
+	// Read-only segments with pages of their own can use the frames of the image cache
+	bool aligned  = (program->p_vaddr % VM_PAGE_SIZE) == (program->p_offset % VM_PAGE_SIZE);
+	bool separate = (!next || VM_PAGE_ALIGN_DOWN(next->p_vaddr) >= end);
+
+	if(aligned && separate && !(program->p_flags & PF_W) && program->p_filesz == program->p_memsz && vm_resolveVirtualAddress(executable->pdirectory, start) == 0x0)
+	{
+		segment->shared   = true;
+		segment->filePage = program->p_offset / VM_PAGE_SIZE;
+
+		ld_imageFileMapPages(executable->file, executable->pdirectory, segment->filePage, start, segment->pages, segment->vmflags);
+		return true;
+	}
+
+	// Private pages that hold file data are populated right away, the rest is left to ld_executableHandleFault()
+	vm_address_t fileStart = program->p_vaddr;
+	vm_address_t fileEnd   = program->p_vaddr + program->p_filesz;
+
+	for(vm_address_t page = start; page < VM_PAGE_ALIGN_UP(fileEnd); page += VM_PAGE_SIZE)
+	{
+		vm_address_t lower = MAX(page, fileStart);
+		vm_address_t upper = MIN(page + VM_PAGE_SIZE, fileEnd);
+
+		bool zeroed = (lower != page || upper != page + VM_PAGE_SIZE);
+		uintptr_t frame = __ld_executableMapPrivatePage(executable->pdirectory, page, segment->vmflags, zeroed);
 
-	if(strncmp((const char *)header->e_ident, ELF_MAGIC, strlen(ELF_MAGIC)) != 0)
+		if(!frame)
+			return false;
+
+		__ld_executableCopyToFrame(frame, lower - page, &image[program->p_offset + (lower - fileStart)], upper - lower);
+	}
+
+	return true;
+}
+
+ld_exectuable_t *__ld_executableCreate(vm_page_directory_t pdirectory, ld_image_file_t *file)
+{
+	uint8_t *image = (uint8_t *)ld_imageFileMapKernel(file, 0, file->pages);
+	if(!image)
 		return NULL;
 
+	elf_header_t *header = (elf_header_t *)image;
+	elf_program_header_t *programHeader = (elf_program_header_t *)(image + header->e_phoff);
+
+	if(file->size < sizeof(elf_header_t) || strncmp((const char *)header->e_ident, ELF_MAGIC, strlen(ELF_MAGIC)) != 0 || header->e_phoff + header->e_phnum * sizeof(elf_program_header_t) > file->size)
+	{
+		vm_free(vm_getKernelDirectory(), (vm_address_t)image, file->pages);
+		return NULL;
+	}
+
 	ld_exectuable_t *executable = halloc(NULL, sizeof(ld_exectuable_t));
 	if(executable)
 	{
 		// Initialize the executable
-		executable->useCount   = 1;
-		executable->entry      = header->e_entry;
-		executable->pdirectory = pdirectory;
+		executable->useCount     = 1;
+		executable->entry        = header->e_entry;
+		executable->pdirectory   = pdirectory;
+		executable->file         = file;
+		executable->segmentCount = 0;
 
-		elf_program_header_t *programHeader = (elf_program_header_t *)(begin + header->e_phoff);
-		vm_address_t minAddress = -1;
-		vm_address_t maxAddress = 0;
+		executable->tlsImage     = NULL;
+		executable->tlsImageSize = 0;
+		executable->tlsSize      = 0;
+		executable->tlsAlignment = 1;
 
-		size_t pages = 0;
+		bool result = true;
 
-		// Calculate the needed size
-		for(int i=0; i<header->e_phnum; i++) 
+		for(int i=0; i<header->e_phnum && result; i++) 
 		{
 			elf_program_header_t *program = &programHeader[i];
 
 			if(program->p_type == PT_LOAD)
 			{
-				if(program->p_paddr < minAddress)
-					minAddress = program->p_paddr;
-
-				if(program->p_paddr + program->p_memsz > maxAddress)
-					maxAddress = program->p_paddr + program->p_memsz;
+				if(executable->segmentCount == kLDMaxSegments || program->p_offset + program->p_filesz > file->size)
+				{
+					result = false;
+					break;
+				}
+
+				elf_program_header_t *next = NULL;
+				for(int j=i+1; j<header->e_phnum; j++)
+				{
+					if(programHeader[j].p_type == PT_LOAD)
+					{
+						next = &programHeader[j];
+						break;
+					}
+				}
+
+				result = __ld_executableMapSegment(executable, program, next, image);
 			}
-		}
-
-		// Calculate the starting address and the number of pages we need to allocate
-		minAddress = VM_PAGE_ALIGN_DOWN(minAddress);
-		pages = VM_PAGE_COUNT(maxAddress - minAddress);
 
-		// Memory allocation
-		uint8_t *memory = (uint8_t *)pm_alloc(pages);
-		uint8_t *target = (uint8_t *)vm_alloc(vm_getKernelDirectory(), (uintptr_t)memory, pages, VM_FLAGS_KERNEL);
-		uint8_t *source = begin;
-
-		memset(target, 0, pages * VM_PAGE_SIZE);
-
-		// Copy the data from the image
-		for(int i=0; i<header->e_phnum; i++) 
-		{
-			elf_program_header_t *program = &programHeader[i];
-
-			if(program->p_type == PT_LOAD)
+			if(program->p_type == PT_TLS && program->p_offset + program->p_filesz <= file->size)
 			{
-				memcpy(&target[program->p_vaddr - minAddress], &source[program->p_offset], program->p_filesz);
+				uint8_t *tlsImage = NULL;
+				if(program->p_filesz > 0)
+				{
+					tlsImage = halloc(NULL, program->p_filesz);
+					if(tlsImage)
+						memcpy(tlsImage, &image[program->p_offset], program->p_filesz);
+				}
+
+				if(program->p_filesz == 0 || tlsImage)
+				{
+					if(!ld_exectuableSetTLSTemplate(executable, tlsImage, program->p_filesz, program->p_memsz, program->p_align))
+						hfree(NULL, tlsImage);
+				}
 			}
 		}
 
-		vm_free(vm_getKernelDirectory(), (vm_address_t)target, pages);
-		vm_mapPageRange(pdirectory, (uintptr_t)memory, minAddress, pages, VM_FLAGS_USERLAND);
+		if(!result)
+		{
+			// The reference to the file is the callers
+			executable->file = NULL;
+			ld_executableRelease(executable);
 
-		executable->pimage = (uintptr_t)memory;
-		executable->vimage = (vm_address_t)minAddress;
-		executable->imagePages = pages;
+			executable = NULL;
+		}
 	}
 
+	vm_free(vm_getKernelDirectory(), (vm_address_t)image, file->pages);
 	return executable;
 }
 
@@ -99,27 +197,16 @@ ld_exectuable_t *ld_executableCreateWithFile(vm_page_directory_t pdirectory, con
 	int fd = vfs_open(file, O_RDONLY, &error);
 	if(fd >= 0)
 	{
-		size_t size = vfs_seek(fd, 0, SEEK_END, &error);
-		size_t pages = VM_PAGE_COUNT(size);
-		uint8_t *buffer = mm_alloc(vm_getKernelDirectory(), pages, VM_FLAGS_KERNEL);
-
-		vfs_seek(fd, 0, SEEK_SET, &error);
-		
-		size_t left = size;
-		uint8_t *temp = buffer;
-
-		while(left > 0)
-		{
-			size_t read = vfs_read(fd, temp, left, &error);
+		// The cache has the file in memory already if the executable was started before
+		ld_image_file_t *image = ld_imageFileWithDescriptor(fd, &error);
+		vfs_close(fd);
 
-			left -= read;
-			temp += read;
-		}
+		if(!image)
+			return NULL;
 
-		ld_exectuable_t *executable = ld_exectuableCreate(pdirectory, buffer, size);
-		
-		mm_free(buffer, vm_getKernelDirectory(), pages);
-		vfs_close(fd);
+		ld_exectuable_t *executable = __ld_executableCreate(pdirectory, image);
+		if(!executable)
+			ld_imageFileRelease(image);
 
 		return executable;
 	}
@@ -135,18 +222,67 @@ ld_exectuable_t *ld_exectuableCopy(vm_page_directory_t pdirectory, ld_exectuable
 	ld_exectuable_t *executable = halloc(NULL, sizeof(ld_exectuable_t));
 	if(executable)
 	{
-		source->useCount ++;
+		executable->pdirectory   = pdirectory;
+		executable->useCount     = 1;
+		executable->entry        = source->entry;
+		executable->file         = source->file;
+		executable->segmentCount = 0;
+
+		executable->tlsImage     = NULL;
+		executable->tlsImageSize = 0;
+		executable->tlsSize      = source->tlsSize;
+		executable->tlsAlignment = source->tlsAlignment;
+
+		if(source->tlsImage)
+		{
+			executable->tlsImage = halloc(NULL, source->tlsImageSize);
+			if(!executable->tlsImage)
+			{
+				hfree(NULL, executable);
+				return NULL;
+			}
 
-		executable->pdirectory = pdirectory;
-		executable->useCount   = 1;
-		executable->entry      = source->entry;
+			memcpy(executable->tlsImage, source->tlsImage, source->tlsImageSize);
+			executable->tlsImageSize = source->tlsImageSize;
+		}
+
+		if(executable->file)
+			ld_imageFileRetain(executable->file);
 
-		executable->source = source;
-		executable->pimage = source->pimage;
-		executable->vimage = source->vimage;
-		executable->imagePages = source->imagePages;
+		// Shared segments are mapped as they are, private pages get copied unless they were never touched
+		for(size_t i=0; i<source->segmentCount; i++)
+		{
+			ld_segment_t *segment = &source->segments[i];
 
-		vm_mapPageRange(pdirectory, executable->pimage, executable->vimage, executable->imagePages, VM_FLAGS_USERLAND_R);
+			executable->segments[i] = *segment;
+			executable->segmentCount ++;
+
+			if(segment->shared)
+			{
+				ld_imageFileMapPages(executable->file, pdirectory, segment->filePage, segment->vaddress, segment->pages, segment->vmflags);
+				continue;
+			}
+
+			for(size_t j=0; j<segment->pages; j++)
+			{
+				vm_address_t page = segment->vaddress + (j * VM_PAGE_SIZE);
+				uintptr_t sourceFrame = vm_resolveVirtualAddress(source->pdirectory, page);
+
+				if(!sourceFrame)
+					continue;
+
+				uintptr_t frame = __ld_executableMapPrivatePage(pdirectory, page, segment->vmflags, false);
+				if(!frame)
+				{
+					ld_executableRelease(executable);
+					return NULL;
+				}
+
+				uint8_t *mapped = (uint8_t *)vm_alloc(vm_getKernelDirectory(), sourceFrame, 1, VM_FLAGS_KERNEL);
+				__ld_executableCopyToFrame(frame, 0, mapped, VM_PAGE_SIZE);
+				vm_free(vm_getKernelDirectory(), (vm_address_t)mapped, 1);
+			}
+		}
 	}
 
 	return executable;
@@ -158,15 +294,81 @@ void ld_executableRelease(ld_exectuable_t *executable)
 
 	if(executable->useCount == 0)
 	{
-		if(executable->source)
-			ld_executableRelease(executable->source);
+		for(size_t i=0; i<executable->segmentCount; i++)
+		{
+			ld_segment_t *segment = &executable->segments[i];
 
-		if(executable->pimage)
-			pm_free(executable->pimage, executable->imagePages);
+			if(segment->shared)
+			{
+				vm_free(executable->pdirectory, segment->vaddress, segment->pages);
+				continue;
+			}
 
-		if(executable->vimage)
-			vm_free(executable->pdirectory, executable->vimage, executable->imagePages);
+			// Unmapping every page as it's freed takes care of pages shared by two segments
+			for(size_t j=0; j<segment->pages; j++)
+			{
+				vm_address_t page = segment->vaddress + (j * VM_PAGE_SIZE);
+				uintptr_t frame = vm_resolveVirtualAddress(executable->pdirectory, page);
+
+				if(frame)
+				{
+					pm_free(frame, 1);
+					vm_free(executable->pdirectory, page, 1);
+				}
+			}
+		}
+
+		if(executable->file)
+			ld_imageFileRelease(executable->file);
+
+		if(executable->tlsImage)
+			hfree(NULL, executable->tlsImage);
 
 		hfree(NULL, executable);
 	}
 }
+
+bool ld_executableHandleFault(ld_exectuable_t *executable, vm_address_t address)
+{
+	vm_address_t page = VM_PAGE_ALIGN_DOWN(address);
+
+	for(size_t i=0; i<executable->segmentCount; i++)
+	{
+		ld_segment_t *segment = &executable->segments[i];
+
+		if(segment->shared || page < segment->vaddress || page >= segment->vaddress + (segment->pages * VM_PAGE_SIZE))
+			continue;
+
+		// A present page means the fault was a genuine protection violation
+		if(vm_resolveVirtualAddress(executable->pdirectory, page))
+			return false;
+
+		uintptr_t frame = pm_allocZeroed(1);
+		if(!frame)
+			return false;
+
+		vm_mapPage(executable->pdirectory, frame, page, segment->vmflags);
+		return true;
+	}
+
+	return false;
+}
+
+bool ld_exectuableSetTLSTemplate(ld_exectuable_t *executable, uint8_t *image, size_t imageSize, size_t size, size_t alignment)
+{
+	alignment = MAX(alignment, 1);
+
+	if(imageSize > size || size > kLDMaxTLSSize || alignment > VM_PAGE_SIZE || (alignment & (alignment - 1)) != 0)
+		return false;
+
+	if(executable->tlsImage)
+		hfree(NULL, executable->tlsImage);
+
+	// Takes over the image, which must be allocated with halloc()
+	executable->tlsImage     = image;
+	executable->tlsImageSize = imageSize;
+	executable->tlsSize      = size;
+	executable->tlsAlignment = alignment;
+
+	return true;
+}
@@ -22,25 +22,54 @@
 #include <prefix.h>
 #include <memory/memory.h>
 
+#define kLDMaxTLSSize (4 * VM_PAGE_SIZE) // Upper bound for the static TLS block of a process
+#define kLDMaxSegments 8
+
+/**
+ * Overview:
+ * Executables are mapped segment by segment from the image cache, see imagecache.h. Read-only PT_LOAD
+ * segments that don't share a page with another segment map the frames of the cache directly, every
+ * other segment gets private frames which are allocated page by page, so the image has no physically
+ * contiguous requirement. Private pages past the file data of a segment (ie. .bss) aren't backed at all
+ * until they are touched, ld_executableHandleFault() fills them in with zeroed frames.
+ **/
+
+typedef struct
+{
+	vm_address_t vaddress;
+	size_t pages;
+	uint32_t vmflags;
+
+	bool shared;
+	size_t filePage; // First page of the image cache file, only valid for shared segments
+} ld_segment_t;
+
 typedef struct ld_exectuable_s
 {
 	vm_page_directory_t pdirectory;
-	struct ld_exectuable_s *source;
-
 	vm_address_t entry; // The main entry point into the executable
 
-	// Location and size of the image
-	uintptr_t    	pimage;
-	vm_address_t 	vimage;
-	size_t 			imagePages;
+	struct ld_image_file_s *file;
+
+	ld_segment_t segments[kLDMaxSegments];
+	size_t segmentCount;
+
+	// Static TLS template, copied below the thread pointer of every thread in the process
+	// Comes from the PT_TLS segment of the executable or is handed over by linkd via SYS_TLS_TEMPLATE
+	uint8_t *tlsImage; // The initialized part, the rest of the block is zero filled
+	size_t   tlsImageSize;
+	size_t   tlsSize;
+	size_t   tlsAlignment;
 
 	uint32_t useCount;
 } ld_exectuable_t;
 
-ld_exectuable_t *ld_exectuableCreate(vm_page_directory_t pdirectory,  uint8_t *begin, size_t size);
 ld_exectuable_t *ld_executableCreateWithFile(vm_page_directory_t pdirectory, const char *file);
 ld_exectuable_t *ld_exectuableCopy(vm_page_directory_t pdirectory, ld_exectuable_t *source);
 
 void ld_executableRelease(ld_exectuable_t *executable);
 
+bool ld_executableHandleFault(ld_exectuable_t *executable, vm_address_t address);
+bool ld_exectuableSetTLSTemplate(ld_exectuable_t *executable, uint8_t *image, size_t imageSize, size_t size, size_t alignment);
+
 #endif /* _LOADER_H_ */
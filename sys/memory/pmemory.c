@@ -40,11 +40,34 @@ extern uintptr_t stack_top;
 static uint32_t __pm_heap[PM_HEAPSIZE];
 static spinlock_t __pm_spinlock = SPINLOCK_INIT;
 
+// Free pages that are known to contain only zeroes, always a subset of __pm_heap
+static uint32_t __pm_zeroed[PM_HEAPSIZE];
+static size_t __pm_zeroedPages = 0;
+static uintptr_t __pm_zeroCursor = 0; // Where the next search for dirty pages starts
+
+static uint64_t __pm_zeroedHits   = 0;
+static uint64_t __pm_zeroedMisses = 0;
+
+typedef enum
+{
+	pm_search_any,
+	pm_search_zeroed,
+	pm_search_dirty
+} pm_search_t;
+
 // Marks the given page as used in the heap bitmap
 static inline void __pm_markUsed(uintptr_t page)
 {
 	uint32_t index = page / PM_PAGE_SIZE;
-	__pm_heap[index / 32] &= ~(1 << (index & 31));
+	uint32_t bit = (1u << (index & 31));
+
+	if(__pm_zeroed[index / 32] & bit)
+	{
+		__pm_zeroed[index / 32] &= ~bit;
+		__pm_zeroedPages --;
+	}
+
+	__pm_heap[index / 32] &= ~bit;
 }
 
 // Marks the given page as unused in the heap bitmap
@@ -54,22 +77,53 @@ static inline void __pm_markFree(uintptr_t page)
 	__pm_heap[index / 32] |= (1 << (index & 31));
 }
 
+static inline void __pm_markZeroed(uintptr_t page)
+{
+	uint32_t index = page / PM_PAGE_SIZE;
+
+	__pm_zeroed[index / 32] |= (1u << (index & 31));
+	__pm_zeroedPages ++;
+}
+
+static inline bool __pm_isZeroed(uintptr_t page)
+{
+	uint32_t index = page / PM_PAGE_SIZE;
+	return (__pm_zeroed[index / 32] & (1u << (index & 31)));
+}
+
+static inline uint32_t __pm_searchWord(uint32_t index, pm_search_t search)
+{
+	switch(search)
+	{
+		case pm_search_zeroed:
+			return __pm_heap[index] & __pm_zeroed[index];
+
+		case pm_search_dirty:
+			return __pm_heap[index] & ~__pm_zeroed[index];
+
+		default:
+			return __pm_heap[index];
+	}
+}
+
 
-static inline uintptr_t __pm_findFreePages(uintptr_t lowerLimit, size_t pages)
+static inline uintptr_t __pm_findFreePages(uintptr_t lowerLimit, size_t pages, pm_search_t search)
 {
 	size_t found = 0; // The number of found pages
 	uintptr_t page = 0; // Address of the first found page
 
 	for(uint32_t i = lowerLimit / PM_PAGE_SIZE / 32; i<PM_HEAPSIZE; i++)
 	{
-		if(__pm_heap[i] == 0)
+		uint32_t word = __pm_searchWord(i, search);
+
+		if(word == 0)
 		{
 			found = 0;
 			continue;
 		}
 
 
-		if(__pm_heap[i] == 0xFFFFFFFF)
+		if(word == 0xFFFFFFFF)
 		{
 			if(found == 0)
 				page = i * 32 * PM_PAGE_SIZE;
@@ -80,7 +134,7 @@ static inline uintptr_t __pm_findFreePages(uintptr_t lowerLimit, size_t pages)
 		{
 			for(uint32_t j=0; j<32; j++)
 			{
-				if(__pm_heap[i] & (1 << j))
+				if(word & (1u << j))
 				{
 					if(found == 0)
 						page = (i * 32 + j) * PM_PAGE_SIZE;
@@ -104,6 +158,15 @@ static inline uintptr_t __pm_findFreePages(uintptr_t lowerLimit, size_t pages)
 	return 0x0;
 }
 
+static inline void __pm_markRangeUsed(uintptr_t page, size_t pages)
+{
+	for(size_t i=0; i<pages; i++)
+	{
+		__pm_markUsed(page);
+		page += PM_PAGE_SIZE;
+	}
+}
+
 
 // MARK --
 // Returns a physical page range not lower than lowerLimit
@@ -111,38 +174,76 @@ uintptr_t pm_allocLimit(uintptr_t lowerLimit, size_t pages)
 {
 	spinlock_lock(&__pm_spinlock);
 
-	uintptr_t page = __pm_findFreePages(lowerLimit, pages);
+	uintptr_t page = __pm_findFreePages(lowerLimit, pages, pm_search_any);
 	if(page)
-	{
-		uintptr_t temp = page;
-		for(size_t i=0; i<pages; i++)
-		{
-			__pm_markUsed(temp);
-			temp += PM_PAGE_SIZE;
-		}
-	}
+		__pm_markRangeUsed(page, pages);
 
 	spinlock_unlock(&__pm_spinlock);
 	return page;
 }
 
 // Returns a physical page range of n pages
+// Dirty pages are preferred, the zeroed ones are kept for pm_allocZeroed()
 uintptr_t pm_alloc(size_t pages)
 {
 	spinlock_lock(&__pm_spinlock);
 
-	uintptr_t page = __pm_findFreePages(0x0, pages);
+	uintptr_t page = __pm_findFreePages(0x0, pages, pm_search_dirty);
+	if(!page && __pm_zeroedPages > 0)
+		page = __pm_findFreePages(0x0, pages, pm_search_any);
+
 	if(page)
+		__pm_markRangeUsed(page, pages);
+
+	spinlock_unlock(&__pm_spinlock);
+	return page;
+}
+
+// Returns a physical page range of n pages that is filled with zeroes
+uintptr_t pm_allocZeroed(size_t pages)
+{
+	spinlock_lock(&__pm_spinlock);
+
+	size_t dirty = 0;
+	uintptr_t page = __pm_findFreePages(0x0, pages, pm_search_zeroed);
+
+	if(!page)
 	{
-		uintptr_t temp = page;
-		for(size_t i=0; i<pages; i++)
+		page = __pm_findFreePages(0x0, pages, pm_search_any);
+
+		if(page)
 		{
-			__pm_markUsed(temp);
-			temp += PM_PAGE_SIZE;
+			for(size_t i=0; i<pages; i++)
+			{
+				if(!__pm_isZeroed(page + i * PM_PAGE_SIZE))
+					dirty ++;
+			}
 		}
 	}
 
+	if(page)
+	{
+		__pm_markRangeUsed(page, pages);
+
+		__pm_zeroedHits   += pages - dirty;
+		__pm_zeroedMisses += dirty;
+	}
+
 	spinlock_unlock(&__pm_spinlock);
+
+	if(page && dirty > 0)
+	{
+		void *memory = (void *)vm_alloc(vm_getKernelDirectory(), page, pages, VM_FLAGS_KERNEL);
+		if(!memory)
+		{
+			pm_free(page, pages);
+			return 0x0;
+		}
+
+		memset(memory, 0, pages * PM_PAGE_SIZE);
+		vm_free(vm_getKernelDirectory(), (vm_address_t)memory, pages);
+	}
+
 	return page;
 }
 
@@ -159,6 +260,71 @@ void pm_free(uintptr_t page, size_t pages)
 	spinlock_unlock(&__pm_spinlock);
 }
 
+// Zeroes up to maxPages dirty free pages, until the pool holds kPMZeroedPoolPages pages
+// Returns the number of pages that were zeroed, the caller should stop calling once it returns 0
+size_t pm_zeroFreePages(size_t maxPages)
+{
+	size_t zeroed = 0;
+
+	while(zeroed < maxPages)
+	{
+		spinlock_lock(&__pm_spinlock);
+
+		if(__pm_zeroedPages >= kPMZeroedPoolPages)
+		{
+			spinlock_unlock(&__pm_spinlock);
+			break;
+		}
+
+		uintptr_t page = __pm_findFreePages(__pm_zeroCursor, 1, pm_search_dirty);
+		if(!page && __pm_zeroCursor > 0)
+			page = __pm_findFreePages(0x0, 1, pm_search_dirty);
+
+		if(!page)
+		{
+			spinlock_unlock(&__pm_spinlock);
+			break;
+		}
+
+		// Take the page out of the heap while it's being zeroed
+		__pm_markUsed(page);
+		__pm_zeroCursor = page;
+
+		spinlock_unlock(&__pm_spinlock);
+
+		void *memory = (void *)vm_alloc(vm_getKernelDirectory(), page, 1, VM_FLAGS_KERNEL);
+		if(!memory)
+		{
+			pm_free(page, 1);
+			break;
+		}
+
+		memset(memory, 0, PM_PAGE_SIZE);
+		vm_free(vm_getKernelDirectory(), (vm_address_t)memory, 1);
+
+		spinlock_lock(&__pm_spinlock);
+
+		__pm_markFree(page);
+		__pm_markZeroed(page);
+
+		spinlock_unlock(&__pm_spinlock);
+		zeroed ++;
+	}
+
+	return zeroed;
+}
+
+void pm_getZeroedStatistics(pm_zeroed_statistics_t *statistics)
+{
+	spinlock_lock(&__pm_spinlock);
+
+	statistics->pages  = __pm_zeroedPages;
+	statistics->hits   = __pm_zeroedHits;
+	statistics->misses = __pm_zeroedMisses;
+
+	spinlock_unlock(&__pm_spinlock);
+}
+
 // MARK: Init
 
 void pm_markMultibootModule(struct multiboot_module_s *module)
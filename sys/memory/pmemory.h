@@ -23,13 +23,25 @@
 #include <prefix.h>
 
 #define PM_PAGE_SIZE 0x1000
+#define kPMZeroedPoolPages 1024 // Upper limit of pre-zeroed pages kept around by pm_zeroFreePages()
+
+typedef struct
+{
+	size_t pages; // Zeroed pages in the pool
+	uint64_t hits; // Pages handed out by pm_allocZeroed() that were already zeroed
+	uint64_t misses; // Pages that pm_allocZeroed() had to zero itself
+} pm_zeroed_statistics_t;
 
 // Barebone allocation system
 uintptr_t pm_alloc(size_t pages);
 uintptr_t pm_allocLimit(uintptr_t lowerLimit, size_t pages);
+uintptr_t pm_allocZeroed(size_t pages);
 
 void pm_free(uintptr_t page, size_t pages);
 
+size_t pm_zeroFreePages(size_t maxPages);
+void pm_getZeroedStatistics(pm_zeroed_statistics_t *statistics);
+
 bool pm_init(void *data); // Data must be of type struct multiboot_s *!
 
 #endif /* _PMEMORY_H_ */
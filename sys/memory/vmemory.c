@@ -462,6 +462,26 @@ uintptr_t vm_resolveVirtualAddress(vm_page_directory_t directory, vm_address_t v
 	return (uintptr_t)((entry & ~0xFFF) | ((uint32_t)vaddress & 0xFFF));
 }
 
+uint32_t vm_getPageFlags(vm_page_directory_t directory, vm_address_t vaddress)
+{
+	bool isKernelDirectory = true;
+
+	if(directory != __vm_kernelDirectory)
+	{
+		directory = (vm_page_directory_t)vm_alloc(__vm_kernelDirectory, (uintptr_t)directory, 1, VM_FLAGS_KERNEL);
+		isKernelDirectory = false;
+	}
+
+	vm_lock();
+	uint32_t entry = __vm_getPagetableEntry(directory, vaddress);
+
+	if(!isKernelDirectory)
+		__vm_mapPage__noLock(__vm_kernelDirectory, 0x0, (vm_address_t)directory, 0);
+
+	vm_unlock();
+	return (entry & VM_PAGETABLEFLAG_PRESENT) ? (entry & VM_PAGETABLEFLAG_ALL) : 0;
+}
+
 vm_address_t vm_findFreePages_noLock(vm_page_directory_t directory, size_t pages, vm_address_t lowerLimit, vm_address_t upperLimit)
 {
 	vm_address_t vaddress = 0x0;
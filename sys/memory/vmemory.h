@@ -72,6 +72,7 @@ void vm_lock();
 void vm_unlock();
 
 uintptr_t vm_resolveVirtualAddress(vm_page_directory_t context, vm_address_t virtAddress);
+uint32_t vm_getPageFlags(vm_page_directory_t context, vm_address_t virtAddress); // 0 if the page isn't present
 vm_address_t vm_findFreePages(vm_page_directory_t directory, size_t pages, vm_address_t lowerLimit, vm_address_t upperLimit);
 
 void vm_mapPage(vm_page_directory_t context, uintptr_t physAddress, vm_address_t virtAddress, uint32_t flags);
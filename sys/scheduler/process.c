@@ -20,9 +20,12 @@
 #include <memory/memory.h>
 #include <system/syslog.h>
 #include <syscall/scmmap.h>
+#include <syscall/scioring.h>
 #include <libc/string.h>
+#include <libc/math.h>
 #include <interrupts/trampoline.h>
 #include <vfs/vfs.h>
+#include <loader/imagecache.h>
 #include "process.h"
 #include "scheduler.h"
 
@@ -62,8 +65,12 @@ process_t *process_createVoid(int *errno)
 
 		process->mappings = list_create(sizeof(mmap_description_t), offsetof(mmap_description_t, listNext), offsetof(mmap_description_t, listPrev));
 
-		memset(&process->files, 0, kSDMaxOpenFiles * sizeof(vfs_file_t *));
-		process->openFiles = 0;
+		process->filesLock     = SPINLOCK_INIT;
+		process->files         = NULL;
+		process->filesBitmap   = NULL;
+		process->filesCapacity = 0;
+		process->openFiles     = 0;
+		process->ioring        = NULL;
 
 		process->threadLock    = SPINLOCK_INIT;
 		process->threadCounter = 0;
@@ -141,6 +148,36 @@ process_t *process_createWithFile(const char *name, int *errno)
 }
 
 extern thread_t *thread_clone(struct process_s *target, thread_t *source, int *errno); 
+bool process_growFileTable(process_t *process, size_t capacity);
+
+bool process_inheritFiles(process_t *child, process_t *parent)
+{
+	spinlock_lock(&parent->filesLock);
+
+	if(parent->filesCapacity > 0 && !process_growFileTable(child, parent->filesCapacity))
+	{
+		spinlock_unlock(&parent->filesLock);
+		return false;
+	}
+
+	// The child shares the open files (and with them the offsets) with its parent
+	for(size_t i=0; i<parent->filesCapacity; i++)
+	{
+		vfs_file_t *file = parent->files[i];
+		if(file && file != kSDInvalidFile)
+		{
+			vfs_fileRetain(file);
+
+			child->files[i] = file;
+			child->filesBitmap[i / 32] |= (1u << (i % 32));
+			child->openFiles ++;
+		}
+	}
+
+	spinlock_unlock(&parent->filesLock);
+	return true;
+}
+
 
 process_t *process_fork(process_t *parent, int *errno)
 {
@@ -160,6 +197,9 @@ process_t *process_fork(process_t *parent, int *errno)
 
 		child->context->chdir = parent->context->chdir;
 
+		if(!process_inheritFiles(child, parent))
+			PROCESS_BAILWITHERROR(child, ENOMEM);
+
 		thread_t *thread = thread_clone(child, parent->scheduledThread, errno);
 		if(!thread)
 		{
@@ -201,6 +241,16 @@ process_t *process_getParent()
 	return process->pprocess;
 }
 
+uintptr_t process_resolveAddress(process_t *process, vm_address_t vaddress)
+{
+	uintptr_t physical = vm_resolveVirtualAddress(process->pdirectory, vaddress);
+
+	if(!physical && process->image && ld_executableHandleFault(process->image, vaddress))
+		physical = vm_resolveVirtualAddress(process->pdirectory, vaddress);
+
+	return physical;
+}
+
 process_t *process_getWithPid(pid_t pid)
 {
 	spinlock_lock(&_sd_lock);
@@ -236,6 +286,22 @@ void process_destroy(process_t *process)
 	if(process->image)
 		ld_executableRelease(process->image);
 
+	// Close all open files
+	for(size_t i=0; i<process->filesCapacity; i++)
+	{
+		vfs_file_t *file = process->files[i];
+		if(file && file != kSDInvalidFile)
+			vfs_fileRelease(file);
+	}
+
+	if(process->files)
+	{
+		hfree(NULL, process->files);
+		hfree(NULL, process->filesBitmap);
+	}
+
+	ioring_destroy(process);
+
 	if(process->context)
 		vfs_contextDelete(process->context);
 
@@ -246,9 +312,17 @@ void process_destroy(process_t *process)
 		size_t pages = VM_PAGE_COUNT(description->length);
 
 		vm_free(process->pdirectory, description->vaddress, pages);
-		pm_free(description->paddress, pages);
 
-		description = description->next;
+		if(description->file)
+		{
+			ld_imageFileRelease(description->file);
+		}
+		else
+		{
+			pm_free(description->paddress, pages);
+		}
+
+		description = description->listNext;
 	}
 
 	vm_deleteDirectory(process->pdirectory);
@@ -267,38 +341,230 @@ void process_unlock(process_t *process)
 }
 
 
-int process_allocateFiledescriptor(process_t *process)
+// Must be called with the files lock held (or on a process that isn't visible yet)
+bool process_growFileTable(process_t *process, size_t capacity)
 {
-	for(int i=0; i<kSDMaxOpenFiles; i++)
+	if(capacity > kSDMaxOpenFiles)
+		return false;
+
+	size_t words = (capacity + 31) / 32;
+
+	vfs_file_t **files = halloc(NULL, capacity * sizeof(vfs_file_t *));
+	uint32_t *bitmap = halloc(NULL, words * sizeof(uint32_t));
+
+	if(!files || !bitmap)
 	{
-		if(process->files[i] == NULL)
+		if(files)
+			hfree(NULL, files);
+
+		if(bitmap)
+			hfree(NULL, bitmap);
+
+		return false;
+	}
+
+	memset(files, 0, capacity * sizeof(vfs_file_t *));
+	memset(bitmap, 0, words * sizeof(uint32_t));
+
+	if(process->files)
+	{
+		memcpy(files, process->files, process->filesCapacity * sizeof(vfs_file_t *));
+		memcpy(bitmap, process->filesBitmap, ((process->filesCapacity + 31) / 32) * sizeof(uint32_t));
+
+		hfree(NULL, process->files);
+		hfree(NULL, process->filesBitmap);
+	}
+
+	process->files = files;
+	process->filesBitmap = bitmap;
+	process->filesCapacity = capacity;
+
+	return true;
+}
+
+// Returns the lowest free descriptor that is >= lowerLimit, growing the table if needed. Must be called with the files lock held
+int process_findFreeFiledescriptor(process_t *process, size_t lowerLimit)
+{
+	size_t words = (process->filesCapacity + 31) / 32;
+
+	for(size_t i = lowerLimit / 32; i<words; i++)
+	{
+		uint32_t word = process->filesBitmap[i];
+		if(i == lowerLimit / 32)
+			word |= (1u << (lowerLimit % 32)) - 1; // Pretend the descriptors below the limit are taken
+
+		if(word != 0xFFFFFFFF)
 		{
-			process->files[i] = kSDInvalidFile;
-			return i;
+			size_t fd = (i * 32) + __builtin_ctz(~word);
+			if(fd < process->filesCapacity)
+				return (int)fd;
 		}
 	}
 
-	return -1;
+	size_t capacity = MAX(process->filesCapacity, lowerLimit + 1);
+	capacity = MAX(capacity, kSDInitialOpenFiles);
+
+	while(capacity <= process->filesCapacity || capacity <= lowerLimit)
+		capacity *= 2;
+
+	capacity = (capacity + 31) & ~31;
+	capacity = MIN(capacity, kSDMaxOpenFiles);
+
+	size_t fd = MAX(process->filesCapacity, lowerLimit);
+	if(fd >= capacity || !process_growFileTable(process, capacity))
+		return -1;
+
+	return (int)fd;
 }
-void process_setFileForFiledescriptor(process_t *process, int fd, struct vfs_file_s *file)
-{
-	if(fd >= kSDMaxOpenFiles)
-		return;
 
+static inline void __process_markFiledescriptor(process_t *process, int fd, vfs_file_t *file)
+{
 	process->files[fd] = file;
+	process->filesBitmap[fd / 32] |= (1u << (fd % 32));
+	process->openFiles ++;
 }
-void process_releaseFiledescriptor(process_t *process, int fd)
+
+
+int process_allocateFiledescriptor(process_t *process)
+{
+	spinlock_lock(&process->filesLock);
+
+	int fd = process_findFreeFiledescriptor(process, 0);
+	if(fd >= 0)
+		__process_markFiledescriptor(process, fd, kSDInvalidFile);
+
+	spinlock_unlock(&process->filesLock);
+	return fd;
+}
+bool process_setFileForFiledescriptor(process_t *process, int fd, struct vfs_file_s *file)
 {
-	if(fd >= kSDMaxOpenFiles)
-		return;
+	bool result = false;
+	spinlock_lock(&process->filesLock);
 
+	if(fd >= 0 && (size_t)fd < process->filesCapacity && process->files[fd] == kSDInvalidFile)
+	{
+		process->files[fd] = file;
+		result = true;
+	}
+
+	spinlock_unlock(&process->filesLock);
+	return result;
+}
+
+static inline void __process_clearFiledescriptor(process_t *process, int fd)
+{
 	process->files[fd] = NULL;
+	process->filesBitmap[fd / 32] &= ~(1u << (fd % 32));
+	process->openFiles --;
+}
+
+void process_cancelFiledescriptor(process_t *process, int fd)
+{
+	spinlock_lock(&process->filesLock);
+
+	if(fd >= 0 && (size_t)fd < process->filesCapacity && process->files[fd] == kSDInvalidFile)
+		__process_clearFiledescriptor(process, fd);
+
+	spinlock_unlock(&process->filesLock);
+}
+struct vfs_file_s *process_releaseFiledescriptor(process_t *process, int fd)
+{
+	vfs_file_t *file = NULL;
+	spinlock_lock(&process->filesLock);
+
+	// Reserved descriptors belong to the open() that is still in flight, only it may cancel them
+	if(fd >= 0 && (size_t)fd < process->filesCapacity && process->files[fd] && process->files[fd] != kSDInvalidFile)
+	{
+		file = process->files[fd];
+		__process_clearFiledescriptor(process, fd);
+	}
+
+	spinlock_unlock(&process->filesLock);
+	return file;
 }
 struct vfs_file_s *process_fileWithFiledescriptor(process_t *process, int fd)
 {
-	if(fd >= kSDMaxOpenFiles)
-		return NULL;
+	vfs_file_t *file = NULL;
+	spinlock_lock(&process->filesLock);
+
+	if(fd >= 0 && (size_t)fd < process->filesCapacity)
+	{
+		file = process->files[fd];
+		if(file == kSDInvalidFile)
+			file = NULL;
 
-	return process->files[fd];
+		if(file)
+			vfs_fileRetain(file);
+	}
+
+	spinlock_unlock(&process->filesLock);
+	return file;
 }
+int process_duplicateFiledescriptor(process_t *process, int fd, int target, int *errno)
+{
+	vfs_file_t *replaced = NULL;
+	spinlock_lock(&process->filesLock);
 
+	vfs_file_t *file = (fd >= 0 && (size_t)fd < process->filesCapacity) ? process->files[fd] : NULL;
+	if(!file || file == kSDInvalidFile || target >= kSDMaxOpenFiles)
+	{
+		spinlock_unlock(&process->filesLock);
+
+		*errno = EBADF;
+		return -1;
+	}
+
+	if(target == fd)
+	{
+		spinlock_unlock(&process->filesLock);
+		return target;
+	}
+
+	if(target < 0)
+	{
+		target = process_findFreeFiledescriptor(process, 0);
+		if(target < 0)
+		{
+			spinlock_unlock(&process->filesLock);
+
+			*errno = EMFILE;
+			return -1;
+		}
+	}
+	else if((size_t)target >= process->filesCapacity)
+	{
+		if(process_findFreeFiledescriptor(process, target) != target)
+		{
+			spinlock_unlock(&process->filesLock);
+
+			*errno = ENOMEM;
+			return -1;
+		}
+	}
+
+	if(process->files[target] == kSDInvalidFile)
+	{
+		// The descriptor is reserved by an open() that is still in flight
+		spinlock_unlock(&process->filesLock);
+
+		*errno = EBUSY;
+		return -1;
+	}
+
+	if(process->files[target])
+	{
+		replaced = process->files[target];
+		process->openFiles --;
+	}
+
+	vfs_fileRetain(file);
+	__process_markFiledescriptor(process, target, file);
+
+	spinlock_unlock(&process->filesLock);
+
+	// Closing the replaced file might end up in the filesystem, so don't hold the lock while doing it
+	if(replaced && replaced != kSDInvalidFile)
+		vfs_fileRelease(replaced);
+
+	return target;
+}
@@ -30,8 +30,10 @@
 
 struct vfs_file_s;
 struct vfs_context_s;
+struct ioring_context_s;
 
 #define kSDMaxOpenFiles 512
+#define kSDInitialOpenFiles 32 // The file table starts with room for this many descriptors and doubles when full
 #define kSDInvalidFile ((struct vfs_file_s *)-1)
 
 typedef struct process_s
@@ -59,9 +61,14 @@ typedef struct process_s
 
 	list_t *mappings; // used for mmap() 
 
-	struct vfs_file_s *files[kSDMaxOpenFiles];
+	spinlock_t filesLock; // Guards the file table, independent of the process lock
+	struct vfs_file_s **files;
+	uint32_t *filesBitmap; // One bit per descriptor, set if the descriptor is in use
+	size_t filesCapacity;
 	size_t openFiles;
 
+	struct ioring_context_s *ioring; // Created on demand by io_setup()
+
 	struct process_s *pprocess; // Parent
 	struct process_s *next;
 } process_t;
@@ -73,14 +80,24 @@ process_t *process_fork(process_t *parent, int *errno);
 process_t *process_getWithPid(pid_t pid);
 
 process_t *process_getCurrentProcess();
+uintptr_t process_resolveAddress(process_t *process, vm_address_t vaddress); // Like vm_resolveVirtualAddress(), but populates lazily backed pages
 process_t *process_getParent();
 
 void process_lock(process_t *process);
 void process_unlock(process_t *process);
 
+// Reserves the lowest free descriptor, returns -1 if the table is full
 int process_allocateFiledescriptor(process_t *process);
-void process_setFileForFiledescriptor(process_t *process, int fd, struct vfs_file_s *file);
-void process_releaseFiledescriptor(process_t *process, int fd);
+// Installs the file for a reserved descriptor, the table takes over the callers reference. Fails if fd isn't reserved
+bool process_setFileForFiledescriptor(process_t *process, int fd, struct vfs_file_s *file);
+// Frees a reserved descriptor again, for open() when it fails
+void process_cancelFiledescriptor(process_t *process, int fd);
+// Frees the descriptor and returns the file it referred to, the caller takes over the tables reference.
+// Returns NULL for free and reserved descriptors
+struct vfs_file_s *process_releaseFiledescriptor(process_t *process, int fd);
+// Returns the retained file of the descriptor, must be balanced with vfs_fileRelease()
 struct vfs_file_s *process_fileWithFiledescriptor(process_t *process, int fd);
+// Makes target refer to the same file as fd, target == -1 picks the lowest free descriptor. Returns the new descriptor
+int process_duplicateFiledescriptor(process_t *process, int fd, int target, int *errno);
 
 #endif /* _PROCESS_H_ */
@@ -194,6 +194,10 @@ uint32_t sd_schedule(uint32_t esp)
 	ir_trampoline_map->pagedir  = process->pdirectory;
 	ir_trampoline_map->tss.esp0 = thread->esp + sizeof(cpu_state_t);
 
+	// Threads with a TLS area return to userland with %gs set to the TLS selector, which gets reloaded with this base
+	if(thread->tlsPointer)
+		gdt_setTLSBase(ir_trampoline_map->gdt, (uint32_t)thread->tlsPointer);
+
 	thread->wasNice = false;
 
 	spinlock_unlock(&_sd_lock);
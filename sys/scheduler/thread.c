@@ -32,6 +32,7 @@
 #define THREAD_WANTED_TICKS 4
 
 void thread_destroy(thread_t *thread);
+bool thread_copyTLSArea(process_t *process, thread_t *thread, thread_t *source);
 
 uint32_t _thread_getUniqueID(process_t *process)
 {
@@ -72,6 +73,7 @@ thread_t *thread_createVoid(process_t *process, thread_entry_t entry, int *errno
 		thread->userStackPages  = 0;
 		thread->userStack       = NULL;
 		thread->userStackVirt   = NULL;
+		thread->kernelStackPages = 0;
 		thread->kernelStack     = NULL;
 		thread->kernelStackVirt = NULL;
 
@@ -79,7 +81,10 @@ thread_t *thread_createVoid(process_t *process, thread_entry_t entry, int *errno
 		thread->argumentCount = 0;
 
 		// TLS
-		thread->tlsVirtual = 0;
+		thread->tlsVirtual     = 0;
+		thread->tlsPointer     = 0;
+		thread->tlsPages       = 0;
+		thread->tlsStaticPages = 0;
 
 		// Sleeping related
 		thread->sleeping = false;
@@ -130,22 +135,25 @@ void thread_attachToProcess(process_t *process, thread_t *thread)
 		} \
 	} while(0)
 
-thread_t *thread_createKernel(process_t *process, thread_entry_t entry, uint32_t argCount, va_list args, int *errno)
+thread_t *thread_createKernel(process_t *process, thread_entry_t entry, size_t stackSize, uint32_t argCount, va_list args, int *errno)
 {
 	thread_t *thread = thread_createVoid(process, entry, errno);
 	if(thread)
 	{
-		uint8_t *kernelStack = (uint8_t *)pm_alloc(1);
+		size_t stackPages = MAX(VM_PAGE_COUNT(stackSize), 1);
+
+		uint8_t *kernelStack = (uint8_t *)pm_alloc(stackPages);
 		__threadAssert(kernelStack, ENOMEM);
 
 		// Create the kernel stack
-		thread->kernelStack     = kernelStack;
-		thread->kernelStackVirt = (uint8_t *)vm_allocLimit(process->pdirectory, (uintptr_t)kernelStack, 1, THREAD_STACK_LIMIT, VM_UPPER_LIMIT, VM_FLAGS_KERNEL);
+		thread->kernelStackPages = stackPages;
+		thread->kernelStack      = kernelStack;
+		thread->kernelStackVirt  = (uint8_t *)vm_allocLimit(process->pdirectory, (uintptr_t)kernelStack, stackPages, THREAD_STACK_LIMIT, VM_UPPER_LIMIT, VM_FLAGS_KERNEL);
 
 		__threadAssert(thread->kernelStackVirt, ENOMEM);
 
-		uint32_t *stack = ((uint32_t *)(thread->kernelStackVirt + VM_PAGE_SIZE)) - argCount;
-		memset(thread->kernelStackVirt, 0, 1 * VM_PAGE_SIZE);
+		uint32_t *stack = ((uint32_t *)(thread->kernelStackVirt + (stackPages * VM_PAGE_SIZE))) - argCount;
+		memset(thread->kernelStackVirt, 0, stackPages * VM_PAGE_SIZE);
 
 		// Push the arguments for the thread on its stack
 		thread->arguments = NULL;
@@ -225,6 +233,7 @@ thread_t *thread_createUserland(process_t *process, thread_entry_t entry, size_t
 		// User and kernel stack
 		thread->userStack   = userStack;
 		thread->kernelStack = kernelStack;
+		thread->kernelStackPages = 1;
 
 		// Map the user stack
 		thread->userStackPages = stackPages;
@@ -299,7 +308,7 @@ thread_t *thread_create(process_t *process, thread_entry_t entry, size_t stackSi
 	thread_t *thread;
 	if(process->ring0)
 	{
-		thread = thread_createKernel(process, entry, args, vlist, errno);
+		thread = thread_createKernel(process, entry, stackSize, args, vlist, errno);
 	}
 	else
 	{
@@ -340,6 +349,7 @@ thread_t *thread_clone(struct process_s *process, thread_t *source, int *errno)
 		// Stack handling
 		thread->userStack   = userStack;
 		thread->kernelStack = kernelStack;
+		thread->kernelStackPages = 1;
 
 		// User stack
 		thread->userStackVirt  = source->userStackVirt;
@@ -388,6 +398,18 @@ thread_t *thread_clone(struct process_s *process, thread_t *source, int *errno)
 		}
 
 		memcpy(thread->kernelStackVirt, source->kernelStackVirt, VM_PAGE_SIZE);
+
+		if(source->tlsVirtual && !thread_copyTLSArea(process, thread, source))
+		{
+			spinlock_unlock(&source->lock);
+			thread_destroy(thread);
+
+			if(errno)
+				*errno = ENOMEM;
+
+			return NULL;
+		}
+
 		thread_attachToProcess(process, thread);
 	}
 
@@ -413,19 +435,21 @@ void thread_destroy(thread_t *thread)
 	
 	if(thread->kernelStackVirt)
 	{
-		vm_free(process->pdirectory, (vm_address_t)thread->kernelStackVirt, 1);
-		vm_free(vm_getKernelDirectory(), (vm_address_t)thread->kernelStackVirt, 1);
+		vm_free(process->pdirectory, (vm_address_t)thread->kernelStackVirt, thread->kernelStackPages);
+		vm_free(vm_getKernelDirectory(), (vm_address_t)thread->kernelStackVirt, thread->kernelStackPages);
 	}
 
 	if(thread->tlsVirtual)
 	{
+		size_t pages = thread->tlsStaticPages + thread->tlsPages;
 		uintptr_t physical = vm_resolveVirtualAddress(process->pdirectory, thread->tlsVirtual);
-		vm_free(process->pdirectory, thread->tlsVirtual, thread->tlsPages);
-		pm_free(physical, thread->tlsPages);
+
+		vm_free(process->pdirectory, thread->tlsVirtual, pages);
+		pm_free(physical, pages);
 	}
 
 	if(thread->kernelStack)
-		pm_free((uintptr_t)thread->kernelStack, 1);
+		pm_free((uintptr_t)thread->kernelStack, thread->kernelStackPages);
 
 	if(thread->arguments)
 	{
@@ -555,16 +579,66 @@ void thread_wakeup(thread_t *thread)
 
 
 
-uintptr_t thread_getTLSArea(thread_t *thread, uint32_t pages, int *errno)
+bool thread_copyTLSArea(process_t *process, thread_t *thread, thread_t *source)
 {
-	uint32_t allowedPages = MAX(1, MIN(5, pages));
-	bool needsTLSResize = (allowedPages > thread->tlsPages && thread->tlsVirtual != 0);
+	size_t pages = source->tlsStaticPages + source->tlsPages;
+	uintptr_t pmemory = pm_alloc(pages);
+
+	if(!pmemory)
+		return false;
+
+	uintptr_t sourcePmemory = vm_resolveVirtualAddress(source->process->pdirectory, source->tlsVirtual);
+
+	void *tlsSource = (void *)vm_alloc(vm_getKernelDirectory(), sourcePmemory, pages, VM_FLAGS_KERNEL);
+	void *tlsTarget = (void *)vm_alloc(vm_getKernelDirectory(), pmemory, pages, VM_FLAGS_KERNEL);
+
+	if(!tlsSource || !tlsTarget)
+	{
+		if(tlsSource)
+			vm_free(vm_getKernelDirectory(), (vm_address_t)tlsSource, pages);
+
+		if(tlsTarget)
+			vm_free(vm_getKernelDirectory(), (vm_address_t)tlsTarget, pages);
+
+		pm_free(pmemory, pages);
+		return false;
+	}
+
+	memcpy(tlsTarget, tlsSource, pages * VM_PAGE_SIZE);
+
+	vm_free(vm_getKernelDirectory(), (vm_address_t)tlsSource, pages);
+	vm_free(vm_getKernelDirectory(), (vm_address_t)tlsTarget, pages);
 
-	if(thread->tlsVirtual && allowedPages <= thread->tlsPages)
-		return thread->tlsVirtual;
+	// The area lives at the same address in the child, so the thread pointer stored in it stays valid
+	vm_mapPageRange(process->pdirectory, pmemory, source->tlsVirtual, pages, VM_FLAGS_USERLAND);
 
+	thread->tlsVirtual     = source->tlsVirtual;
+	thread->tlsPointer     = source->tlsPointer;
+	thread->tlsPages       = source->tlsPages;
+	thread->tlsStaticPages = source->tlsStaticPages;
+
+	return true;
+}
+
+uintptr_t thread_getTLSArea(thread_t *thread, uint32_t pages, int *errno)
+{
 	process_t *process = thread->process;
-	uintptr_t pmemory = pm_alloc(allowedPages);
+	ld_exectuable_t *image = process->image;
+
+	size_t staticSize = 0;
+	if(image && image->tlsSize > 0)
+		staticSize = (image->tlsSize + image->tlsAlignment - 1) & ~(image->tlsAlignment - 1);
+
+	size_t staticPages  = VM_PAGE_COUNT(staticSize);
+	size_t allowedPages = MAX(1, MIN(5, pages));
+
+	if(thread->tlsVirtual && allowedPages <= thread->tlsPages && staticPages == thread->tlsStaticPages)
+		return thread->tlsPointer;
+
+	allowedPages = MAX(allowedPages, thread->tlsPages);
+
+	size_t totalPages = staticPages + allowedPages;
+	uintptr_t pmemory = pm_allocZeroed(totalPages);
 
 	if(!pmemory)
 	{
@@ -572,35 +646,74 @@ uintptr_t thread_getTLSArea(thread_t *thread, uint32_t pages, int *errno)
 		return -1;
 	}
 
-	vm_address_t vmemory = vm_alloc(process->pdirectory, pmemory, allowedPages, VM_FLAGS_USERLAND);
-	if(!vmemory)
+	vm_address_t vmemory = vm_alloc(process->pdirectory, pmemory, totalPages, VM_FLAGS_USERLAND);
+	uint8_t *target = (uint8_t *)vm_alloc(vm_getKernelDirectory(), pmemory, totalPages, VM_FLAGS_KERNEL);
+
+	if(!vmemory || !target)
 	{
-		pm_free(pmemory, allowedPages);
+		if(vmemory)
+			vm_free(process->pdirectory, vmemory, totalPages);
+
+		if(target)
+			vm_free(vm_getKernelDirectory(), (vm_address_t)target, totalPages);
+
+		pm_free(pmemory, totalPages);
 
 		*errno = ENOMEM;
 		return -1;
 	}
 
-	vm_address_t target = vm_alloc(vm_getKernelDirectory(), pmemory, allowedPages, VM_FLAGS_KERNEL);
-	memset((void *)target, 0, allowedPages * VM_PAGE_SIZE);
+	uint8_t *pointer = target + (staticPages * VM_PAGE_SIZE);
+	bool needsStaticBlock = true;
 
-	if(needsTLSResize)
+	if(thread->tlsVirtual)
 	{
+		// Resize, the userland buckets move along with the thread pointer.
+		// The static block is only kept if its layout didn't change, otherwise it's initialized again from the template
+		size_t sourcePages = thread->tlsStaticPages + thread->tlsPages;
 		uintptr_t sourcePmemory = vm_resolveVirtualAddress(process->pdirectory, thread->tlsVirtual);
-		vm_address_t source = vm_alloc(vm_getKernelDirectory(), sourcePmemory, thread->tlsPages, VM_FLAGS_USERLAND);
+		uint8_t *source = (uint8_t *)vm_alloc(vm_getKernelDirectory(), sourcePmemory, sourcePages, VM_FLAGS_KERNEL);
+
+		if(source)
+		{
+			if(thread->tlsStaticPages == staticPages)
+			{
+				memcpy(target, source, sourcePages * VM_PAGE_SIZE);
+				needsStaticBlock = false;
+			}
+			else
+			{
+				memcpy(pointer, source + (thread->tlsStaticPages * VM_PAGE_SIZE), thread->tlsPages * VM_PAGE_SIZE);
+			}
 
-		memcpy((void *)target, (void *)source, thread->tlsPages * VM_PAGE_SIZE);
+			vm_free(vm_getKernelDirectory(), (vm_address_t)source, sourcePages);
+		}
 
-		vm_free(process->pdirectory, thread->tlsVirtual, thread->tlsPages);
-		pm_free(sourcePmemory, thread->tlsPages);
+		vm_free(process->pdirectory, thread->tlsVirtual, sourcePages);
+		pm_free(sourcePmemory, sourcePages);
 	}
 
-	vm_free(vm_getKernelDirectory(), target, allowedPages);
+	if(needsStaticBlock && image && image->tlsImage)
+		memcpy(pointer - staticSize, image->tlsImage, image->tlsImageSize);
+
+	// The first word at the thread pointer holds the thread pointer itself, as the i386 TLS ABI demands.
+	// This lets userland turn %gs into a plain pointer with a single load
+	thread->tlsVirtual     = vmemory;
+	thread->tlsPointer     = vmemory + (staticPages * VM_PAGE_SIZE);
+	thread->tlsPages       = allowedPages;
+	thread->tlsStaticPages = staticPages;
 
-	thread->tlsVirtual = vmemory;
-	thread->tlsPages = allowedPages;
+	*((uint32_t *)pointer) = (uint32_t)thread->tlsPointer;
+	vm_free(vm_getKernelDirectory(), (vm_address_t)target, totalPages);
 	
-	return vmemory;
+	return thread->tlsPointer;
+}
+
+void thread_setTLSSegment(thread_t *thread, cpu_state_t *state)
+{
+	// The segment register is reloaded from the saved state when returning to userland, which also picks up the new base
+	state->gs = GDT_TLS_SELECTOR;
+	gdt_setTLSBase(ir_trampoline_map->gdt, (uint32_t)thread->tlsPointer);
 }
 
 
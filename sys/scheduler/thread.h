@@ -53,6 +53,7 @@ typedef struct thread_s
 	uint8_t *userStack;
 	uint8_t *userStackVirt;
 
+	size_t kernelStackPages; // Ring 0 threads get the stack size passed to thread_create(), all others a single page
 	uint8_t *kernelStack;
 	uint8_t *kernelStackVirt;
 
@@ -71,8 +72,11 @@ typedef struct thread_s
 	list_t *listener;
 
 	// TLS
+	// The area is laid out as [static TLS block][thread pointer | userland buckets], %gs points at tlsPointer
 	vm_address_t tlsVirtual;
-	size_t tlsPages;
+	vm_address_t tlsPointer;
+	size_t tlsPages; // Pages following the thread pointer
+	size_t tlsStaticPages; // Pages holding the static block right below the thread pointer
 
 	// Sleeping
 	bool sleeping;
@@ -116,6 +120,7 @@ void thread_sleep(thread_t *thread, uint64_t time);
 void thread_wakeup(thread_t *thread);
 
 uintptr_t thread_getTLSArea(thread_t *thread, uint32_t pages, int *errno);
+void thread_setTLSSegment(thread_t *thread, cpu_state_t *state);
 
 void thread_setName(thread_t *thread, const char *name, int *errno);
 void thread_setPriority(thread_t *thread, int priority);
@@ -0,0 +1,254 @@
+//
+//  scioring.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <errno.h>
+#include <scheduler/scheduler.h>
+#include <vfs/vfs.h>
+#include <libc/string.h>
+#include <libc/math.h>
+
+#include "scioring.h"
+#include "syscall.h"
+
+void ioring_destroy(process_t *process)
+{
+	ioring_context_t *context = process->ioring;
+	if(!context)
+		return;
+
+	vm_free(vm_getKernelDirectory(), (vm_address_t)context->ring, context->pages);
+	vm_free(process->pdirectory, context->vaddress, context->pages);
+	pm_free(context->paddress, context->pages);
+
+	hfree(NULL, context);
+	process->ioring = NULL;
+}
+
+static int32_t ioring_executePath(ioring_sqe_t *sqe, int *errno)
+{
+	vm_address_t virtual;
+	const char *path = sc_mapProcessString((const char *)sqe->address, &virtual, errno);
+	if(!path)
+		return -1;
+
+	int32_t result;
+	if(sqe->opcode == IORING_OP_OPEN)
+	{
+		result = vfs_open(path, (int)sqe->length, errno);
+	}
+	else
+	{
+		bool stat = vfs_stat(path, (vfs_stat_t *)sqe->stat, errno);
+		result = stat ? 0 : -1;
+	}
+
+	vm_free(vm_getKernelDirectory(), virtual, kSCStringPages);
+	return result;
+}
+
+static int32_t ioring_execute(ioring_sqe_t *sqe, int *errno)
+{
+	switch(sqe->opcode)
+	{
+		case IORING_OP_NOP:
+			return 0;
+
+		case IORING_OP_READ:
+			return (int32_t)vfs_read(sqe->fd, (void *)sqe->address, sqe->length, errno);
+
+		case IORING_OP_WRITE:
+			return (int32_t)vfs_write(sqe->fd, (const void *)sqe->address, sqe->length, errno);
+
+		case IORING_OP_OPEN:
+		case IORING_OP_STAT:
+			return ioring_executePath(sqe, errno);
+
+		case IORING_OP_CLOSE:
+			if(vfs_close(sqe->fd) == -1)
+			{
+				*errno = EBADF;
+				return -1;
+			}
+
+			return 0;
+
+		default:
+			*errno = EINVAL;
+			return -1;
+	}
+}
+
+// Executes up to count submissions, bounded by what is queued and the room left in the completion queue.
+// Returns the number of consumed submissions
+static uint32_t ioring_submit(ioring_context_t *context, uint32_t count, int *errno)
+{
+	ioring_t *ring = context->ring;
+	uint32_t sqMask = context->sqEntries - 1;
+	uint32_t cqMask = context->cqEntries - 1;
+
+	spinlock_lock(&context->lock);
+
+	uint32_t pending = ring->sqTail - context->sqHead;
+	uint32_t used    = context->cqTail - ring->cqHead;
+
+	if(pending > context->sqEntries || used > context->cqEntries)
+	{
+		spinlock_unlock(&context->lock);
+
+		*errno = EINVAL;
+		return -1;
+	}
+
+	uint32_t available = context->cqEntries - used;
+
+	count = MIN(count, pending);
+	count = MIN(count, available);
+
+	__sync_synchronize(); // Don't look at the entries before seeing the tail that published them
+
+	for(uint32_t i=0; i<count; i++)
+	{
+		// Work on a copy, userland may change the entry while it is being executed
+		ioring_sqe_t sqe = context->sqes[(context->sqHead + i) & sqMask];
+		ioring_cqe_t *cqe = &context->cqes[context->cqTail & cqMask];
+
+		int error = 0;
+		int32_t result = ioring_execute(&sqe, &error);
+
+		cqe->userData = sqe.userData;
+		cqe->result   = result;
+		cqe->error    = error;
+
+		context->cqTail ++;
+	}
+
+	context->sqHead += count;
+	ring->sqHead = context->sqHead;
+
+	__sync_synchronize(); // Publish the completions before the tail
+	ring->cqTail = context->cqTail;
+
+	spinlock_unlock(&context->lock);
+	return count;
+}
+
+
+// io_setup() signature:
+// void *io_setup(uint32_t entries)
+
+uint32_t _sc_ioSetup(__unused uint32_t *esp, uint32_t *uesp, int *errno)
+{
+	process_t *process = process_getCurrentProcess();
+	uint32_t entries = *(uint32_t *)(uesp + 0);
+
+	if(entries == 0 || entries > kIORingMaxEntries || (entries & (entries - 1)) != 0)
+	{
+		*errno = EINVAL;
+		return -1;
+	}
+
+	size_t sqOffset = sizeof(ioring_t);
+	size_t cqOffset = sqOffset + entries * sizeof(ioring_sqe_t);
+	size_t length   = cqOffset + (entries * 2) * sizeof(ioring_cqe_t);
+	size_t pages    = VM_PAGE_COUNT(length);
+
+	process_lock(process);
+
+	if(process->ioring)
+	{
+		process_unlock(process);
+
+		*errno = EBUSY;
+		return -1;
+	}
+
+	ioring_context_t *context = halloc(NULL, sizeof(ioring_context_t));
+	uintptr_t pmemory = pm_allocZeroed(pages);
+
+	if(!context || !pmemory)
+		goto ioSetupFailed;
+
+	vm_address_t vmemory = vm_alloc(process->pdirectory, pmemory, pages, VM_FLAGS_USERLAND);
+	if(!vmemory)
+		goto ioSetupFailed;
+
+	ioring_t *ring = (ioring_t *)vm_alloc(vm_getKernelDirectory(), pmemory, pages, VM_FLAGS_KERNEL);
+	if(!ring)
+	{
+		vm_free(process->pdirectory, vmemory, pages);
+		goto ioSetupFailed;
+	}
+
+	ring->sqEntries = entries;
+	ring->sqOffset  = sqOffset;
+	ring->cqEntries = entries * 2;
+	ring->cqOffset  = cqOffset;
+
+	context->ring      = ring;
+	context->sqes      = (ioring_sqe_t *)(((uint8_t *)ring) + sqOffset);
+	context->cqes      = (ioring_cqe_t *)(((uint8_t *)ring) + cqOffset);
+	context->vaddress  = vmemory;
+	context->paddress  = pmemory;
+	context->pages     = pages;
+	context->sqHead    = 0;
+	context->cqTail    = 0;
+	context->sqEntries = entries;
+	context->cqEntries = entries * 2;
+	context->lock      = SPINLOCK_INIT;
+
+	process->ioring = context;
+	process_unlock(process);
+
+	return vmemory;
+
+ioSetupFailed:
+	process_unlock(process);
+
+	if(pmemory)
+		pm_free(pmemory, pages);
+
+	if(context)
+		hfree(NULL, context);
+
+	*errno = ENOMEM;
+	return -1;
+}
+
+// io_enter() signature:
+// int io_enter(uint32_t count)
+
+uint32_t _sc_ioEnter(__unused uint32_t *esp, uint32_t *uesp, int *errno)
+{
+	process_t *process = process_getCurrentProcess();
+	uint32_t count = *(uint32_t *)(uesp + 0);
+
+	ioring_context_t *context = process->ioring;
+	if(!context)
+	{
+		*errno = ENXIO;
+		return -1;
+	}
+
+	return ioring_submit(context, count, errno);
+}
+
+
+void _sc_ioringInit()
+{
+	sc_setSyscallHandler(SYS_IO_SETUP, _sc_ioSetup);
+	sc_setSyscallHandler(SYS_IO_ENTER, _sc_ioEnter);
+}
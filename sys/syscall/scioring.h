@@ -0,0 +1,99 @@
+//
+//  scioring.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _SCIORING_H_
+#define _SCIORING_H_
+
+#include <prefix.h>
+#include <system/lock.h>
+#include <memory/memory.h>
+
+struct process_s;
+
+/*
+ * Overview:
+ * An I/O ring is a pair of queues shared between a process and the kernel. Userland fills
+ * submission entries and advances sqTail, a single SYS_IO_ENTER then lets the kernel work
+ * through the whole batch and post one completion entry per submission, so a batch of n
+ * operations costs one kernel entry instead of n.
+ * The layout below is mirrored by libc's sys/ioring.h and must be kept in sync.
+ */
+
+#define kIORingMaxEntries 256 // Submission entries, the completion queue is twice as large
+
+#define IORING_OP_NOP   0
+#define IORING_OP_READ  1
+#define IORING_OP_WRITE 2
+#define IORING_OP_OPEN  3
+#define IORING_OP_CLOSE 4
+#define IORING_OP_STAT  5
+
+typedef struct ioring_sqe_s
+{
+	uint32_t opcode;
+	int32_t fd; // READ, WRITE and CLOSE
+	uint32_t address; // The buffer for READ and WRITE, the path for OPEN and STAT
+	uint32_t length; // The buffer size for READ and WRITE, the open flags for OPEN
+	uint32_t stat; // The vfs_stat_t to fill for STAT
+	uint32_t userData; // Passed through to the completion
+} ioring_sqe_t;
+
+typedef struct ioring_cqe_s
+{
+	uint32_t userData;
+	int32_t result;
+	int32_t error;
+} ioring_cqe_t;
+
+typedef struct ioring_s
+{
+	// Userland produces at sqTail, the kernel consumes at sqHead
+	uint32_t sqHead;
+	uint32_t sqTail;
+	uint32_t sqEntries;
+	uint32_t sqOffset; // Offset of the submission entries from the start of the ring
+
+	// The kernel produces at cqTail, userland consumes at cqHead
+	uint32_t cqHead;
+	uint32_t cqTail;
+	uint32_t cqEntries;
+	uint32_t cqOffset;
+} ioring_t;
+
+// Kernel side bookkeeping, the ring itself stays mapped into the kernel for its whole lifetime
+typedef struct ioring_context_s
+{
+	ioring_t *ring;
+	ioring_sqe_t *sqes;
+	ioring_cqe_t *cqes;
+
+	vm_address_t vaddress; // Address of the ring in the owning process
+	uintptr_t paddress;
+	size_t pages;
+
+	// Private copies of the kernel owned indices and the sizes, userland may scribble over the shared ones
+	uint32_t sqHead;
+	uint32_t cqTail;
+	uint32_t sqEntries;
+	uint32_t cqEntries;
+
+	spinlock_t lock;
+} ioring_context_t;
+
+void ioring_destroy(struct process_s *process);
+
+#endif /* _SCIORING_H_ */
@@ -19,6 +19,8 @@
 #include <libc/assert.h>
 #include <system/syslog.h>
 #include <libc/string.h>
+#include <libc/math.h>
+#include <loader/imagecache.h>
 
 #include "scmmap.h"
 #include "syscall.h"
@@ -36,6 +38,29 @@ uint32_t mmap_vmflagsForProtectionFlags(int protection)
 	return vmflags;
 }
 
+uint32_t mmap_vmflagsForDescription(mmap_description_t *description)
+{
+	// Shared frames must never become writeable, no matter what the protection says
+	if(description->file)
+		return VM_FLAGS_USERLAND_R;
+
+	return mmap_vmflagsForProtectionFlags(description->protection);
+}
+
+// Maps all pages of the description with the given flags
+void mmap_mapDescription(vm_page_directory_t pdirectory, mmap_description_t *description, uint32_t vmflags)
+{
+	size_t pages = VM_PAGE_COUNT(description->length);
+
+	if(description->file)
+	{
+		ld_imageFileMapPages(description->file, pdirectory, description->paddress / VM_PAGE_SIZE, description->vaddress, pages, vmflags);
+		return;
+	}
+
+	vm_mapPageRange(pdirectory, description->paddress, description->vaddress, pages, vmflags);
+}
+
 bool mmap_copyMappings(process_t *target, process_t *source)
 {
 	list_lock(target->mappings);
@@ -47,11 +72,25 @@ bool mmap_copyMappings(process_t *target, process_t *source)
 		mmap_description_t *dstDescription = list_addBack(target->mappings);
 
 		size_t pages = VM_PAGE_COUNT(srcDescription->length);
-		dstDescription->paddress   = pm_alloc(pages);
+		dstDescription->process    = target;
 		dstDescription->vaddress   = srcDescription->vaddress;
 		dstDescription->protection = srcDescription->protection;
 		dstDescription->length     = srcDescription->length;
 
+		if(srcDescription->file)
+		{
+			// Shared frames stay shared
+			dstDescription->paddress = srcDescription->paddress;
+			dstDescription->file     = srcDescription->file;
+
+			ld_imageFileRetain(dstDescription->file);
+			mmap_mapDescription(target->pdirectory, dstDescription, VM_FLAGS_USERLAND_R);
+
+			srcDescription = srcDescription->listNext;
+			continue;
+		}
+
+		dstDescription->paddress = pm_alloc(pages);
 		vm_mapPageRange(target->pdirectory, dstDescription->paddress, dstDescription->vaddress, pages, mmap_vmflagsForProtectionFlags(dstDescription->protection));
 
 		// Copy the mappings content
@@ -63,7 +102,7 @@ bool mmap_copyMappings(process_t *target, process_t *source)
 		vm_free(vm_getKernelDirectory(), (vm_address_t)srcmem, pages);
 		vm_free(vm_getKernelDirectory(), (vm_address_t)dstmem, pages);
 
-		srcDescription = srcDescription->next;
+		srcDescription = srcDescription->listNext;
 	}
 
 	list_unlock(source->mappings);
@@ -98,10 +137,14 @@ void mmap_splitDescription(mmap_description_t *description, vm_address_t address
 		next->protection = description->protection;
 		next->next       = description->next;
 		next->process    = description->process;
+		next->file       = description->file;
 
 		description->length = description->length - next->length;
 		description->next = next;
 
+		if(next->file)
+			ld_imageFileRetain(next->file);
+
 		if(nextOut)
 			*nextOut = next;
 	}
@@ -114,12 +157,16 @@ void mmap_splitDescription(mmap_description_t *description, vm_address_t address
 		prev->protection = description->protection;
 		prev->prev       = description->prev;
 		prev->process    = description->process;
+		prev->file       = description->file;
 
 		description->vaddress = prev->vaddress + prev->length;
 		description->paddress = prev->paddress + prev->length;
 		description->length   = description->length - prev->length;
 		description->prev     = prev;
 
+		if(prev->file)
+			ld_imageFileRetain(prev->file);
+
 		if(prevOut)
 			*prevOut = prev;
 	}
@@ -132,6 +179,7 @@ void mmap_splitDescription(mmap_description_t *description, vm_address_t address
 		prev->protection = description->protection;
 		prev->prev       = description->prev;
 		prev->process    = description->process;
+		prev->file       = description->file;
 
 		mmap_description_t *next = list_addBack(process->mappings);
 		next->paddress   = description->paddress + length;
@@ -140,6 +188,7 @@ void mmap_splitDescription(mmap_description_t *description, vm_address_t address
 		next->protection = description->protection;
 		next->next       = description->next;
 		next->process    = description->process;
+		next->file       = description->file;
 
 		description->vaddress = prev->vaddress + prev->length;
 		description->paddress = prev->paddress + prev->length;
@@ -147,6 +196,12 @@ void mmap_splitDescription(mmap_description_t *description, vm_address_t address
 		description->prev     = prev;
 		description->next     = next;
 
+		if(description->file)
+		{
+			ld_imageFileRetain(prev->file);
+			ld_imageFileRetain(next->file);
+		}
+
 		if(nextOut)
 			*nextOut = next;
 
@@ -163,6 +218,9 @@ void mmap_joinDescription(mmap_description_t *description, mmap_description_t *j
 
 	process_t *process = (process_t *)description->process;
 
+	if(joining->file)
+		ld_imageFileRelease(joining->file);
+
 	if(description->next == joining)
 	{
 		description->next = joining->next;
@@ -223,6 +281,57 @@ bool mmap_tryJoinFragments(mmap_description_t *description, vm_address_t address
 	return false;
 }
 
+vm_address_t mmap_mapMemory(process_t *process, uintptr_t pmemory, size_t pages, uintptr_t address, uint32_t vmflags)
+{
+	vm_address_t vmemory = 0x0;
+	if(address != 0x0)
+	{
+		// todo: This could be done more elegant, but does the trick for the meantime...
+		vmemory = vm_allocLimit(process->pdirectory, pmemory, pages, (vm_address_t)address, VM_UPPER_LIMIT, vmflags);
+
+		if(!vmemory)
+			vmemory = vm_alloc(process->pdirectory, pmemory, pages, vmflags);
+	}
+	else
+	{
+		vmemory = vm_alloc(process->pdirectory, pmemory, pages, vmflags);
+	}
+
+	return vmemory;
+}
+
+// Copies the file contents starting at offset into the frames at pmemory
+bool mmap_copyFile(ld_image_file_t *file, uintptr_t pmemory, size_t pages, uint32_t offset)
+{
+	size_t first = offset / VM_PAGE_SIZE;
+	if(first >= file->pages)
+		return true;
+
+	size_t count = MIN(pages, file->pages - first);
+
+	void *srcmem = (void *)ld_imageFileMapKernel(file, first, count);
+	void *dstmem = (void *)vm_alloc(vm_getKernelDirectory(), pmemory, count, VM_FLAGS_KERNEL);
+
+	if(!srcmem || !dstmem)
+	{
+		if(srcmem)
+			vm_free(vm_getKernelDirectory(), (vm_address_t)srcmem, count);
+
+		if(dstmem)
+			vm_free(vm_getKernelDirectory(), (vm_address_t)dstmem, count);
+
+		return false;
+	}
+
+	// The image cache zero pads the last page, so whole pages can be copied
+	memcpy(dstmem, srcmem, count * VM_PAGE_SIZE);
+
+	vm_free(vm_getKernelDirectory(), (vm_address_t)srcmem, count);
+	vm_free(vm_getKernelDirectory(), (vm_address_t)dstmem, count);
+
+	return true;
+}
+
 // mmap() signature:
 // void *mmap(void *addr, size_t length, int prot, int flags, int fd, uint32_t offset)
 
@@ -236,9 +345,8 @@ uint32_t _sc_mmap(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 	int protection    = *((int *)(uesp + 2));
 	int flags         = *((int *)(uesp + 3));
 
-	// Unused stuff
-	__unused int filed         = *((int *)(uesp + 4));
-	__unused uint32_t offset   = *((int *)(uesp + 5));
+	int filed         = *((int *)(uesp + 4));
+	uint32_t offset   = *((int *)(uesp + 5));
 
 	list_lock(process->mappings);
 	mmap_description_t *description = list_addBack(process->mappings);
@@ -254,69 +362,128 @@ uint32_t _sc_mmap(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 	description->process = process;
 
 	if((flags & MAP_PRIVATE) && (flags & MAP_SHARED))
+	{
+		*errno = EINVAL;
 		goto mmapFailed;
+	}
 
-	if((flags & MAP_PRIVATE) && (flags & MAP_ANONYMOUS))
+	if((flags & MAP_PRIVATE) && !(flags & MAP_ANONYMOUS))
 	{
-		// Check if address and length are on an 4k aligned
-		if((address % 4096) != 0 || (length % 4096) != 0)
+		if((address % 4096) != 0 || (offset % 4096) != 0 || length == 0)
 		{
-			list_unlock(process->mappings);
-
 			*errno = EINVAL;
-			return MAP_FAILED;
+			goto mmapFailed;
 		}
 
-		// Get the right virtual memory flags for the requested protection bits
-		uint32_t vmflags = mmap_vmflagsForProtectionFlags(protection);
-
-		size_t pages      = VM_PAGE_COUNT(length);
-		uintptr_t pmemory = pm_alloc(pages);
-
-		if(!pmemory)
-		{
-			*errno = ENOMEM;
+		ld_image_file_t *file = ld_imageFileWithDescriptor(filed, errno);
+		if(!file)
 			goto mmapFailed;
-		}
 
+		size_t pages = VM_PAGE_COUNT(length);
+		uintptr_t pmemory;
+		uint32_t vmflags;
 
-		vm_address_t vmemory = 0x0;
-		if(address != 0x0)
+		if(!(protection & PROT_WRITE))
 		{
-			// todo: This could be done more elegant, but does the trick for the meantime...
-			vmemory = vm_allocLimit(process->pdirectory, pmemory, pages, (vm_address_t)address, VM_UPPER_LIMIT, vmflags);
+			// Read-only mappings use the frames of the image cache
+			if((offset / VM_PAGE_SIZE) + pages > file->pages)
+			{
+				ld_imageFileRelease(file);
+
+				*errno = ENXIO;
+				goto mmapFailed;
+			}
 
-			if(!vmemory)
-				vmemory = vm_alloc(process->pdirectory, pmemory, pages, vmflags);
+			pmemory = file->frames[offset / VM_PAGE_SIZE];
+			vmflags = VM_FLAGS_USERLAND_R;
 		}
 		else
 		{
-			vmemory = vm_alloc(process->pdirectory, pmemory, pages, vmflags);
+			pmemory = pm_allocZeroed(pages);
+			if(!pmemory)
+			{
+				ld_imageFileRelease(file);
+
+				*errno = ENOMEM;
+				goto mmapFailed;
+			}
+
+			bool copied = mmap_copyFile(file, pmemory, pages, offset);
+			ld_imageFileRelease(file);
+
+			if(!copied)
+			{
+				pm_free(pmemory, pages);
+
+				*errno = ENOMEM;
+				goto mmapFailed;
+			}
+
+			file = NULL;
+			vmflags = mmap_vmflagsForProtectionFlags(protection);
 		}
 
+		vm_address_t vmemory = mmap_mapMemory(process, pmemory, pages, address, vmflags);
 		if(!vmemory)
 		{
+			if(file)
+			{
+				ld_imageFileRelease(file);
+			}
+			else
+			{
+				pm_free(pmemory, pages);
+			}
+
 			*errno = ENOMEM;
+			goto mmapFailed;
+		}
 
-			pm_free(pmemory, pages);
+		description->vaddress   = vmemory;
+		description->paddress   = file ? offset : pmemory;
+		description->length     = pages * VM_PAGE_SIZE;
+		description->protection = protection;
+		description->file       = file;
+
+		// The frames of the image cache aren't contiguous, remap them page by page
+		if(file)
+			mmap_mapDescription(process->pdirectory, description, vmflags);
+
+		list_unlock(process->mappings);
+		return vmemory;
+	}
+
+	if((flags & MAP_PRIVATE) && (flags & MAP_ANONYMOUS))
+	{
+		// Check if address and length are on an 4k aligned
+		if((address % 4096) != 0 || (length % 4096) != 0)
+		{
+			*errno = EINVAL;
 			goto mmapFailed;
 		}
 
+		// Get the right virtual memory flags for the requested protection bits
+		uint32_t vmflags = mmap_vmflagsForProtectionFlags(protection);
+
+		size_t pages      = VM_PAGE_COUNT(length);
+		uintptr_t pmemory = pm_allocZeroed(pages);
 
-		// Map the memory also in kernel address space and initialize it with zeroes
-		void *memory = (void *)vm_alloc(vm_getKernelDirectory(), pmemory, pages, VM_FLAGS_KERNEL);
-		if(!memory)
+		if(!pmemory)
 		{
 			*errno = ENOMEM;
+			goto mmapFailed;
+		}
 
-			vm_free(process->pdirectory, vmemory, pages);
-			pm_free(pmemory, pages);
 
+		vm_address_t vmemory = mmap_mapMemory(process, pmemory, pages, address, vmflags);
+		if(!vmemory)
+		{
+			*errno = ENOMEM;
+
+			pm_free(pmemory, pages);
 			goto mmapFailed;
 		}
 
-		memset(memory, 0, pages * VM_PAGE_SIZE);
-		vm_free(vm_getKernelDirectory(), (vm_address_t)memory, pages);
 
 		// Update the description
 		description->vaddress   = vmemory;
@@ -359,12 +526,14 @@ uint32_t _sc_munmap(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 	mmap_description_t *description = list_first(process->mappings); 
 	while(description)
 	{
-		if(description->vaddress >= address && address <= description->vaddress + description->length)
+		if(address >= description->vaddress && address < description->vaddress + description->length)
 		{
 			if(address + length > description->vaddress + description->length)
 			{
 				if(!mmap_tryJoinFragments(description, address, length))
 				{
+					list_unlock(process->mappings);
+
 					*errno = ENOMEM;
 					return -1;
 				}
@@ -374,14 +543,23 @@ uint32_t _sc_munmap(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 			size_t pages = VM_PAGE_COUNT(description->length);
 
 			vm_free(process->pdirectory, description->vaddress, pages);
-			pm_free(description->vaddress, pages);
+
+			// Shared frames belong to the image cache
+			if(description->file)
+			{
+				ld_imageFileRelease(description->file);
+			}
+			else
+			{
+				pm_free(description->paddress, pages);
+			}
 
 			list_remove(process->mappings, description);
 			list_unlock(process->mappings);
 			return 0;
 		}
 
-		description = description->next;
+		description = description->listNext;
 	}
 
 	list_unlock(process->mappings);
@@ -414,30 +592,38 @@ uint32_t _sc_mprotect(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 	mmap_description_t *description = list_first(process->mappings); 
 	while(description)
 	{
-		if(description->vaddress >= address && address <= description->vaddress + description->length)
+		if(address >= description->vaddress && address < description->vaddress + description->length)
 		{
+			if(description->file && (protection & PROT_WRITE))
+			{
+				list_unlock(process->mappings);
+
+				*errno = EACCES;
+				return -1;
+			}
+
 			if(address + length > description->vaddress + description->length)
 			{
 				if(!mmap_tryJoinFragments(description, address, length))
 				{
+					list_unlock(process->mappings);
+
 					*errno = ENOMEM;
 					return -1;
 				}
 			}
 
 			mmap_splitDescription(description, address, length, NULL, NULL);
-
-			uint32_t vmflags = mmap_vmflagsForProtectionFlags(protection);
-			size_t pages = VM_PAGE_COUNT(description->length);
-
-			vm_mapPageRange(process->pdirectory, description->paddress, description->vaddress, pages, vmflags);
 			description->protection = protection;
 
+			uint32_t vmflags = mmap_vmflagsForDescription(description);
+			mmap_mapDescription(process->pdirectory, description, vmflags);
+
 			list_unlock(process->mappings);
 			return 0;
 		}
 
-		description = description->next;
+		description = description->listNext;
 	}
 
 	list_unlock(process->mappings);
@@ -31,19 +31,25 @@
 
 #define MAP_SHARED    0x0001 // Not supported yet
 #define MAP_PRIVATE   0x0002
-#define MAP_ANONYMOUS 	0x0004 // Must be specified because of lack of file descriptors
+#define MAP_ANONYMOUS 	0x0004
 #define MAP_FAILED		-1
 
+// File backed mappings are MAP_PRIVATE only. Without PROT_WRITE they map the frames of the image cache
+// directly and are shared between all processes mapping the same file, see loader/imagecache.h.
+// Writable file mappings get a private copy of the file contents.
+
 typedef struct mmap_description_s
 {
 	process_t *process; // Process of the mapping
 
 	vm_address_t vaddress;
-	uintptr_t paddress;
+	uintptr_t paddress; // Byte offset into the file for mappings with a file
 
 	size_t length; // In bytes
 	int protection; // mmap flags, not vmemory flags!
 
+	struct ld_image_file_s *file; // Set if the frames are shared with the image cache
+
 	// Used when the mmap is fragmented
 	struct mmap_description_s *next;
 	struct mmap_description_s *prev;
@@ -53,6 +59,7 @@ typedef struct mmap_description_s
 } mmap_description_t;
 
 uint32_t mmap_vmflagsForProtectionFlags(int protection);
+uint32_t mmap_vmflagsForDescription(mmap_description_t *description);
 bool mmap_copyMappings(process_t *target, process_t *source);
 
 #endif
@@ -16,6 +16,8 @@
 //  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 
+#include <libc/math.h>
+#include <libc/string.h>
 #include <scheduler/scheduler.h>
 #include <system/syslog.h>
 #include <system/panic.h>
@@ -77,12 +79,104 @@ uint32_t _sc_threadExit(uint32_t *esp, __unused uint32_t *uesp, __unused int *er
 	return 0;
 }
 
-uint32_t _sc_threadTLSArea(__unused uint32_t *esp, uint32_t *uesp, int *errno)
+uint32_t _sc_threadTLSArea(uint32_t *esp, uint32_t *uesp, int *errno)
 {
 	thread_t *thread = thread_getCurrentThread();
 	uint32_t pages = *(uint32_t *)(uesp + 0);
 
-	return thread_getTLSArea(thread, pages, errno);
+	uintptr_t pointer = thread_getTLSArea(thread, pages, errno);
+	if(pointer != (uintptr_t)-1)
+		thread_setTLSSegment(thread, (cpu_state_t *)*esp);
+
+	return pointer;
+}
+
+// int tls_template(const void *image, size_t imageSize, size_t size, size_t alignment)
+uint32_t _sc_threadTLSTemplate(uint32_t *esp, uint32_t *uesp, int *errno)
+{
+	process_t *process = process_getCurrentProcess();
+	thread_t *thread = thread_getCurrentThread();
+
+	const uint8_t *image = *(const uint8_t **)(uesp + 0);
+	size_t imageSize = *(size_t *)(uesp + 1);
+	size_t size      = *(size_t *)(uesp + 2);
+	size_t alignment = *(size_t *)(uesp + 3);
+
+	if(!process->image || process->image->tlsSize > 0)
+	{
+		*errno = EBUSY;
+		return -1;
+	}
+
+	if(imageSize > size || size > kLDMaxTLSSize)
+	{
+		*errno = EINVAL;
+		return -1;
+	}
+
+	// Copy the image into the kernel, page by page since the pages aren't necessarily physically contiguous
+	uint8_t *copy = NULL;
+	if(imageSize > 0)
+	{
+		copy = halloc(NULL, imageSize);
+		if(!copy)
+		{
+			*errno = ENOMEM;
+			return -1;
+		}
+
+		size_t copied = 0;
+		while(copied < imageSize)
+		{
+			vm_address_t virtual;
+			vm_address_t source = (vm_address_t)(image + copied);
+
+			uint8_t *mapped = sc_mapProcessMemory((const void *)source, &virtual, 1, errno);
+			if(!mapped)
+			{
+				hfree(NULL, copy);
+				return -1;
+			}
+
+			size_t left   = imageSize - copied;
+			size_t length = VM_PAGE_SIZE - (source - VM_PAGE_ALIGN_DOWN(source));
+			length = MIN(length, left);
+
+			memcpy(copy + copied, mapped, length);
+			vm_free(vm_getKernelDirectory(), virtual, 1);
+
+			copied += length;
+		}
+	}
+
+	if(!ld_exectuableSetTLSTemplate(process->image, copy, imageSize, size, alignment))
+	{
+		if(copy)
+			hfree(NULL, copy);
+
+		*errno = EINVAL;
+		return -1;
+	}
+
+	// Threads that already have a TLS area get it laid out again with the new static block
+	bool result = true;
+	spinlock_lock(&process->threadLock);
+
+	thread_t *temp = process->mainThread;
+	while(temp)
+	{
+		if(temp->tlsVirtual && thread_getTLSArea(temp, temp->tlsPages, errno) == (uintptr_t)-1)
+			result = false;
+
+		temp = temp->next;
+	}
+
+	spinlock_unlock(&process->threadLock);
+
+	if(thread->tlsVirtual)
+		thread_setTLSSegment(thread, (cpu_state_t *)*esp);
+
+	return result ? 0 : -1;
 }
 
 
@@ -101,4 +195,5 @@ void _sc_threadInit()
 	sc_setSyscallHandler(SYS_THREADJOIN, _sc_threadJoin);
 	sc_setSyscallHandler(SYS_THREADSELF, _sc_threadSelf);
 	sc_setSyscallHandler(SYS_TLS_AREA, _sc_threadTLSArea);
+	sc_setSyscallHandler(SYS_TLS_TEMPLATE, _sc_threadTLSTemplate);
 }
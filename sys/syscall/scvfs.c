@@ -29,17 +29,38 @@ uint32_t _sc_open(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 
 	vm_address_t virtual;
 
-	char *path = sc_mapProcessMemory(tpath, &virtual, 2, errno);
+	char *path = sc_mapProcessString(tpath, &virtual, errno);
+	if(!path)
+		return -1;
 	int fd = vfs_open(path, flags, errno);
 
-	vm_free(vm_getKernelDirectory(), virtual, 2);
+	vm_free(vm_getKernelDirectory(), virtual, kSCStringPages);
 	return (uint32_t)fd;
 }
 
-uint32_t _sc_close(__unused uint32_t *esp, uint32_t *uesp, __unused int *errno)
+uint32_t _sc_close(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 {
 	int fd = *(int *)(uesp + 0);
 	int result = vfs_close(fd);
+
+	if(result == -1)
+		*errno = EBADF;
+
+	return (uint32_t)result;
+}
+
+uint32_t _sc_dup(__unused uint32_t *esp, uint32_t *uesp, int *errno)
+{
+	int fd = *(int *)(uesp + 0);
+	int result = vfs_dup(fd, errno);
+	return (uint32_t)result;
+}
+
+uint32_t _sc_dup2(__unused uint32_t *esp, uint32_t *uesp, int *errno)
+{
+	int fd = *(int *)(uesp + 0);
+	int target = *(int *)(uesp + 1);
+	int result = vfs_dup2(fd, target, errno);
 	return (uint32_t)result;
 }
 
@@ -84,16 +105,28 @@ uint32_t _sc_readdir(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 	return (uint32_t)result;
 }
 
+uint32_t _sc_getdents(__unused uint32_t *esp, uint32_t *uesp, int *errno)
+{
+	int fd = *(int *)(uesp + 0);
+	void *ptr = *(void **)(uesp + 1);
+	size_t size = *(size_t *)(uesp + 2);
+
+	size_t result = vfs_getDents(fd, ptr, size, errno);
+	return (uint32_t)result;
+}
+
 
 uint32_t _sc_mkdir(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 {
 	const char *tpath = *(const char **)(uesp + 0);
 
 	vm_address_t virtual;
-	char *path = sc_mapProcessMemory(tpath, &virtual, 2, errno);
+	char *path = sc_mapProcessString(tpath, &virtual, errno);
+	if(!path)
+		return -1;
 
 	bool result = vfs_mkdir(path, errno);
-	vm_free(vm_getKernelDirectory(), virtual, 2);
+	vm_free(vm_getKernelDirectory(), virtual, kSCStringPages);
 
 	return result ? 0 : (size_t)-1;
 }
@@ -103,10 +136,12 @@ uint32_t _sc_remove(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 	const char *tpath = *(const char **)(uesp + 0);
 
 	vm_address_t virtual;
-	char *path = sc_mapProcessMemory(tpath, &virtual, 2, errno);
+	char *path = sc_mapProcessString(tpath, &virtual, errno);
+	if(!path)
+		return -1;
 
 	bool result = vfs_remove(path, errno);
-	vm_free(vm_getKernelDirectory(), virtual, 2);
+	vm_free(vm_getKernelDirectory(), virtual, kSCStringPages);
 
 	return result ? 0 : (size_t)-1;
 }
@@ -117,13 +152,21 @@ uint32_t _sc_move(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 	const char *tpath2 = *(const char **)(uesp + 1);
 
 	vm_address_t virtual1, virtual2;
-	char *path1 = sc_mapProcessMemory(tpath1, &virtual1, 2, errno);
-	char *path2 = sc_mapProcessMemory(tpath2, &virtual2, 2, errno);
+	char *path1 = sc_mapProcessString(tpath1, &virtual1, errno);
+	if(!path1)
+		return -1;
+
+	char *path2 = sc_mapProcessString(tpath2, &virtual2, errno);
+	if(!path2)
+	{
+		vm_free(vm_getKernelDirectory(), virtual1, kSCStringPages);
+		return -1;
+	}
 
 	bool result = vfs_move(path1, path2, errno);
 
-	vm_free(vm_getKernelDirectory(), virtual1, 2);
-	vm_free(vm_getKernelDirectory(), virtual2, 2);
+	vm_free(vm_getKernelDirectory(), virtual1, kSCStringPages);
+	vm_free(vm_getKernelDirectory(), virtual2, kSCStringPages);
 
 	return result ? 0 : (size_t)-1;
 }
@@ -134,10 +177,12 @@ uint32_t _sc_stat(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 	vfs_stat_t *stat = *(vfs_stat_t **)(uesp + 1);
 
 	vm_address_t virtual;
-	char *path = sc_mapProcessMemory(tpath, &virtual, 2, errno);
+	char *path = sc_mapProcessString(tpath, &virtual, errno);
+	if(!path)
+		return -1;
 
 	bool result = vfs_stat(path, stat, errno);
-	vm_free(vm_getKernelDirectory(), virtual, 2);
+	vm_free(vm_getKernelDirectory(), virtual, kSCStringPages);
 
 	return result ? 0 : (size_t)-1;
 }
@@ -147,10 +192,13 @@ void _sc_vfsInit()
 {
 	sc_setSyscallHandler(SYS_OPEN, _sc_open);
 	sc_setSyscallHandler(SYS_CLOSE, _sc_close);
+	sc_setSyscallHandler(SYS_DUP, _sc_dup);
+	sc_setSyscallHandler(SYS_DUP2, _sc_dup2);
 	sc_setSyscallHandler(SYS_READ, _sc_read);
 	sc_setSyscallHandler(SYS_WRITE, _sc_write);
 	sc_setSyscallHandler(SYS_SEEK, _sc_seek);
 	sc_setSyscallHandler(SYS_DIRREAD, _sc_readdir);
+	sc_setSyscallHandler(SYS_GETDENTS, _sc_getdents);
 	sc_setSyscallHandler(SYS_MKDIR, _sc_mkdir);
 	sc_setSyscallHandler(SYS_REMOVE, _sc_remove);
 	sc_setSyscallHandler(SYS_MOVE, _sc_move);
@@ -30,43 +30,114 @@ static syscall_callback_t _sc_syscalls[_SYS_MAXCALLS];
 uint32_t _sc_print(__unused uint32_t *esp, uint32_t *uesp, int *errno)
 {
 	vm_address_t virtual;
-	char *string = sc_mapProcessMemory(*(void **)(uesp), &virtual, 2, errno);
+	char *string = sc_mapProcessString(*(char **)(uesp), &virtual, errno);
 	if(!string)
 		return -1;
 
 	info("%s", string);
 
-	vm_free(vm_getKernelDirectory(), virtual, 2);
+	vm_free(vm_getKernelDirectory(), virtual, kSCStringPages);
 	return 0;
 }
 
+// Maps pages of the current process read-only into the kernel. Every page has to be backed, the pages
+// aren't necessarily physically contiguous so each one is mapped on its own
 void *sc_mapProcessMemory(const void *memory, vm_address_t *mappedBase, size_t pages, int *errno)
 {
 	process_t *process = process_getCurrentProcess();
 
-	vm_address_t virtual = VM_PAGE_ALIGN_DOWN((vm_address_t)memory);
-	vm_address_t offset  = ((vm_address_t)memory) - virtual;
-	uintptr_t physical;
+	vm_address_t base   = VM_PAGE_ALIGN_DOWN((vm_address_t)memory);
+	vm_address_t offset = ((vm_address_t)memory) - base;
 
-	if(virtual == 0x0)
+	if(base == 0x0)
 	{
 		*errno = EINVAL;
 		return NULL;
 	}
 
-	physical = vm_resolveVirtualAddress(process->pdirectory, virtual);
-	virtual  = vm_alloc(vm_getKernelDirectory(), physical, pages, VM_FLAGS_KERNEL);
+	for(size_t i=0; i<pages; i++)
+	{
+		if(!process_resolveAddress(process, base + (i * VM_PAGE_SIZE)))
+		{
+			*errno = EFAULT;
+			return NULL;
+		}
+	}
 
+	vm_address_t virtual = vm_alloc(vm_getKernelDirectory(), process_resolveAddress(process, base), pages, VM_PAGETABLEFLAG_PRESENT);
 	if(!virtual)
 	{
 		*errno = ENOMEM;
 		return NULL;
 	}
 
+	for(size_t i=1; i<pages; i++)
+	{
+		uintptr_t physical = process_resolveAddress(process, base + (i * VM_PAGE_SIZE));
+		vm_mapPage(vm_getKernelDirectory(), physical, virtual + (i * VM_PAGE_SIZE), VM_PAGETABLEFLAG_PRESENT);
+	}
+
 	*mappedBase = virtual;
 	return (void *)(virtual + offset);
 }
 
+// Like sc_mapProcessMemory() with kSCStringPages pages, but the second page only has to be backed if the
+// string doesn't end within the first one. Otherwise the first page is mapped a second time in its place,
+// so that the kernel never sees an unrelated frame
+char *sc_mapProcessString(const char *string, vm_address_t *mappedBase, int *errno)
+{
+	process_t *process = process_getCurrentProcess();
+
+	vm_address_t base   = VM_PAGE_ALIGN_DOWN((vm_address_t)string);
+	vm_address_t offset = ((vm_address_t)string) - base;
+
+	if(base == 0x0)
+	{
+		*errno = EINVAL;
+		return NULL;
+	}
+
+	uintptr_t physical = process_resolveAddress(process, base);
+	if(!physical)
+	{
+		*errno = EFAULT;
+		return NULL;
+	}
+
+	vm_address_t virtual = vm_alloc(vm_getKernelDirectory(), physical, kSCStringPages, VM_PAGETABLEFLAG_PRESENT);
+	if(!virtual)
+	{
+		*errno = ENOMEM;
+		return NULL;
+	}
+
+	char *mapped = (char *)(virtual + offset);
+	bool terminated = false;
+
+	for(size_t i=0; i<VM_PAGE_SIZE - offset; i++)
+	{
+		if(mapped[i] == '\0')
+		{
+			terminated = true;
+			break;
+		}
+	}
+
+	uintptr_t next = terminated ? physical : process_resolveAddress(process, base + VM_PAGE_SIZE);
+	if(!next)
+	{
+		vm_free(vm_getKernelDirectory(), virtual, kSCStringPages);
+
+		*errno = EFAULT;
+		return NULL;
+	}
+
+	vm_mapPage(vm_getKernelDirectory(), next, virtual + VM_PAGE_SIZE, VM_PAGETABLEFLAG_PRESENT);
+
+	*mappedBase = virtual;
+	return mapped;
+}
+
 
 /**
  * Syscall main entry point
@@ -113,6 +184,7 @@ void _sc_processInit();
 void _sc_threadInit();
 void _sc_mmapInit();
 void _sc_vfsInit();
+void _sc_ioringInit();
 
 bool sc_init(__unused void *data)
 {
@@ -124,6 +196,7 @@ bool sc_init(__unused void *data)
 	_sc_threadInit();
 	_sc_mmapInit();
 	_sc_vfsInit();
+	_sc_ioringInit();
 
 	return true;
 }
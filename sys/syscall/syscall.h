@@ -38,6 +38,7 @@
 #define SYS_THREADJOIN    10
 #define SYS_THREADSELF    11
 #define SYS_TLS_AREA      12
+#define SYS_TLS_TEMPLATE  13
 #define SYS_PROCESSCREATE 17
 #define SYS_PROCESSKILL   18
 #define SYS_MMAP          19
@@ -53,8 +54,16 @@
 #define SYS_REMOVE        29
 #define SYS_MOVE          30
 #define SYS_STAT          31
+#define SYS_GETDENTS      32
+#define SYS_DUP           33
+#define SYS_DUP2          34
+#define SYS_IO_SETUP      35
+#define SYS_IO_ENTER      36
+
+#define kSCStringPages 2 // Strings passed to syscalls may span at most this many pages
 
 void *sc_mapProcessMemory(const void *memory, vm_address_t *mappedBase, size_t pages, int *errno);
+char *sc_mapProcessString(const char *string, vm_address_t *mappedBase, int *errno);
 
 typedef uint32_t (*syscall_callback_t)(uint32_t *esp, uint32_t *uesp, int *errno);
 
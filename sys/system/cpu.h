@@ -165,6 +165,16 @@ static inline uint64_t cpu_readMSR(uint32_t msr)
 	return (low | (high << 31));
 }
 
+static inline uint64_t cpu_readTSC()
+{
+	uint32_t high;
+	uint32_t low;
+
+	__asm__ volatile("rdtsc" : "=a" (low), "=d" (high));
+
+	return (((uint64_t)high) << 32) | low;
+}
+
 
 void cpuid(struct cpuid_registers_s *registers);
 
@@ -312,6 +312,9 @@ typedef struct
 #define DT_LOPROC	0x70000000	/* Start of processor-specific */
 #define DT_HIPROC	0x7fffffff	/* End of processor-specific */
 #define	DT_PROCNUM	DT_MIPS_NUM	/* Most used by any processor */
+#define DT_GNU_HASH	0x6ffffef5	/* GNU-style hash table */
+
+#define DF_BIND_NOW	0x8		/* No lazy binding for this object (DT_FLAGS) */
 
 static inline uint32_t elf_hash(const char *name)
 {
@@ -336,4 +339,18 @@ static inline uint32_t elf_hash(const char *name)
 	return h;
 }
 
+static inline uint32_t elf_gnuHash(const char *name)
+{
+	uint8_t *buffer = (uint8_t *)name;
+	uint32_t h = 5381;
+
+	while(*buffer != '\0')
+	{
+		h = (h << 5) + h + *buffer;
+		buffer ++;
+	}
+
+	return h;
+}
+
 #endif /* _ELF_H_ */
@@ -38,6 +38,12 @@ void gdt_setEntry(uint64_t *gdt, int16_t index, uint32_t base, uint32_t limit, i
 	// Avoid tail call optimization in addition to the no inlining because that somehow results in strange crashes when compiled with LLVM/Clang 3.1
 }
 
+void gdt_setTLSBase(uint64_t *gdt, uint32_t base)
+{
+	// The segment spans the whole address space, so negative offsets from the thread pointer wrap around to the static TLS block
+	gdt_setEntry(gdt, GDT_TLS_ENTRY, base, 0xFFFFFFFF, GDT_FLAG_SEGMENT | GDT_FLAG_32_BIT | GDT_FLAG_DATASEG | GDT_FLAG_4K | GDT_FLAG_PRESENT | GDT_FLAG_RING3);
+}
+
 void gdt_init(uint64_t *gdt, struct tss_s *tss)
 {
 	struct 
@@ -59,6 +65,7 @@ void gdt_init(uint64_t *gdt, struct tss_s *tss)
 	gdt_setEntry(gdt, 4, 0x0, 0xFFFFFFFF, GDT_FLAG_SEGMENT | GDT_FLAG_32_BIT | GDT_FLAG_DATASEG | GDT_FLAG_4K | GDT_FLAG_PRESENT | GDT_FLAG_RING3);
 
 	gdt_setEntry(gdt, 5, (uint32_t)tss, sizeof(struct tss_s), GDT_FLAG_TSS | GDT_FLAG_PRESENT | GDT_FLAG_RING3);	
+	gdt_setTLSBase(gdt, 0x0);
 	
 	// Prepare the TSS
 	tss->esp0 = 0x0;
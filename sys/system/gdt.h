@@ -34,8 +34,12 @@
 #define GDT_FLAG_4K      	0x800
 #define GDT_FLAG_32_BIT  	0x400
 
-#define GDT_ENTRIES 		6
+#define GDT_ENTRIES 		7
+
+#define GDT_TLS_ENTRY 		6
+#define GDT_TLS_SELECTOR 	0x33 // Ring 3 data segment whose base is the thread pointer of the running thread
 
 void gdt_init(uint64_t *gdt, struct tss_s *tss);
+void gdt_setTLSBase(uint64_t *gdt, uint32_t base);
 
 #endif /* _GDT_H_ */
@@ -25,13 +25,16 @@
 #include <interrupts/trampoline.h>
 #include <scheduler/scheduler.h>
 #include <vfs/vfs.h>
+#include <vfs/ffs/ffs.h>
 #include "kernel.h"
 #include "helper.h"
+#include "symbols.h"
 #include "syslog.h"
 
 void *kern_data = NULL;
 elf_section_header_t *kern_stringTable = NULL;
 elf_section_header_t *kern_symbolTable = NULL;
+array_t *kern_symbolIndex = NULL;
 
 extern uintptr_t kernelBegin; // Marks the beginning of the kernel (set by the linker)
 extern uintptr_t kernelEnd;	// Marks the end of the kernel (also set by the linker)
@@ -89,29 +92,51 @@ void kern_loadKernelData()
 	if(!hasData)
 	{
 		int error;
-		int fd = vfs_open("/firedrake", O_RDONLY, &error);
-		if(fd >= 0)
-		{
-			size_t size = vfs_seek(fd, 0, SEEK_END, &error);
-			size_t pages = VM_PAGE_COUNT(size);
+		vfs_node_t *node = vfs_resolvePath("/firedrake", vfs_getKernelContext(), &error);
 
-			uint8_t *data = mm_alloc(vm_getKernelDirectory(), pages, VM_FLAGS_KERNEL);
-			kern_data = data;
+		if(node)
+		{
+			// The initrd is kept mapped, so the symbol table can be referenced in place
+			kern_data = (void *)ffs_nodeExternalData(node, NULL);
+		}
 
-			vfs_seek(fd, 0, SEEK_SET, &error);
-			
-			while(size > 0)
+		if(!kern_data)
+		{
+			int fd = vfs_open("/firedrake", O_RDONLY, &error);
+			if(fd >= 0)
 			{
-				size_t read = vfs_read(fd, data, size, &error);
+				size_t size = vfs_seek(fd, 0, SEEK_END, &error);
+				size_t pages = VM_PAGE_COUNT(size);
+
+				uint8_t *data = mm_alloc(vm_getKernelDirectory(), pages, VM_FLAGS_KERNEL);
+				kern_data = data;
+
+				vfs_seek(fd, 0, SEEK_SET, &error);
+				
+				while(size > 0)
+				{
+					size_t read = vfs_read(fd, data, size, &error);
+
+					size -= read;
+					data += read;
+				}
 
-				size -= read;
-				data += read;
+				vfs_close(fd);
 			}
+		}
 
+		if(kern_data)
+		{
 			kern_fetchStringTable();
 			kern_fetchSymbolTable();
 
-			vfs_close(fd);
+			if(kern_stringTable && kern_symbolTable)
+			{
+				elf_sym_t *symtab = (elf_sym_t *)(((char *)kern_data) + kern_symbolTable->sh_offset);
+				size_t symbols = kern_symbolTable->sh_size / kern_symbolTable->sh_entsize;
+
+				kern_symbolIndex = symbols_createIndex(symtab, symbols, kern_stringTable->sh_size);
+			}
 		}
 
 		hasData = true; // It doesn't matter if we have actual data or not, if the read failed, it will fail again
@@ -140,21 +165,14 @@ const char *kern_nameForAddress(uintptr_t address, io_library_t **outLibrary)
 
 	if(address >= kernelBeginVirt && address <= kernelEndVirt)
 	{
-		header = kern_fetchHeader();
-		symbol = (elf_sym_t *)(((char *)header) + kern_symbolTable->sh_offset);
-
-		size_t symbols = kern_symbolTable->sh_size / kern_symbolTable->sh_entsize;
+		if(!kern_symbolIndex)
+			return "???";
 
-		for(size_t i=0; i<symbols; i++, symbol++)
+		symbol = symbols_findExact(kern_symbolIndex, address);
+		if(symbol)
 		{
-			if(symbol->st_value == address)
-			{
-				if(symbol->st_name >= kern_stringTable->sh_size)
-					return "<corrupt>";
-
-				char *name = (symbol->st_name) ? ((char *)header) + kern_stringTable->sh_offset + symbol->st_name : "<null>";
-				return name;
-			}
+			header = kern_fetchHeader();
+			return ((char *)header) + kern_stringTable->sh_offset + symbol->st_name;
 		}
 	}
 	else
@@ -195,28 +213,11 @@ uintptr_t kern_resolveAddress(uintptr_t address)
 	vm_address_t kernelBeginVirt = (vm_address_t)&kernelBegin;
 	vm_address_t kernelEndVirt = (vm_address_t)&kernelEnd;
 
-	elf_header_t *header;
-	elf_sym_t *tsymbol;
-
 	if(address >= kernelBeginVirt && address <= kernelEndVirt)
 	{
-		header  = kern_fetchHeader();
-		tsymbol = (elf_sym_t *)(((char *)header) + kern_symbolTable->sh_offset);
-
-		size_t symbols = kern_symbolTable->sh_size / kern_symbolTable->sh_entsize;
-
-		while(address >= kernelBeginVirt)
-		{
-			elf_sym_t *symbol = tsymbol;
-
-			for(size_t i=0; i<symbols; i++, symbol++)
-			{
-				if(symbol->st_value == address)
-					return address;
-			}
-
-			address --;
-		}
+		elf_sym_t *symbol = kern_symbolIndex ? symbols_findClosest(kern_symbolIndex, address) : NULL;
+		if(symbol && symbol->st_value >= kernelBeginVirt)
+			return symbol->st_value;
 	}
 	else
 	{
@@ -0,0 +1,99 @@
+//
+//  symbols.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "symbols.h"
+
+static comparison_result_t symbols_compare(void *object1, void *object2)
+{
+	elf_sym_t *symbol1 = (elf_sym_t *)object1;
+	elf_sym_t *symbol2 = (elf_sym_t *)object2;
+
+	if(symbol1->st_value != symbol2->st_value)
+		return (symbol1->st_value < symbol2->st_value) ? kCompareLesserThan : kCompareGreaterThan;
+
+	// Keep aliases in symbol table order
+	if(symbol1 != symbol2)
+		return (symbol1 < symbol2) ? kCompareLesserThan : kCompareGreaterThan;
+
+	return kCompareEqualTo;
+}
+
+array_t *symbols_createIndex(elf_sym_t *symtab, size_t count, size_t strtabSize)
+{
+	array_t *index = array_create();
+	if(!index)
+		return NULL;
+
+	for(size_t i=0; i<count; i++)
+	{
+		elf_sym_t *symbol = &symtab[i];
+		uint8_t type = ELF32_ST_TYPE(symbol->st_info);
+
+		if(symbol->st_name == 0 || symbol->st_name >= strtabSize || symbol->st_shndx == SHN_UNDEF)
+			continue;
+
+		if(type == STT_SECTION || type == STT_FILE)
+			continue;
+
+		array_addObject(index, symbol);
+	}
+
+	array_sort(index, symbols_compare);
+	return index;
+}
+
+
+elf_sym_t *symbols_findClosest(array_t *index, uintptr_t value)
+{
+	size_t lower = 0;
+	size_t upper = array_count(index);
+
+	// Find the first symbol past the value
+	while(lower < upper)
+	{
+		size_t middle = lower + ((upper - lower) / 2);
+		elf_sym_t *symbol = array_objectAtIndex(index, middle);
+
+		if(symbol->st_value <= value)
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+
+	if(lower == 0)
+		return NULL;
+
+	// Walk back to the first alias
+	elf_sym_t *symbol = array_objectAtIndex(index, lower - 1);
+	while(lower > 1)
+	{
+		elf_sym_t *previous = array_objectAtIndex(index, lower - 2);
+		if(previous->st_value != symbol->st_value)
+			break;
+
+		symbol = previous;
+		lower --;
+	}
+
+	return symbol;
+}
+
+elf_sym_t *symbols_findExact(array_t *index, uintptr_t value)
+{
+	elf_sym_t *symbol = symbols_findClosest(index, value);
+	return (symbol && symbol->st_value == value) ? symbol : NULL;
+}
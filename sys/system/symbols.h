@@ -0,0 +1,40 @@
+//
+//  symbols.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _SYMBOLS_H_
+#define _SYMBOLS_H_
+
+#include <prefix.h>
+#include <container/array.h>
+#include "elf.h"
+
+/**
+ * Overview:
+ * A symbol index is an array of the named, defined symbols of a symbol table, sorted by their value.
+ * It answers "which symbol contains this address" with a binary search instead of a walk over the whole table,
+ * which is what backtraces and panics in driver code need. Lookups don't allocate and don't lock,
+ * so they are safe to use from a panic.
+ **/
+
+array_t *symbols_createIndex(elf_sym_t *symtab, size_t count, size_t strtabSize);
+
+// Returns the symbol with the greatest value lesser than or equal to value, or NULL.
+// Aliases resolve to the first of them in the symbol table
+elf_sym_t *symbols_findClosest(array_t *index, uintptr_t value);
+elf_sym_t *symbols_findExact(array_t *index, uintptr_t value);
+
+#endif /* _SYMBOLS_H_ */
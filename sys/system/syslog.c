@@ -16,21 +16,15 @@
 //  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 
-#include <libc/stdio.h>
 #include <kerneld/syslogd.h>
 #include "syslog.h"
 
-#define SYSLOG_BUFFER_SIZE 512
-
 void syslog(syslog_level_t level, const char *format, ...)
 {
-	char buffer[SYSLOG_BUFFER_SIZE];
-
 	va_list arguments;
 	va_start(arguments, format);
-	
-	vsnprintf(buffer, SYSLOG_BUFFER_SIZE, format, arguments);
-	syslogd_queueMessage(level, buffer);
+
+	syslogd_queueMessage(level, format, arguments); // Checks the level before touching the arguments
 
 	va_end(arguments);
 }
@@ -24,6 +24,7 @@ void _test_array_objectAdding();
 void _test_array_insertion();
 void _test_array_removal();
 void _test_array_stressTest();
+void _test_array_iteration();
 
 void test_array()
 {
@@ -34,6 +35,7 @@ void test_array()
 		kunit_test_suiteAddTest(arraySuite, kunit_testCreate("Insertion test", "Tests wether objects can be inserted to the array", _test_array_insertion));
 		kunit_test_suiteAddTest(arraySuite, kunit_testCreate("Removal test", "Tests wether objects can be removed from the array", _test_array_removal));
 		kunit_test_suiteAddTest(arraySuite, kunit_testCreate("Stress test", "Tests wether the array can handle large number of objects", _test_array_stressTest));
+		kunit_test_suiteAddTest(arraySuite, kunit_testCreate("Iteration test", "Tests iteration and bulk copies", _test_array_iteration));
 	}
 	kunit_test_suiteRun(arraySuite);
 }
@@ -173,3 +175,30 @@ void _test_array_stressTest()
 	array_destroy(array);
 }
 
+void _test_array_iteration()
+{
+	array_t *array = array_create();
+
+	for(uint32_t i=0; i<8; i++)
+	{
+		array_addObject(array, (void *)(0x100 * (i + 1)));
+	}
+
+	void *object;
+	uint32_t count = 0;
+
+	array_foreach(array, i, object)
+	{
+		KUAssertEquals(object, (void *)(0x100 * (i + 1)), "Iteration must return the objects in order.");
+		count ++;
+	}
+
+	KUAssertEquals(count, 8, "Iteration must visit all objects.");
+
+	void *buffer[8];
+	KUAssertEquals(array_copyObjects(array, buffer, 2, 8), 6, "Copying must stop at the end of the array.");
+	KUAssertEquals(buffer[0], (void *)0x300, "Copying must start at the index.");
+	KUAssertEquals(array_copyObjects(array, buffer, 8, 8), 0, "Copying past the end must copy nothing.");
+
+	array_destroy(array);
+}
@@ -24,6 +24,7 @@ void _test_atree_insertion();
 void _test_atree_iteration();
 void _test_atree_removal();
 void _test_atree_find();
+void _test_atree_findFloor();
 
 void test_atree()
 {
@@ -34,6 +35,7 @@ void test_atree()
 		kunit_test_suiteAddTest(atreeSuite, kunit_testCreate("Iteration test", "Tests wether atrees can be iterators over", _test_atree_iteration));
 		kunit_test_suiteAddTest(atreeSuite, kunit_testCreate("Removal test", "Tests wether data can be removed from atrees", _test_atree_removal));
 		kunit_test_suiteAddTest(atreeSuite, kunit_testCreate("Find test", "Tests wether data can be found in atrees", _test_atree_find));
+		kunit_test_suiteAddTest(atreeSuite, kunit_testCreate("Floor test", "Tests wether the closest lower key can be found in atrees", _test_atree_findFloor));
 	}
 	kunit_test_suiteRun(atreeSuite);
 }
@@ -92,6 +94,30 @@ void _test_atree_iteration()
 	}
 
 	iterator_destroy(iterator);
+
+	// Cursors must visit every object in key order, including the one stored as NULL
+	atree_cursor_t cursor;
+	uint32_t count = 0;
+
+	atree_foreach(tree, cursor, ptr)
+	{
+		KUAssertEquals(ptr, (void *)(count * 0x100), "The cursor must return the objects in ascending order");
+		count ++;
+	}
+
+	KUAssertEquals(count, 10, "The cursor must visit 10 objects");
+
+	atree_foreachBackwards(tree, cursor, ptr)
+	{
+		count --;
+		KUAssertEquals(ptr, (void *)(count * 0x100), "The cursor must return the objects in descending order");
+	}
+
+	void *buffer[16];
+	KUAssertEquals(atree_copyObjects(tree, buffer, 4), 4, "Copying must stop at the buffer size");
+	KUAssertEquals(atree_copyObjects(tree, buffer, 16), 10, "Copying must return all objects");
+	KUAssertEquals(buffer[9], (void *)0x900, "Copied objects must be in ascending order");
+
 	atree_destroy(tree);
 }
 
@@ -136,3 +162,25 @@ void _test_atree_find()
 	atree_destroy(tree);
 }
 
+void _test_atree_findFloor()
+{
+	atree_t *tree = atree_create(_test_atree_comparator);
+
+	for(uint32_t i=1; i<10; i++)
+	{
+		void *ptr = (void *)(i * 0x100);
+		atree_insert(tree, ptr, ptr);
+	}
+
+	void *find1 = atree_findFloor(tree, (void *)(0x100));
+	void *find2 = atree_findFloor(tree, (void *)(0x3ff));
+	void *find3 = atree_findFloor(tree, (void *)(0x10000));
+	void *find4 = atree_findFloor(tree, (void *)(0x80));
+
+	KUAssertEquals(find1, (void *)(0x100), "The tree must find exact matches");
+	KUAssertEquals(find2, (void *)(0x300), "The tree must find the closest lower key");
+	KUAssertEquals(find3, (void *)(0x900), "The tree must find the closest lower key");
+	KUAssertNull(find4, "The atree must not find anything below the smallest key!");
+
+	atree_destroy(tree);
+}
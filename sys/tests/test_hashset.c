@@ -26,6 +26,7 @@ void _test_hashset_insertion();
 void _test_hashset_deletion();
 void _test_hashset_lookup();
 void _test_hashset_stressTest();
+void _test_hashset_resize();
 
 void test_hashset()
 {
@@ -36,6 +37,7 @@ void test_hashset()
 		kunit_test_suiteAddTest(hashsetSuite, kunit_testCreate("Deletion test", "Tests wether entries can be removed from hashsets", _test_hashset_deletion));
 		kunit_test_suiteAddTest(hashsetSuite, kunit_testCreate("Lookup test", "Tests wether lookups are working", _test_hashset_lookup));
 		kunit_test_suiteAddTest(hashsetSuite, kunit_testCreate("Stress test", "Stess tests the hashset", _test_hashset_stressTest));
+		kunit_test_suiteAddTest(hashsetSuite, kunit_testCreate("Resize test", "Tests lookups, removals and iteration while the hashset resizes", _test_hashset_resize));
 	}
 	kunit_test_suiteRun(hashsetSuite);
 }
@@ -138,3 +140,67 @@ void _test_hashset_stressTest()
 		hashset_destroy(set);
 	}
 }
+
+#define kHashsetResizeTestCount 2000
+
+void _test_hashset_resize()
+{
+	hashset_t *set = hashset_create(0, hash_integer, hash_integerCompare);
+
+	for(uint32_t i=0; i<kHashsetResizeTestCount; i++)
+	{
+		hashset_setObjectForKey(set, (void *)((i + 1) * 0x10), (const void *)i);
+
+		// Every key must stay reachable, regardless of the table it currently lives in
+		KUAssertEquals(hashset_objectForKey(set, (const void *)(i / 2)), (void *)(((i / 2) + 1) * 0x10), "The object must be equal!");
+	}
+
+	KUAssertEquals(hashset_count(set), kHashsetResizeTestCount, "The hashset must contain %i entries!", kHashsetResizeTestCount);
+
+	for(uint32_t i=0; i<kHashsetResizeTestCount; i+=2)
+		hashset_removeObjectForKey(set, (const void *)i);
+
+	KUAssertEquals(hashset_count(set), kHashsetResizeTestCount / 2, "The hashset must contain %i entries!", kHashsetResizeTestCount / 2);
+
+	for(uint32_t i=0; i<kHashsetResizeTestCount; i++)
+	{
+		void *object = hashset_objectForKey(set, (const void *)i);
+
+		if(i % 2)
+			KUAssertEquals(object, (void *)((i + 1) * 0x10), "The object must be equal!");
+		else
+			KUAssertNull(object, "The object must be NULL!");
+	}
+
+	uint32_t count = 0;
+	void *object;
+
+	iterator_t *iterator = hashset_iterator(set);
+	while((object = iterator_nextObject(iterator)))
+		count ++;
+
+	iterator_destroy(iterator);
+
+	KUAssertEquals(count, kHashsetResizeTestCount / 2, "The iterator must return %i objects!", kHashsetResizeTestCount / 2);
+
+	// The cursor has to cover both tables while a resize is in flight
+	hashset_cursor_t cursor;
+	count = 0;
+
+	hashset_foreach(set, cursor, object)
+	{
+		KUAssertEquals(hashset_objectForKey(set, cursor.bucket->key), object, "The cursor must return the object stored for the key!");
+		count ++;
+	}
+
+	KUAssertEquals(count, kHashsetResizeTestCount / 2, "The cursor must return %i objects!", kHashsetResizeTestCount / 2);
+
+	size_t size = (kHashsetResizeTestCount / 2) * sizeof(void *);
+	void **buffer = halloc(NULL, size);
+
+	KUAssertEquals(hashset_copyObjects(set, buffer, 10), 10, "Copying must stop at the buffer size!");
+	KUAssertEquals(hashset_copyObjects(set, buffer, kHashsetResizeTestCount), kHashsetResizeTestCount / 2, "Copying must return all objects!");
+
+	hfree(NULL, buffer);
+	hashset_destroy(set);
+}
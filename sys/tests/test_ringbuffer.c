@@ -0,0 +1,132 @@
+//
+//  test_ringbuffer.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <container/ringbuffer.h>
+#include <libc/string.h>
+#include "unittests.h"
+
+void _test_ringbuffer_creation();
+void _test_ringbuffer_readWrite();
+void _test_ringbuffer_wrapAround();
+void _test_ringbuffer_overflow();
+void _test_ringbuffer_reserveCommit();
+
+void test_ringbuffer()
+{
+	kunit_test_suite_t *ringbufferSuite = kunit_test_suiteCreate("Ringbuffer Tests", "Ringbuffer tests", true);
+	{
+		kunit_test_suiteAddTest(ringbufferSuite, kunit_testCreate("Creation test", "Tests wether ringbuffers can be created and are rounded to a power of two", _test_ringbuffer_creation));
+		kunit_test_suiteAddTest(ringbufferSuite, kunit_testCreate("Read/Write test", "Tests wether data can be written and read back", _test_ringbuffer_readWrite));
+		kunit_test_suiteAddTest(ringbufferSuite, kunit_testCreate("Wrap around test", "Tests writes and reads that cross the end of the buffer", _test_ringbuffer_wrapAround));
+		kunit_test_suiteAddTest(ringbufferSuite, kunit_testCreate("Overflow test", "Tests that writes which don't fit are rejected", _test_ringbuffer_overflow));
+		kunit_test_suiteAddTest(ringbufferSuite, kunit_testCreate("Reserve/Commit test", "Tests that reservations only become visible once committed, in order", _test_ringbuffer_reserveCommit));
+	}
+	kunit_test_suiteRun(ringbufferSuite);
+}
+
+void _test_ringbuffer_creation()
+{
+	ringbuffer_t *ringbuffer = ringbuffer_create(100, 0);
+
+	KUAssertNotNull(ringbuffer, "The ringbuffer must not be NULL!");
+	KUAssertEquals(ringbuffer->size, 128, "The size must be rounded up to a power of two!");
+	KUAssertEquals(ringbuffer_length(ringbuffer), 0, "The ringbuffer must be empty!");
+	KUAssertEquals(ringbuffer_space(ringbuffer), 128, "The whole ringbuffer must be free!");
+
+	ringbuffer_destroy(ringbuffer);
+}
+
+void _test_ringbuffer_readWrite()
+{
+	ringbuffer_t *ringbuffer = ringbuffer_create(64, 0);
+	char buffer[16];
+
+	KUAssertEquals(ringbuffer_write(ringbuffer, "Hello World", 12), 12, "The write must succeed!");
+	KUAssertEquals(ringbuffer_length(ringbuffer), 12, "The ringbuffer must contain 12 bytes!");
+
+	KUAssertEquals(ringbuffer_read(ringbuffer, buffer, 16), 12, "The read must return everything that was written!");
+	KUAssertTrue((strcmp(buffer, "Hello World") == 0), "The read data must match the written data!");
+	KUAssertEquals(ringbuffer_length(ringbuffer), 0, "The ringbuffer must be empty after the read!");
+
+	ringbuffer_destroy(ringbuffer);
+}
+
+void _test_ringbuffer_wrapAround()
+{
+	ringbuffer_t *ringbuffer = ringbuffer_create(16, 0);
+	uint8_t data[12];
+	uint8_t buffer[12];
+
+	for(int i=0; i<100; i++)
+	{
+		for(int j=0; j<12; j++)
+			data[j] = (uint8_t)(i + j);
+
+		KUAssertEquals(ringbuffer_write(ringbuffer, data, 12), 12, "The write must succeed!");
+		KUAssertEquals(ringbuffer_read(ringbuffer, buffer, 12), 12, "The read must succeed!");
+
+		for(int j=0; j<12; j++)
+			KUAssertEquals(buffer[j], data[j], "The read data must match the written data!");
+	}
+
+	ringbuffer_destroy(ringbuffer);
+}
+
+void _test_ringbuffer_overflow()
+{
+	ringbuffer_t *ringbuffer = ringbuffer_create(16, 0);
+	uint8_t data[16] = { 0 };
+
+	KUAssertEquals(ringbuffer_write(ringbuffer, data, 10), 10, "The first write must succeed!");
+	KUAssertEquals(ringbuffer_write(ringbuffer, data, 10), 0, "The second write mustn't fit!");
+	KUAssertEquals(ringbuffer_write(ringbuffer, data, 6), 6, "The remaining space must be usable!");
+	KUAssertEquals(ringbuffer_space(ringbuffer), 0, "The ringbuffer must be full!");
+
+	ringbuffer_destroy(ringbuffer);
+}
+
+void _test_ringbuffer_reserveCommit()
+{
+	ringbuffer_t *ringbuffer = ringbuffer_create(16, kRingbufferFlagMultiProducer);
+	ringbuffer_range_t first, second, peek;
+	char buffer[8];
+
+	ringbuffer_write(ringbuffer, "0123456789", 10);
+	ringbuffer_read(ringbuffer, buffer, 8);
+
+	KUAssertTrue(ringbuffer_reserve(ringbuffer, 4, &first), "The first reservation must succeed!");
+	KUAssertTrue(ringbuffer_reserve(ringbuffer, 8, &second), "The second reservation must succeed!");
+	KUAssertFalse(ringbuffer_reserve(ringbuffer, 4, &peek), "The third reservation mustn't fit!");
+	KUAssertEquals(second.length[0] + second.length[1], 8, "The reservation must cover the requested size!");
+	KUAssertEquals(second.length[1], 6, "The second reservation must wrap around!");
+
+	ringbuffer_rangeCopyIn(&first, 0, "abcd", 4);
+	ringbuffer_rangeCopyIn(&second, 0, "efghijkl", 8);
+	KUAssertEquals(ringbuffer_length(ringbuffer), 2, "Uncommitted data mustn't be visible!");
+
+	ringbuffer_commit(ringbuffer, &first);
+	ringbuffer_commit(ringbuffer, &second);
+	KUAssertEquals(ringbuffer_peek(ringbuffer, &peek), 14, "Committed data must be visible!");
+
+	ringbuffer_consume(ringbuffer, 2);
+	ringbuffer_read(ringbuffer, buffer, 4);
+	KUAssertTrue((strncmp(buffer, "abcd", 4) == 0), "The first reservation must come first!");
+	ringbuffer_read(ringbuffer, buffer, 8);
+	KUAssertTrue((strncmp(buffer, "efghijkl", 8) == 0), "The second reservation must come second!");
+
+	ringbuffer_destroy(ringbuffer);
+}
@@ -24,6 +24,7 @@ void test_array();
 void test_atree();
 void test_hashset();
 void test_list();
+void test_ringbuffer();
 
 void runUnitTests()
 {
@@ -37,4 +38,5 @@ void runUnitTests()
 	test_atree();
 	test_hashset();
 	test_list();
+	test_ringbuffer();
 }
@@ -18,6 +18,7 @@
 
 #include <errno.h>
 #include <libc/string.h>
+#include <libc/math.h>
 #include <scheduler/scheduler.h>
 #include "context.h"
 
@@ -58,50 +59,62 @@ void vfs_contextChangeDirectory(vfs_context_t *context, vfs_node_t *node)
 	context->chdir = node;
 }
 
-bool vfs_contextCopyDataOut(vfs_context_t *context, const void *data, size_t size, void *target, int *errno)
+// Copies between the kernel and the address space of the context one page at a time,
+// user memory is neither physically contiguous nor necessarily populated yet
+bool __vfs_contextCopyData(vfs_context_t *context, vm_address_t address, uint8_t *buffer, size_t size, bool toUser, int *errno)
 {
-	if(!data || !target || size == 0)
-	{
-		*errno = EINVAL;
-		return false;
-	}
+	process_t *process = process_getCurrentProcess();
+	if(process->pdirectory != context->pdirectory)
+		process = NULL;
 
-	if(context->pdirectory == vm_getKernelDirectory())
-	{
-		memcpy(target, data, size);
-		return true;
-	}
-	else
+	while(size > 0)
 	{
-		vm_address_t temp = (vm_address_t)data;
-		vm_address_t page = VM_PAGE_ALIGN_DOWN(temp);
+		vm_address_t page = VM_PAGE_ALIGN_DOWN(address);
 
-		size_t pages  = VM_PAGE_COUNT(size);
-		size_t offset = temp - page; 
+		size_t offset = address - page;
+		size_t length = MIN(size, VM_PAGE_SIZE - offset);
 
-		uintptr_t physical = vm_resolveVirtualAddress(context->pdirectory, page);
+		uintptr_t physical = process ? process_resolveAddress(process, page) : vm_resolveVirtualAddress(context->pdirectory, page);
 		if(!physical)
 		{
 			*errno = EINVAL;
 			return false;
 		}
 
-		vm_address_t tvirtual = vm_alloc(vm_getKernelDirectory(), physical, pages, VM_FLAGS_KERNEL);
-		if(!tvirtual)
+		// Read-only pages may be frames shared through the image cache, writing through the kernel alias would change them for everyone
+		if(toUser && !(vm_getPageFlags(context->pdirectory, page) & VM_PAGETABLEFLAG_WRITEABLE))
+		{
+			*errno = EFAULT;
+			return false;
+		}
+
+		uint8_t *mapped = (uint8_t *)vm_alloc(vm_getKernelDirectory(), physical, 1, VM_FLAGS_KERNEL);
+		if(!mapped)
 		{
 			*errno = ENOMEM;
 			return false;
 		}
 
-		void *mapped = (void *)(tvirtual + offset);
-		memcpy(target, mapped, size);
+		if(toUser)
+		{
+			memcpy(mapped + offset, buffer, length);
+		}
+		else
+		{
+			memcpy(buffer, mapped + offset, length);
+		}
+
+		vm_free(vm_getKernelDirectory(), (vm_address_t)mapped, 1);
 
-		vm_free(vm_getKernelDirectory(), tvirtual, pages);
-		return true;
+		address += length;
+		buffer  += length;
+		size    -= length;
 	}
+
+	return true;
 }
 
-bool vfs_contextCopyDataIn(vfs_context_t *context, const void *data, size_t size, void *target, int *errno)
+bool vfs_contextCopyDataOut(vfs_context_t *context, const void *data, size_t size, void *target, int *errno)
 {
 	if(!data || !target || size == 0)
 	{
@@ -114,32 +127,23 @@ bool vfs_contextCopyDataIn(vfs_context_t *context, const void *data, size_t size
 		memcpy(target, data, size);
 		return true;
 	}
-	else
-	{
-		vm_address_t temp = (vm_address_t)target;
-		vm_address_t page = VM_PAGE_ALIGN_DOWN(temp);
-
-		size_t pages  = VM_PAGE_COUNT(size);
-		size_t offset = temp - page; 
-
-		uintptr_t physical = vm_resolveVirtualAddress(context->pdirectory, page);
-		if(!physical)
-		{
-			*errno = EINVAL;
-			return false;
-		}
 
-		vm_address_t tvirtual = vm_alloc(vm_getKernelDirectory(), physical, pages, VM_FLAGS_KERNEL);
-		if(!tvirtual)
-		{
-			*errno = ENOMEM;
-			return false;
-		}
+	return __vfs_contextCopyData(context, (vm_address_t)data, (uint8_t *)target, size, false, errno);
+}
 
-		void *mapped = (void *)(tvirtual + offset);
-		memcpy(mapped, data, size);
+bool vfs_contextCopyDataIn(vfs_context_t *context, const void *data, size_t size, void *target, int *errno)
+{
+	if(!data || !target || size == 0)
+	{
+		*errno = EINVAL;
+		return false;
+	}
 
-		vm_free(vm_getKernelDirectory(), tvirtual, pages);
+	if(context->pdirectory == vm_getKernelDirectory())
+	{
+		memcpy(target, data, size);
 		return true;
 	}
+
+	return __vfs_contextCopyData(context, (vm_address_t)target, (uint8_t *)data, size, true, errno);
 }
@@ -0,0 +1,199 @@
+//
+//  dcache.c
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <libc/string.h>
+#include <container/hashset.h>
+#include <system/lock.h>
+#include "dcache.h"
+
+#define __vfs_dcacheBarrier() __asm__ volatile("" ::: "memory")
+
+typedef struct
+{
+	vfs_node_t *parent;
+	vfs_node_t *node; // NULL for negative entries
+	uint32_t hash;
+
+	uint8_t valid;
+	uint8_t length;
+	char name[kVFSDCacheMaxNameLength];
+} vfs_dcache_entry_t;
+
+static vfs_dcache_entry_t __vfs_dcacheEntries[kVFSDCacheSize];
+static vfs_dcache_statistics_t __vfs_dcacheStatistics;
+
+static spinlock_t __vfs_dcacheLock = SPINLOCK_INIT;
+static volatile uint32_t __vfs_dcacheSequence = 0; // Odd while a writer modifies the entries
+static volatile uint32_t __vfs_dcacheGeneration = 0; // Bumped on every invalidation
+
+static inline vfs_dcache_entry_t *__vfs_dcacheEntry(vfs_node_t *parent, uint32_t hash)
+{
+	uint32_t index = (hash ^ hash_integer(parent)) & (kVFSDCacheSize - 1);
+	return &__vfs_dcacheEntries[index];
+}
+
+static inline void __vfs_dcacheBeginWrite()
+{
+	__vfs_dcacheSequence ++;
+	__vfs_dcacheBarrier();
+}
+
+static inline void __vfs_dcacheEndWrite()
+{
+	__vfs_dcacheBarrier();
+	__vfs_dcacheSequence ++;
+}
+
+
+uint32_t vfs_dcacheHash(const char *name, size_t length)
+{
+	uint32_t result = 0;
+
+	for(size_t i=0; i<length; i++)
+	{
+		result += (uint8_t)name[i];
+		result += (result << 10);
+		result += (result >> 6);
+	}
+
+	result += (result << 3);
+	result += (result >> 11);
+	result += (result << 15);
+
+	return result;
+}
+
+uint32_t vfs_dcacheGeneration()
+{
+	return __vfs_dcacheGeneration;
+}
+
+
+vfs_dcache_result_t vfs_dcacheLookup(vfs_node_t *parent, const char *name, uint32_t hash, vfs_node_t **node)
+{
+	vfs_dcache_entry_t *slot = __vfs_dcacheEntry(parent, hash);
+	vfs_dcache_entry_t entry;
+
+	// Readers never wait for a writer, a lookup that races with one is simply treated as a miss
+	uint32_t sequence = __vfs_dcacheSequence;
+	__vfs_dcacheBarrier();
+
+	if(!(sequence & 1))
+	{
+		memcpy(&entry, slot, sizeof(vfs_dcache_entry_t));
+		__vfs_dcacheBarrier();
+
+		if(sequence == __vfs_dcacheSequence && entry.valid && entry.parent == parent && entry.hash == hash)
+		{
+			size_t length = strlen(name);
+			if(entry.length == length && strncmp(entry.name, name, length) == 0)
+			{
+				*node = entry.node;
+
+				if(entry.node)
+				{
+					__vfs_dcacheStatistics.hits ++;
+					return vfs_dcacheResultHit;
+				}
+
+				__vfs_dcacheStatistics.negativeHits ++;
+				return vfs_dcacheResultNegative;
+			}
+		}
+	}
+
+	__vfs_dcacheStatistics.misses ++;
+	return vfs_dcacheResultMiss;
+}
+
+void vfs_dcacheInsert(vfs_node_t *parent, const char *name, uint32_t hash, vfs_node_t *node, uint32_t generation)
+{
+	size_t length = strlen(name);
+	if(length >= kVFSDCacheMaxNameLength)
+		return;
+
+	spinlock_lock(&__vfs_dcacheLock);
+
+	// If the generation changed, the result of the lookup might already be stale
+	if(generation == __vfs_dcacheGeneration)
+	{
+		vfs_dcache_entry_t *entry = __vfs_dcacheEntry(parent, hash);
+
+		__vfs_dcacheBeginWrite();
+
+		entry->parent = parent;
+		entry->node   = node;
+		entry->hash   = hash;
+		entry->length = length;
+		entry->valid  = 1;
+
+		memcpy(entry->name, name, length);
+
+		__vfs_dcacheEndWrite();
+	}
+
+	spinlock_unlock(&__vfs_dcacheLock);
+}
+
+
+void vfs_dcacheInvalidate(vfs_node_t *parent, const char *name)
+{
+	size_t length = strlen(name);
+	uint32_t hash = vfs_dcacheHash(name, length);
+
+	spinlock_lock(&__vfs_dcacheLock);
+
+	__vfs_dcacheGeneration ++;
+	__vfs_dcacheStatistics.invalidations ++;
+
+	vfs_dcache_entry_t *entry = __vfs_dcacheEntry(parent, hash);
+	if(entry->valid && entry->parent == parent && entry->hash == hash)
+	{
+		__vfs_dcacheBeginWrite();
+		entry->valid = 0;
+		__vfs_dcacheEndWrite();
+	}
+
+	spinlock_unlock(&__vfs_dcacheLock);
+}
+
+void vfs_dcacheInvalidateDirectory(vfs_node_t *parent)
+{
+	spinlock_lock(&__vfs_dcacheLock);
+
+	__vfs_dcacheGeneration ++;
+	__vfs_dcacheStatistics.invalidations ++;
+
+	__vfs_dcacheBeginWrite();
+
+	for(size_t i=0; i<kVFSDCacheSize; i++)
+	{
+		vfs_dcache_entry_t *entry = &__vfs_dcacheEntries[i];
+		if(entry->parent == parent || entry->node == parent)
+			entry->valid = 0;
+	}
+
+	__vfs_dcacheEndWrite();
+
+	spinlock_unlock(&__vfs_dcacheLock);
+}
+
+
+void vfs_dcacheStatistics(vfs_dcache_statistics_t *statistics)
+{
+	memcpy(statistics, &__vfs_dcacheStatistics, sizeof(vfs_dcache_statistics_t));
+}
@@ -0,0 +1,60 @@
+//
+//  dcache.h
+//  Firedrake
+//
+//  Created by Sidney Just
+//  Copyright (c) 2013 by Sidney Just
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated 
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation 
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, 
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _VFS_DCACHE_H_
+#define _VFS_DCACHE_H_
+
+#include <prefix.h>
+#include "node.h"
+
+/*
+ * Overview:
+ * The dentry cache maps (parent directory, path component) pairs to the node that accessNode() returned for them,
+ * including negative entries for names that don't exist. Lookups are lock free and guarded by a sequence counter,
+ * writers serialize on a spinlock. Every change to a directory invalidates the affected entries.
+ */
+
+#define kVFSDCacheSize 1024 // Must be a power of two
+#define kVFSDCacheMaxNameLength 32 // Longer names are never cached
+
+typedef enum
+{
+	vfs_dcacheResultMiss,
+	vfs_dcacheResultHit,
+	vfs_dcacheResultNegative
+} vfs_dcache_result_t;
+
+typedef struct
+{
+	uint32_t hits;
+	uint32_t negativeHits;
+	uint32_t misses;
+	uint32_t invalidations;
+} vfs_dcache_statistics_t;
+
+uint32_t vfs_dcacheHash(const char *name, size_t length);
+uint32_t vfs_dcacheGeneration();
+
+vfs_dcache_result_t vfs_dcacheLookup(vfs_node_t *parent, const char *name, uint32_t hash, vfs_node_t **node);
+void vfs_dcacheInsert(vfs_node_t *parent, const char *name, uint32_t hash, vfs_node_t *node, uint32_t generation);
+
+void vfs_dcacheInvalidate(vfs_node_t *parent, const char *name);
+void vfs_dcacheInvalidateDirectory(vfs_node_t *parent);
+
+void vfs_dcacheStatistics(vfs_dcache_statistics_t *statistics);
+
+#endif /* _VFS_DCACHE_H_ */
@@ -21,6 +21,7 @@
 
 #include <prefix.h>
 #include <container/hashset.h>
+#include <vfs/filesystem.h>
 
 typedef struct
 {
@@ -29,4 +30,10 @@ typedef struct
 
 bool ffs_init();
 
+// Creates a file whose content is backed directly by the given memory instead of a copy.
+// The memory must stay valid for the lifetime of the node, the first write to the file copies it.
+vfs_node_t *ffs_createFileWithData(vfs_instance_t *instance, vfs_node_t *parent, const char *name, const void *data, size_t size, int *errno);
+// Returns the backing memory of a file created with ffs_createFileWithData() or NULL if the file has been written to since
+const void *ffs_nodeExternalData(vfs_node_t *node, size_t *size);
+
 #endif
@@ -21,6 +21,7 @@
 #include <libc/math.h>
 #include <memory/memory.h>
 #include <system/syslog.h>
+#include "ffs.h"
 #include "ffs_callbacks.h"
 #include "ffs_node.h"
 
@@ -63,6 +64,24 @@ vfs_node_t *ffs_createFile(vfs_instance_t *instance, __unused vfs_context_t *con
 	ffs_insertNode(instance, node);
 	return node;
 }
+vfs_node_t *ffs_createFileWithData(vfs_instance_t *instance, vfs_node_t *parent, const char *name, const void *data, size_t size, int *errno)
+{
+	vfs_node_t *node = vfs_nodeCreate(instance, name, vfs_nodeTypeFile, ffs_node_dataCreateWithData(data, size));
+	node->size = size;
+
+	if(parent)
+	{
+		if(!ffs_attachNode(parent, node, errno))
+		{
+			ffs_node_dataDestroy(node->data);
+			vfs_nodeDelete(node);
+			return NULL;
+		}
+	}
+
+	ffs_insertNode(instance, node);
+	return node;
+}
 vfs_node_t *ffs_createDirectory(vfs_instance_t *instance, __unused vfs_context_t *context, vfs_node_t *parent, const char *name, int *errno)
 {
 	vfs_node_t *node = vfs_nodeCreate(instance, name, vfs_nodeTypeDirectory, NULL);
@@ -174,6 +193,28 @@ bool ffs_nodeMove(__unused vfs_instance_t *instance, __unused vfs_context_t *con
 }
 
 
+const void *ffs_nodeExternalData(vfs_node_t *node, size_t *size)
+{
+	if(node->type != vfs_nodeTypeFile || !node->data)
+		return NULL;
+
+	vfs_nodeLock(node);
+
+	ffs_node_data_t *data = node->data;
+	const void *result = NULL;
+
+	if(data->external)
+	{
+		result = data->data;
+
+		if(size)
+			*size = data->size;
+	}
+
+	vfs_nodeUnlock(node);
+	return result;
+}
+
 bool ffs_nodeStat(__unused vfs_instance_t *instance, vfs_context_t *context, vfs_node_t *node, vfs_stat_t *stat, int *errno)
 {
 	bool result = vfs_nodeStat(node, context, stat, errno);
@@ -189,11 +230,12 @@ bool ffs_nodeStat(__unused vfs_instance_t *instance, vfs_context_t *context, vfs
 	return result;
 }
 
+// Cursor of an open directory. The last returned child is retained, so as long as it's still attached
+// the read can continue right after it, otherwise the entries are scanned for the next higher generation
 typedef struct
 {
-	vfs_directory_entry_t *entries;
-	size_t count;
-	size_t pages;
+	vfs_node_t *current;
+	uint32_t generation;
 } ffs_file_data_t;
 
 vfs_file_t *ffs_fileOpen(__unused vfs_instance_t *instance, __unused vfs_context_t *context, vfs_node_t *node, int flags, int *errno)
@@ -202,28 +244,9 @@ vfs_file_t *ffs_fileOpen(__unused vfs_instance_t *instance, __unused vfs_context
 
 	if(file && node->type == vfs_nodeTypeDirectory)
 	{
-		vfs_directory_t *directory = (vfs_directory_t *)node;
-		size_t count = hashset_count(directory->childs);
-		size_t pages = VM_PAGE_COUNT(count * sizeof(vfs_directory_entry_t));
-
-		vfs_directory_entry_t *data = mm_alloc(vm_getKernelDirectory(), pages, VM_FLAGS_KERNEL);
-		vfs_directory_entry_t *temp = data;
-
-		iterator_t *iterator = hashset_iterator(directory->childs);
-		vfs_node_t *entry;
-		while((entry = iterator_nextObject(iterator)))
-		{
-			strcpy(temp->name, entry->name);
-			temp->type = entry->type;
-			temp->id = entry->id;
-
-			temp ++;
-		}
-
 		ffs_file_data_t *ffsData = halloc(NULL, sizeof(ffs_file_data_t));
-		ffsData->entries = data;
-		ffsData->pages   = pages;
-		ffsData->count   = count;
+		ffsData->current = NULL;
+		ffsData->generation = 0;
 
 		file->data = ffsData;
 	}
@@ -233,8 +256,19 @@ vfs_file_t *ffs_fileOpen(__unused vfs_instance_t *instance, __unused vfs_context
 		ffs_node_data_t *data = node->data;
 		if(data)
 		{
+			vfs_nodeLock(node);
+
+			if(data->external)
+			{
+				data->data = NULL;
+				data->external = false;
+			}
+
 			data->size = 0;
 			node->size = 0;
+
+			vfs_nodeModified(node);
+			vfs_nodeUnlock(node);
 		}
 	}
 
@@ -245,7 +279,9 @@ void ffs_fileClose(__unused vfs_instance_t *instance, __unused vfs_context_t *co
 	if(file->data)
 	{
 		ffs_file_data_t *data = file->data;
-		mm_free(data->entries, vm_getKernelDirectory(), data->pages);
+		if(data->current)
+			vfs_nodeRelease(data->current);
+
 		hfree(NULL, data);
 	}
 
@@ -263,6 +299,9 @@ size_t ffs_fileWrite(__unused vfs_instance_t *instance, vfs_context_t *context,
 	{
 		file->node->size = node->size;
 		file->offset += written;
+
+		if(written > 0)
+			vfs_nodeModified(file->node);
 	}
 
 	vfs_nodeUnlock(file->node);
@@ -286,6 +325,32 @@ size_t ffs_fileRead(__unused vfs_instance_t *instance, vfs_context_t *context, v
 
 off_t ffs_fileSeek(__unused vfs_instance_t *instance, __unused vfs_context_t *context, vfs_file_t *file, off_t offset, int whence, int *errno)
 {
+	if(file->node->type == vfs_nodeTypeDirectory)
+	{
+		// Directories can only be rewound
+		if(whence != SEEK_SET || offset != 0)
+		{
+			*errno = EINVAL;
+			return -1;
+		}
+
+		vfs_nodeLock(file->node);
+
+		ffs_file_data_t *data = file->data;
+		vfs_node_t *current = data->current;
+
+		data->current = NULL;
+		data->generation = 0;
+		file->offset = 0;
+
+		vfs_nodeUnlock(file->node);
+
+		if(current)
+			vfs_nodeRelease(current);
+
+		return 0;
+	}
+
 	vfs_nodeLock(file->node);
 	ffs_node_data_t *node = file->node->data;
 
@@ -306,6 +371,8 @@ off_t ffs_fileSeek(__unused vfs_instance_t *instance, __unused vfs_context_t *co
 			break;
 
 		default:
+			vfs_nodeUnlock(file->node);
+
 			*errno = EINVAL;
 			return -1;
 	}
@@ -320,28 +387,68 @@ off_t ffs_fileSeek(__unused vfs_instance_t *instance, __unused vfs_context_t *co
 	return moved;
 }
 
-off_t ffs_dirRead(__unused vfs_instance_t *instance, vfs_context_t *context, vfs_file_t *file, vfs_directory_entry_t *entp, uint32_t count, int *errno)
+size_t ffs_dirRead(__unused vfs_instance_t *instance, __unused vfs_context_t *context, vfs_file_t *file, vfs_dirent_t *buffer, size_t size, uint32_t count, int *errno)
 {
+	vfs_directory_t *directory = (vfs_directory_t *)file->node;
+	ffs_file_data_t *data = file->data;
+
 	vfs_nodeLock(file->node);
-	ffs_file_data_t *node = file->data;
-	vfs_directory_entry_t *entries = node->entries + file->offset;
 
-	off_t read = 0;
-	uint32_t left = node->count - file->offset;
-	count = MIN(left, count);
-	
-	if(count > 0)
+	vfs_node_t *previous = data->current;
+	vfs_node_t *child;
+
+	if(previous && previous->parent == directory && previous->generation == data->generation)
+	{
+		child = previous->next;
+	}
+	else
+	{
+		child = list_first(directory->entries);
+		while(child && child->generation <= data->generation)
+			child = child->next;
+	}
+
+	uint8_t *entry = (uint8_t *)buffer;
+	size_t written = 0;
+
+	for(; child && count > 0; count --)
 	{
-		bool result = vfs_contextCopyDataIn(context, entries, count * sizeof(vfs_directory_entry_t), entp, errno);
-		read = -1;
+		size_t nameLength = strlen(child->name);
+		size_t length = VFS_DIRENT_LENGTH(nameLength);
 
-		if(result)
-		{
-			file->offset += count;
-			read = count;
-		}
+		if(length > size - written)
+			break;
+
+		vfs_dirent_t *dirent = (vfs_dirent_t *)(entry + written);
+		dirent->id = child->id;
+		dirent->length = length;
+		dirent->type = child->type;
+		dirent->nameLength = nameLength;
+
+		memcpy(dirent->name, child->name, nameLength + 1);
+
+		written += length;
+		file->offset ++;
+
+		data->current = child;
+		data->generation = child->generation;
+
+		child = child->next;
 	}
 
+	if(data->current != previous)
+		vfs_nodeRetain(data->current);
+
 	vfs_nodeUnlock(file->node);
-	return read;
+
+	if(previous && data->current != previous)
+		vfs_nodeRelease(previous);
+
+	if(written == 0 && child)
+	{
+		*errno = EINVAL; // The buffer can't hold the next entry
+		return -1;
+	}
+
+	return written;
 }
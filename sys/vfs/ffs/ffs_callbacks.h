@@ -38,6 +38,6 @@ void ffs_fileClose(vfs_instance_t *, vfs_context_t *, vfs_file_t *file);
 size_t ffs_fileWrite(vfs_instance_t *, vfs_context_t *context, vfs_file_t *file, const void *data, size_t size, int *errno);
 size_t ffs_fileRead(vfs_instance_t *, vfs_context_t *context, vfs_file_t *file, void *data, size_t size, int *errno);
 off_t ffs_fileSeek(vfs_instance_t *, vfs_context_t *context, vfs_file_t *file, off_t offset, int whence, int *errno);
-off_t ffs_dirRead(vfs_instance_t *instance, vfs_context_t *context, vfs_file_t *file, vfs_directory_entry_t *entp, uint32_t count, int *errno);
+size_t ffs_dirRead(vfs_instance_t *instance, vfs_context_t *context, vfs_file_t *file, vfs_dirent_t *buffer, size_t size, uint32_t count, int *errno);
 
 #endif
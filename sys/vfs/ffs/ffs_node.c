@@ -31,13 +31,25 @@ ffs_node_data_t *ffs_node_dataCreate()
 	data->data = NULL;
 	data->size = 0;
 	data->pages = 0;
+	data->external = false;
+
+	return data;
+}
+
+ffs_node_data_t *ffs_node_dataCreateWithData(const void *ptr, size_t size)
+{
+	ffs_node_data_t *data = halloc(NULL, sizeof(ffs_node_data_t));
+	data->data = (uint8_t *)ptr;
+	data->size = size;
+	data->pages = 0;
+	data->external = true;
 
 	return data;
 }
 
 void ffs_node_dataDestroy(ffs_node_data_t *data)
 {
-	if(data->data)
+	if(data->data && !data->external)
 		mm_free(data->data, vm_getKernelDirectory(), data->pages);
 
 	hfree(NULL, data);
@@ -45,6 +57,22 @@ void ffs_node_dataDestroy(ffs_node_data_t *data)
 
 void ffs_node_allocateMemory(ffs_node_data_t *data, size_t minSize)
 {
+	if(data->external)
+	{
+		// The data is borrowed, so the first write has to copy it into memory owned by the node
+		size_t pages = VM_PAGE_COUNT(MAX(minSize, data->size));
+		uint8_t *temp = mm_alloc(vm_getKernelDirectory(), pages, VM_FLAGS_KERNEL);
+
+		if(data->size > 0)
+			memcpy(temp, data->data, data->size);
+
+		data->data  = temp;
+		data->pages = pages;
+		data->external = false;
+
+		return;
+	}
+
 	if(!data->data)
 	{
 		size_t pages = VM_PAGE_COUNT(minSize);
@@ -97,10 +125,7 @@ size_t ffs_node_readData(ffs_node_data_t *data, vfs_context_t *context, size_t o
 	{
 		bool result = vfs_contextCopyDataIn(context, data->data + offset, size, ptr, errno);
 		if(result)
-		{
-			data->size += size;
 			return size;
-		}
 
 		return -1;
 	}
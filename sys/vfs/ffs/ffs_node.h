@@ -28,9 +28,11 @@ typedef struct
 	uint8_t *data;
 	size_t size;
 	size_t pages;
+	bool external; // data points to memory not owned by the node (eg. the initrd module), it's copied on the first write
 } ffs_node_data_t;
 
 ffs_node_data_t *ffs_node_dataCreate();
+ffs_node_data_t *ffs_node_dataCreateWithData(const void *ptr, size_t size);
 void ffs_node_dataDestroy(ffs_node_data_t *data);
 size_t ffs_node_writeData(ffs_node_data_t *data, vfs_context_t *context, size_t offset, const void *ptr, size_t size, int *errno);
 size_t ffs_node_readData(ffs_node_data_t *data, vfs_context_t *context, size_t offset, void *ptr, size_t size, int *errno);
@@ -31,7 +31,7 @@ struct vfs_descriptor_s;
 struct vfs_instance_s;
 struct vfs_context_s;
 struct vfs_file_s;
-struct vfs_directory_entry_s;
+struct vfs_dirent_s;
 
 typedef struct vfs_callbacks_s
 {
@@ -53,7 +53,8 @@ typedef struct vfs_callbacks_s
 	size_t (*fileWrite)(struct vfs_instance_s *instance, struct vfs_context_s *context, struct vfs_file_s *file, const void *data, size_t size, int *errno);
 	size_t (*fileRead)(struct vfs_instance_s *instance, struct vfs_context_s *context, struct vfs_file_s *file, void *data, size_t size, int *errno);
 	off_t (*fileSeek)(struct vfs_instance_s *instance, struct vfs_context_s *context, struct vfs_file_s *file, off_t offset, int whence, int *errno);
-	off_t (*dirRead)(struct vfs_instance_s *instance, struct vfs_context_s *context, struct vfs_file_s *file, struct vfs_directory_entry_s *entp, uint32_t count, int *errno);
+	// Fills the kernel buffer with as many vfs_dirent_t records as fit, but at most count, and returns the number of bytes used, or 0 at the end of the directory
+	size_t (*dirRead)(struct vfs_instance_s *instance, struct vfs_context_s *context, struct vfs_file_s *file, struct vfs_dirent_s *buffer, size_t size, uint32_t count, int *errno);
 } vfs_callbacks_t;
 
 typedef struct vfs_instance_s
@@ -23,6 +23,8 @@
 #include "fcntl.h"
 #include "descriptor.h"
 #include "filesystem.h"
+#include "context.h"
+#include "dcache.h"
 
 vfs_file_t *vfs_fileCreate(vfs_node_t *node, int flags, void *data, int *errno)
 {
@@ -47,6 +49,7 @@ vfs_file_t *vfs_fileCreate(vfs_node_t *node, int flags, void *data, int *errno)
 		file->flags = flags;
 		file->offset = 0;
 		file->data = data;
+		file->references = 1;
 
 		if(node->type == vfs_nodeTypeFile && (flags & O_APPEND))
 		{
@@ -63,6 +66,20 @@ void vfs_fileDelete(vfs_file_t *file)
 	hfree(NULL, file);
 }
 
+void vfs_fileRetain(vfs_file_t *file)
+{
+	__sync_add_and_fetch(&file->references, 1);
+}
+
+void vfs_fileRelease(vfs_file_t *file)
+{
+	if(__sync_sub_and_fetch(&file->references, 1) == 0)
+	{
+		struct vfs_instance_s *instance = file->node->instance;
+		instance->callbacks.fileClose(instance, vfs_getCurrentContext(), file);
+	}
+}
+
 
 
 vfs_node_t *vfs_nodeFresh(struct vfs_instance_s *instance, const char *name, size_t size)
@@ -81,6 +98,9 @@ vfs_node_t *vfs_nodeFresh(struct vfs_instance_s *instance, const char *name, siz
 	node->references = 1;
 	node->parent = NULL;
 	node->size = 0;
+	node->version = 0;
+	node->generation = 0;
+	node->next = node->prev = NULL;
 	node->atime = node->mtime = node->ctime = time_getTimestamp();
 
 	spinlock_unlock(&instance->lock);
@@ -104,6 +124,8 @@ vfs_node_t *vfs_nodeCreate(struct vfs_instance_s *instance, const char *name, vf
 		{
 			vfs_directory_t *directory = (vfs_directory_t *)vfs_nodeFresh(instance, name, sizeof(vfs_directory_t));
 			directory->childs = hashset_create(10, hash_cstring, hash_cstringCompare);
+			directory->entries = list_create(sizeof(vfs_node_t), offsetof(vfs_node_t, next), offsetof(vfs_node_t, prev));
+			directory->generation = 0;
 
 			node = (vfs_node_t *)directory;
 			break;
@@ -141,16 +163,19 @@ void vfs_nodeDelete(vfs_node_t *node)
 		case vfs_nodeTypeDirectory:
 		{
 			vfs_directory_t *directory = (vfs_directory_t *)node;
-			iterator_t *iterator = hashset_iterator(directory->childs);
 
-			while((node = iterator_nextObject(iterator)))
+			while((node = list_first(directory->entries)))
 			{
+				list_removeSoft(directory->entries, node);
+
 				node->parent = NULL;
 				vfs_nodeRelease(node);
 			}
 
-			iterator_destroy(iterator);
+			list_destroy(directory->entries);
 			hashset_destroy(directory->childs);
+
+			vfs_dcacheInvalidateDirectory((vfs_node_t *)directory);
 			break;
 		}
 
@@ -180,6 +205,12 @@ void vfs_nodeUnlock(vfs_node_t *node)
 	spinlock_unlock(&node->lock);
 }
 
+void vfs_nodeModified(vfs_node_t *node)
+{
+	node->version ++;
+	node->mtime = time_getTimestamp();
+}
+
 void vfs_nodeRetain(vfs_node_t *node)
 {
 	node->references ++;
@@ -204,8 +235,12 @@ bool vfs_directoryAttachNode(vfs_directory_t *directory, vfs_node_t *node)
 		return false;
 
 	hashset_setObjectForKey(directory->childs, node, node->name);
+	vfs_dcacheInvalidate((vfs_node_t *)directory, node->name);
 	vfs_nodeRetain(node);
 
+	node->generation = ++ directory->generation;
+	list_insertBack(directory->entries, node);
+
 	node->parent = directory;
 
 	return true;
@@ -216,6 +251,8 @@ bool vfs_directoryRemoveNode(vfs_directory_t *directory, vfs_node_t *node)
 	if(node->parent == directory)
 	{
 		hashset_removeObjectForKey(directory->childs, node->name);
+		vfs_dcacheInvalidate((vfs_node_t *)directory, node->name);
+		list_removeSoft(directory->entries, node);
 		node->parent = NULL;
 
 		vfs_nodeRelease(node);
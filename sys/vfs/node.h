@@ -23,6 +23,7 @@
 #include <system/lock.h>
 #include <system/time.h>
 #include <container/hashset.h>
+#include <container/list.h>
 
 #define kVFSMaxFilenameLength 256
 
@@ -60,6 +61,7 @@ typedef struct vfs_node_s
 	uint32_t references;
 	uint32_t id;
 	size_t size;
+	uint32_t version; // Bumped with every change of the content, see vfs_nodeModified()
 
 	timestamp_t atime;
 	timestamp_t mtime;
@@ -67,13 +69,20 @@ typedef struct vfs_node_s
 
 	struct vfs_directory_s *parent;
 	void *data;
+
+	// Position in the parents entry list
+	uint32_t generation;
+	struct vfs_node_s *next;
+	struct vfs_node_s *prev;
 } vfs_node_t;
 
 typedef struct vfs_directory_s
 {
 	vfs_node_t node;
 
-	hashset_t *childs;
+	hashset_t *childs; // Name lookup
+	list_t *entries; // The childs in the order they were attached, ascending by generation
+	uint32_t generation;
 } vfs_directory_t;
 
 typedef struct vfs_link_s
@@ -91,20 +100,39 @@ typedef struct vfs_directory_entry_s
 	vfs_node_type_t type;
 } vfs_directory_entry_t;
 
+// Compact, variable length directory entry. The name is NUL terminated and the length is padded to 4 bytes
+typedef struct vfs_dirent_s
+{
+	uint32_t id;
+	uint16_t length;
+	uint8_t type;
+	uint8_t nameLength;
+	char name[];
+} vfs_dirent_t;
+
+#define VFS_DIRENT_LENGTH(nameLength) ((sizeof(vfs_dirent_t) + (nameLength) + 1 + 3) & ~3)
+#define VFS_DIRENT_MAXLENGTH VFS_DIRENT_LENGTH(kVFSMaxFilenameLength - 1)
+
 typedef struct vfs_file_s
 {
 	vfs_node_t *node;
 	size_t offset;
 	int flags;
 	void *data;
+
+	uint32_t references; // One per file descriptor plus one per in-flight operation
 } vfs_file_t;
 
 vfs_file_t *vfs_fileCreate(vfs_node_t *node, int flags, void *data, int *errno);
 void vfs_fileDelete(vfs_file_t *file);
 
+void vfs_fileRetain(vfs_file_t *file);
+void vfs_fileRelease(vfs_file_t *file); // Closes the file through its instance once the last reference is gone
+
 
 void vfs_nodeLock(vfs_node_t *node);
 void vfs_nodeUnlock(vfs_node_t *node);
+void vfs_nodeModified(vfs_node_t *node); // Must be called with the node lock held
 
 // These methods don't lock the node, appropriate locking must be done by the caller!
 vfs_node_t *vfs_nodeCreate(struct vfs_instance_s *instance, const char *name, vfs_node_type_t type, void *data);
@@ -22,72 +22,72 @@
 #include <system/syslog.h>
 #include "filesystem.h"
 #include "path.h"
+#include "dcache.h"
 
 extern vfs_node_t *vfs_rootNode;
 
 vfs_node_t *vfs_resolvePath(const char *path, vfs_context_t *context, int *errno)
 {
-	vfs_path_t *request = vfs_pathCreate(path, context);
+	vfs_path_t request;
+	vfs_pathInit(&request, path, context);
 
-	while(vfs_pathNextElement(request, errno))
+	while(vfs_pathNextElement(&request, errno))
 	{}
 
-	vfs_node_t *node = vfs_pathCurrent(request);
-	vfs_pathDestroy(request);
-
-	return node;
+	return vfs_pathCurrent(&request);
 }
 
 vfs_node_t *vfs_resolvePathToParent(const char *path, vfs_context_t *context, char *name, int *errno)
 {
-	vfs_path_t *request = vfs_pathCreate(path, context);
+	vfs_path_t request;
 	vfs_node_t *node = NULL;
 
-	while(!vfs_pathIsAtEnd(request))
+	vfs_pathInit(&request, path, context);
+
+	while(!vfs_pathIsAtEnd(&request))
 	{
-		node = vfs_pathCurrent(request);
-		bool result = vfs_pathNextElement(request, errno);
+		node = vfs_pathCurrent(&request);
+		bool result = vfs_pathNextElement(&request, errno);
 
-		if(!result && !vfs_pathIsAtEnd(request))
+		if(!result && !vfs_pathIsAtEnd(&request))
 		{
 			*errno = ENOENT;
-
-			vfs_pathDestroy(request);
 			return NULL;
 		}
 
-		if(!result && vfs_pathIsAtEnd(request))
+		if(!result && vfs_pathIsAtEnd(&request))
 		{
 			if(name)
-				strcpy(name, vfs_pathCurrentName(request));
+				strcpy(name, vfs_pathCurrentName(&request));
 
-			vfs_pathDestroy(request);
 			return node;
 		}
 	}
 
 	if(name)
-		strcpy(name, vfs_pathCurrentName(request));
+		strcpy(name, vfs_pathCurrentName(&request));
 
-	vfs_pathDestroy(request);
 	return node ? (vfs_node_t *)node->parent : NULL;
 }
 
-vfs_path_t *vfs_pathCreate(const char *path, vfs_context_t *context)
+void vfs_pathInit(vfs_path_t *request, const char *path, vfs_context_t *context)
 {
 	assert(path);
 	assert(context);
 
+	request->path = (char *)path;
+	request->element = request->path;
+
+	request->context = context;
+	request->node  = context->chdir;
+	request->atEnd = false;
+}
+
+vfs_path_t *vfs_pathCreate(const char *path, vfs_context_t *context)
+{
 	vfs_path_t *request = halloc(NULL, sizeof(vfs_path_t));
 	if(request)
-	{
-		request->path = (char *)path;
-		request->element = request->path;
-
-		request->context = context;
-		request->node  = context->chdir;
-		request->atEnd = false;
-	}
+		vfs_pathInit(request, path, context);
 
 	return request;
 }
@@ -134,7 +134,9 @@ bool vfs_pathNextElement(vfs_path_t *path, int *errno)
 		element = path->element + strlen(path->element);
 	}
 
-	strlcpy(path->name, path->element, element - path->element);
+	size_t length = element - path->element;
+
+	strlcpy(path->name, path->element, length);
 	if(strcmp(path->name, "..") == 0)
 	{
 		path->node = (vfs_node_t *)path->node->parent;
@@ -142,8 +144,32 @@ bool vfs_pathNextElement(vfs_path_t *path, int *errno)
 	}
 	else
 	{
-		vfs_instance_t *instance = path->node->instance;
-		path->node = instance->callbacks.accessNode(instance, path->context, path->node, path->name, errno);
+		vfs_node_t *parent = path->node;
+		uint32_t hash = vfs_dcacheHash(path->name, length);
+
+		switch(vfs_dcacheLookup(parent, path->name, hash, &path->node))
+		{
+			case vfs_dcacheResultHit:
+				break;
+
+			case vfs_dcacheResultNegative:
+				path->node = NULL;
+				break;
+
+			case vfs_dcacheResultMiss:
+			{
+				uint32_t generation = vfs_dcacheGeneration();
+				vfs_instance_t *instance = parent->instance;
+
+				path->node = instance->callbacks.accessNode(instance, path->context, parent, path->name, errno);
+
+				// Links are resolved by their target instance, so only plain directory lookups are cached
+				if(parent->type == vfs_nodeTypeDirectory)
+					vfs_dcacheInsert(parent, path->name, hash, path->node, generation);
+
+				break;
+			}
+		}
 	}
 
 	path->element = element;
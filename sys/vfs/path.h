@@ -37,6 +37,7 @@ typedef struct
 
 vfs_node_t *vfs_resolvePath(const char *path, vfs_context_t *context, int *errno);
 vfs_node_t *vfs_resolvePathToParent(const char *path, vfs_context_t *context, char *name, int *errno);
+void vfs_pathInit(vfs_path_t *request, const char *path, vfs_context_t *context);
 vfs_path_t *vfs_pathCreate(const char *path, vfs_context_t *context);
 void vfs_pathDestroy(vfs_path_t *path);
 
@@ -21,6 +21,7 @@
 #include <memory/memory.h>
 #include <libc/string.h>
 #include <libc/stdio.h>
+#include <libc/math.h>
 #include <scheduler/process.h>
 #include <system/syslog.h>
 #include <system/helper.h>
@@ -52,8 +53,8 @@ bool vfs_unregisterFilesystem(const char *name)
 
 	list_lock(vfs_list);
 
-	vfs_descriptor_t *descriptor = list_first(vfs_list);
-	while(descriptor)
+	vfs_descriptor_t *descriptor;
+	list_foreach(vfs_list, descriptor)
 	{
 		if(strcmp(descriptor->name, name) == 0)
 		{
@@ -73,8 +74,6 @@ bool vfs_unregisterFilesystem(const char *name)
 
 			return true;
 		}
-
-		descriptor = descriptor->next;
 	}
 
 	list_unlock(vfs_list);
@@ -87,16 +86,14 @@ vfs_descriptor_t *vfs_filesystemWithName(const char *name)
 
 	list_lock(vfs_list);
 
-	vfs_descriptor_t *descriptor = list_first(vfs_list);
-	while(descriptor)
+	vfs_descriptor_t *descriptor;
+	list_foreach(vfs_list, descriptor)
 	{
 		if(strcmp(descriptor->name, name) == 0)
 		{
 			list_unlock(vfs_list);
 			return descriptor;
 		}
-
-		descriptor = descriptor->next;
 	}
 
 	list_unlock(vfs_list);
@@ -107,17 +104,28 @@ vfs_descriptor_t *vfs_filesystemWithName(const char *name)
 // File operations
 // --------
 
+// Installs the file for the descriptor vfs_open() reserved
+static int vfs_installFile(process_t *process, int filedescriptor, vfs_file_t *file, int *errno)
+{
+	if(!process_setFileForFiledescriptor(process, filedescriptor, file))
+	{
+		vfs_fileRelease(file);
+
+		*errno = EBADF;
+		return -1;
+	}
+
+	return filedescriptor;
+}
+
 int vfs_open(const char *path, int flags, int *errno)
 {
 	process_t *process = process_getCurrentProcess();
-	process_lock(process);
 
 	int filedescriptor = process_allocateFiledescriptor(process);
 	if(filedescriptor == -1)
 	{
 		*errno = EMFILE;
-		process_unlock(process);
-
 		return -1;
 	}
 
@@ -130,9 +138,7 @@ int vfs_open(const char *path, int flags, int *errno)
 		{	
 			*errno = EEXIST;
 
-			process_releaseFiledescriptor(process, filedescriptor);
-			process_unlock(process);
-
+			process_cancelFiledescriptor(process, filedescriptor);
 			return -1;
 		}
 
@@ -140,69 +146,70 @@ int vfs_open(const char *path, int flags, int *errno)
 		vfs_file_t *file = instance->callbacks.fileOpen(instance, context, node, flags, errno);
 		if(!file)
 		{
-			process_releaseFiledescriptor(process, filedescriptor);
-			process_unlock(process);
-
+			process_cancelFiledescriptor(process, filedescriptor);
 			return -1;
 		}
 
-		process_setFileForFiledescriptor(process, filedescriptor, file);
-		process_unlock(process);
-
-		return filedescriptor;
+		return vfs_installFile(process, filedescriptor, file, errno);
 	}
 
 	if(flags & O_CREAT)
 	{
 		char name[kVFSMaxFilenameLength];
-
 		vfs_node_t *parent = vfs_resolvePathToParent(path, context, name, errno);
-		vfs_instance_t *instance = parent->instance;
 
 		if(parent)
 		{
+			vfs_instance_t *instance = parent->instance;
+
 			node = instance->callbacks.createFile(instance, context, parent, name, errno);
-			vfs_file_t *file = instance->callbacks.fileOpen(instance, context, node, flags, errno);
+			vfs_file_t *file = node ? instance->callbacks.fileOpen(instance, context, node, flags, errno) : NULL;
 
 			if(!file)
 			{
-				process_releaseFiledescriptor(process, filedescriptor);
-				process_unlock(process);
-
+				process_cancelFiledescriptor(process, filedescriptor);
 				return -1;
 			}
 
-			process_setFileForFiledescriptor(process, filedescriptor, file);
-			process_unlock(process);
-
-			return filedescriptor;
+			return vfs_installFile(process, filedescriptor, file, errno);
 		}
 	}
 	
 	*errno = ENOENT;
 
-	process_releaseFiledescriptor(process, filedescriptor);
-	process_unlock(process);
-
+	process_cancelFiledescriptor(process, filedescriptor);
 	return -1;
 }
 
 int vfs_close(int fd)
 {
 	process_t *process = process_getCurrentProcess();
-	vfs_file_t *file = process_fileWithFiledescriptor(process, fd);
+	vfs_file_t *file = process_releaseFiledescriptor(process, fd);
 	if(!file)
 		return -1;
 
-	vfs_context_t *context = vfs_getCurrentContext();
-	vfs_instance_t *instance = file->node->instance;
-
-	instance->callbacks.fileClose(instance, context, file);
-	
-	process_releaseFiledescriptor(process, fd);
+	vfs_fileRelease(file);
 	return 0;
 }
 
+int vfs_dup(int fd, int *errno)
+{
+	process_t *process = process_getCurrentProcess();
+	return process_duplicateFiledescriptor(process, fd, -1, errno);
+}
+
+int vfs_dup2(int fd, int target, int *errno)
+{
+	if(target < 0)
+	{
+		*errno = EBADF;
+		return -1;
+	}
+
+	process_t *process = process_getCurrentProcess();
+	return process_duplicateFiledescriptor(process, fd, target, errno);
+}
+
 size_t vfs_write(int fd, const void *data, size_t size, int *errno)
 {
 	process_t *process = process_getCurrentProcess();
@@ -210,12 +217,17 @@ size_t vfs_write(int fd, const void *data, size_t size, int *errno)
 
 	if(!file || !(file->flags & O_WRONLY || file->flags & O_RDWR))
 	{
+		if(file)
+			vfs_fileRelease(file);
+
 		*errno = EBADF;
 		return -1;
 	}
 
 	if(file->node->type == vfs_nodeTypeDirectory)
 	{
+		vfs_fileRelease(file);
+
 		*errno = EISDIR;
 		return -1;
 	}
@@ -223,7 +235,10 @@ size_t vfs_write(int fd, const void *data, size_t size, int *errno)
 	vfs_context_t *context = vfs_getCurrentContext();
 	vfs_instance_t *instance = file->node->instance;
 
-	return instance->callbacks.fileWrite(instance, context, file, data, size, errno);
+	size_t result = instance->callbacks.fileWrite(instance, context, file, data, size, errno);
+	vfs_fileRelease(file);
+
+	return result;
 }
 
 size_t vfs_read(int fd, void *data, size_t size, int *errno)
@@ -233,12 +248,17 @@ size_t vfs_read(int fd, void *data, size_t size, int *errno)
 
 	if(!file || !(file->flags & O_RDONLY || file->flags & O_RDWR))
 	{
+		if(file)
+			vfs_fileRelease(file);
+
 		*errno = EBADF;
 		return -1;
 	}
 
 	if(file->node->type == vfs_nodeTypeDirectory)
 	{
+		vfs_fileRelease(file);
+
 		*errno = EISDIR;
 		return -1;
 	}
@@ -246,7 +266,10 @@ size_t vfs_read(int fd, void *data, size_t size, int *errno)
 	vfs_context_t *context = vfs_getCurrentContext();
 	vfs_instance_t *instance = file->node->instance;
 
-	return instance->callbacks.fileRead(instance, context, file, data, size, errno);
+	size_t result = instance->callbacks.fileRead(instance, context, file, data, size, errno);
+	vfs_fileRelease(file);
+
+	return result;
 }
 
 off_t vfs_seek(int fd, off_t offset, int whence, int *errno)
@@ -263,7 +286,10 @@ off_t vfs_seek(int fd, off_t offset, int whence, int *errno)
 	vfs_context_t *context = vfs_getCurrentContext();
 	vfs_instance_t *instance = file->node->instance;
 
-	return instance->callbacks.fileSeek(instance, context, file, offset, whence, errno);
+	off_t result = instance->callbacks.fileSeek(instance, context, file, offset, whence, errno);
+	vfs_fileRelease(file);
+
+	return result;
 }
 
 off_t vfs_readDir(int fd, struct vfs_directory_entry_s *entp, uint32_t count, int *errno)
@@ -279,6 +305,8 @@ off_t vfs_readDir(int fd, struct vfs_directory_entry_s *entp, uint32_t count, in
 
 	if(file->node->type == vfs_nodeTypeFile)
 	{
+		vfs_fileRelease(file);
+
 		*errno = ENOTDIR;
 		return -1;
 	}
@@ -287,7 +315,109 @@ off_t vfs_readDir(int fd, struct vfs_directory_entry_s *entp, uint32_t count, in
 	vfs_context_t *context = vfs_getCurrentContext();
 	vfs_instance_t *instance = file->node->instance;
 
-	return instance->callbacks.dirRead(instance, context, file, entp, count, errno);
+	// Legacy fixed size entries, read one record at a time and expand it.
+	// Asking for a single record keeps the file from moving past entries that weren't copied out
+	uint8_t buffer[VFS_DIRENT_MAXLENGTH];
+	vfs_dirent_t *dirent = (vfs_dirent_t *)buffer;
+	vfs_directory_entry_t entry;
+
+	off_t read = 0;
+
+	while(read < (off_t)count)
+	{
+		size_t result = instance->callbacks.dirRead(instance, context, file, dirent, VFS_DIRENT_MAXLENGTH, 1, errno);
+		if(result == 0)
+			break;
+
+		if(result == (size_t)-1)
+		{
+			read = -1;
+			break;
+		}
+
+		entry.id = dirent->id;
+		entry.type = (vfs_node_type_t)dirent->type;
+		strcpy(entry.name, dirent->name);
+
+		if(!vfs_contextCopyDataIn(context, &entry, sizeof(vfs_directory_entry_t), entp + read, errno))
+		{
+			read = -1;
+			break;
+		}
+
+		read ++;
+	}
+
+	vfs_fileRelease(file);
+	return read;
+}
+
+size_t vfs_getDents(int fd, void *data, size_t size, int *errno)
+{
+	process_t *process = process_getCurrentProcess();
+	vfs_file_t *file = process_fileWithFiledescriptor(process, fd);
+
+	if(!file)
+	{
+		*errno = EBADF;
+		return -1;
+	}
+
+	if(file->node->type == vfs_nodeTypeFile || size < VFS_DIRENT_LENGTH(0))
+	{
+		*errno = (file->node->type == vfs_nodeTypeFile) ? ENOTDIR : EINVAL;
+
+		vfs_fileRelease(file);
+		return -1;
+	}
+
+	vfs_context_t *context = vfs_getCurrentContext();
+	vfs_instance_t *instance = file->node->instance;
+
+	// The records are collected in a kernel buffer and copied out in one go per refill
+	size_t bufferSize = MIN(size, VM_PAGE_SIZE);
+	vfs_dirent_t *buffer = halloc(NULL, bufferSize);
+	if(!buffer)
+	{
+		vfs_fileRelease(file);
+
+		*errno = ENOMEM;
+		return -1;
+	}
+
+	uint8_t *target = data;
+	size_t written = 0;
+
+	while(written < size)
+	{
+		size_t result = instance->callbacks.dirRead(instance, context, file, buffer, MIN(size - written, bufferSize), UINT32_MAX, errno);
+		if(result == (size_t)-1)
+		{
+			// Only an error if not even a single entry could be returned
+			if(written > 0)
+				*errno = 0;
+			else
+				written = -1;
+
+			break;
+		}
+
+		if(result == 0)
+			break;
+
+		if(!vfs_contextCopyDataIn(context, buffer, result, target + written, errno))
+		{
+			written = -1;
+			break;
+		}
+
+		written += result;
+	}
+
+	hfree(NULL, buffer);
+	vfs_fileRelease(file);
+
+	return written;
 }
 
 
@@ -408,6 +538,8 @@ void vfs_readInitrd()
 
 			dbg("loading initrd (%u bytes)...", end - buffer);
 
+			// The module stays mapped and marked as used for the lifetime of the kernel,
+			// so the file nodes reference their data in place instead of copying it into the ffs
 			while(buffer < end)
 			{
 				// Read the file header
@@ -419,38 +551,28 @@ void vfs_readInitrd()
 				buffer += 8;
 
 				// Read the files destination path
-				char *name = halloc(NULL, nameLength + 1);
-				memcpy(name, buffer, nameLength);
+				char *path = halloc(NULL, nameLength + 1);
+				memcpy(path, buffer, nameLength);
 
-				name[nameLength] = '\0';
+				path[nameLength] = '\0';
 				buffer += nameLength;
 
-				// Read the files data
+				// Create the file node
+				char name[kVFSMaxFilenameLength];
 				int error;
-				int fd = vfs_open(name, O_WRONLY | O_CREAT, &error);
-				if(fd >= 0)
-				{
-					size_t left = binaryLength;
-					while(left > 0)
-					{
-						size_t written = vfs_write(fd, buffer, left, &error);
-
-						left   -= written;
-						buffer += written;
-					}
-
-					vfs_close(fd);
-				}
-				else
-				{
-					buffer += binaryLength;
-					warn("Couldn't open and write %s, reason: %i\n", name, error);
-				}
-
-				hfree(NULL, name);
-			}
 
-			// TODO: At this point we could unmap the initrd module from the virtual address space
+				vfs_node_t *parent = vfs_resolvePathToParent(path, vfs_kernelContext, name, &error);
+				vfs_node_t *node = NULL;
+
+				if(parent && parent->instance == vfs_rootInstance)
+					node = ffs_createFileWithData(vfs_rootInstance, parent, name, buffer, binaryLength, &error);
+
+				if(!node)
+					warn("Couldn't create %s, reason: %i\n", path, error);
+
+				buffer += binaryLength;
+				hfree(NULL, path);
+			}
 
 			dbg("done");
 			break;
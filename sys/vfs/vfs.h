@@ -33,11 +33,14 @@ vfs_descriptor_t *vfs_filesystemWithName(const char *name);
 
 int vfs_open(const char *path, int flags, int *errno);
 int vfs_close(int fd);
+int vfs_dup(int fd, int *errno);
+int vfs_dup2(int fd, int target, int *errno);
 
 size_t vfs_read(int fd, void *data, size_t size, int *errno);
 size_t vfs_write(int fd, const void *data, size_t size, int *errno);
 off_t vfs_seek(int fd, off_t offset, int whence, int *errno);
 off_t vfs_readDir(int fd, struct vfs_directory_entry_s *entp, uint32_t count, int *errno);
+size_t vfs_getDents(int fd, void *data, size_t size, int *errno);
 
 bool vfs_mkdir(const char *path, int *errno);
 bool vfs_remove(const char *path, int *errno);